@@ -0,0 +1,80 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2019  Made to Order Software Corporation
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Implementation of zipios::CachedInputStream.
+ *
+ * This file includes the implementation of the zipios::CachedInputStream
+ * class which reads the content of a cached entry.
+ */
+
+#include "cachedinputstream.hpp"
+
+
+namespace zipios
+{
+
+
+/** \class CachedInputStream
+ * \brief An istream reading the content of a cached entry.
+ *
+ * The collections that have an EntryCache return this stream when the
+ * entry being read is found in the cache. The stream reads directly
+ * from the shared data of the cache, so creating it does not require
+ * any copy and it supports seeking anywhere in the entry.
+ *
+ * The stream holds a reference to the data so it remains valid even
+ * after the entry gets evicted from the cache.
+ */
+
+
+/** \brief Initialize a CachedInputStream.
+ *
+ * \param[in] data  The content of the entry to read.
+ */
+CachedInputStream::CachedInputStream(EntryCache::data_t data)
+    : std::istream(nullptr)
+    , m_data(data)
+    , m_buf(m_data->empty() ? nullptr : &(*m_data)[0], m_data->size())
+{
+    // properly initialize the stream with the buffer
+    init(&m_buf);
+}
+
+
+/** \brief Clean up the CachedInputStream.
+ *
+ * The reference to the data gets released.
+ */
+CachedInputStream::~CachedInputStream()
+{
+}
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
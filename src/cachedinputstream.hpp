@@ -0,0 +1,65 @@
+#pragma once
+#ifndef ZIPIOS_CACHEDINPUTSTREAM_HPP
+#define ZIPIOS_CACHEDINPUTSTREAM_HPP
+
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2019  Made to Order Software Corporation
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Define zipios::CachedInputStream.
+ *
+ * This file declares the zipios::CachedInputStream class used to read
+ * the content of an entry saved in a zipios::EntryCache.
+ */
+
+#include "zipios/entrycache.hpp"
+
+#include "memoryinputstreambuf.hpp"
+
+
+namespace zipios
+{
+
+
+class CachedInputStream : public std::istream
+{
+public:
+                    CachedInputStream(EntryCache::data_t data);
+                    CachedInputStream(CachedInputStream const & src) = delete;
+    CachedInputStream & operator = (CachedInputStream const & rhs) = delete;
+    virtual         ~CachedInputStream() override;
+
+private:
+    EntryCache::data_t      m_data;
+    MemoryInputStreambuf    m_buf;
+};
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
+#endif
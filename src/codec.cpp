@@ -0,0 +1,351 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2019  Made to Order Software Corporation
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Implementation of the zipios::Codec interface.
+ *
+ * This file implements the functions used to create codecs and the
+ * helper functions shared by all the codecs.
+ */
+
+#include "codec.hpp"
+
+#include "zipios/zipiosexceptions.hpp"
+
+#ifdef ZIPIOS_HAS_LZMA
+#include "lzmacodec.hpp"
+#endif
+#ifdef ZIPIOS_HAS_ZSTD
+#include "zstdcodec.hpp"
+#endif
+
+
+namespace zipios
+{
+
+
+/** \class Codec
+ * \brief Interface of the compression methods other than DEFLATED.
+ *
+ * STORED and DEFLATED entries are handled directly by the Zip streams
+ * since zlib is always available. The other compression methods are
+ * implemented by a Codec. A codec compresses and decompresses the data
+ * of one entry at a time, in a streaming manner: the caller gives it
+ * buffers and the codec consumes input and produces output until one
+ * or the other is exhausted.
+ *
+ * The codecs available depend on the libraries found at build time:
+ *
+ * \li LZMA (method 14) requires liblzma (see ZIPIOS_USE_LZMA);
+ * \li Zstandard (method 93) requires libzstd (see ZIPIOS_USE_ZSTD).
+ *
+ * A codec object is not thread safe. Each stream creates its own.
+ */
+
+
+/** \brief Clean up a codec.
+ *
+ * The destructor is virtual so codecs can be destroyed through
+ * a pointer to this interface.
+ */
+Codec::~Codec()
+{
+}
+
+
+/** \brief Check whether a compression method is supported by a codec.
+ *
+ * This function returns true if create() can create a codec for
+ * \p method in this build of Zipios.
+ *
+ * STORED and DEFLATED are not handled by codecs so the function
+ * returns false for those.
+ *
+ * \param[in] method  The method to check.
+ *
+ * \return true if a codec is available for \p method.
+ */
+bool Codec::isSupported(StorageMethod method)
+{
+    switch(method)
+    {
+#ifdef ZIPIOS_HAS_LZMA
+    case StorageMethod::LZMA:
+        return true;
+#endif
+
+#ifdef ZIPIOS_HAS_ZSTD
+    case StorageMethod::ZSTD:
+        return true;
+#endif
+
+    default:
+        return false;
+
+    }
+}
+
+
+/** \brief Create a codec.
+ *
+ * This function creates a codec for the compression method \p method.
+ *
+ * \exception FileCollectionException
+ * No codec is available for \p method in this build of Zipios.
+ *
+ * \param[in] method  The compression method of the entry.
+ *
+ * \return A pointer to the new codec.
+ *
+ * \sa isSupported()
+ */
+Codec::pointer_t Codec::create(StorageMethod method)
+{
+    switch(method)
+    {
+#ifdef ZIPIOS_HAS_LZMA
+    case StorageMethod::LZMA:
+        return pointer_t(new LzmaCodec);
+#endif
+
+#ifdef ZIPIOS_HAS_ZSTD
+    case StorageMethod::ZSTD:
+        return pointer_t(new ZstdCodec);
+#endif
+
+    default:
+        throw FileCollectionException("Unsupported compression format");
+
+    }
+}
+
+
+/** \fn StorageMethod Codec::getMethod() const;
+ * \brief Retrieve the compression method of this codec.
+ *
+ * \return The method saved in the headers of the entries compressed
+ *         with this codec.
+ */
+
+
+/** \brief Retrieve the version needed to extract the entry.
+ *
+ * The compression methods implemented as codecs all require version
+ * 6.3 of the Zip format.
+ *
+ * \return The version needed to extract the entries compressed with
+ *         this codec.
+ */
+uint16_t Codec::getExtractVersion() const
+{
+    return 63;
+}
+
+
+/** \brief Retrieve the general purpose flags of the entry.
+ *
+ * Some compression methods use bits of the general purpose bit field
+ * of the headers to describe the compressed data. By default, no flag
+ * is required.
+ *
+ * \return The flags to set in the headers of the entries compressed
+ *         with this codec.
+ */
+uint16_t Codec::getGeneralPurposeFlags() const
+{
+    return 0;
+}
+
+
+/** \fn size_t Codec::getCompressBound(size_t size) const;
+ * \brief Compute the largest compressed size of some data.
+ *
+ * The ZipOutputStreambuf uses this bound to decide whether the headers
+ * of an entry need Zip64 before the data gets compressed.
+ *
+ * \param[in] size  The size of the uncompressed data.
+ *
+ * \return The largest possible size of the compressed data.
+ */
+
+
+/** \fn void Codec::startDecompression(size_t uncompressed_size);
+ * \brief Get ready to decompress the data of an entry.
+ *
+ * This function must be called before the first call to decompress()
+ * and again each time the decompression needs to restart from the
+ * beginning of the data.
+ *
+ * \param[in] uncompressed_size  The size of the data once decompressed
+ *                               as found in the headers of the entry.
+ */
+
+
+/** \fn bool Codec::decompress(char const * & input, size_t & input_size, char * & output, size_t & output_size);
+ * \brief Decompress some data.
+ *
+ * This function decompresses data from \p input to \p output. On
+ * return, the pointers and sizes are updated to point to the input
+ * not yet consumed and the output not yet used.
+ *
+ * The function never reads past the end of the compressed data so
+ * whatever follows in the archive may be passed in \p input too.
+ *
+ * \exception IOException
+ * The compressed data is invalid.
+ *
+ * \param[in,out] input  The compressed data.
+ * \param[in,out] input_size  The number of bytes in \p input.
+ * \param[in,out] output  The buffer receiving the uncompressed data.
+ * \param[in,out] output_size  The number of bytes available in \p output.
+ *
+ * \return true once the end of the compressed data was reached.
+ */
+
+
+/** \brief Decompress the whole data of an entry.
+ *
+ * This function decompresses the \p input_size bytes of \p input in
+ * \p output. The data must decompress to exactly \p output_size bytes.
+ * Any data after the end of the compressed data is ignored.
+ *
+ * \exception IOException
+ * The compressed data is invalid or does not decompress to exactly
+ * \p output_size bytes.
+ *
+ * \param[in] input  The compressed data.
+ * \param[in] input_size  The number of bytes in \p input.
+ * \param[out] output  The buffer receiving the uncompressed data.
+ * \param[in] output_size  The exact size of the uncompressed data.
+ */
+void Codec::decompressAll(char const * input, size_t input_size, char * output, size_t output_size)
+{
+    startDecompression(output_size);
+    for(;;)
+    {
+        size_t const available_input(input_size);
+        size_t const available_output(output_size);
+        if(decompress(input, input_size, output, output_size))
+        {
+            if(output_size != 0)
+            {
+                throw IOException("Codec::decompressAll(): the data is smaller than expected.");
+            }
+            return;
+        }
+        if(input_size == available_input
+        && output_size == available_output)
+        {
+            throw IOException("Codec::decompressAll(): the data is truncated or larger than expected.");
+        }
+    }
+}
+
+
+/** \fn void Codec::startCompression(FileEntry::CompressionLevel level, size_t size);
+ * \brief Get ready to compress the data of an entry.
+ *
+ * This function must be called before the first call to compress()
+ * of each entry.
+ *
+ * The \p size parameter is only a hint used to reduce the memory
+ * used to compress small entries. The data may end up being larger.
+ *
+ * \param[in] level  The compression level, COMPRESSION_LEVEL_NONE is
+ *                   not valid here.
+ * \param[in] size  The expected size of the uncompressed data.
+ */
+
+
+/** \fn bool Codec::compress(char const * & input, size_t & input_size, char * & output, size_t & output_size, bool finish);
+ * \brief Compress some data.
+ *
+ * This function compresses data from \p input to \p output. On return,
+ * the pointers and sizes are updated to point to the input not yet
+ * consumed and the output not yet used. The function must be called
+ * again with more output space until all the input was consumed.
+ *
+ * Once all the data was given to the codec, the function must be
+ * called with \p finish set to true until it returns true so the
+ * codec can output the data it still buffers.
+ *
+ * \exception IOException
+ * The compression failed.
+ *
+ * \param[in,out] input  The data to compress.
+ * \param[in,out] input_size  The number of bytes in \p input.
+ * \param[in,out] output  The buffer receiving the compressed data.
+ * \param[in,out] output_size  The number of bytes available in \p output.
+ * \param[in] finish  Whether all the data was given to the codec.
+ *
+ * \return true once \p finish is true and all the compressed data
+ *         was output.
+ */
+
+
+/** \brief Convert a Zipios compression level to a library level.
+ *
+ * The levels from 1 to 100 are converted linearly to the levels from
+ * \p fastest to \p smallest.
+ *
+ * \param[in] level  The Zipios compression level.
+ * \param[in] fastest  The fastest level of the library.
+ * \param[in] normal  The default level of the library.
+ * \param[in] smallest  The level of the library compressing the most.
+ *
+ * \return The corresponding level of the library.
+ */
+int Codec::convertLevel(FileEntry::CompressionLevel level, int fastest, int normal, int smallest)
+{
+    switch(level)
+    {
+    case FileEntry::COMPRESSION_LEVEL_DEFAULT:
+        return normal;
+
+    case FileEntry::COMPRESSION_LEVEL_SMALLEST:
+        return smallest;
+
+    case FileEntry::COMPRESSION_LEVEL_FASTEST:
+        return fastest;
+
+    default:
+        if(level < FileEntry::COMPRESSION_LEVEL_MINIMUM
+        || level > FileEntry::COMPRESSION_LEVEL_MAXIMUM)
+        {
+            // This is excluded from the coverage since if we reach this
+            // line there is an internal error that needs to be fixed.
+            throw std::logic_error("the compression level must be defined between -3 and 100, see the zipios/fileentry.hpp for a list of valid levels."); // LCOV_EXCL_LINE
+        }
+        return fastest + ((level - 1) * (smallest - fastest) + 99 / 2) / 99;
+
+    }
+}
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
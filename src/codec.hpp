@@ -0,0 +1,78 @@
+#pragma once
+#ifndef ZIPIOS_CODEC_HPP
+#define ZIPIOS_CODEC_HPP
+
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2019  Made to Order Software Corporation
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Declaration of the zipios::Codec interface.
+ *
+ * The zipios::Codec interface is implemented by the compression methods
+ * other than STORED and DEFLATED, such as LZMA and Zstandard.
+ */
+
+#include "zipios/fileentry.hpp"
+
+#include <memory>
+
+
+namespace zipios
+{
+
+
+class Codec
+{
+public:
+    typedef std::shared_ptr<Codec>  pointer_t;
+
+    virtual                     ~Codec();
+
+    static bool                 isSupported(StorageMethod method);
+    static pointer_t            create(StorageMethod method);
+
+    virtual StorageMethod       getMethod() const = 0;
+    virtual uint16_t            getExtractVersion() const;
+    virtual uint16_t            getGeneralPurposeFlags() const;
+    virtual size_t              getCompressBound(size_t size) const = 0;
+
+    virtual void                startDecompression(size_t uncompressed_size) = 0;
+    virtual bool                decompress(char const * & input, size_t & input_size, char * & output, size_t & output_size) = 0;
+    void                        decompressAll(char const * input, size_t input_size, char * output, size_t output_size);
+
+    virtual void                startCompression(FileEntry::CompressionLevel level, size_t size) = 0;
+    virtual bool                compress(char const * & input, size_t & input_size, char * & output, size_t & output_size, bool finish) = 0;
+
+protected:
+    static int                  convertLevel(FileEntry::CompressionLevel level, int fastest, int normal, int smallest);
+};
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
+#endif
@@ -30,8 +30,11 @@
 
 #include "zipios/zipiosexceptions.hpp"
 
+#include "cachedinputstream.hpp"
 #include "zipios_common.hpp"
 
+#include <algorithm>
+
 
 namespace zipios
 {
@@ -55,7 +58,7 @@ namespace
  *                              can save the found file collection.
  * \param[in] matchpath  How the name of the entry is compared with \p name.
  */
-void matchEntry(CollectionCollection::vector_t collections, std::string const& name, FileEntry::pointer_t& cep, FileCollection::pointer_t& file_collection, CollectionCollection::MatchPath matchpath)
+void matchEntry(CollectionCollection::vector_t const & collections, std::string const& name, FileEntry::pointer_t& cep, FileCollection::pointer_t& file_collection, CollectionCollection::MatchPath matchpath)
 {
     for(auto it = collections.begin(); it != collections.end(); ++it)
     {
@@ -70,6 +73,32 @@ void matchEntry(CollectionCollection::vector_t collections, std::string const& n
     file_collection.reset();
 }
 
+
+/** \brief Merge a sorted list of entries in another.
+ *
+ * The glob() and listDirectory() functions of the children collections
+ * return their entries sorted by name. This function merges \p entries
+ * in \p all_entries so the result is also sorted by name. When two
+ * entries have the same name, the one of the first collection comes
+ * first.
+ *
+ * \param[in,out] all_entries  The entries found so far.
+ * \param[in] entries  The entries of the next collection.
+ */
+void mergeEntries(FileEntry::vector_t & all_entries, FileEntry::vector_t const & entries)
+{
+    size_t const middle(all_entries.size());
+    all_entries += entries;
+    std::inplace_merge(
+              all_entries.begin()
+            , all_entries.begin() + middle
+            , all_entries.end()
+            , [](FileEntry::pointer_t const & lhs, FileEntry::pointer_t const & rhs)
+            {
+                return lhs->getName() < rhs->getName();
+            });
+}
+
 } // no name namespace
 
 
@@ -85,6 +114,11 @@ void matchEntry(CollectionCollection::vector_t collections, std::string const& n
  * mounted on /. If more than one collection contain a file with
  * the same path only the one in the first added collection is
  * accessible.
+ *
+ * A cache of decompressed entries can be attached to the
+ * CollectionCollection with setCacheBudget(). Entries read through
+ * the CollectionCollection are then kept in memory whatever the type
+ * of the child collection they come from.
  */
 
 
@@ -110,12 +144,20 @@ CollectionCollection::CollectionCollection()
  */
 CollectionCollection::CollectionCollection(CollectionCollection const& src)
     : FileCollection(src)
+    //, m_collections() -- see below
+    //, m_cache() -- see below
 {
     m_collections.reserve(src.m_collections.size());
     for(auto it = src.m_collections.begin(); it != src.m_collections.end(); ++it)
     {
         m_collections.push_back((*it)->clone());
     }
+
+    EntryCache::pointer_t cache(std::atomic_load(&src.m_cache));
+    if(cache != nullptr)
+    {
+        m_cache.reset(new EntryCache(cache->getBudget()));
+    }
 }
 
 
@@ -143,6 +185,11 @@ CollectionCollection& CollectionCollection::operator = (CollectionCollection con
         {
             m_collections.push_back((*it)->clone());
         }
+
+        EntryCache::pointer_t cache(std::atomic_load(&rhs.m_cache));
+        std::atomic_store(&m_cache, cache == nullptr
+                                        ? EntryCache::pointer_t()
+                                        : EntryCache::pointer_t(new EntryCache(cache->getBudget())));
     }
 
     return *this;
@@ -272,11 +319,32 @@ void CollectionCollection::close()
         (*it)->close();
     }
     m_collections.clear();
+    std::atomic_store(&m_cache, EntryCache::pointer_t());
 
     FileCollection::close();
 }
 
 
+/** \brief Retrieve the statistics of the cache of this collection.
+ *
+ * If no cache is attached to this CollectionCollection, all the fields
+ * of the returned statistics are zero.
+ *
+ * \return A copy of the statistics of the cache.
+ *
+ * \sa setCacheBudget()
+ */
+EntryCache::statistics_t CollectionCollection::getCacheStatistics() const
+{
+    EntryCache::pointer_t cache(std::atomic_load(&m_cache));
+    if(cache == nullptr)
+    {
+        return EntryCache::statistics_t();
+    }
+    return cache->getStatistics();
+}
+
+
 /** \brief Retrieve a vector to all the collection entries.
  *
  * This function gathers the entries of all the children collections
@@ -352,6 +420,60 @@ FileEntry::pointer_t CollectionCollection::getEntry(std::string const& name, Mat
 }
 
 
+/** \brief Retrieve the entries matching a pattern.
+ *
+ * This function gathers the entries matching \p pattern in all the
+ * children collections. The result is sorted by name.
+ *
+ * Contrary to getEntry(), an entry found in multiple collections is
+ * returned once per collection, as entries() does.
+ *
+ * \param[in] pattern  The pattern the names of the entries have to match.
+ *
+ * \return The matching entries of all the children collections.
+ *
+ * \sa FileCollection::glob()
+ */
+FileEntry::vector_t CollectionCollection::glob(std::string const & pattern) const
+{
+    mustBeValid();
+
+    FileEntry::vector_t all_entries;
+    for(auto it = m_collections.begin(); it != m_collections.end(); ++it)
+    {
+        mergeEntries(all_entries, (*it)->glob(pattern));
+    }
+
+    return all_entries;
+}
+
+
+/** \brief Retrieve the entries found in a directory.
+ *
+ * This function gathers the entries found in the \p prefix directory
+ * of all the children collections. The result is sorted by name.
+ *
+ * \param[in] prefix  The name of the directory to list.
+ * \param[in] recursive  Whether the entries of sub-directories are included.
+ *
+ * \return The entries of that directory in all the children collections.
+ *
+ * \sa FileCollection::listDirectory()
+ */
+FileEntry::vector_t CollectionCollection::listDirectory(std::string const & prefix, bool recursive) const
+{
+    mustBeValid();
+
+    FileEntry::vector_t all_entries;
+    for(auto it = m_collections.begin(); it != m_collections.end(); ++it)
+    {
+        mergeEntries(all_entries, (*it)->listDirectory(prefix, recursive));
+    }
+
+    return all_entries;
+}
+
+
 /** \brief Retrieve pointer to an istream.
  *
  * This function returns a shared pointer to an istream defined from the
@@ -372,6 +494,10 @@ FileEntry::pointer_t CollectionCollection::getEntry(std::string const& name, Mat
  * and want to ignore the directory name, set the matchpath parameter
  * to MatchPath::IGNORE.
  *
+ * When a cache is attached to this CollectionCollection (see
+ * setCacheBudget()), the entry gets read in the cache the first time
+ * and the returned stream reads from that cached copy.
+ *
  * \param[in] entry_name  The name of the file to search in the collection.
  * \param[in] matchpath  Whether the full path or just the filename is matched.
  *
@@ -389,8 +515,91 @@ CollectionCollection::stream_pointer_t CollectionCollection::getInputStream(std:
     FileEntry::pointer_t cep;
 
     matchEntry(m_collections, entry_name, cep, file_collection, matchpath);
+    if(!cep)
+    {
+        return nullptr;
+    }
+
+    EntryCache::pointer_t cache(std::atomic_load(&m_cache));
+    if(cache == nullptr
+    || cep->isDirectory())
+    {
+        return file_collection->getInputStream(entry_name, matchpath);
+    }
+
+    // the first collection with a matching entry always is the one
+    // which defines the entry with that exact name so the name of the
+    // entry found is a valid key for both MatchPath values
+    //
+    EntryCache::data_t data(cache->find(cep->getName()));
+    if(data == nullptr)
+    {
+        stream_pointer_t is(file_collection->getInputStream(entry_name, matchpath));
+        if(!is
+        || cep->getSize() > cache->getBudget())
+        {
+            return is;
+        }
+
+        // the size is a hint, the stream defines the actual data
+        //
+        std::shared_ptr<std::vector<char>> buffer(new std::vector<char>(cep->getSize()));
+        size_t size(0);
+        for(;;)
+        {
+            if(size == buffer->size())
+            {
+                buffer->resize(size + getBufferSize());
+            }
+            std::streamsize const r(is->rdbuf()->sgetn(&(*buffer)[size], buffer->size() - size));
+            if(r <= 0)
+            {
+                break;
+            }
+            size += r;
+        }
+        buffer->resize(size);
+
+        cache->insert(cep->getName(), buffer);
+        data = buffer;
+    }
+
+    return stream_pointer_t(new CachedInputStream(data));
+}
+
+
+/** \brief Attach a cache of entries to this CollectionCollection.
+ *
+ * Once a budget is defined, the getInputStream() function reads the
+ * whole entry in the cache the first time it gets requested and all
+ * the following calls for that entry return a stream reading the
+ * cached data, until the entry gets evicted. The cache holds at most
+ * \p budget bytes of data; entries larger than that are read as usual.
+ *
+ * Changing the budget of an existing cache keeps the cached entries
+ * that still fit. Setting the budget to zero removes the cache.
+ *
+ * \param[in] budget  The maximum number of bytes to cache, or zero.
+ *
+ * \sa getCacheStatistics()
+ */
+void CollectionCollection::setCacheBudget(size_t budget)
+{
+    if(budget == 0)
+    {
+        std::atomic_store(&m_cache, EntryCache::pointer_t());
+        return;
+    }
 
-    return cep ? file_collection->getInputStream(entry_name) : nullptr;
+    EntryCache::pointer_t cache(std::atomic_load(&m_cache));
+    if(cache != nullptr)
+    {
+        cache->setBudget(budget);
+    }
+    else
+    {
+        std::atomic_store(&m_cache, EntryCache::pointer_t(new EntryCache(budget)));
+    }
 }
 
 
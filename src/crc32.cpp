@@ -0,0 +1,299 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2019  Made to Order Software Corporation
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Implementation of the CRC-32 functions.
+ *
+ * The CRC-32 of Zip archives gets computed with the PCLMULQDQ
+ * instruction when the processor supports it and with zlib otherwise.
+ */
+
+#include "crc32.hpp"
+
+#include <algorithm>
+
+#include <zlib.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define ZIPIOS_CRC32_PCLMUL
+#include <smmintrin.h>
+#include <wmmintrin.h>
+#endif
+
+
+namespace zipios
+{
+
+
+namespace
+{
+
+
+/** \brief The type of the functions computing a CRC-32.
+ *
+ * The \p crc parameter and the returned value are the CRC as
+ * returned by zlib crc32(), i.e. not inverted.
+ */
+typedef uint32_t (*crc32_function_t)(uint32_t crc, unsigned char const * data, size_t size);
+
+
+/** \brief Compute a CRC-32 with zlib.
+ *
+ * This is the portable implementation. zlib counts bytes with 32 bit
+ * numbers so large buffers are processed in several calls.
+ *
+ * \param[in] crc  The CRC of the previous data.
+ * \param[in] data  The data to add to the CRC.
+ * \param[in] size  The number of bytes in \p data.
+ *
+ * \return The updated CRC.
+ */
+uint32_t crc32_zlib(uint32_t crc, unsigned char const * data, size_t size)
+{
+    while(size > 0)
+    {
+        uInt const chunk(static_cast<uInt>(std::min(size, static_cast<size_t>(1) << 30)));
+        crc = static_cast<uint32_t>(crc32(crc, data, chunk));
+        data += chunk;
+        size -= chunk;
+    }
+    return crc;
+}
+
+
+#ifdef ZIPIOS_CRC32_PCLMUL
+/** \brief The folding constants of the CRC-32 polynomial.
+ *
+ * These constants are the powers of x modulo the reflected CRC-32
+ * polynomial (0xEDB88320) used to fold 512, 128, and 64 bits at a
+ * time, followed by the constants of the Barrett reduction. See
+ * "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ
+ * Instruction" by Intel.
+ */
+alignas(16) uint64_t const g_k1k2[2] = { 0x0154442bd4, 0x01c6e41596 };
+alignas(16) uint64_t const g_k3k4[2] = { 0x01751997d0, 0x00ccaa009e };
+alignas(16) uint64_t const g_k5k0[2] = { 0x0163cd6124, 0x0000000000 };
+alignas(16) uint64_t const g_poly[2] = { 0x01db710641, 0x01f7011641 };
+
+
+/** \brief Fold a buffer with PCLMULQDQ.
+ *
+ * This function computes the CRC of \p size bytes. The size must be
+ * at least 64 and a multiple of 16. The CRC is inverted on input and
+ * output.
+ *
+ * \param[in] crc  The inverted CRC of the previous data.
+ * \param[in] data  The data to add to the CRC.
+ * \param[in] size  The number of bytes in \p data.
+ *
+ * \return The inverted CRC.
+ */
+__attribute__((target("pclmul,sse4.1")))
+uint32_t crc32_fold(uint32_t crc, unsigned char const * data, size_t size)
+{
+    __m128i const * p(reinterpret_cast<__m128i const *>(data));
+
+    __m128i x1(_mm_loadu_si128(p + 0));
+    __m128i x2(_mm_loadu_si128(p + 1));
+    __m128i x3(_mm_loadu_si128(p + 2));
+    __m128i x4(_mm_loadu_si128(p + 3));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(static_cast<int>(crc)));
+    p += 4;
+    size -= 64;
+
+    // fold 512 bits at a time
+    //
+    __m128i k(_mm_load_si128(reinterpret_cast<__m128i const *>(g_k1k2)));
+    while(size >= 64)
+    {
+        __m128i const x5(_mm_clmulepi64_si128(x1, k, 0x00));
+        __m128i const x6(_mm_clmulepi64_si128(x2, k, 0x00));
+        __m128i const x7(_mm_clmulepi64_si128(x3, k, 0x00));
+        __m128i const x8(_mm_clmulepi64_si128(x4, k, 0x00));
+        x1 = _mm_clmulepi64_si128(x1, k, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, k, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, k, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, k, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128(p + 0));
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128(p + 1));
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128(p + 2));
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128(p + 3));
+        p += 4;
+        size -= 64;
+    }
+
+    // fold the 4 x 128 bits in 128 bits
+    //
+    k = _mm_load_si128(reinterpret_cast<__m128i const *>(g_k3k4));
+    __m128i x5(_mm_clmulepi64_si128(x1, k, 0x00));
+    x1 = _mm_clmulepi64_si128(x1, k, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, k, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, k, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    // fold the remaining 128 bit blocks
+    //
+    while(size >= 16)
+    {
+        x5 = _mm_clmulepi64_si128(x1, k, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128(p)), x5);
+        ++p;
+        size -= 16;
+    }
+
+    // fold 128 bits to 64 bits
+    //
+    __m128i const mask(_mm_setr_epi32(~0, 0, ~0, 0));
+    x2 = _mm_clmulepi64_si128(x1, k, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+    k = _mm_loadl_epi64(reinterpret_cast<__m128i const *>(g_k5k0));
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, mask);
+    x1 = _mm_clmulepi64_si128(x1, k, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    // Barrett reduction to 32 bits
+    //
+    k = _mm_load_si128(reinterpret_cast<__m128i const *>(g_poly));
+    x2 = _mm_and_si128(x1, mask);
+    x2 = _mm_clmulepi64_si128(x2, k, 0x10);
+    x2 = _mm_and_si128(x2, mask);
+    x2 = _mm_clmulepi64_si128(x2, k, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return static_cast<uint32_t>(_mm_extract_epi32(x1, 1));
+}
+
+
+/** \brief Compute a CRC-32 with PCLMULQDQ.
+ *
+ * This function folds the largest multiple of 16 bytes with
+ * crc32_fold() and uses zlib for the small buffers and the last
+ * few bytes.
+ *
+ * \param[in] crc  The CRC of the previous data.
+ * \param[in] data  The data to add to the CRC.
+ * \param[in] size  The number of bytes in \p data.
+ *
+ * \return The updated CRC.
+ */
+uint32_t crc32_pclmul(uint32_t crc, unsigned char const * data, size_t size)
+{
+    if(size < 64)
+    {
+        return crc32_zlib(crc, data, size);
+    }
+
+    size_t const folded(size & ~static_cast<size_t>(15));
+    crc = ~crc32_fold(~crc, data, folded);
+    return crc32_zlib(crc, data + folded, size - folded);
+}
+#endif
+
+
+/** \brief Select the fastest CRC-32 function.
+ *
+ * \return The function to use to compute CRC-32 values.
+ */
+crc32_function_t select_crc32()
+{
+#ifdef ZIPIOS_CRC32_PCLMUL
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("pclmul")
+    && __builtin_cpu_supports("sse4.1"))
+    {
+        return crc32_pclmul;
+    }
+#endif
+    return crc32_zlib;
+}
+
+
+/** \brief The CRC-32 function selected for this processor.
+ *
+ * The function gets selected the first time it is needed.
+ *
+ * \return The selected function.
+ */
+crc32_function_t get_crc32()
+{
+    static crc32_function_t const g_crc32(select_crc32());
+    return g_crc32;
+}
+
+
+} // no name namespace
+
+
+/** \brief Update a CRC-32 with more data.
+ *
+ * This function computes the CRC-32 used by Zip archives (the same
+ * as zlib crc32()). On x86 processors with the PCLMULQDQ instruction
+ * the computation is several times faster than with zlib.
+ *
+ * Start with a \p crc of zero.
+ *
+ * \note
+ * The SSE4.2 crc32 instruction cannot be used, it computes a
+ * CRC-32C which uses a different polynomial.
+ *
+ * \param[in] crc  The CRC of the previous data, zero to start.
+ * \param[in] data  The data to add to the CRC.
+ * \param[in] size  The number of bytes in \p data.
+ *
+ * \return The CRC-32 of the previous data followed by \p data.
+ */
+uint32_t updateCrc32(uint32_t crc, void const * data, size_t size)
+{
+    return get_crc32()(crc, static_cast<unsigned char const *>(data), size);
+}
+
+
+/** \brief Retrieve the name of the CRC-32 implementation in use.
+ *
+ * \return "pclmul" or "zlib".
+ */
+char const * getCrc32Implementation()
+{
+#ifdef ZIPIOS_CRC32_PCLMUL
+    if(get_crc32() == crc32_pclmul)
+    {
+        return "pclmul";
+    }
+#endif
+    return "zlib";
+}
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
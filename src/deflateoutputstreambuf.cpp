@@ -29,6 +29,7 @@
 
 #include "zipios/zipiosexceptions.hpp"
 
+#include "crc32.hpp"
 #include "zipios_common.hpp"
 
 
@@ -57,11 +58,13 @@ namespace zipios
 DeflateOutputStreambuf::DeflateOutputStreambuf(std::streambuf *outbuf)
     : FilterOutputStreambuf(outbuf)
     //, m_overflown_bytes(0) -- auto-init
+    //, m_written_bytes(0) -- auto-init
     , m_invec(getBufferSize())
-    //, m_zs() -- auto-init
-    //, m_zs_initialized(false) -- auto-init
     , m_outvec(getBufferSize())
     //, m_crc32(0) -- auto-init
+    //, m_zs() -- auto-init
+    //, m_zs_initialized(false) -- auto-init
+    //, m_parallel_deflater() -- auto-init
 {
     // NOTICE: It is important that this constructor and the methods it
     //         calls does not do anything with the output streambuf m_outbuf.
@@ -101,9 +104,17 @@ DeflateOutputStreambuf::~DeflateOutputStreambuf()
  * is expected to come from the FileEntry which is about to be
  * saved in the file.
  *
+ * When \p thread_count is more than one, the data gets compressed in
+ * blocks by that many threads with a ParallelDeflater. The result is
+ * a standard deflate stream, slightly larger than the one produced by
+ * a single thread.
+ *
+ * \param[in] compression_level  The level used to compress the data.
+ * \param[in] thread_count  The number of threads compressing the data.
+ *
  * \return true if the initialization succeeded, false otherwise.
  */
-bool DeflateOutputStreambuf::init(FileEntry::CompressionLevel compression_level)
+bool DeflateOutputStreambuf::init(FileEntry::CompressionLevel compression_level, size_t thread_count)
 {
     if(m_zs_initialized)
     {
@@ -157,6 +168,15 @@ bool DeflateOutputStreambuf::init(FileEntry::CompressionLevel compression_level)
 
     }
 
+    m_parallel_deflater.reset();
+    if(thread_count > 1)
+    {
+        m_parallel_deflater.reset(new ParallelDeflater(zlevel, thread_count));
+        setp(&m_invec[0], &m_invec[0] + getBufferSize());
+        m_crc32 = crc32(0, Z_NULL, 0);
+        return true;
+    }
+
     // m_zs.next_in and avail_in must be set according to
     // zlib.h (inline doc).
     m_zs.next_in  = reinterpret_cast<unsigned char *>(&m_invec[0]);
@@ -208,6 +228,17 @@ void DeflateOutputStreambuf::closeStream()
     {
         m_zs_initialized = false;
 
+        if(m_parallel_deflater != nullptr)
+        {
+            // flush the remaining data, then the deflater gets destroyed
+            // even if finish() fails
+            overflow();
+            std::unique_ptr<ParallelDeflater> deflater(std::move(m_parallel_deflater));
+            m_written_bytes += deflater->finish(m_outbuf);
+            m_crc32 = deflater->getCrc32();
+            return;
+        }
+
         // flush any remaining data
         endDeflation();
 
@@ -274,6 +305,21 @@ size_t DeflateOutputStreambuf::getSize() const
  */
 int DeflateOutputStreambuf::overflow(int c)
 {
+    if(m_parallel_deflater != nullptr)
+    {
+        // the CRC gets computed by the threads
+        m_written_bytes += m_parallel_deflater->write(&m_invec[0], pptr() - pbase(), m_outbuf);
+        setp(&m_invec[0], &m_invec[0] + getBufferSize());
+
+        if(c != EOF)
+        {
+            *pptr() = c;
+            pbump(1);
+        }
+
+        return 0;
+    }
+
     int err(Z_OK);
 
     m_zs.avail_in = pptr() - pbase();
@@ -281,7 +327,7 @@ int DeflateOutputStreambuf::overflow(int c)
 
     if(m_zs.avail_in > 0)
     {
-        m_crc32 = crc32(m_crc32, m_zs.next_in, m_zs.avail_in); // update crc32
+        m_crc32 = updateCrc32(m_crc32, m_zs.next_in, m_zs.avail_in);
 
         m_zs.next_out = reinterpret_cast<unsigned char *>(&m_outvec[0]);
         m_zs.avail_out = getBufferSize();
@@ -366,6 +412,7 @@ void DeflateOutputStreambuf::flushOutvec()
             // inside the same loop in ZipFile::saveCollectionToArchive()
             throw IOException("DeflateOutputStreambuf::flushOutvec(): write to buffer failed."); // LCOV_EXCL_LINE
         }
+        m_written_bytes += deflated_bytes;
     }
 
     m_zs.next_out = reinterpret_cast<unsigned char *>(&m_outvec[0]);
@@ -33,6 +33,7 @@
  */
 
 #include "filteroutputstreambuf.hpp"
+#include "paralleldeflater.hpp"
 
 #include "zipios/fileentry.hpp"
 
@@ -52,7 +53,7 @@ public:
     DeflateOutputStreambuf& operator = (DeflateOutputStreambuf const & rhs) = delete;
     virtual                 ~DeflateOutputStreambuf();
 
-    bool                    init(FileEntry::CompressionLevel compression_level);
+    bool                    init(FileEntry::CompressionLevel compression_level, size_t thread_count = 1);
     void                    closeStream();
     uint32_t                getCrc32() const;
     size_t                  getSize() const;
@@ -61,8 +62,11 @@ protected:
     virtual int             overflow(int c = EOF);
     virtual int             sync();
 
-    uint32_t                m_overflown_bytes = 0;
+    size_t                  m_overflown_bytes = 0;
+    size_t                  m_written_bytes = 0;
     std::vector<char>       m_invec;
+    std::vector<char>       m_outvec;
+    uint32_t                m_crc32 = 0;
 
 private:
     void                    endDeflation();
@@ -70,10 +74,7 @@ private:
 
     z_stream                m_zs = z_stream();
     bool                    m_zs_initialized = false;
-
-    std::vector<char>       m_outvec;
-
-    uint32_t                m_crc32 = 0;
+    std::unique_ptr<ParallelDeflater> m_parallel_deflater;
 };
 
 
@@ -215,6 +215,41 @@ DirectoryCollection::stream_pointer_t DirectoryCollection::getInputStream(std::s
 }
 
 
+/** \brief Retrieve the entries matching a pattern.
+ *
+ * This function makes sure that the entries were loaded and then
+ * it searches them as FileCollection::glob() does.
+ *
+ * \param[in] pattern  The pattern the names of the entries have to match.
+ *
+ * \return A copy of the shared pointers to the matching entries.
+ */
+FileEntry::vector_t DirectoryCollection::glob(std::string const & pattern) const
+{
+    loadEntries();
+
+    return FileCollection::glob(pattern);
+}
+
+
+/** \brief Retrieve the entries found in a directory.
+ *
+ * This function makes sure that the entries were loaded and then
+ * it searches them as FileCollection::listDirectory() does.
+ *
+ * \param[in] prefix  The name of the directory to list.
+ * \param[in] recursive  Whether the entries of sub-directories are included.
+ *
+ * \return A copy of the shared pointers to the entries of that directory.
+ */
+FileEntry::vector_t DirectoryCollection::listDirectory(std::string const & prefix, bool recursive) const
+{
+    loadEntries();
+
+    return FileCollection::listDirectory(prefix, recursive);
+}
+
+
 /** \brief Create another DirectoryCollection.
  *
  * This function creates a clone of this DirectoryCollection. This is
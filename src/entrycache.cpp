@@ -0,0 +1,313 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2019  Made to Order Software Corporation
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Implementation of the zipios::EntryCache class.
+ *
+ * This file implements the cache of decompressed entries used by the
+ * ZipFile and CollectionCollection classes.
+ */
+
+#include "zipios/entrycache.hpp"
+
+#include <iterator>
+
+
+namespace zipios
+{
+
+
+/** \class EntryCache
+ * \brief A cache of decompressed entries.
+ *
+ * Reading the same entry over and over again means decompressing it
+ * each time. When a collection has a cache attached, the content of
+ * each entry read is saved in the cache and the following reads of
+ * that entry return a stream over that content.
+ *
+ * The cache is limited by a budget in bytes: the total size of the
+ * cached entries never goes over that budget. Entries larger than the
+ * budget are never cached.
+ *
+ * The eviction uses a segmented LRU: new entries are added to a
+ * probation segment and only move to the protected segment when they
+ * get read a second time. When space is needed, the least recently
+ * used entry of the probation segment is evicted first. This way a
+ * scan of many entries read only once does not push out the few
+ * entries that get read all the time. The protected segment is limited
+ * to 80% of the budget; the entries that do not fit anymore go back
+ * to the probation segment.
+ *
+ * The data of an entry is shared and immutable. An entry that gets
+ * evicted remains valid for the streams still reading it.
+ *
+ * The cache is protected by a mutex so it can be used by any number
+ * of threads at once.
+ */
+
+
+/** \struct EntryCache::statistics_t
+ * \brief The current state of the cache.
+ *
+ * The m_budget field is the current budget of the cache, m_size is
+ * the total size in bytes of the cached entries, and m_count is the
+ * number of cached entries.
+ *
+ * The m_hits and m_misses fields count the number of times find()
+ * returned a cached entry and the number of times it did not. The
+ * m_evictions field counts the number of entries removed from the
+ * cache to make space for others.
+ */
+
+
+namespace
+{
+
+
+/** \brief The share of the budget the protected segment can use.
+ *
+ * The protected segment can use up to this many percent of the
+ * budget. The rest is kept for the probation segment so new entries
+ * get a chance to be read a second time before they get evicted.
+ */
+size_t const g_protected_percent = 80;
+
+
+} // no name namespace
+
+
+/** \brief Initialize an EntryCache.
+ *
+ * The cache is created empty.
+ *
+ * \param[in] budget  The maximum number of bytes the cache can hold.
+ */
+EntryCache::EntryCache(size_t budget)
+    //: m_mutex() -- auto-init
+    : m_budget(budget)
+    //, m_probation() -- auto-init
+    //, m_protected() -- auto-init
+    //, m_probation_size(0) -- auto-init
+    //, m_protected_size(0) -- auto-init
+    //, m_items() -- auto-init
+    //, m_hits(0) -- auto-init
+    //, m_misses(0) -- auto-init
+    //, m_evictions(0) -- auto-init
+{
+}
+
+
+/** \brief Retrieve the budget of this cache.
+ *
+ * \return The maximum number of bytes this cache can hold.
+ */
+size_t EntryCache::getBudget() const
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    return m_budget;
+}
+
+
+/** \brief Change the budget of this cache.
+ *
+ * If the new budget is smaller than the size of the cached entries,
+ * the least recently used entries get evicted immediately.
+ *
+ * \param[in] budget  The new maximum number of bytes the cache can hold.
+ */
+void EntryCache::setBudget(size_t budget)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_budget = budget;
+    evict();
+}
+
+
+/** \brief Search an entry in the cache.
+ *
+ * This function returns the data of the entry named \p name if it is
+ * in the cache. A hit moves the entry to the front of the protected
+ * segment.
+ *
+ * \param[in] name  The name of the entry to search.
+ *
+ * \return The data of the entry or nullptr if it is not cached.
+ */
+EntryCache::data_t EntryCache::find(std::string const & name)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    auto it(m_items.find(name));
+    if(it == m_items.end())
+    {
+        ++m_misses;
+        return data_t();
+    }
+    ++m_hits;
+
+    list_t::iterator item(it->second);
+    if(item->m_protected)
+    {
+        m_protected.splice(m_protected.begin(), m_protected, item);
+    }
+    else
+    {
+        size_t const size(item->m_data->size());
+        item->m_protected = true;
+        m_protected.splice(m_protected.begin(), m_probation, item);
+        m_probation_size -= size;
+        m_protected_size += size;
+
+        // demote the least recently used protected entries which do
+        // not fit in the protected segment anymore
+        //
+        size_t const protected_budget(m_budget / 100 * g_protected_percent
+                                     + m_budget % 100 * g_protected_percent / 100);
+        while(m_protected_size > protected_budget
+           && m_protected.size() > 1)
+        {
+            list_t::iterator last(std::prev(m_protected.end()));
+            size_t const last_size(last->m_data->size());
+            last->m_protected = false;
+            m_probation.splice(m_probation.begin(), m_protected, last);
+            m_protected_size -= last_size;
+            m_probation_size += last_size;
+        }
+    }
+
+    return item->m_data;
+}
+
+
+/** \brief Add an entry to the cache.
+ *
+ * This function adds the data of the entry named \p name to the
+ * probation segment of the cache, evicting the least recently used
+ * entries if necessary.
+ *
+ * If the data is larger than the budget of the cache or the entry is
+ * already cached (i.e. another thread added it first), the function
+ * does nothing.
+ *
+ * \param[in] name  The name of the entry.
+ * \param[in] data  The decompressed content of the entry.
+ */
+void EntryCache::insert(std::string const & name, data_t data)
+{
+    if(data == nullptr)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    if(data->size() > m_budget
+    || m_items.find(name) != m_items.end())
+    {
+        return;
+    }
+
+    item_t item;
+    item.m_name = name;
+    item.m_data = data;
+    m_probation.push_front(item);
+    m_probation_size += data->size();
+    m_items[name] = m_probation.begin();
+
+    evict();
+}
+
+
+/** \brief Remove all the entries from the cache.
+ *
+ * The statistic counters are not reset.
+ */
+void EntryCache::clear()
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    m_items.clear();
+    m_probation.clear();
+    m_protected.clear();
+    m_probation_size = 0;
+    m_protected_size = 0;
+}
+
+
+/** \brief Retrieve the current statistics of the cache.
+ *
+ * \return A copy of the counters of the cache.
+ */
+EntryCache::statistics_t EntryCache::getStatistics() const
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    statistics_t statistics;
+    statistics.m_budget = m_budget;
+    statistics.m_size = m_probation_size + m_protected_size;
+    statistics.m_count = m_items.size();
+    statistics.m_hits = m_hits;
+    statistics.m_misses = m_misses;
+    statistics.m_evictions = m_evictions;
+    return statistics;
+}
+
+
+/** \brief Evict entries until the cache fits its budget.
+ *
+ * The least recently used entries of the probation segment are evicted
+ * first. The protected entries only get evicted once the probation
+ * segment is empty.
+ *
+ * The mutex must be locked by the caller.
+ */
+void EntryCache::evict()
+{
+    while(m_probation_size + m_protected_size > m_budget)
+    {
+        bool const probation(!m_probation.empty());
+        list_t & segment(probation ? m_probation : m_protected);
+        list_t::iterator last(std::prev(segment.end()));
+        size_t const size(last->m_data->size());
+        if(probation)
+        {
+            m_probation_size -= size;
+        }
+        else
+        {
+            m_protected_size -= size;
+        }
+        m_items.erase(last->m_name);
+        segment.erase(last);
+        ++m_evictions;
+    }
+}
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
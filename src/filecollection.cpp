@@ -31,7 +31,7 @@
 
 #include "zipios/zipiosexceptions.hpp"
 
-#include <algorithm>
+#include "sortednames.hpp"
 
 
 namespace zipios
@@ -50,104 +50,25 @@ namespace
 char const *g_default_filename = "-";
 
 
-/** \brief Class object used with the std::find_if() function.
+/** \brief Create a function returning the names of a vector.
  *
- * This function object is used with the STL find_if algorithm to
- * find a FileEntry in a container, which name (as obtained with
- * FileEntry::getName()) is identical to the name specified in the
- * MatchName constructor.
- */
-class MatchName
-{
-public:
-    /** \brief Initialize a MatchName object.
-     *
-     * This function saves the name to search in the FileCollection.
-     *
-     * This class expect the name to be a full path and file name
-     * with extension. The full name has to match.
-     *
-     * \param[in] name  The name of the file being searched.
-     */
-    explicit MatchName(std::string const& name)
-        : m_name(name)
-    {
-    }
-
-    /** \brief Compare an entry to this MatchName.
-     *
-     * This function compares the full name of the entry with the
-     * saved full name. If equal, then it returns true. It is used
-     * with the std::find_if() function.
-     *
-     * \todo
-     * We could transform that with lambda at some point.
-     *
-     * \param[in] entry  The entry to compare with the MatchName.
-     *
-     * \return true if the name of the entry matches the MatchName.
-     */
-    bool operator() (FileEntry::pointer_t entry) const
-    {
-        return entry->getName() == m_name;
-    }
-
-private:
-    std::string const       m_name;
-};
-
-
-/** \brief Class object used with the std::find_if() function.
+ * The SortedNames class retrieves names through a callback. This
+ * function creates that callback for a vector of names.
  *
- * This function object is used with the STL find_if algorithm to
- * find a FileEntry in a container, which name (as obtained with
- * FileEntry::getFileName()) is identical to the name specified in the
- * MatchFileName constructor.
+ * \param[in] names  The vector of names.
  *
- * \warning
- * The file name cannot include a '/' in this case or the search will
- * always fail.
+ * \return A function returning the name at a given index.
  */
-class MatchFileName
+SortedNames::get_name_t get_name_function(std::vector<std::string> const & names)
 {
-public:
-    /** \brief Initialize a MatchFileName object.
-     *
-     * This function saves the base name to search in the
-     * FileCollection.
-     *
-     * This class expect the name to be a base file name, eventually with
-     * an extension. If the name includes a slash then the search will
-     * always fail.
-     *
-     * \param[in] name  The name of the file being searched.
-     */
-    explicit MatchFileName(std::string const& name)
-        : m_name(name)
-    {
-    }
-
-    /** \brief Compare an entry to this MatchFileName.
-     *
-     * This function compares the base name of the entry with the
-     * saved base name. If equal, then it returns true. It is used
-     * with the std::find_if() function.
-     *
-     * \todo
-     * We could transform that with lambda at some point.
-     *
-     * \param[in] entry  The entry to compare with the MatchFileName.
-     *
-     * \return true if the name of the entry matches the MatchFileName.
-     */
-    bool operator() (FileEntry::pointer_t entry) const
-    {
-        return entry->getFileName() == m_name;
-    }
-
-private:
-    std::string const       m_name;
-};
+    return [&names](size_t index)
+        {
+            SortedNames::name_t result;
+            result.m_name = names[index].c_str();
+            result.m_length = names[index].length();
+            return result;
+        };
+}
 
 
 } // no name namespace
@@ -161,6 +82,12 @@ private:
  * collection of files. The specializations of FileCollection
  * represents different origins of file collections, such as
  * directories, simple filename lists and compressed archives.
+ *
+ * The getEntry() function makes use of two hash tables, one for the
+ * full names and one for the basenames of the entries, so a lookup
+ * does not require a linear search through all the entries. These
+ * tables are built the first time getEntry() gets called and rebuilt
+ * whenever the list of entries changes.
  */
 
 
@@ -270,6 +197,13 @@ FileCollection::FileCollection(std::string const& filename)
     : m_filename(filename.empty() ? g_default_filename : filename)
     //, m_entries() -- auto-init
     //, m_valid(true) -- auto-init
+    //, m_index_mutex() -- auto-init
+    //, m_name_index() -- auto-init
+    //, m_filename_index() -- auto-init
+    //, m_indexed_entries(0) -- auto-init
+    //, m_sorted_entry_names() -- auto-init
+    //, m_sorted_names() -- auto-init
+    //, m_sorted_entries(0) -- auto-init
 {
 }
 
@@ -289,6 +223,13 @@ FileCollection::FileCollection(FileCollection const& src)
     : m_filename(src.m_filename)
     //, m_entries() -- see below
     , m_valid(src.m_valid)
+    //, m_index_mutex() -- auto-init
+    //, m_name_index() -- auto-init
+    //, m_filename_index() -- auto-init
+    //, m_indexed_entries(0) -- auto-init
+    //, m_sorted_entry_names() -- auto-init
+    //, m_sorted_names() -- auto-init
+    //, m_sorted_entries(0) -- auto-init
 {
     m_entries.reserve(src.m_entries.size());
     for(auto it = src.m_entries.begin(); it != src.m_entries.end(); ++it)
@@ -326,6 +267,8 @@ FileCollection& FileCollection::operator = (FileCollection const& rhs)
         }
 
         m_valid = rhs.m_valid;
+
+        resetIndex();
     }
 
     return *this;
@@ -377,6 +320,7 @@ void FileCollection::addEntry(FileEntry const & entry)
  */
 void FileCollection::close()
 {
+    resetIndex();
     m_entries.clear();
     m_filename = g_default_filename;
     m_valid = false;
@@ -408,9 +352,19 @@ FileEntry::vector_t FileCollection::entries() const
  * filename while searching for a match, specify FileCollection::IGNORE
  * as the second argument.
  *
+ * The search uses a hash table of the full names or of the basenames
+ * of the entries so it does not depend on the number of entries and
+ * does not allocate any memory (outside of the first call which builds
+ * the hash tables.) When multiple entries share the same name, the
+ * first one is returned.
+ *
  * \note
  * The collection must be valid or the function raises an exception.
  *
+ * \note
+ * A collection which loads its entries lazily must load them before
+ * calling this function (see DirectoryCollection::getEntry().)
+ *
  * \param[in] name  A string containing the name of the entry to get.
  * \param[in] matchpath  Speficy MatchPath::MATCH, if the path should match
  *                       as well, specify MatchPath::IGNORE, if the path
@@ -423,22 +377,10 @@ FileEntry::vector_t FileCollection::entries() const
  */
 FileEntry::pointer_t FileCollection::getEntry(std::string const& name, MatchPath matchpath) const
 {
-    // make sure the entries were loaded if necessary
-    entries();
-
     mustBeValid();
 
-    FileEntry::vector_t::const_iterator iter;
-    if(matchpath == MatchPath::MATCH)
-    {
-        iter = std::find_if(m_entries.begin(), m_entries.end(), MatchName(name));
-    }
-    else
-    {
-        iter = std::find_if(m_entries.begin(), m_entries.end(), MatchFileName(name));
-    }
-
-    return iter == m_entries.end() ? FileEntry::pointer_t() : *iter;
+    size_t index(0);
+    return findEntryIndex(name, matchpath, index) ? m_entries[index] : FileEntry::pointer_t();
 }
 
 
@@ -460,6 +402,83 @@ std::string FileCollection::getName() const
 }
 
 
+/** \brief Retrieve the entries matching a pattern.
+ *
+ * This function returns the entries with a name matching \p pattern,
+ * sorted by name. The pattern supports "*" (any characters except a
+ * slash), "**" (any characters), "?" (one character except a slash),
+ * character sets such as "[a-z]" or "[!0-9]", and "\\" to escape
+ * the next character.
+ *
+ * The entries are searched using a list sorted by name which gets
+ * built the first time this function or listDirectory() is called.
+ * Only the entries starting with the literal part of the pattern
+ * (what comes before the first special character) are checked.
+ *
+ * \param[in] pattern  The pattern the names of the entries have to match.
+ *
+ * \return A copy of the shared pointers to the matching entries.
+ *
+ * \sa listDirectory()
+ */
+FileEntry::vector_t FileCollection::glob(std::string const & pattern) const
+{
+    mustBeValid();
+    buildSortedIndex();
+
+    SortedNames::index_vector_t indexes;
+    m_sorted_names->glob(get_name_function(m_sorted_entry_names), pattern, indexes);
+
+    FileEntry::vector_t result;
+    result.reserve(indexes.size());
+    for(auto const & idx : indexes)
+    {
+        result.push_back(m_entries[idx]);
+    }
+    return result;
+}
+
+
+/** \brief Retrieve the entries found in a directory.
+ *
+ * This function returns the entries found under the \p prefix
+ * directory, sorted by name. The trailing slash of \p prefix is
+ * optional and an empty string represents the root of the collection.
+ *
+ * By default only the entries found directly in that directory are
+ * returned. Set \p recursive to true to also get all the entries found
+ * in sub-directories. Note that a sub-directory is only returned if the
+ * collection includes an entry for it.
+ *
+ * The entries are searched using a list sorted by name which gets
+ * built the first time this function or glob() is called. After that,
+ * the cost of a call is proportional to the number of entries returned.
+ *
+ * \param[in] prefix  The name of the directory to list.
+ * \param[in] recursive  Whether the entries of sub-directories are included.
+ *
+ * \return A copy of the shared pointers to the entries of that directory.
+ *
+ * \sa glob()
+ */
+FileEntry::vector_t FileCollection::listDirectory(std::string const & prefix, bool recursive) const
+{
+    mustBeValid();
+    buildSortedIndex();
+
+    SortedNames::index_vector_t indexes;
+    m_sorted_names->listDirectory(get_name_function(m_sorted_entry_names), prefix, recursive, indexes);
+
+    FileEntry::vector_t result;
+    result.reserve(indexes.size());
+    for(auto const & idx : indexes)
+    {
+        result.push_back(m_entries[idx]);
+    }
+    return result;
+}
+
+
 /** \brief Returns the number of entries in the FileCollection.
  *
  * This function returns the number of entries in the collection.
@@ -550,6 +569,34 @@ void FileCollection::setMethod(size_t limit, StorageMethod small_storage_method,
 }
 
 
+/** \brief Change the storage method of each entry.
+ *
+ * This function calls \p selector with each entry of this collection
+ * and changes the storage method of the entry to the method returned.
+ * This is useful to select the method depending on the type of file,
+ * for example to use ZSTD for text files and STORED for files which
+ * are already compressed.
+ *
+ * \exception InvalidStateException
+ * The \p selector returned a method which is not supported, see
+ * FileEntry::setMethod().
+ *
+ * \param[in] selector  The function returning the method of an entry.
+ */
+void FileCollection::setMethod(method_selector_t selector)
+{
+    // make sure the entries were loaded if necessary
+    entries();
+
+    mustBeValid();
+
+    for(auto it(m_entries.begin()); it != m_entries.end(); ++it)
+    {
+        (*it)->setMethod(selector(**it));
+    }
+}
+
+
 /** \brief Change the compression level to the specified value.
  *
  * This function changes the compression level of all the entries in
@@ -585,6 +632,143 @@ void FileCollection::setLevel(size_t limit, FileEntry::CompressionLevel small_co
 }
 
 
+/** \brief Build the hash tables used to search entries by name.
+ *
+ * This function builds the tables used by getEntry() to quickly
+ * find an entry by full name or by basename. If the tables are
+ * already up to date, the function returns immediately.
+ *
+ * When multiple entries have the same name, the table references
+ * the first one so the result is the same as a linear search.
+ *
+ * The tables are built under a lock and published with an atomic
+ * counter. Once built, searching them does not require the lock so
+ * any number of threads can call getEntry() at the same time as long
+ * as no entries get added or removed.
+ */
+void FileCollection::buildIndex() const
+{
+    if(m_indexed_entries.load(std::memory_order_acquire) == m_entries.size())
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(m_index_mutex);
+    if(m_indexed_entries.load(std::memory_order_relaxed) == m_entries.size())
+    {
+        // another thread built the index in the meantime
+        return;
+    }
+
+    m_name_index.clear();
+    m_filename_index.clear();
+    m_name_index.reserve(m_entries.size());
+    m_filename_index.reserve(m_entries.size());
+
+    size_t const max_entries(m_entries.size());
+    for(size_t idx(0); idx < max_entries; ++idx)
+    {
+        // emplace() does not replace existing entries so the first
+        // entry with a given name is the one kept in the index
+        //
+        m_name_index.emplace(m_entries[idx]->getName(), idx);
+        m_filename_index.emplace(m_entries[idx]->getFileName(), idx);
+    }
+    m_indexed_entries.store(max_entries, std::memory_order_release);
+}
+
+
+/** \brief Build the list of entries sorted by name.
+ *
+ * This function builds the list used by listDirectory() and glob().
+ * Like buildIndex(), the list is rebuilt only when the number of
+ * entries changed and it can be used by multiple threads at once.
+ *
+ * The names are copied since FileEntry::getName() returns a new
+ * string on each call.
+ */
+void FileCollection::buildSortedIndex() const
+{
+    // m_sorted_entries is the number of entries plus one so an empty
+    // collection also gets a list
+    //
+    if(m_sorted_entries.load(std::memory_order_acquire) == m_entries.size() + 1)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(m_index_mutex);
+    if(m_sorted_entries.load(std::memory_order_relaxed) == m_entries.size() + 1)
+    {
+        return;
+    }
+
+    size_t const max_entries(m_entries.size());
+    m_sorted_entry_names.resize(max_entries);
+    for(size_t idx(0); idx < max_entries; ++idx)
+    {
+        m_sorted_entry_names[idx] = m_entries[idx]->getName();
+    }
+
+    if(m_sorted_names == nullptr)
+    {
+        m_sorted_names.reset(new SortedNames);
+    }
+    m_sorted_names->sort(max_entries, get_name_function(m_sorted_entry_names));
+    m_sorted_entries.store(max_entries + 1, std::memory_order_release);
+}
+
+
+/** \brief Search the index of an entry by name.
+ *
+ * This function searches for the entry named \p name and, if found,
+ * saves its position in the m_entries vector in \p index.
+ *
+ * The function is used by getEntry() and by sub-classes which need
+ * to know the position of the entry and not just the entry itself.
+ *
+ * \param[in] name  The name of the entry to search.
+ * \param[in] matchpath  Whether \p name is a full name or a basename.
+ * \param[out] index  The index of the entry when found.
+ *
+ * \return true if the entry was found.
+ */
+bool FileCollection::findEntryIndex(std::string const & name, MatchPath matchpath, size_t & index) const
+{
+    buildIndex();
+
+    entry_index_t const & entry_index(matchpath == MatchPath::MATCH ? m_name_index : m_filename_index);
+    auto const it(entry_index.find(name));
+    if(it == entry_index.end())
+    {
+        return false;
+    }
+
+    index = it->second;
+    return true;
+}
+
+
+/** \brief Mark the hash tables as out of date.
+ *
+ * This function clears the tables used by getEntry(). They get
+ * rebuilt on the next call to getEntry().
+ *
+ * Sub-classes must call this function whenever they replace entries
+ * without changing the number of entries.
+ */
+void FileCollection::resetIndex()
+{
+    std::lock_guard<std::mutex> guard(m_index_mutex);
+    m_name_index.clear();
+    m_filename_index.clear();
+    m_indexed_entries = 0;
+    m_sorted_entry_names.clear();
+    m_sorted_names.reset();
+    m_sorted_entries = 0;
+}
+
+
 /** \brief Write a FileCollection to the output stream.
  *
  * This function writes a simple textual representation of this
@@ -33,6 +33,7 @@
 
 #include "zipios/zipiosexceptions.hpp"
 
+#include "codec.hpp"
 #include "zipios_common.hpp"
 
 
@@ -47,7 +48,8 @@ namespace zipios
  * i.e. STORED is indicated by a 0 in the method field in a zip file and
  * so on.
  *
- * The zipios library only support STORED and DEFLATED at this time.
+ * The zipios library supports STORED and DEFLATED. It also supports
+ * LZMA and ZSTD when it was built with liblzma and libzstd.
  */
 
 
@@ -582,8 +584,9 @@ void FileEntry::setLevel(CompressionLevel level)
  *
  * \exception InvalidStateException
  * This exception is raised if the \p method parameter does not represent
- * a supported method. At this time the library only supports STORED and
- * DEFLATED. The getMethod() may return more types as read from a Zip
+ * a supported method. At this time the library supports STORED and
+ * DEFLATED, as well as LZMA and ZSTD when Zipios was built with liblzma
+ * and libzstd. The getMethod() may return more types as read from a Zip
  * archive, but it is not possible to set such types using this function.
  *
  * \param[in] method  The method field is set to the specified value.
@@ -606,7 +609,6 @@ void FileEntry::setMethod(StorageMethod method)
     //case StorageMethod::RESERVED11:
     //case StorageMethod::BZIP2:
     //case StorageMethod::REVERVED13:
-    //case StorageMethod::LZMA:
     //case StorageMethod::RESERVED15:
     //case StorageMethod::RESERVED16:
     //case StorageMethod::RESERVED17:
@@ -616,6 +618,14 @@ void FileEntry::setMethod(StorageMethod method)
     //case StorageMethod::PPMD_I_1:
         break;
 
+    case StorageMethod::LZMA:
+    case StorageMethod::ZSTD:
+        if(!Codec::isSupported(method))
+        {
+            throw InvalidStateException("method not supported by this build of zipios");
+        }
+        break;
+
     default:
         throw InvalidStateException("unknown method");
 
@@ -0,0 +1,409 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2019  Made to Order Software Corporation
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Implementation of the zipios::InflateCheckpoints class.
+ *
+ * This file implements the list of checkpoints used to seek in the
+ * data of a DEFLATED entry.
+ */
+
+#include "inflatecheckpoints.hpp"
+
+#include "zipios/zipiosexceptions.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+
+namespace zipios
+{
+
+
+/** \class InflateCheckpoints
+ * \brief The checkpoints of a DEFLATED entry.
+ *
+ * Seeking in a DEFLATED entry requires inflating all the data found
+ * before the new position. To avoid restarting from the beginning of
+ * the entry each time, this class records a checkpoint every
+ * getInterval() bytes of uncompressed data, similar to the access
+ * points of the zran example of zlib.
+ *
+ * A checkpoint is taken at the end of a deflate block. It holds the
+ * uncompressed position, the position of the next compressed byte,
+ * the number of bits of the previous byte which belong to the next
+ * block, and the last 32Kb of uncompressed data (the window) which
+ * the next block may refer to. With that information the inflation
+ * can restart at the checkpoint, so a seek costs at most one interval
+ * of inflation.
+ *
+ * The checkpoints are added by the InflateInputStreambuf while it
+ * inflates the data. The object is shared by all the streams reading
+ * the same entry, so it is protected by a mutex.
+ *
+ * The checkpoints can be saved with save() and loaded back with load().
+ * A window takes up to 32Kb so the interval should be much larger than
+ * that (1Mb is a good choice for large entries.)
+ */
+
+
+/** \struct InflateCheckpoints::checkpoint_t
+ * \brief One point from which the inflation can restart.
+ *
+ * The m_out position is the number of uncompressed bytes found before
+ * the checkpoint. The m_in position is the offset of the first byte
+ * of compressed data after the checkpoint, from the start of the data
+ * of the entry. When m_bits is not zero, that many bits at the top of
+ * the byte before m_in are part of the next deflate block.
+ */
+
+
+/** \brief Private definitions of the InflateCheckpoints class.
+ *
+ * This name space includes definitions exclusively used by the
+ * InflateCheckpoints class.
+ */
+namespace
+{
+
+
+/** \brief The magic found at the start of saved checkpoints.
+ *
+ * The saved data starts with these 8 bytes.
+ */
+char const g_checkpoints_magic[8] = { 'Z', 'I', 'P', 'I', 'O', 'S', 'C', 'P' };
+
+
+/** \brief The version of the format of the saved checkpoints.
+ *
+ * This version changes whenever the format changes.
+ */
+uint32_t const g_checkpoints_version = 1;
+
+
+/** \brief The largest window zlib can refer to.
+ *
+ * A deflate stream can refer to at most the last 32Kb of data.
+ */
+size_t const g_max_window_size = 32768;
+
+
+} // no name namespace
+
+
+/** \brief Initialize an empty list of checkpoints.
+ *
+ * The CRC and sizes of the entry are saved with the checkpoints so
+ * load() can verify that saved checkpoints belong to that entry.
+ *
+ * \param[in] interval  The number of uncompressed bytes between checkpoints.
+ * \param[in] crc_32  The CRC32 of the entry.
+ * \param[in] compressed_size  The compressed size of the entry.
+ * \param[in] uncompressed_size  The uncompressed size of the entry.
+ */
+InflateCheckpoints::InflateCheckpoints(offset_t interval, uint32_t crc_32, uint64_t compressed_size, uint64_t uncompressed_size)
+    //: m_mutex() -- auto-init
+    : m_interval(std::max(interval, static_cast<offset_t>(1)))
+    , m_crc_32(crc_32)
+    , m_compressed_size(compressed_size)
+    , m_uncompressed_size(uncompressed_size)
+    //, m_complete(false) -- auto-init
+    //, m_checkpoints() -- auto-init
+{
+}
+
+
+/** \fn InflateCheckpoints::InflateCheckpoints(InflateCheckpoints const & src);
+ * \brief The copy constructor is deleted.
+ *
+ * The checkpoints are shared using a shared pointer.
+ *
+ * \param[in] src  The source to copy.
+ */
+
+
+/** \fn InflateCheckpoints & InflateCheckpoints::operator = (InflateCheckpoints const & rhs);
+ * \brief The assignment operator is deleted.
+ *
+ * The checkpoints are shared using a shared pointer.
+ *
+ * \param[in] rhs  The source to copy.
+ *
+ * \return A reference to this object.
+ */
+
+
+/** \brief Load checkpoints saved with save().
+ *
+ * This function reads checkpoints from \p is. If the data is not valid
+ * or was saved for an entry with a different CRC or different sizes,
+ * then the function returns a null pointer.
+ *
+ * \param[in] is  The stream to read the checkpoints from.
+ * \param[in] crc_32  The CRC32 of the entry.
+ * \param[in] compressed_size  The compressed size of the entry.
+ * \param[in] uncompressed_size  The uncompressed size of the entry.
+ *
+ * \return The loaded checkpoints or a null pointer.
+ */
+InflateCheckpoints::pointer_t InflateCheckpoints::load(std::istream & is, uint32_t crc_32, uint64_t compressed_size, uint64_t uncompressed_size)
+{
+    try
+    {
+        std::string magic;
+        uint32_t version(0);
+        uint32_t saved_crc_32(0);
+        uint64_t saved_compressed_size(0);
+        uint64_t saved_uncompressed_size(0);
+        uint64_t interval(0);
+        uint8_t complete(0);
+        uint64_t count(0);
+        zipRead(is, magic, sizeof(g_checkpoints_magic));
+        zipRead(is, version);
+        zipRead(is, saved_crc_32);
+        zipRead(is, saved_compressed_size);
+        zipRead(is, saved_uncompressed_size);
+        zipRead(is, interval);
+        zipRead(is, complete);
+        zipRead(is, count);
+        if(magic != std::string(g_checkpoints_magic, sizeof(g_checkpoints_magic))
+        || version != g_checkpoints_version
+        || saved_crc_32 != crc_32
+        || saved_compressed_size != compressed_size
+        || saved_uncompressed_size != uncompressed_size
+        || interval == 0
+        || complete > 1)
+        {
+            return pointer_t();
+        }
+
+        pointer_t result(new InflateCheckpoints(interval, crc_32, compressed_size, uncompressed_size));
+        result->m_complete = complete != 0;
+        for(uint64_t idx(0); idx < count; ++idx)
+        {
+            uint64_t out(0);
+            uint64_t in(0);
+            uint8_t bits(0);
+            uint32_t window_size(0);
+            zipRead(is, out);
+            zipRead(is, in);
+            zipRead(is, bits);
+            zipRead(is, window_size);
+            if(out > uncompressed_size
+            || in > compressed_size
+            || bits > 7
+            || window_size > g_max_window_size
+            || (!result->m_checkpoints.empty() && static_cast<offset_t>(out) <= result->m_checkpoints.back().m_out))
+            {
+                return pointer_t();
+            }
+            result->m_checkpoints.push_back(checkpoint_t());
+            checkpoint_t & checkpoint(result->m_checkpoints.back());
+            checkpoint.m_out = out;
+            checkpoint.m_in = in;
+            checkpoint.m_bits = bits;
+            zipRead(is, checkpoint.m_window, window_size);
+        }
+        return result;
+    }
+    catch(IOException const &)
+    {
+        return pointer_t();
+    }
+}
+
+
+/** \brief Save the checkpoints.
+ *
+ * This function writes the checkpoints to \p os so they can be
+ * loaded back later with load() instead of being computed again.
+ *
+ * All the numbers are saved in little endian so the data can be
+ * shared between computers.
+ *
+ * \exception IOException
+ * This exception is raised if writing to \p os fails.
+ *
+ * \param[in] os  The stream where the checkpoints get written.
+ */
+void InflateCheckpoints::save(std::ostream & os) const
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    os.write(g_checkpoints_magic, sizeof(g_checkpoints_magic));
+    zipWrite(os, g_checkpoints_version);
+    zipWrite(os, m_crc_32);
+    zipWrite(os, m_compressed_size);
+    zipWrite(os, m_uncompressed_size);
+    zipWrite(os, static_cast<uint64_t>(m_interval));
+    zipWrite(os, static_cast<uint8_t>(m_complete ? 1 : 0));
+    zipWrite(os, static_cast<uint64_t>(m_checkpoints.size()));
+    for(auto const & checkpoint : m_checkpoints)
+    {
+        zipWrite(os, static_cast<uint64_t>(checkpoint.m_out));
+        zipWrite(os, static_cast<uint64_t>(checkpoint.m_in));
+        zipWrite(os, static_cast<uint8_t>(checkpoint.m_bits));
+        zipWrite(os, static_cast<uint32_t>(checkpoint.m_window.size()));
+        zipWrite(os, checkpoint.m_window);
+    }
+    if(!os)
+    {
+        throw IOException("an I/O error occurred while saving the inflate checkpoints.");
+    }
+}
+
+
+/** \brief Retrieve the interval between checkpoints.
+ *
+ * \return The minimum number of uncompressed bytes between checkpoints.
+ */
+offset_t InflateCheckpoints::getInterval() const
+{
+    return m_interval;
+}
+
+
+/** \brief Retrieve the number of checkpoints.
+ *
+ * \return The number of checkpoints recorded so far.
+ */
+size_t InflateCheckpoints::size() const
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    return m_checkpoints.size();
+}
+
+
+/** \brief Check whether all the checkpoints were recorded.
+ *
+ * Once a stream inflated the entry up to its end, all the checkpoints
+ * are known and the streams do not need to look for new ones.
+ *
+ * \return true if the checkpoints cover the entire entry.
+ */
+bool InflateCheckpoints::isComplete() const
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    return m_complete;
+}
+
+
+/** \brief Mark the checkpoints as complete.
+ *
+ * The InflateInputStreambuf calls this function when it reaches the
+ * end of the compressed data.
+ */
+void InflateCheckpoints::setComplete()
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_complete = true;
+}
+
+
+/** \brief Check whether a checkpoint is expected at \p out.
+ *
+ * A new checkpoint is needed once at least getInterval() bytes were
+ * inflated since the last checkpoint.
+ *
+ * \param[in] out  The current uncompressed position.
+ *
+ * \return true if a checkpoint should be added at \p out.
+ */
+bool InflateCheckpoints::wantsCheckpoint(offset_t out) const
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    offset_t const last(m_checkpoints.empty() ? 0 : m_checkpoints.back().m_out);
+    return !m_complete && out >= last + m_interval;
+}
+
+
+/** \brief Add a checkpoint.
+ *
+ * This function adds a checkpoint at \p out. If another stream added
+ * a checkpoint in the meantime and \p out is not far enough from it,
+ * the new checkpoint is ignored.
+ *
+ * \param[in] out  The uncompressed position of the checkpoint.
+ * \param[in] in  The compressed position of the checkpoint.
+ * \param[in] bits  The number of bits of the previous byte to use.
+ * \param[in] window  The last uncompressed bytes before \p out.
+ * \param[in] size  The size of \p window, at most 32Kb.
+ */
+void InflateCheckpoints::addCheckpoint(offset_t out, offset_t in, int bits, unsigned char const * window, size_t size)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    offset_t const last(m_checkpoints.empty() ? 0 : m_checkpoints.back().m_out);
+    if(m_complete || out < last + m_interval)
+    {
+        return;
+    }
+    size = std::min(size, g_max_window_size);
+    m_checkpoints.push_back(checkpoint_t());
+    checkpoint_t & checkpoint(m_checkpoints.back());
+    checkpoint.m_out = out;
+    checkpoint.m_in = in;
+    checkpoint.m_bits = bits;
+    checkpoint.m_window.assign(window, window + size);
+}
+
+
+/** \brief Search the checkpoint to use to reach \p out.
+ *
+ * This function returns the last checkpoint found at or before
+ * \p out. If there is no such checkpoint, the inflation has to
+ * start at the beginning of the data and the function returns
+ * a null pointer.
+ *
+ * The returned checkpoint never changes and remains valid as long
+ * as this object exists.
+ *
+ * \param[in] out  The uncompressed position to reach.
+ *
+ * \return The checkpoint or a null pointer.
+ */
+InflateCheckpoints::checkpoint_t const * InflateCheckpoints::findCheckpoint(offset_t out) const
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    auto it(std::upper_bound(
+              m_checkpoints.begin()
+            , m_checkpoints.end()
+            , out
+            , [](offset_t position, checkpoint_t const & checkpoint)
+            {
+                return position < checkpoint.m_out;
+            }));
+    if(it == m_checkpoints.begin())
+    {
+        return nullptr;
+    }
+    return &*(it - 1);
+}
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
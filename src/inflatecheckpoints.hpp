@@ -0,0 +1,93 @@
+#pragma once
+#ifndef ZIPIOS_INFLATECHECKPOINTS_HPP
+#define ZIPIOS_INFLATECHECKPOINTS_HPP
+
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2019  Made to Order Software Corporation
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Declaration of the zipios::InflateCheckpoints class.
+ *
+ * The zipios::InflateCheckpoints class records the points from which
+ * the inflation of a DEFLATED entry can be restarted, which makes
+ * seeking in such an entry much faster.
+ */
+
+#include "zipios_common.hpp"
+
+#include <deque>
+#include <memory>
+#include <mutex>
+
+
+namespace zipios
+{
+
+
+class InflateCheckpoints
+{
+public:
+    typedef std::shared_ptr<InflateCheckpoints> pointer_t;
+
+    struct checkpoint_t
+    {
+        offset_t                m_out = 0;
+        offset_t                m_in = 0;
+        int                     m_bits = 0;
+        buffer_t                m_window;
+    };
+
+                                InflateCheckpoints(offset_t interval, uint32_t crc_32, uint64_t compressed_size, uint64_t uncompressed_size);
+                                InflateCheckpoints(InflateCheckpoints const & src) = delete;
+    InflateCheckpoints &        operator = (InflateCheckpoints const & rhs) = delete;
+
+    static pointer_t            load(std::istream & is, uint32_t crc_32, uint64_t compressed_size, uint64_t uncompressed_size);
+    void                        save(std::ostream & os) const;
+
+    offset_t                    getInterval() const;
+    size_t                      size() const;
+    bool                        isComplete() const;
+    void                        setComplete();
+    bool                        wantsCheckpoint(offset_t out) const;
+    void                        addCheckpoint(offset_t out, offset_t in, int bits, unsigned char const * window, size_t size);
+    checkpoint_t const *        findCheckpoint(offset_t out) const;
+
+private:
+    mutable std::mutex          m_mutex;
+    offset_t                    m_interval = 0;
+    uint32_t                    m_crc_32 = 0;
+    uint64_t                    m_compressed_size = 0;
+    uint64_t                    m_uncompressed_size = 0;
+    bool                        m_complete = false;
+    std::deque<checkpoint_t>    m_checkpoints;
+};
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
+#endif
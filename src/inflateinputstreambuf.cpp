@@ -31,8 +31,11 @@
 
 #include "zipios/zipiosexceptions.hpp"
 
+#include "memoryinputstreambuf.hpp"
 #include "zipios_common.hpp"
 
+#include <limits>
+
 
 namespace zipios
 {
@@ -48,8 +51,23 @@ namespace zipios
  * inflation, this class only wraps the functionality in an input
  * stream filter.
  *
+ * When the input streambuf is a MemoryInputStreambuf (i.e. the Zip
+ * archive was memory mapped) the compressed data is passed to zlib
+ * directly from memory instead of being copied to an input buffer
+ * first.
+ *
+ * The zlib state and the buffers come from an InflatePool when one
+ * is specified. The pool keeps them for the next stream once this
+ * one gets destroyed.
+ *
+ * The stream can seek. Seeking forward inflates and drops the data
+ * up to the new position. Seeking backward restarts the inflation
+ * from the beginning of the data, or from the closest checkpoint when
+ * an InflateCheckpoints object was attached with setCheckpoints(). In
+ * the latter case, the checkpoints get recorded while inflating.
+ *
  * \todo
- * Add support for bzip2, lzma compressions.
+ * Add support for bzip2 compression.
  */
 
 
@@ -66,13 +84,22 @@ namespace zipios
  * \param[in,out] inbuf  The streambuf to use for input.
  * \param[in] start_pos  A position to reset the inbuf to before reading. Specify
  *                       -1 to not change the position.
+ * \param[in] pool  The pool where the zlib state and buffers come from,
+ *                  may be null.
  */
-InflateInputStreambuf::InflateInputStreambuf(std::streambuf *inbuf, offset_t start_pos)
+InflateInputStreambuf::InflateInputStreambuf(std::streambuf *inbuf, offset_t start_pos, InflatePool::pointer_t pool)
     : FilterInputStreambuf(inbuf)
-    , m_outvec(getBufferSize())
-    , m_invec(getBufferSize())
-    //, m_zs() -- auto-init
-    //, m_zs_initialized(false) -- auto-init
+    , m_pool(pool)
+    , m_state(InflatePool::getState(pool))
+    , m_outvec(m_state->m_outvec)
+    , m_invec(m_state->m_invec)
+    , m_memory_inbuf(dynamic_cast<MemoryInputStreambuf *>(inbuf))
+    //, m_uncompressed_size(-1) -- auto-init
+    //, m_data_start(-1) -- auto-init
+    //, m_out_position(0) -- auto-init
+    , m_zs(m_state->m_zs)
+    //, m_checkpoints() -- auto-init
+    //, m_in_position(0) -- auto-init
 {
     // NOTICE: It is important that this constructor and the methods it
     // calls doesn't do anything with the input streambuf inbuf, other
@@ -80,10 +107,19 @@ InflateInputStreambuf::InflateInputStreambuf(std::streambuf *inbuf, offset_t sta
     // that this class can be subclassed, and the subclass should get a
     // chance to read from the buffer first)
 
+    // the input buffer is not used when reading from memory
+    if(m_memory_inbuf == nullptr && m_invec.size() < getBufferSize())
+    {
+        m_invec.resize(getBufferSize());
+    }
+
     // zlib init:
-    m_zs.zalloc = Z_NULL;
-    m_zs.zfree  = Z_NULL;
-    m_zs.opaque = Z_NULL;
+    if(!m_state->m_zs_initialized)
+    {
+        m_zs.zalloc = Z_NULL;
+        m_zs.zfree  = Z_NULL;
+        m_zs.opaque = Z_NULL;
+    }
 
     reset(start_pos);
     // We are not checking the return value of reset() and throwing
@@ -94,24 +130,12 @@ InflateInputStreambuf::InflateInputStreambuf(std::streambuf *inbuf, offset_t sta
 
 /** \brief Clean up the InflateInputStreambuf object.
  *
- * The destructor makes sure all allocated resources get cleaned up.
+ * The destructor returns the zlib state and the buffers to the pool.
+ * Without a pool, they get released.
  */
 InflateInputStreambuf::~InflateInputStreambuf()
 {
-    // Dealloc z_stream stuff
-    int const err(inflateEnd(&m_zs));
-    if(err != Z_OK)
-    {
-        // in a destructor we cannot throw...
-        OutputStringStream msgs; // LCOV_EXCL_LINE
-        msgs << "InflateInputStreambuf::~InflateInputStreambuf(): inflateEnd() failed" // LCOV_EXCL_LINE
-             << ": " << zError(err); // LCOV_EXCL_LINE
-        /** \TODO
-         * Write an error callback interface and call that instead of
-         * using std::cerr...
-         */
-        std::cerr << msgs.str() << std::endl; // LCOV_EXCL_LINE
-    }
+    InflatePool::releaseState(m_pool, m_state);
 }
 
 
@@ -140,12 +164,28 @@ std::streambuf::int_type InflateInputStreambuf::underflow()
     m_zs.avail_out = getBufferSize();
     m_zs.next_out = reinterpret_cast<unsigned char *>(&m_outvec[0]);
 
+    // when checkpoints are being recorded, stop at each block boundary
+    //
+    int const flush(m_checkpoints != nullptr && !m_checkpoints->isComplete() ? Z_BLOCK : Z_NO_FLUSH);
+
     // Inflate until _outvec is full
     // eof (or I/O prob) on _inbuf will break out of loop too.
     int err(Z_OK);
     while(m_zs.avail_out > 0 && err == Z_OK)
     {
-        if(m_zs.avail_in == 0)
+        if(m_zs.avail_in == 0 && m_memory_inbuf != nullptr)
+        {
+            // point zlib directly to the data in memory; avail_in
+            // is limited to 32 bits so large entries are inflated
+            // in several chunks
+            //
+            size_t const bc(std::min(m_memory_inbuf->remaining(), static_cast<size_t>(std::numeric_limits<uInt>::max())));
+            m_zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(m_memory_inbuf->current()));
+            m_zs.avail_in = static_cast<uInt>(bc);
+            m_memory_inbuf->pubseekoff(bc, std::ios::cur);
+            m_in_position += bc;
+        }
+        else if(m_zs.avail_in == 0)
         {
             // fill m_invec
             std::streamsize const bc(m_inbuf->sgetn(&m_invec[0], getBufferSize()));
@@ -154,13 +194,18 @@ std::streambuf::int_type InflateInputStreambuf::underflow()
              */
             m_zs.next_in = reinterpret_cast<unsigned char *>(&m_invec[0]);
             m_zs.avail_in = bc;
+            m_in_position += bc;
             // If we could not read any new data (bc == 0) and inflate is not
             // done it will return Z_BUF_ERROR and thus breaks out of the
             // loop. This means we do not have to respond to the situation
             // where we cannot read more bytes here.
         }
 
-        err = inflate(&m_zs, Z_NO_FLUSH);
+        err = inflate(&m_zs, flush);
+        if(flush == Z_BLOCK && err == Z_OK)
+        {
+            checkpoint(m_out_position + getBufferSize() - m_zs.avail_out);
+        }
     }
 
     // Normally the number of inflated bytes will be the
@@ -169,6 +214,13 @@ std::streambuf::int_type InflateInputStreambuf::underflow()
     // less.
     offset_t const inflated_bytes = getBufferSize() - m_zs.avail_out;
     setg(&m_outvec[0], &m_outvec[0], &m_outvec[0] + inflated_bytes);
+    m_out_position += inflated_bytes;
+
+    if(err == Z_STREAM_END && m_checkpoints != nullptr)
+    {
+        // all the checkpoints were seen
+        m_checkpoints->setComplete();
+    }
 
     /** \FIXME
      * Look at the error returned from inflate here, if there is
@@ -220,13 +272,18 @@ bool InflateInputStreambuf::reset(offset_t stream_position)
         m_inbuf->pubseekpos(stream_position);
     }
 
+    // the compressed data starts here, -1 if m_inbuf cannot seek
+    m_data_start = m_inbuf->pubseekoff(0, std::ios::cur, std::ios::in);
+    m_in_position = 0;
+    m_out_position = 0;
+
     // m_zs.next_in and avail_in must be set according to
     // zlib.h (inline doc).
-    m_zs.next_in = reinterpret_cast<Bytef *>(&m_invec[0]);
+    m_zs.next_in = reinterpret_cast<Bytef *>(m_invec.data());
     m_zs.avail_in = 0;
 
     int err(Z_OK);
-    if(m_zs_initialized)
+    if(m_state->m_zs_initialized)
     {
         // just reset it
         err = inflateReset(&m_zs);
@@ -241,7 +298,7 @@ bool InflateInputStreambuf::reset(offset_t stream_position)
            and return Z_STREAM_END.  We always have an extra "dummy" byte,
            because there is always some trailing data after the compressed
            data (either the next entry or the central directory.  */
-        m_zs_initialized = true;
+        m_state->m_zs_initialized = true;
     }
 
     // streambuf init:
@@ -255,6 +312,207 @@ bool InflateInputStreambuf::reset(offset_t stream_position)
 }
 
 
+/** \brief Attach checkpoints to this stream.
+ *
+ * The checkpoints are used to speed up seeking. While inflating, the
+ * stream adds the missing checkpoints to \p checkpoints.
+ *
+ * The same checkpoints can be shared by all the streams reading the
+ * same data.
+ *
+ * \param[in] checkpoints  The checkpoints of the data being inflated.
+ */
+void InflateInputStreambuf::setCheckpoints(InflateCheckpoints::pointer_t checkpoints)
+{
+    m_checkpoints = checkpoints;
+}
+
+
+/** \brief Seek to a new position in the inflated data.
+ *
+ * This function converts \p off to an absolute position and calls
+ * seekpos(). Seeking from the end only works when the subclass
+ * defined the uncompressed size of the data.
+ *
+ * \param[in] off  The offset to seek to.
+ * \param[in] dir  Where \p off is relative to.
+ * \param[in] which  Must include std::ios_base::in.
+ *
+ * \return The new position or -1 on failure.
+ */
+InflateInputStreambuf::pos_type InflateInputStreambuf::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which)
+{
+    offset_t base(0);
+    switch(dir)
+    {
+    case std::ios_base::beg:
+        break;
+
+    case std::ios_base::cur:
+        base = m_out_position - (egptr() - gptr());
+        break;
+
+    case std::ios_base::end:
+        if(m_uncompressed_size < 0)
+        {
+            return pos_type(off_type(-1));
+        }
+        base = m_uncompressed_size;
+        break;
+
+    default:
+        return pos_type(off_type(-1)); // LCOV_EXCL_LINE
+
+    }
+
+    return InflateInputStreambuf::seekpos(pos_type(base + off), which);
+}
+
+
+/** \brief Seek to a new position in the inflated data.
+ *
+ * If \p pos is within the current buffer, the function only moves the
+ * get pointer. Otherwise it inflates and drops the data up to \p pos.
+ * When \p pos is before the current position, or when a checkpoint
+ * exists between the current position and \p pos, the inflation first
+ * restarts from the closest checkpoint before \p pos (or from the
+ * beginning of the data if there is no such checkpoint.)
+ *
+ * \param[in] pos  The position to seek to.
+ * \param[in] which  Must include std::ios_base::in.
+ *
+ * \return The new position or -1 on failure.
+ */
+InflateInputStreambuf::pos_type InflateInputStreambuf::seekpos(pos_type pos, std::ios_base::openmode which)
+{
+    offset_t const target(pos);
+    if((which & std::ios_base::in) == 0
+    || m_data_start < 0
+    || target < 0
+    || (m_uncompressed_size >= 0 && target > m_uncompressed_size))
+    {
+        return pos_type(off_type(-1));
+    }
+
+    // keep the buffer if the new position is within it
+    //
+    offset_t buffer_start(m_out_position - (egptr() - eback()));
+    if(target >= buffer_start && target <= m_out_position)
+    {
+        setg(eback(), eback() + (target - buffer_start), egptr());
+        return pos;
+    }
+
+    InflateCheckpoints::checkpoint_t const * checkpoint(m_checkpoints == nullptr ? nullptr : m_checkpoints->findCheckpoint(target));
+    if(target < m_out_position
+    || (checkpoint != nullptr && checkpoint->m_out > m_out_position))
+    {
+        if(!restart(checkpoint))
+        {
+            return pos_type(off_type(-1));
+        }
+    }
+
+    while(m_out_position < target)
+    {
+        setg(eback(), egptr(), egptr());
+        if(traits_type::eq_int_type(underflow(), traits_type::eof()))
+        {
+            return pos_type(off_type(-1));
+        }
+    }
+
+    buffer_start = m_out_position - (egptr() - eback());
+    setg(eback(), eback() + (target - buffer_start), egptr());
+    return pos;
+}
+
+
+/** \brief Restart the inflation at a checkpoint.
+ *
+ * This function repositions the input streambuf at the compressed
+ * position of \p checkpoint and restores the zlib state as it was
+ * at that point. If \p checkpoint is null, the inflation restarts at
+ * the beginning of the data.
+ *
+ * \param[in] checkpoint  The checkpoint to restart from or nullptr.
+ *
+ * \return true if the inflation can continue from the checkpoint.
+ */
+bool InflateInputStreambuf::restart(InflateCheckpoints::checkpoint_t const * checkpoint)
+{
+    offset_t const in(checkpoint == nullptr ? 0 : checkpoint->m_in);
+    int const bits(checkpoint == nullptr ? 0 : checkpoint->m_bits);
+
+    // when the block starts in the middle of a byte, that byte is
+    // read again and its last bits are given to zlib
+    //
+    offset_t const position(m_data_start + in - (bits != 0 ? 1 : 0));
+    if(m_inbuf->pubseekpos(position, std::ios::in) != position)
+    {
+        return false; // LCOV_EXCL_LINE
+    }
+
+    m_zs.next_in = reinterpret_cast<Bytef *>(m_invec.data());
+    m_zs.avail_in = 0;
+    if(inflateReset(&m_zs) != Z_OK)
+    {
+        return false; // LCOV_EXCL_LINE
+    }
+    if(bits != 0)
+    {
+        int const c(m_inbuf->sbumpc());
+        if(c == traits_type::eof()
+        || inflatePrime(&m_zs, bits, c >> (8 - bits)) != Z_OK)
+        {
+            return false; // LCOV_EXCL_LINE
+        }
+    }
+    if(checkpoint != nullptr
+    && !checkpoint->m_window.empty()
+    && inflateSetDictionary(&m_zs, &checkpoint->m_window[0], checkpoint->m_window.size()) != Z_OK)
+    {
+        return false; // LCOV_EXCL_LINE
+    }
+
+    m_in_position = in;
+    m_out_position = checkpoint == nullptr ? 0 : checkpoint->m_out;
+    setg(&m_outvec[0], &m_outvec[0], &m_outvec[0]);
+
+    return true;
+}
+
+
+/** \brief Record a checkpoint if needed.
+ *
+ * This function is called each time inflate() returns because of
+ * Z_BLOCK. If zlib stopped at the end of a block which is not the
+ * last one and the last checkpoint is far enough, a new checkpoint
+ * gets added with the current window of zlib.
+ *
+ * \param[in] out  The current uncompressed position.
+ */
+void InflateInputStreambuf::checkpoint(offset_t out)
+{
+    // bit 7 is set at the end of a block, bit 6 if that block is
+    // the last one
+    //
+    if((m_zs.data_type & 128) == 0
+    || (m_zs.data_type & 64) != 0
+    || !m_checkpoints->wantsCheckpoint(out))
+    {
+        return;
+    }
+
+    buffer_t window(32768);
+    uInt size(window.size());
+    if(inflateGetDictionary(&m_zs, &window[0], &size) == Z_OK)
+    {
+        m_checkpoints->addCheckpoint(out, m_in_position - m_zs.avail_in, m_zs.data_type & 7, &window[0], size);
+    }
+}
+
+
 } // zipios namespace
 
 // Local Variables:
@@ -32,6 +32,8 @@
  */
 
 #include "filterinputstreambuf.hpp"
+#include "inflatecheckpoints.hpp"
+#include "inflatepool.hpp"
 
 #include "zipios/zipios-config.hpp"
 
@@ -44,28 +46,45 @@ namespace zipios
 {
 
 
+class MemoryInputStreambuf;
+
+
 class InflateInputStreambuf : public FilterInputStreambuf
 {
 public:
-                            InflateInputStreambuf(std::streambuf *inbuf, offset_t s_pos = -1);
+                            InflateInputStreambuf(std::streambuf *inbuf, offset_t s_pos = -1, InflatePool::pointer_t pool = InflatePool::pointer_t());
                             InflateInputStreambuf(InflateInputStreambuf const& src) = delete;
     InflateInputStreambuf&  operator = (InflateInputStreambuf const& src) = delete;
     virtual                 ~InflateInputStreambuf();
 
     bool                    reset(offset_t stream_position = -1);
+    void                    setCheckpoints(InflateCheckpoints::pointer_t checkpoints);
 
 protected:
     virtual std::streambuf::int_type             underflow() override;
+    virtual pos_type        seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which = std::ios_base::in | std::ios_base::out) override;
+    virtual pos_type        seekpos(pos_type pos, std::ios_base::openmode which = std::ios_base::in | std::ios_base::out) override;
+
+    InflatePool::pointer_t  m_pool;
+    InflatePool::state_pointer_t m_state;
 
     /** \FIXME Consider design?
      */
-    std::vector<char>       m_outvec;
+    std::vector<char> &     m_outvec;
+    std::vector<char> &     m_invec;
+    MemoryInputStreambuf *  m_memory_inbuf = nullptr;
+
+    offset_t                m_uncompressed_size = -1;
+    offset_t                m_data_start = -1;
+    offset_t                m_out_position = 0;
 
 private:
-    std::vector<char>       m_invec;
+    bool                    restart(InflateCheckpoints::checkpoint_t const * checkpoint);
+    void                    checkpoint(offset_t out);
 
-    z_stream                m_zs;
-    bool                    m_zs_initialized = false;
+    z_stream &              m_zs;
+    InflateCheckpoints::pointer_t m_checkpoints;
+    offset_t                m_in_position = 0;
 };
 
 
@@ -0,0 +1,222 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2019  Made to Order Software Corporation
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Implementation of the zipios::InflatePool class.
+ *
+ * This file implements the pool of zlib states and buffers shared by
+ * the input streams of a ZipFile.
+ */
+
+#include "inflatepool.hpp"
+
+
+namespace zipios
+{
+
+
+/** \class InflatePool
+ * \brief A pool of zlib states and buffers.
+ *
+ * Each input stream returned by ZipFile::getInputStream() needs a
+ * zlib state, which inflateInit2() allocates, and a few buffers of
+ * getBufferSize() bytes. For short entries, allocating, clearing, and
+ * releasing those takes longer than reading the entry.
+ *
+ * The ZipFile owns one InflatePool. When a stream gets destroyed, its
+ * state and buffers are saved in the pool and the next stream reuses
+ * them as is: the state is only reset with inflateReset() and the
+ * buffers are not cleared.
+ *
+ * The pool is protected by a mutex so streams can be created and
+ * destroyed by any number of threads. Streams hold a shared pointer
+ * to the pool so they can outlive the ZipFile.
+ *
+ * All the functions accept a null pool in which case the state or
+ * buffer gets allocated or released as if there was no pool.
+ */
+
+
+/** \struct InflatePool::state_t
+ * \brief The zlib state of one stream and its buffers.
+ *
+ * The state is initialized with inflateInit2() the first time it gets
+ * used. After that, it remains initialized until it gets destroyed.
+ */
+
+
+/** \brief Release the zlib state.
+ *
+ * The destructor calls inflateEnd() if the state was initialized.
+ */
+InflatePool::state_t::~state_t()
+{
+    if(m_zs_initialized)
+    {
+        inflateEnd(&m_zs);
+    }
+}
+
+
+/** \brief Initialize the pool.
+ *
+ * The pool keeps up to \p max_pooled states and as many buffers.
+ * Extra states and buffers get released when returned to a full pool.
+ *
+ * \param[in] max_pooled  The maximum number of states and buffers kept.
+ */
+InflatePool::InflatePool(size_t max_pooled)
+    : m_max_pooled(max_pooled)
+{
+}
+
+
+/** \fn InflatePool::InflatePool(InflatePool const & src);
+ * \brief The copy constructor is deleted.
+ *
+ * A pool cannot be copied. Share it using a shared pointer instead.
+ *
+ * \param[in] src  The source to copy.
+ */
+
+
+/** \fn InflatePool & InflatePool::operator = (InflatePool const & rhs);
+ * \brief The assignment operator is deleted.
+ *
+ * A pool cannot be copied. Share it using a shared pointer instead.
+ *
+ * \param[in] rhs  The source to copy.
+ *
+ * \return A reference to this object.
+ */
+
+
+/** \brief Get a zlib state.
+ *
+ * This function returns a state from \p pool if one is available,
+ * otherwise it allocates a new one. The output buffer of the state
+ * has getBufferSize() bytes. The input buffer may be empty.
+ *
+ * \param[in] pool  The pool to get the state from, may be null.
+ *
+ * \return A zlib state.
+ */
+InflatePool::state_pointer_t InflatePool::getState(pointer_t pool)
+{
+    if(pool != nullptr)
+    {
+        std::lock_guard<std::mutex> guard(pool->m_mutex);
+        if(!pool->m_states.empty())
+        {
+            state_pointer_t state(std::move(pool->m_states.back()));
+            pool->m_states.pop_back();
+            return state;
+        }
+    }
+
+    state_pointer_t state(new state_t);
+    state->m_outvec.resize(getBufferSize());
+    return state;
+}
+
+
+/** \brief Return a zlib state to the pool.
+ *
+ * This function saves \p state in \p pool so another stream can reuse
+ * it. If there is no pool or the pool is full, the state is released.
+ *
+ * \param[in] pool  The pool to save the state in, may be null.
+ * \param[in,out] state  The state to save, null on return.
+ */
+void InflatePool::releaseState(pointer_t pool, state_pointer_t & state)
+{
+    if(pool != nullptr && state != nullptr)
+    {
+        std::lock_guard<std::mutex> guard(pool->m_mutex);
+        if(pool->m_states.size() < pool->m_max_pooled)
+        {
+            pool->m_states.push_back(std::move(state));
+            return;
+        }
+    }
+    state.reset();
+}
+
+
+/** \brief Get an I/O buffer.
+ *
+ * This function saves a buffer of getBufferSize() bytes in \p buffer.
+ * The buffer comes from \p pool if one is available. The content of
+ * the buffer is undefined.
+ *
+ * \param[in] pool  The pool to get the buffer from, may be null.
+ * \param[out] buffer  The vector receiving the buffer.
+ */
+void InflatePool::getBuffer(pointer_t pool, std::vector<char> & buffer)
+{
+    if(pool != nullptr)
+    {
+        std::lock_guard<std::mutex> guard(pool->m_mutex);
+        if(!pool->m_buffers.empty())
+        {
+            buffer.swap(pool->m_buffers.back());
+            pool->m_buffers.pop_back();
+            return;
+        }
+    }
+
+    buffer.resize(getBufferSize());
+}
+
+
+/** \brief Return an I/O buffer to the pool.
+ *
+ * This function saves \p buffer in \p pool so another stream can reuse
+ * it. If there is no pool or the pool is full, the buffer is released.
+ *
+ * \param[in] pool  The pool to save the buffer in, may be null.
+ * \param[in,out] buffer  The buffer to save, empty on return.
+ */
+void InflatePool::releaseBuffer(pointer_t pool, std::vector<char> & buffer)
+{
+    if(pool != nullptr && buffer.size() == getBufferSize())
+    {
+        std::lock_guard<std::mutex> guard(pool->m_mutex);
+        if(pool->m_buffers.size() < pool->m_max_pooled)
+        {
+            pool->m_buffers.push_back(std::vector<char>());
+            pool->m_buffers.back().swap(buffer);
+            return;
+        }
+    }
+    std::vector<char>().swap(buffer);
+}
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
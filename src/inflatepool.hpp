@@ -0,0 +1,88 @@
+#pragma once
+#ifndef ZIPIOS_INFLATEPOOL_HPP
+#define ZIPIOS_INFLATEPOOL_HPP
+
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2019  Made to Order Software Corporation
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Declaration of the zipios::InflatePool class.
+ *
+ * The zipios::InflatePool class keeps zlib states and buffers around
+ * so the input streams of a ZipFile can reuse them.
+ */
+
+#include "zipios/zipios-config.hpp"
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <zlib.h>
+
+
+namespace zipios
+{
+
+
+class InflatePool
+{
+public:
+    typedef std::shared_ptr<InflatePool>    pointer_t;
+
+    struct state_t
+    {
+                                ~state_t();
+
+        z_stream                m_zs = z_stream();
+        bool                    m_zs_initialized = false;
+        std::vector<char>       m_invec;
+        std::vector<char>       m_outvec;
+    };
+    typedef std::unique_ptr<state_t>        state_pointer_t;
+
+                                InflatePool(size_t max_pooled = 16);
+                                InflatePool(InflatePool const & src) = delete;
+    InflatePool &               operator = (InflatePool const & rhs) = delete;
+
+    static state_pointer_t      getState(pointer_t pool);
+    static void                 releaseState(pointer_t pool, state_pointer_t & state);
+    static void                 getBuffer(pointer_t pool, std::vector<char> & buffer);
+    static void                 releaseBuffer(pointer_t pool, std::vector<char> & buffer);
+
+private:
+    std::mutex                  m_mutex;
+    size_t                      m_max_pooled = 16;
+    std::vector<state_pointer_t> m_states;
+    std::vector<std::vector<char>> m_buffers;
+};
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
+#endif
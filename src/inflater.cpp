@@ -0,0 +1,168 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2019  Made to Order Software Corporation
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Implementation of the zipios::Inflater interface.
+ *
+ * This file implements the functions used to create and list the
+ * available inflaters.
+ */
+
+#include "zipios/inflater.hpp"
+
+#include "zipios/zipiosexceptions.hpp"
+
+#include "zlibinflater.hpp"
+#ifdef ZIPIOS_HAS_LIBDEFLATE
+#include "libdeflateinflater.hpp"
+#endif
+
+
+namespace zipios
+{
+
+
+/** \class Inflater
+ * \brief Interface of the whole entry decompressors.
+ *
+ * When the whole data of a DEFLATED entry is needed, such as in
+ * ZipFile::readEntry() or to fill the cache of a ZipFile, the size of
+ * the uncompressed data is known from the Central Directory and the
+ * output buffer is allocated at once. A decompressor which does not
+ * need to support streaming can then be used. Such decompressors, like
+ * libdeflate, are two to three times faster than the zlib inflate()
+ * function.
+ *
+ * The create() function returns one of the inflaters compiled in
+ * Zipios. The "zlib" inflater is always available. The "libdeflate"
+ * inflater is available when libdeflate was found at build time (see
+ * the ZIPIOS_USE_LIBDEFLATE option) and it is the default when
+ * available. Linking against zlib-ng in its zlib compatible mode also
+ * speeds up the "zlib" inflater and the input streams.
+ *
+ * You can also implement your own inflater and attach it to a ZipFile
+ * with ZipFile::setInflater().
+ *
+ * An inflater may be used by several threads at the same time.
+ */
+
+
+/** \brief Clean up an inflater.
+ *
+ * The destructor is virtual so inflaters can be destroyed through
+ * a pointer to this interface.
+ */
+Inflater::~Inflater()
+{
+}
+
+
+/** \fn std::string Inflater::getName() const;
+ * \brief Retrieve the name of this inflater.
+ *
+ * This function returns the name of the inflater such as "zlib" or
+ * "libdeflate".
+ *
+ * \return The name of this inflater.
+ */
+
+
+/** \fn void Inflater::inflate(char const * input, size_t input_size, char * output, size_t output_size);
+ * \brief Decompress a raw DEFLATE stream.
+ *
+ * This function decompresses the \p input_size bytes of \p input in
+ * \p output. The DEFLATE stream must decompress to exactly
+ * \p output_size bytes. Any data after the end of the DEFLATE stream
+ * is ignored.
+ *
+ * The \p output pointer may be null when \p output_size is zero.
+ *
+ * \exception IOException
+ * The compressed data is invalid or does not decompress to exactly
+ * \p output_size bytes.
+ *
+ * \param[in] input  The compressed data.
+ * \param[in] input_size  The number of bytes in \p input.
+ * \param[out] output  The buffer receiving the uncompressed data.
+ * \param[in] output_size  The exact size of the uncompressed data.
+ */
+
+
+/** \brief Create an inflater.
+ *
+ * This function creates the inflater named \p name. When \p name is
+ * an empty string, the fastest inflater available is created.
+ *
+ * \exception InvalidException
+ * The named inflater is not available in this build.
+ *
+ * \param[in] name  The name of the inflater to create or an empty string.
+ *
+ * \return A pointer to the new inflater.
+ *
+ * \sa getNames()
+ */
+Inflater::pointer_t Inflater::create(std::string const & name)
+{
+#ifdef ZIPIOS_HAS_LIBDEFLATE
+    if(name.empty()
+    || name == "libdeflate")
+    {
+        return pointer_t(new LibdeflateInflater);
+    }
+#endif
+    if(name.empty()
+    || name == "zlib")
+    {
+        return pointer_t(new ZlibInflater);
+    }
+
+    throw InvalidException("Inflater::create(): unknown inflater \"" + name + "\".");
+}
+
+
+/** \brief Retrieve the names of the available inflaters.
+ *
+ * This function returns the names which can be passed to create(),
+ * the fastest one first.
+ *
+ * \return The list of the available inflaters.
+ */
+std::vector<std::string> Inflater::getNames()
+{
+    std::vector<std::string> names;
+#ifdef ZIPIOS_HAS_LIBDEFLATE
+    names.push_back("libdeflate");
+#endif
+    names.push_back("zlib");
+    return names;
+}
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
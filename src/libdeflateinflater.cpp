@@ -0,0 +1,156 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2019  Made to Order Software Corporation
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Implementation of the zipios::LibdeflateInflater class.
+ *
+ * This file implements the inflater based on the libdeflate library.
+ */
+
+#include "libdeflateinflater.hpp"
+
+#include "zipios/zipiosexceptions.hpp"
+
+
+namespace zipios
+{
+
+
+/** \class LibdeflateInflater
+ * \brief Decompress whole entries with libdeflate.
+ *
+ * libdeflate only decompresses whole buffers, which is exactly what
+ * is needed to read a whole entry. It is much faster than zlib.
+ *
+ * A libdeflate decompressor can only be used by one thread at a time
+ * so the inflater keeps a pool of decompressors.
+ */
+
+
+/** \brief Initialize a libdeflate inflater.
+ *
+ * The decompressors get allocated the first time they are needed.
+ */
+LibdeflateInflater::LibdeflateInflater()
+    //: m_mutex() -- auto-init
+    //, m_decompressors() -- auto-init
+{
+}
+
+
+/** \brief Clean up the libdeflate inflater.
+ *
+ * The pooled decompressors are released.
+ */
+LibdeflateInflater::~LibdeflateInflater()
+{
+    for(auto d : m_decompressors)
+    {
+        libdeflate_free_decompressor(d);
+    }
+}
+
+
+/** \brief Retrieve the name of this inflater.
+ *
+ * \return "libdeflate".
+ */
+std::string LibdeflateInflater::getName() const
+{
+    return "libdeflate";
+}
+
+
+/** \brief Decompress a raw DEFLATE stream with libdeflate.
+ *
+ * See Inflater::inflate() for details.
+ *
+ * \exception IOException
+ * The compressed data is invalid or does not decompress to exactly
+ * \p output_size bytes.
+ *
+ * \param[in] input  The compressed data.
+ * \param[in] input_size  The number of bytes in \p input.
+ * \param[out] output  The buffer receiving the uncompressed data.
+ * \param[in] output_size  The exact size of the uncompressed data.
+ */
+void LibdeflateInflater::inflate(char const * input, size_t input_size, char * output, size_t output_size)
+{
+    libdeflate_decompressor * d(nullptr);
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if(!m_decompressors.empty())
+        {
+            d = m_decompressors.back();
+            m_decompressors.pop_back();
+        }
+    }
+    if(d == nullptr)
+    {
+        d = libdeflate_alloc_decompressor();
+        if(d == nullptr)
+        {
+            throw IOException("LibdeflateInflater::inflate(): could not allocate a decompressor."); // LCOV_EXCL_LINE
+        }
+    }
+
+    // without an actual size pointer, libdeflate fails unless the
+    // output is exactly output_size bytes
+    //
+    char empty(0);
+    libdeflate_result const r(libdeflate_deflate_decompress(
+                      d
+                    , input
+                    , input_size
+                    , output == nullptr ? &empty : output
+                    , output_size
+                    , nullptr));
+
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_decompressors.push_back(d);
+    }
+
+    switch(r)
+    {
+    case LIBDEFLATE_SUCCESS:
+        break;
+
+    case LIBDEFLATE_SHORT_OUTPUT:
+    case LIBDEFLATE_INSUFFICIENT_SPACE:
+        throw IOException("LibdeflateInflater::inflate(): the size of the inflated data does not match the size of the entry.");
+
+    default:
+        throw IOException("LibdeflateInflater::inflate(): invalid compressed data.");
+
+    }
+}
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
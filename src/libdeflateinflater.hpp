@@ -0,0 +1,71 @@
+#pragma once
+#ifndef ZIPIOS_LIBDEFLATEINFLATER_HPP
+#define ZIPIOS_LIBDEFLATEINFLATER_HPP
+
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2019  Made to Order Software Corporation
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Declaration of the zipios::LibdeflateInflater class.
+ *
+ * The zipios::LibdeflateInflater class decompresses whole entries with
+ * libdeflate. It is only compiled when libdeflate was found at build
+ * time.
+ */
+
+#include "zipios/inflater.hpp"
+
+#include <mutex>
+
+#include <libdeflate.h>
+
+
+namespace zipios
+{
+
+
+class LibdeflateInflater : public Inflater
+{
+public:
+                                LibdeflateInflater();
+                                LibdeflateInflater(LibdeflateInflater const & src) = delete;
+    LibdeflateInflater &        operator = (LibdeflateInflater const & rhs) = delete;
+    virtual                     ~LibdeflateInflater() override;
+
+    virtual std::string         getName() const override;
+    virtual void                inflate(char const * input, size_t input_size, char * output, size_t output_size) override;
+
+private:
+    std::mutex                  m_mutex;
+    std::vector<libdeflate_decompressor *>  m_decompressors;
+};
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
+#endif
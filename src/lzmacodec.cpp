@@ -0,0 +1,396 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2019  Made to Order Software Corporation
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Implementation of the zipios::LzmaCodec class.
+ *
+ * This file implements the LZMA codec using liblzma.
+ */
+
+#include "lzmacodec.hpp"
+
+#include "zipios/zipiosexceptions.hpp"
+
+#include "zipios_common.hpp"
+
+#include <cstdlib>
+#include <cstring>
+
+
+namespace zipios
+{
+
+
+namespace
+{
+
+
+/** \brief Bit of the general purpose bit field marking an end marker.
+ *
+ * When this bit is set in the headers of an LZMA entry, the compressed
+ * data ends with an end of stream marker.
+ */
+uint16_t const      g_end_marker = 1 << 1;
+
+
+/** \brief The size of the LZMA properties header.
+ *
+ * The compressed data starts with the version of the LZMA library
+ * (2 bytes), the size of the properties (2 bytes), and the properties
+ * themselves (5 bytes for LZMA1).
+ */
+size_t const        g_header_size = 9;
+
+
+/** \brief Throw an exception for a liblzma error.
+ *
+ * \exception IOException
+ * This function always throws.
+ *
+ * \param[in] where  The name of the function where the error occurred.
+ * \param[in] ret  The code returned by liblzma.
+ */
+[[noreturn]] void throwLzmaError(char const * where, lzma_ret ret)
+{
+    OutputStringStream msgs;
+    msgs << where << ": ";
+    switch(ret)
+    {
+    case LZMA_MEM_ERROR:
+        msgs << "out of memory";
+        break;
+
+    case LZMA_OPTIONS_ERROR:
+        msgs << "unsupported LZMA options";
+        break;
+
+    case LZMA_DATA_ERROR:
+    case LZMA_FORMAT_ERROR:
+        msgs << "invalid LZMA data";
+        break;
+
+    default:
+        msgs << "liblzma error " << static_cast<int>(ret);
+        break;
+
+    }
+    throw IOException(msgs.str());
+}
+
+
+} // no name namespace
+
+
+/** \class LzmaCodec
+ * \brief Compress and decompress LZMA entries.
+ *
+ * The data of an LZMA entry (method 14) starts with a 9 byte header
+ * with the LZMA properties followed by a raw LZMA stream. The stream
+ * may end with an end of stream marker. The codec always writes one
+ * and marks it in the general purpose bit field of the headers. When
+ * reading, the uncompressed size of the entry is used to stop the
+ * decompression so both kinds of streams are supported.
+ *
+ * The dictionary used to compress an entry is never made larger than
+ * the entry, which saves a lot of memory with small entries.
+ */
+
+
+/** \brief Initialize an LZMA codec.
+ *
+ * The liblzma state gets allocated once startDecompression() or
+ * startCompression() gets called.
+ */
+LzmaCodec::LzmaCodec()
+    //: m_stream(LZMA_STREAM_INIT) -- auto-init
+    //, m_header() -- auto-init
+    //, m_header_size(0) -- auto-init
+    //, m_header_position(0) -- auto-init
+    //, m_remaining(0) -- auto-init
+{
+}
+
+
+/** \brief Release the liblzma state.
+ *
+ * The destructor releases the memory allocated by liblzma.
+ */
+LzmaCodec::~LzmaCodec()
+{
+    lzma_end(&m_stream);
+}
+
+
+/** \brief Retrieve the compression method of this codec.
+ *
+ * \return StorageMethod::LZMA.
+ */
+StorageMethod LzmaCodec::getMethod() const
+{
+    return StorageMethod::LZMA;
+}
+
+
+/** \brief Retrieve the general purpose flags of LZMA entries.
+ *
+ * The compressed data always ends with an end of stream marker.
+ *
+ * \return The end of stream marker flag.
+ */
+uint16_t LzmaCodec::getGeneralPurposeFlags() const
+{
+    return g_end_marker;
+}
+
+
+/** \brief Compute the largest compressed size of some data.
+ *
+ * The range coder can expand incompressible data a little. The bound
+ * is made generous since it is only used to decide whether Zip64 is
+ * necessary.
+ *
+ * \param[in] size  The size of the uncompressed data.
+ *
+ * \return The largest possible size of the compressed data.
+ */
+size_t LzmaCodec::getCompressBound(size_t size) const
+{
+    return size + size / 3 + g_header_size + 128;
+}
+
+
+/** \brief Get ready to decompress the data of an entry.
+ *
+ * The LZMA decoder itself gets initialized once the properties
+ * header was read.
+ *
+ * \param[in] uncompressed_size  The size of the uncompressed data.
+ */
+void LzmaCodec::startDecompression(size_t uncompressed_size)
+{
+    m_header_size = 0;
+    m_remaining = uncompressed_size;
+}
+
+
+/** \brief Decompress some LZMA data.
+ *
+ * The function first reads the properties header, then decompresses
+ * the LZMA stream until the uncompressed size of the entry was output.
+ *
+ * \exception IOException
+ * The properties are not supported or the data is invalid.
+ *
+ * \param[in,out] input  The compressed data.
+ * \param[in,out] input_size  The number of bytes in \p input.
+ * \param[in,out] output  The buffer receiving the uncompressed data.
+ * \param[in,out] output_size  The number of bytes available in \p output.
+ *
+ * \return true once the uncompressed size of the entry was output.
+ */
+bool LzmaCodec::decompress(char const * & input, size_t & input_size, char * & output, size_t & output_size)
+{
+    if(m_remaining == 0)
+    {
+        return true;
+    }
+
+    if(m_header_size < g_header_size)
+    {
+        size_t const size(std::min(g_header_size - m_header_size, input_size));
+        memcpy(m_header + m_header_size, input, size);
+        m_header_size += size;
+        input += size;
+        input_size -= size;
+        if(m_header_size < g_header_size)
+        {
+            return false;
+        }
+
+        // bytes 0 and 1 are the version of the LZMA library, ignore them
+        //
+        if(m_header[2] != 5 || m_header[3] != 0)
+        {
+            throw IOException("LzmaCodec::decompress(): unsupported LZMA properties size.");
+        }
+
+        lzma_filter filters[2];
+        filters[0].id = LZMA_FILTER_LZMA1;
+        filters[0].options = nullptr;
+        filters[1].id = LZMA_VLI_UNKNOWN;
+        filters[1].options = nullptr;
+        lzma_ret ret(lzma_properties_decode(&filters[0], nullptr, m_header + 4, 5));
+        if(ret == LZMA_OK)
+        {
+            ret = lzma_raw_decoder(&m_stream, filters);
+        }
+        free(filters[0].options);
+        if(ret != LZMA_OK)
+        {
+            throwLzmaError("LzmaCodec::decompress()", ret);
+        }
+    }
+
+    // never output more than the size of the entry, the end of stream
+    // marker is optional so liblzma may not know where the data ends
+    //
+    size_t const size(std::min(output_size, m_remaining));
+    m_stream.next_in = reinterpret_cast<uint8_t const *>(input);
+    m_stream.avail_in = input_size;
+    m_stream.next_out = reinterpret_cast<uint8_t *>(output);
+    m_stream.avail_out = size;
+
+    lzma_ret const ret(lzma_code(&m_stream, LZMA_RUN));
+
+    size_t const decompressed(size - m_stream.avail_out);
+    input = reinterpret_cast<char const *>(m_stream.next_in);
+    input_size = m_stream.avail_in;
+    output += decompressed;
+    output_size -= decompressed;
+    m_remaining -= decompressed;
+
+    switch(ret)
+    {
+    case LZMA_OK:
+    case LZMA_BUF_ERROR:
+        return m_remaining == 0;
+
+    case LZMA_STREAM_END:
+        return true;
+
+    default:
+        throwLzmaError("LzmaCodec::decompress()", ret);
+
+    }
+}
+
+
+/** \brief Get ready to compress the data of an entry.
+ *
+ * The compression levels are converted to the liblzma presets 0 to 9.
+ * The properties header gets output by the first call to compress().
+ *
+ * \exception IOException
+ * The encoder cannot be initialized.
+ *
+ * \param[in] level  The compression level.
+ * \param[in] size  The expected size of the uncompressed data.
+ */
+void LzmaCodec::startCompression(FileEntry::CompressionLevel level, size_t size)
+{
+    lzma_options_lzma options;
+    if(lzma_lzma_preset(&options, convertLevel(level, 0, LZMA_PRESET_DEFAULT, 9)))
+    {
+        throw IOException("LzmaCodec::startCompression(): unsupported LZMA preset."); // LCOV_EXCL_LINE
+    }
+    if(size < options.dict_size)
+    {
+        options.dict_size = std::max(static_cast<uint32_t>(size), static_cast<uint32_t>(LZMA_DICT_SIZE_MIN));
+    }
+
+    lzma_filter filters[2];
+    filters[0].id = LZMA_FILTER_LZMA1;
+    filters[0].options = &options;
+    filters[1].id = LZMA_VLI_UNKNOWN;
+    filters[1].options = nullptr;
+
+    m_header[0] = LZMA_VERSION_MAJOR;
+    m_header[1] = LZMA_VERSION_MINOR;
+    m_header[2] = 5;
+    m_header[3] = 0;
+    lzma_ret ret(lzma_properties_encode(&filters[0], m_header + 4));
+    if(ret == LZMA_OK)
+    {
+        ret = lzma_raw_encoder(&m_stream, filters);
+    }
+    if(ret != LZMA_OK)
+    {
+        throwLzmaError("LzmaCodec::startCompression()", ret); // LCOV_EXCL_LINE
+    }
+    m_header_position = 0;
+}
+
+
+/** \brief Compress some data with LZMA.
+ *
+ * \exception IOException
+ * liblzma failed compressing the data.
+ *
+ * \param[in,out] input  The data to compress.
+ * \param[in,out] input_size  The number of bytes in \p input.
+ * \param[in,out] output  The buffer receiving the compressed data.
+ * \param[in,out] output_size  The number of bytes available in \p output.
+ * \param[in] finish  Whether all the data was given to the codec.
+ *
+ * \return true once all the compressed data was output.
+ */
+bool LzmaCodec::compress(char const * & input, size_t & input_size, char * & output, size_t & output_size, bool finish)
+{
+    if(m_header_position < g_header_size)
+    {
+        size_t const size(std::min(g_header_size - m_header_position, output_size));
+        memcpy(output, m_header + m_header_position, size);
+        m_header_position += size;
+        output += size;
+        output_size -= size;
+        if(m_header_position < g_header_size)
+        {
+            return false;
+        }
+    }
+
+    m_stream.next_in = reinterpret_cast<uint8_t const *>(input);
+    m_stream.avail_in = input_size;
+    m_stream.next_out = reinterpret_cast<uint8_t *>(output);
+    m_stream.avail_out = output_size;
+
+    lzma_ret const ret(lzma_code(&m_stream, finish ? LZMA_FINISH : LZMA_RUN));
+
+    input = reinterpret_cast<char const *>(m_stream.next_in);
+    input_size = m_stream.avail_in;
+    output = reinterpret_cast<char *>(m_stream.next_out);
+    output_size = m_stream.avail_out;
+
+    switch(ret)
+    {
+    case LZMA_OK:
+    case LZMA_BUF_ERROR:
+        return false;
+
+    case LZMA_STREAM_END:
+        return true;
+
+    default:
+        throwLzmaError("LzmaCodec::compress()", ret); // LCOV_EXCL_LINE
+
+    }
+}
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
@@ -0,0 +1,79 @@
+#pragma once
+#ifndef ZIPIOS_LZMACODEC_HPP
+#define ZIPIOS_LZMACODEC_HPP
+
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2019  Made to Order Software Corporation
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Declaration of the zipios::LzmaCodec class.
+ *
+ * The zipios::LzmaCodec class compresses and decompresses LZMA entries
+ * with liblzma. It is only compiled when liblzma was found at build
+ * time.
+ */
+
+#include "codec.hpp"
+
+#include <lzma.h>
+
+
+namespace zipios
+{
+
+
+class LzmaCodec : public Codec
+{
+public:
+                                LzmaCodec();
+                                LzmaCodec(LzmaCodec const & src) = delete;
+    LzmaCodec &                 operator = (LzmaCodec const & rhs) = delete;
+    virtual                     ~LzmaCodec() override;
+
+    virtual StorageMethod       getMethod() const override;
+    virtual uint16_t            getGeneralPurposeFlags() const override;
+    virtual size_t              getCompressBound(size_t size) const override;
+
+    virtual void                startDecompression(size_t uncompressed_size) override;
+    virtual bool                decompress(char const * & input, size_t & input_size, char * & output, size_t & output_size) override;
+
+    virtual void                startCompression(FileEntry::CompressionLevel level, size_t size) override;
+    virtual bool                compress(char const * & input, size_t & input_size, char * & output, size_t & output_size, bool finish) override;
+
+private:
+    lzma_stream                 m_stream = LZMA_STREAM_INIT;
+    unsigned char               m_header[9] = {};
+    size_t                      m_header_size = 0;
+    size_t                      m_header_position = 0;
+    size_t                      m_remaining = 0;
+};
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
+#endif
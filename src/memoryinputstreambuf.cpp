@@ -0,0 +1,217 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2019  Made to Order Software Corporation
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Implementation of the zipios::MemoryInputStreambuf class.
+ *
+ * This file implements a read-only std::streambuf over a buffer
+ * in memory.
+ */
+
+#include "memoryinputstreambuf.hpp"
+
+
+namespace zipios
+{
+
+
+/** \class MemoryInputStreambuf
+ * \brief An input stream buffer reading directly from memory.
+ *
+ * The MemoryInputStreambuf class makes a buffer in memory, generally
+ * a MemoryMappedFile, available as an std::streambuf. The get area
+ * is the buffer itself so reading from this streambuf does not require
+ * any intermediate copy and no underflow() ever happens.
+ *
+ * The class also gives direct access to the data at the current
+ * position with current() and remaining(). This is used by the
+ * ZipInputStreambuf and InflateInputStreambuf classes to read the
+ * data of an entry without copying it first.
+ *
+ * The buffer is never modified. It must remain valid for as long as
+ * this streambuf exists.
+ */
+
+
+/** \brief Initialize a memory input stream buffer.
+ *
+ * This constructor sets up the get area to the specified buffer.
+ *
+ * \param[in] data  A pointer to the data to read from.
+ * \param[in] size  The number of bytes available in \p data.
+ */
+MemoryInputStreambuf::MemoryInputStreambuf(char const * data, size_t size)
+{
+    // the get area is never written to, see pbackfail() which we do
+    // not override and thus never accepts a different character
+    //
+    char * const start(const_cast<char *>(data));
+    setg(start, start, start + size);
+}
+
+
+/** \fn MemoryInputStreambuf::MemoryInputStreambuf(MemoryInputStreambuf const & src);
+ * \brief The copy constructor is deleted.
+ *
+ * MemoryInputStreambuf objects cannot be copied.
+ *
+ * \param[in] src  The source to copy.
+ */
+
+
+/** \fn MemoryInputStreambuf & MemoryInputStreambuf::operator = (MemoryInputStreambuf const & rhs);
+ * \brief The assignment operator is deleted.
+ *
+ * MemoryInputStreambuf objects cannot be copied.
+ *
+ * \param[in] rhs  The source to copy.
+ *
+ * \return A reference to this object.
+ */
+
+
+/** \brief Clean up the memory input stream buffer.
+ *
+ * The buffer is not owned by this object so the destructor has
+ * nothing to do.
+ */
+MemoryInputStreambuf::~MemoryInputStreambuf()
+{
+}
+
+
+/** \brief Retrieve a pointer to the data at the current position.
+ *
+ * This function returns a pointer to the next byte that would be
+ * read from this streambuf.
+ *
+ * \return A pointer to the current read position.
+ */
+char const * MemoryInputStreambuf::current() const
+{
+    return gptr();
+}
+
+
+/** \brief Retrieve the number of bytes left in the buffer.
+ *
+ * This function returns the number of bytes between the current
+ * position and the end of the buffer.
+ *
+ * \return The number of bytes that can still be read.
+ */
+size_t MemoryInputStreambuf::remaining() const
+{
+    return egptr() - gptr();
+}
+
+
+/** \brief Change the current position.
+ *
+ * This function moves the current position relative to the start,
+ * the current position, or the end of the buffer.
+ *
+ * Attempting to move outside of the buffer fails.
+ *
+ * \param[in] off  The offset to apply.
+ * \param[in] dir  The origin of the offset.
+ * \param[in] which  Only std::ios_base::in is supported.
+ *
+ * \return The new position or pos_type(off_type(-1)) on errors.
+ */
+MemoryInputStreambuf::pos_type MemoryInputStreambuf::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which)
+{
+    if((which & std::ios_base::in) == 0)
+    {
+        return pos_type(off_type(-1));
+    }
+
+    off_type base(0);
+    switch(dir)
+    {
+    case std::ios_base::beg:
+        break;
+
+    case std::ios_base::cur:
+        base = gptr() - eback();
+        break;
+
+    case std::ios_base::end:
+        base = egptr() - eback();
+        break;
+
+    default:
+        return pos_type(off_type(-1)); // LCOV_EXCL_LINE
+
+    }
+
+    off_type const pos(base + off);
+    if(pos < 0 || pos > egptr() - eback())
+    {
+        return pos_type(off_type(-1));
+    }
+
+    setg(eback(), eback() + pos, egptr());
+
+    return pos_type(pos);
+}
+
+
+/** \brief Change the current position.
+ *
+ * This function moves the current position to the absolute position
+ * \p pos.
+ *
+ * \param[in] pos  The new position.
+ * \param[in] which  Only std::ios_base::in is supported.
+ *
+ * \return The new position or pos_type(off_type(-1)) on errors.
+ */
+MemoryInputStreambuf::pos_type MemoryInputStreambuf::seekpos(pos_type pos, std::ios_base::openmode which)
+{
+    return seekoff(off_type(pos), std::ios_base::beg, which);
+}
+
+
+/** \brief Return the number of bytes still available.
+ *
+ * Since all the data is present in memory, this function returns
+ * the exact number of bytes that are still available or -1 once
+ * the end of the buffer was reached.
+ *
+ * \return The number of bytes available or -1.
+ */
+std::streamsize MemoryInputStreambuf::showmanyc()
+{
+    std::streamsize const size(remaining());
+    return size == 0 ? -1 : size;
+}
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
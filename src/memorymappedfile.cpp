@@ -0,0 +1,231 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2019  Made to Order Software Corporation
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Implementation of the zipios::MemoryMappedFile class.
+ *
+ * This file includes the operating system specific code used to map
+ * a file in memory.
+ */
+
+#if !defined(ZIPIOS_WINDOWS) && (defined(_WINDOWS) || defined(WIN32) || defined(_WIN32) || defined(__WIN32))
+#define ZIPIOS_WINDOWS
+#endif
+
+#include "memorymappedfile.hpp"
+
+#include "zipios/zipiosexceptions.hpp"
+
+#ifdef ZIPIOS_WINDOWS
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+namespace zipios
+{
+
+
+/** \class MemoryMappedFile
+ * \brief Map a file in memory for reading.
+ *
+ * The MemoryMappedFile class maps an entire file in memory, read-only.
+ * The ZipFile uses it when opened with AccessMode::MEMORY_MAP so the
+ * Central Directory, the local headers and the compressed data all get
+ * read directly from memory instead of going through an std::ifstream.
+ *
+ * The object is generally held in a shared pointer since the ZipFile
+ * and all the input streams it returns need to keep the mapping alive.
+ *
+ * \note
+ * An empty file cannot be mapped. In that case data() returns nullptr
+ * and size() returns zero.
+ */
+
+
+/** \brief Map the named file in memory.
+ *
+ * This constructor opens the named file and maps it in memory. The
+ * file descriptor is closed immediately since the mapping remains
+ * valid without it.
+ *
+ * \exception IOException
+ * The function throws if the file cannot be opened, its size cannot
+ * be determined, or the mapping fails.
+ *
+ * \param[in] filename  The name of the file to map in memory.
+ */
+MemoryMappedFile::MemoryMappedFile(std::string const & filename)
+{
+#ifdef ZIPIOS_WINDOWS
+    HANDLE const file(CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr));
+    if(file == INVALID_HANDLE_VALUE)
+    {
+        throw IOException("Error opening file \"" + filename + "\" to map it in memory.");
+    }
+    m_file = file;
+
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(file, &size))
+    {
+        CloseHandle(file);
+        throw IOException("Error retrieving the size of file \"" + filename + "\".");
+    }
+    m_size = static_cast<size_t>(size.QuadPart);
+    if(m_size == 0)
+    {
+        return;
+    }
+
+    HANDLE const mapping(CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr));
+    if(mapping == nullptr)
+    {
+        CloseHandle(file);
+        throw IOException("Error mapping file \"" + filename + "\" in memory.");
+    }
+    m_mapping = mapping;
+
+    m_data = static_cast<char const *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if(m_data == nullptr)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        throw IOException("Error mapping file \"" + filename + "\" in memory.");
+    }
+#else
+    int const fd(open(filename.c_str(), O_RDONLY));
+    if(fd < 0)
+    {
+        throw IOException("Error opening file \"" + filename + "\" to map it in memory.");
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0)
+    {
+        close(fd);                                                                  // LCOV_EXCL_LINE
+        throw IOException("Error retrieving the size of file \"" + filename + "\"."); // LCOV_EXCL_LINE
+    }
+    m_size = static_cast<size_t>(st.st_size);
+    if(m_size == 0)
+    {
+        close(fd);
+        return;
+    }
+
+    void * const ptr(mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0));
+    close(fd);
+    if(ptr == MAP_FAILED)
+    {
+        throw IOException("Error mapping file \"" + filename + "\" in memory.");
+    }
+    m_data = static_cast<char const *>(ptr);
+#endif
+}
+
+
+/** \fn MemoryMappedFile::MemoryMappedFile(MemoryMappedFile const & src);
+ * \brief The copy constructor is deleted.
+ *
+ * A memory mapped file cannot be copied. Share it using a shared
+ * pointer instead.
+ *
+ * \param[in] src  The source to copy.
+ */
+
+
+/** \fn MemoryMappedFile & MemoryMappedFile::operator = (MemoryMappedFile const & rhs);
+ * \brief The assignment operator is deleted.
+ *
+ * A memory mapped file cannot be copied. Share it using a shared
+ * pointer instead.
+ *
+ * \param[in] rhs  The source to copy.
+ *
+ * \return A reference to this object.
+ */
+
+
+/** \brief Unmap the file.
+ *
+ * The destructor releases the mapping.
+ */
+MemoryMappedFile::~MemoryMappedFile()
+{
+#ifdef ZIPIOS_WINDOWS
+    if(m_data != nullptr)
+    {
+        UnmapViewOfFile(m_data);
+    }
+    if(m_mapping != nullptr)
+    {
+        CloseHandle(m_mapping);
+    }
+    if(m_file != nullptr)
+    {
+        CloseHandle(m_file);
+    }
+#else
+    if(m_data != nullptr)
+    {
+        munmap(const_cast<char *>(m_data), m_size);
+    }
+#endif
+}
+
+
+/** \brief Retrieve a pointer to the mapped data.
+ *
+ * This function returns a pointer to the first byte of the file.
+ * The data is read-only.
+ *
+ * \return A pointer to the file data or nullptr if the file is empty.
+ */
+char const * MemoryMappedFile::data() const
+{
+    return m_data;
+}
+
+
+/** \brief Retrieve the size of the mapped file.
+ *
+ * This function returns the size of the file in bytes.
+ *
+ * \return The number of bytes accessible through data().
+ */
+size_t MemoryMappedFile::size() const
+{
+    return m_size;
+}
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
@@ -0,0 +1,373 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2019  Made to Order Software Corporation
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Implementation of the zipios::ParallelCompressor class.
+ *
+ * This file implements the worker threads used by
+ * zipios::ZipFile::saveCollectionToArchive() to compress several
+ * entries at the same time.
+ */
+
+#include "parallelcompressor.hpp"
+
+#include "ziplocalentry.hpp"
+#include "zipoutputstream.hpp"
+
+#include <algorithm>
+
+
+namespace zipios
+{
+
+
+namespace
+{
+
+
+/** \brief A stream buffer writing the output to a vector.
+ *
+ * The workers save the entries they compress in memory with this
+ * stream buffer. It supports seeking within the data already written
+ * so the ZipOutputStream can also rewrite the local header as it does
+ * when it is not in streaming mode.
+ */
+class VectorOutputStreambuf
+    : public std::streambuf
+{
+public:
+    VectorOutputStreambuf(std::vector<char> & data)
+        : m_data(data)
+        //, m_position(0) -- auto-init
+    {
+    }
+
+protected:
+    virtual int_type overflow(int_type c) override
+    {
+        if(!traits_type::eq_int_type(c, traits_type::eof()))
+        {
+            char_type const d(traits_type::to_char_type(c));
+            xsputn(&d, 1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    virtual std::streamsize xsputn(char_type const * s, std::streamsize n) override
+    {
+        size_t const overwrite(std::min(static_cast<size_t>(n), m_data.size() - m_position));
+        std::copy(s, s + overwrite, m_data.begin() + m_position);
+        m_data.insert(m_data.end(), s + overwrite, s + n);
+        m_position += n;
+        return n;
+    }
+
+    virtual pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override
+    {
+        if((which & std::ios_base::out) == 0)
+        {
+            return pos_type(off_type(-1));
+        }
+
+        off_type position(off);
+        if(dir == std::ios_base::cur)
+        {
+            position += m_position;
+        }
+        else if(dir == std::ios_base::end)
+        {
+            position += m_data.size();
+        }
+        if(position < 0
+        || static_cast<size_t>(position) > m_data.size())
+        {
+            return pos_type(off_type(-1));
+        }
+        m_position = position;
+        return pos_type(position);
+    }
+
+    virtual pos_type seekpos(pos_type pos, std::ios_base::openmode which) override
+    {
+        return seekoff(off_type(pos), std::ios_base::beg, which);
+    }
+
+private:
+    std::vector<char> &     m_data;
+    size_t                  m_position = 0;
+};
+
+
+} // no name namespace
+
+
+
+/** \class ParallelCompressor
+ * \brief Compress entries with several threads.
+ *
+ * The ParallelCompressor starts a number of threads which compress the
+ * entries of a collection in memory, in the order in which they appear
+ * in the archive. The ZipFile::saveCollectionToArchive() function then
+ * saves them one after the other with ZipOutputStream::putRawEntry().
+ *
+ * Each entry gets compressed exactly as the ZipOutputStream would
+ * compress it on its own, in the same streaming mode and with the
+ * same number of threads per entry, so the resulting archive is byte
+ * for byte the same whatever the number of threads.
+ *
+ * The memory used by the compressed entries waiting to be saved is
+ * limited by a budget. A thread only starts compressing the next entry
+ * once the upper bound of its size (see getMemoryBound()) fits in the
+ * budget. The entries which do not fit in the budget at all are not
+ * given to the ParallelCompressor; the caller compresses those
+ * directly to the output while the threads go on with the next entries.
+ */
+
+
+/** \brief Start the threads compressing entries.
+ *
+ * The \p entries vector has one item per entry of the archive. The
+ * entries to compress are defined and must be ZipCentralDirectoryEntry
+ * objects since the same object is later saved in the archive. The
+ * other items are null pointers and get skipped.
+ *
+ * The upper bound of the size of each entry to compress must fit in
+ * \p memory_budget.
+ *
+ * \param[in] collection  The collection from which the data is read.
+ * \param[in] entries  The entries of the archive.
+ * \param[in] thread_count  The number of threads to start.
+ * \param[in] streaming  Whether the archive is saved in streaming mode.
+ * \param[in] deflate_thread_count  The number of threads compressing
+ *                                  the blocks of each DEFLATED entry.
+ * \param[in] memory_budget  The maximum number of bytes reserved by
+ *                           the entries compressed but not yet released.
+ */
+ParallelCompressor::ParallelCompressor(FileCollection & collection, FileEntry::vector_t const & entries, size_t thread_count, bool streaming, size_t deflate_thread_count, size_t memory_budget)
+    : m_collection(collection)
+    , m_streaming(streaming)
+    , m_deflate_thread_count(deflate_thread_count)
+    , m_memory_budget(memory_budget)
+    , m_jobs(entries.size())
+    //, m_next(0) -- auto-init
+    //, m_reserved(0) -- auto-init
+    //, m_stop(false) -- auto-init
+    //, m_mutex() -- auto-init
+    //, m_condition() -- auto-init
+    //, m_threads() -- auto-init
+{
+    for(size_t idx(0); idx < entries.size(); ++idx)
+    {
+        if(entries[idx] != nullptr)
+        {
+            m_jobs[idx].m_entry = entries[idx];
+            m_jobs[idx].m_reserved = getMemoryBound(*entries[idx]);
+        }
+    }
+
+    for(size_t idx(0); idx < thread_count; ++idx)
+    {
+        m_threads.push_back(std::thread(&ParallelCompressor::run, this));
+    }
+}
+
+
+/** \brief Stop the threads.
+ *
+ * The entries being compressed are completed, the other ones are
+ * abandoned.
+ */
+ParallelCompressor::~ParallelCompressor()
+{
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_stop = true;
+    }
+    m_condition.notify_all();
+
+    for(auto & t : m_threads)
+    {
+        t.join();
+    }
+}
+
+
+/** \brief Compute the memory needed to compress an entry.
+ *
+ * This function returns an upper bound of the size of the buffer
+ * holding the local header, compressed data, and data descriptor of
+ * \p entry, based on the uncompressed size of the entry.
+ *
+ * \param[in] entry  The entry to be compressed.
+ *
+ * \return The number of bytes reserved to compress \p entry.
+ */
+size_t ParallelCompressor::getMemoryBound(FileEntry const & entry)
+{
+    // the compressed data, with some room for incompressible data,
+    // plus the local header, its Zip64 extra field, and a data descriptor
+    //
+    size_t const size(entry.getSize());
+    return size + (size >> 8) + 1024 + entry.getName().length() + entry.getExtra().size();
+}
+
+
+/** \brief Wait for the compressed data of an entry.
+ *
+ * This function blocks until the entry at \p index was compressed.
+ * Its CRC and sizes are then defined and the function returns a
+ * pointer to its compressed data, which remains valid until release()
+ * gets called.
+ *
+ * \exception std::exception
+ * The exception raised while compressing the entry gets rethrown.
+ *
+ * \param[in] index  The index of the entry.
+ *
+ * \return A pointer to FileEntry::getCompressedSize() bytes of data.
+ */
+char const * ParallelCompressor::getCompressedData(size_t index)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    job_t & job(m_jobs[index]);
+    while(!job.m_done)
+    {
+        m_condition.wait(lock);
+    }
+    if(job.m_error != nullptr)
+    {
+        std::rethrow_exception(job.m_error);
+    }
+    return job.m_data.data() + job.m_data_offset;
+}
+
+
+/** \brief Release the memory of a compressed entry.
+ *
+ * Once the compressed data of the entry at \p index was saved, this
+ * function frees it and lets the threads compress more entries.
+ *
+ * \param[in] index  The index of the entry.
+ */
+void ParallelCompressor::release(size_t index)
+{
+    std::vector<char> data;
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        job_t & job(m_jobs[index]);
+        m_reserved -= job.m_reserved;
+        job.m_reserved = 0;
+        job.m_data.swap(data);
+    }
+    m_condition.notify_all();
+}
+
+
+/** \brief Compress entries until all are done or the object is destroyed.
+ *
+ * Each thread runs this function. The entries are started in order so
+ * the entries saved first are compressed first and the memory budget
+ * never prevents the next entry to be saved from being compressed.
+ */
+void ParallelCompressor::run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for(;;)
+    {
+        while(m_next < m_jobs.size() && m_jobs[m_next].m_entry == nullptr)
+        {
+            ++m_next;
+        }
+        if(m_stop || m_next >= m_jobs.size())
+        {
+            return;
+        }
+
+        job_t & job(m_jobs[m_next]);
+        if(m_reserved + job.m_reserved > m_memory_budget)
+        {
+            m_condition.wait(lock);
+            continue;
+        }
+        m_reserved += job.m_reserved;
+        ++m_next;
+
+        lock.unlock();
+        try
+        {
+            compress(job);
+        }
+        catch(...)
+        {
+            job.m_error = std::current_exception();
+        }
+        lock.lock();
+
+        job.m_done = true;
+        m_condition.notify_all();
+    }
+}
+
+
+/** \brief Compress one entry in memory.
+ *
+ * The entry gets compressed with a ZipOutputStream in the streaming
+ * mode of the archive, the same way it would be compressed directly
+ * in the archive. The
+ * local header saved in memory is skipped when the data gets saved.
+ *
+ * \param[in,out] job  The job with the entry to compress.
+ */
+void ParallelCompressor::compress(job_t & job)
+{
+    job.m_data.reserve(job.m_reserved);
+    VectorOutputStreambuf buf(job.m_data);
+    std::ostream os(&buf);
+
+    {
+        ZipOutputStream output_stream(os);
+        output_stream.setStreaming(m_streaming);
+        output_stream.setThreadCount(m_deflate_thread_count);
+
+        FileCollection::stream_pointer_t is(m_collection.getInputStream(job.m_entry->getName()));
+        output_stream.putEntry(job.m_entry, is.get());
+        output_stream.closeEntry();
+
+        // finish here so exceptions are not lost in the destructor; the
+        // central directory is not needed, it gets cut by the resize()
+        //
+        output_stream.finish();
+    }
+
+    job.m_data_offset = static_cast<ZipLocalEntry *>(job.m_entry.get())->ZipLocalEntry::getHeaderSize();
+    job.m_data.resize(job.m_data_offset + job.m_entry->getCompressedSize());
+}
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
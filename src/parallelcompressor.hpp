@@ -0,0 +1,95 @@
+#pragma once
+#ifndef ZIPIOS_PARALLELCOMPRESSOR_HPP
+#define ZIPIOS_PARALLELCOMPRESSOR_HPP
+
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2019  Made to Order Software Corporation
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Define the zipios::ParallelCompressor class.
+ *
+ * The zipios::ParallelCompressor class compresses the entries of a
+ * collection in memory using several threads while they get saved
+ * to a Zip archive in order.
+ */
+
+#include "zipios/filecollection.hpp"
+
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+
+namespace zipios
+{
+
+
+class ParallelCompressor
+{
+public:
+                            ParallelCompressor(FileCollection & collection, FileEntry::vector_t const & entries, size_t thread_count, bool streaming, size_t deflate_thread_count, size_t memory_budget);
+                            ParallelCompressor(ParallelCompressor const & src) = delete;
+    ParallelCompressor &    operator = (ParallelCompressor const & rhs) = delete;
+                            ~ParallelCompressor();
+
+    static size_t           getMemoryBound(FileEntry const & entry);
+    char const *            getCompressedData(size_t index);
+    void                    release(size_t index);
+
+private:
+    struct job_t
+    {
+        FileEntry::pointer_t    m_entry;
+        size_t                  m_reserved = 0;
+        bool                    m_done = false;
+        std::vector<char>       m_data;
+        size_t                  m_data_offset = 0;
+        std::exception_ptr      m_error;
+    };
+
+    void                    run();
+    void                    compress(job_t & job);
+
+    FileCollection &        m_collection;
+    bool                    m_streaming = false;
+    size_t                  m_deflate_thread_count = 1;
+    size_t                  m_memory_budget = 0;
+    std::vector<job_t>      m_jobs;
+    size_t                  m_next = 0;
+    size_t                  m_reserved = 0;
+    bool                    m_stop = false;
+    std::mutex              m_mutex;
+    std::condition_variable m_condition;
+    std::vector<std::thread> m_threads;
+};
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
+#endif
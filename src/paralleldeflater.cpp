@@ -0,0 +1,437 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2019  Made to Order Software Corporation
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Implementation of the zipios::ParallelDeflater class.
+ *
+ * This file implements the threads used by the
+ * zipios::DeflateOutputStreambuf class to compress large entries.
+ */
+
+#include "paralleldeflater.hpp"
+
+#include "zipios/zipiosexceptions.hpp"
+
+#include "crc32.hpp"
+#include "zipios_common.hpp"
+
+#include <algorithm>
+
+#include <zlib.h>
+
+
+namespace zipios
+{
+
+
+/** \class ParallelDeflater
+ * \brief Compress one stream of data with several threads.
+ *
+ * The ParallelDeflater cuts the data in blocks of BLOCK_SIZE bytes and
+ * compresses each block as a separate raw deflate stream on a thread.
+ * Each stream gets the last DICTIONARY_SIZE bytes of the previous block
+ * as its dictionary so the compression ratio is nearly the same as
+ * compressing all the data at once.
+ *
+ * All the blocks, except the last one, end with a sync flush, which
+ * ends the deflate data on a byte boundary without marking it as the
+ * last deflate block. The compressed blocks are therefore concatenated
+ * as is and form one standard deflate stream any inflater can read.
+ *
+ * The CRC of each block is also computed by the threads and they get
+ * combined with crc32_combine().
+ *
+ * The output only depends on the compression level and the data, not
+ * on the number of threads.
+ */
+
+
+/** \brief The size of the blocks compressed by each thread.
+ *
+ * The input data is cut in blocks of this size. Only the last block
+ * may be smaller.
+ */
+size_t const ParallelDeflater::BLOCK_SIZE;
+
+
+/** \brief The size of the dictionary of each block.
+ *
+ * The deflate window is 32Kb so each block gets primed with that many
+ * bytes found at the end of the previous block.
+ */
+size_t const ParallelDeflater::DICTIONARY_SIZE;
+
+
+/** \brief Initialize a parallel deflater.
+ *
+ * The threads only get started once the data does not fit in a single
+ * block. Smaller data gets compressed by the calling thread.
+ *
+ * \param[in] zlevel  The zlib compression level, from 1 to 9 or
+ *                    Z_DEFAULT_COMPRESSION.
+ * \param[in] thread_count  The number of threads compressing blocks.
+ */
+ParallelDeflater::ParallelDeflater(int zlevel, size_t thread_count)
+    : m_zlevel(zlevel)
+    , m_thread_count(std::max(static_cast<size_t>(1), thread_count))
+    //, m_input() -- auto-init
+    //, m_dictionary_size(0) -- auto-init
+    //, m_crc32(0) -- auto-init
+    //, m_pending() -- auto-init
+    //, m_queue() -- auto-init
+    //, m_stop(false) -- auto-init
+    //, m_mutex() -- auto-init
+    //, m_condition() -- auto-init
+    //, m_threads() -- auto-init
+{
+    m_input.reserve(DICTIONARY_SIZE + BLOCK_SIZE);
+    m_crc32 = crc32(0, Z_NULL, 0);
+}
+
+
+/** \brief Stop the threads.
+ *
+ * The blocks being compressed are completed, the other ones are
+ * abandoned.
+ */
+ParallelDeflater::~ParallelDeflater()
+{
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_stop = true;
+    }
+    m_condition.notify_all();
+
+    for(auto & t : m_threads)
+    {
+        t.join();
+    }
+}
+
+
+/** \brief Add data to be compressed.
+ *
+ * The data gets copied in the current block. Each time a block is
+ * full, it gets passed to the threads. The blocks compressed so far
+ * get written to \p outbuf, in order.
+ *
+ * To limit the amount of memory used, the function waits for the
+ * oldest block to be compressed when twice as many blocks as there
+ * are threads are waiting to be written.
+ *
+ * \exception IOException
+ * The compression of a block failed or \p outbuf did not accept the
+ * compressed data.
+ *
+ * \param[in] data  The data to compress.
+ * \param[in] size  The number of bytes in \p data.
+ * \param[in] outbuf  The stream buffer receiving the compressed data.
+ *
+ * \return The number of bytes written to \p outbuf.
+ */
+size_t ParallelDeflater::write(char const * data, size_t size, std::streambuf * outbuf)
+{
+    size_t written(0);
+    while(size > 0)
+    {
+        // a full block only gets submitted once more data is available
+        // because the last block has to be finished instead of flushed
+        //
+        if(m_input.size() == m_dictionary_size + BLOCK_SIZE)
+        {
+            submit(false);
+            written += output(outbuf, m_thread_count * 2);
+        }
+
+        size_t const count(std::min(size, m_dictionary_size + BLOCK_SIZE - m_input.size()));
+        m_input.insert(m_input.end(), data, data + count);
+        data += count;
+        size -= count;
+    }
+
+    return written;
+}
+
+
+/** \brief Compress the last block and write all the remaining data.
+ *
+ * This function ends the deflate stream. Once it returned, getCrc32()
+ * returns the CRC of all the data passed to write().
+ *
+ * \exception IOException
+ * The compression of a block failed or \p outbuf did not accept the
+ * compressed data.
+ *
+ * \param[in] outbuf  The stream buffer receiving the compressed data.
+ *
+ * \return The number of bytes written to \p outbuf.
+ */
+size_t ParallelDeflater::finish(std::streambuf * outbuf)
+{
+    submit(true);
+    return output(outbuf, 0);
+}
+
+
+/** \brief Retrieve the CRC of the data.
+ *
+ * The CRC only includes the blocks which were written so far. After
+ * finish() was called, it is the CRC of all the data.
+ *
+ * \return The CRC32 of the data written.
+ */
+uint32_t ParallelDeflater::getCrc32() const
+{
+    return m_crc32;
+}
+
+
+/** \brief Pass the current block to the threads.
+ *
+ * The current block is queued for compression and a new block gets
+ * started with the last DICTIONARY_SIZE bytes of the current block as
+ * its dictionary.
+ *
+ * When the data fits in a single block, no thread gets started and the
+ * block is compressed immediately.
+ *
+ * \param[in] last  Whether this is the last block of data.
+ */
+void ParallelDeflater::submit(bool last)
+{
+    block_t::pointer_t block(new block_t);
+    block->m_input.swap(m_input);
+    block->m_dictionary_size = m_dictionary_size;
+    block->m_last = last;
+
+    if(!last)
+    {
+        m_dictionary_size = std::min(DICTIONARY_SIZE, block->m_input.size());
+        m_input.reserve(DICTIONARY_SIZE + BLOCK_SIZE);
+        m_input.insert(m_input.end(), block->m_input.end() - m_dictionary_size, block->m_input.end());
+    }
+
+    if(last && m_threads.empty())
+    {
+        compress(*block);
+        block->m_done = true;
+        m_pending.push_back(block);
+        return;
+    }
+
+    if(m_threads.empty())
+    {
+        for(size_t idx(0); idx < m_thread_count; ++idx)
+        {
+            m_threads.push_back(std::thread(&ParallelDeflater::run, this));
+        }
+    }
+
+    m_pending.push_back(block);
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_queue.push_back(block);
+    }
+    m_condition.notify_all();
+}
+
+
+/** \brief Write the compressed blocks.
+ *
+ * This function writes the blocks which are compressed to \p outbuf in
+ * order. It stops at the first block not yet compressed unless more
+ * than \p max_pending blocks are waiting to be written.
+ *
+ * \exception IOException
+ * The compression of a block failed or \p outbuf did not accept the
+ * compressed data.
+ *
+ * \param[in] outbuf  The stream buffer receiving the compressed data.
+ * \param[in] max_pending  The number of blocks which can remain.
+ *
+ * \return The number of bytes written to \p outbuf.
+ */
+size_t ParallelDeflater::output(std::streambuf * outbuf, size_t max_pending)
+{
+    size_t written(0);
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while(!m_pending.empty())
+    {
+        block_t::pointer_t block(m_pending.front());
+        if(!block->m_done)
+        {
+            if(m_pending.size() <= max_pending)
+            {
+                break;
+            }
+            m_condition.wait(lock);
+            continue;
+        }
+        m_pending.pop_front();
+        lock.unlock();
+
+        if(block->m_error != nullptr)
+        {
+            std::rethrow_exception(block->m_error);
+        }
+
+        m_crc32 = crc32_combine(m_crc32, block->m_crc32, block->m_input.size() - block->m_dictionary_size);
+
+        std::streamsize const size(block->m_output.size());
+        if(outbuf->sputn(block->m_output.data(), size) != size)
+        {
+            throw IOException("ParallelDeflater::output(): write to buffer failed."); // LCOV_EXCL_LINE
+        }
+        written += size;
+
+        lock.lock();
+    }
+
+    return written;
+}
+
+
+/** \brief Compress blocks until the object is destroyed.
+ *
+ * Each thread runs this function. The blocks are taken in order so
+ * the block written next is always the first one compressed.
+ */
+void ParallelDeflater::run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for(;;)
+    {
+        if(m_stop)
+        {
+            return;
+        }
+        if(m_queue.empty())
+        {
+            m_condition.wait(lock);
+            continue;
+        }
+
+        block_t::pointer_t block(m_queue.front());
+        m_queue.pop_front();
+
+        lock.unlock();
+        try
+        {
+            compress(*block);
+        }
+        catch(...)
+        {
+            block->m_error = std::current_exception();
+        }
+        lock.lock();
+
+        block->m_done = true;
+        m_condition.notify_all();
+    }
+}
+
+
+/** \brief Compress one block.
+ *
+ * The block is compressed as a raw deflate stream primed with its
+ * dictionary. The last block gets finished, the others end with a
+ * sync flush so the next block can be appended to them.
+ *
+ * \exception IOException
+ * The zlib library failed compressing the block.
+ *
+ * \param[in,out] block  The block to compress.
+ */
+void ParallelDeflater::compress(block_t & block) const
+{
+    unsigned char * input(reinterpret_cast<unsigned char *>(block.m_input.data()));
+    size_t const size(block.m_input.size() - block.m_dictionary_size);
+
+    block.m_crc32 = updateCrc32(crc32(0, Z_NULL, 0), input + block.m_dictionary_size, size);
+
+    // an empty entry gets no deflate data at all, as with a single
+    // thread (see DeflateOutputStreambuf::endDeflation())
+    //
+    if(block.m_input.empty())
+    {
+        return;
+    }
+
+    z_stream zs = z_stream();
+    int err(deflateInit2(&zs, m_zlevel, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY));
+    if(err != Z_OK)
+    {
+        OutputStringStream msgs; // LCOV_EXCL_LINE
+        msgs << "ParallelDeflater::compress(): error while initializing zlib, " << zError(err); // LCOV_EXCL_LINE
+        throw IOException(msgs.str()); // LCOV_EXCL_LINE
+    }
+
+    if(block.m_dictionary_size > 0)
+    {
+        err = deflateSetDictionary(&zs, input, block.m_dictionary_size);
+    }
+
+    // the bound does not include the empty stored block of a sync flush
+    //
+    block.m_output.resize(deflateBound(&zs, size) + 8);
+    zs.next_in = input + block.m_dictionary_size;
+    zs.avail_in = size;
+    size_t used(0);
+    int const flush(block.m_last ? Z_FINISH : Z_SYNC_FLUSH);
+    while(err == Z_OK)
+    {
+        if(used == block.m_output.size())
+        {
+            block.m_output.resize(block.m_output.size() * 2); // LCOV_EXCL_LINE
+        }
+        zs.next_out = reinterpret_cast<unsigned char *>(block.m_output.data()) + used;
+        zs.avail_out = block.m_output.size() - used;
+        err = deflate(&zs, flush);
+        used = block.m_output.size() - zs.avail_out;
+
+        // a sync flush is complete once deflate() leaves some room
+        //
+        if(!block.m_last && err == Z_OK && zs.avail_out > 0)
+        {
+            break;
+        }
+    }
+    deflateEnd(&zs);
+
+    if(err != Z_OK && err != Z_STREAM_END)
+    {
+        OutputStringStream msgs; // LCOV_EXCL_LINE
+        msgs << "ParallelDeflater::compress(): deflate() failed: " << zError(err); // LCOV_EXCL_LINE
+        throw IOException(msgs.str()); // LCOV_EXCL_LINE
+    }
+    block.m_output.resize(used);
+}
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
@@ -0,0 +1,106 @@
+#pragma once
+#ifndef ZIPIOS_PARALLELDEFLATER_HPP
+#define ZIPIOS_PARALLELDEFLATER_HPP
+
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2019  Made to Order Software Corporation
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+/** \file
+ * \brief Define the zipios::ParallelDeflater class.
+ *
+ * The zipios::ParallelDeflater class compresses one stream of data
+ * with several threads, one block at a time.
+ */
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <streambuf>
+#include <thread>
+#include <vector>
+
+
+namespace zipios
+{
+
+
+class ParallelDeflater
+{
+public:
+    static size_t const     BLOCK_SIZE = 128 * 1024;
+    static size_t const     DICTIONARY_SIZE = 32 * 1024;
+
+                            ParallelDeflater(int zlevel, size_t thread_count);
+                            ParallelDeflater(ParallelDeflater const & src) = delete;
+    ParallelDeflater &      operator = (ParallelDeflater const & rhs) = delete;
+                            ~ParallelDeflater();
+
+    size_t                  write(char const * data, size_t size, std::streambuf * outbuf);
+    size_t                  finish(std::streambuf * outbuf);
+    uint32_t                getCrc32() const;
+
+private:
+    struct block_t
+    {
+        typedef std::shared_ptr<block_t>    pointer_t;
+
+        std::vector<char>       m_input;
+        size_t                  m_dictionary_size = 0;
+        bool                    m_last = false;
+        std::vector<char>       m_output;
+        uint32_t                m_crc32 = 0;
+        bool                    m_done = false;
+        std::exception_ptr      m_error;
+    };
+
+    void                    submit(bool last);
+    size_t                  output(std::streambuf * outbuf, size_t max_pending);
+    void                    run();
+    void                    compress(block_t & block) const;
+
+    int                     m_zlevel = 0;
+    size_t                  m_thread_count = 0;
+    std::vector<char>       m_input;
+    size_t                  m_dictionary_size = 0;
+    uint32_t                m_crc32 = 0;
+    std::deque<block_t::pointer_t> m_pending;
+    std::deque<block_t::pointer_t> m_queue;
+    bool                    m_stop = false;
+    std::mutex              m_mutex;
+    std::condition_variable m_condition;
+    std::vector<std::thread> m_threads;
+};
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
+#endif
@@ -0,0 +1,231 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2019  Made to Order Software Corporation
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Implementation of the zipios::PositionalFile class.
+ *
+ * This file includes the operating system specific code used to read
+ * a file at a given offset.
+ */
+
+#if !defined(ZIPIOS_WINDOWS) && (defined(_WINDOWS) || defined(WIN32) || defined(_WIN32) || defined(__WIN32))
+#define ZIPIOS_WINDOWS
+#endif
+
+#include "positionalfile.hpp"
+
+#include "zipios/zipiosexceptions.hpp"
+
+#ifdef ZIPIOS_WINDOWS
+#include <algorithm>
+
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+namespace zipios
+{
+
+
+/** \class PositionalFile
+ * \brief A file read at explicit offsets.
+ *
+ * The PositionalFile class holds one open file descriptor and reads
+ * it with pread(). Since each read specifies its own offset, the
+ * file position is never used and any number of readers can share
+ * the same object, even from different threads.
+ *
+ * The ZipFile opens one PositionalFile when opened with
+ * AccessMode::STREAM. All the input streams it returns read the
+ * archive through it instead of opening the file again.
+ *
+ * The object is generally held in a shared pointer since the ZipFile
+ * and all the input streams it returns need to keep the file open.
+ */
+
+
+/** \brief Open the named file for reading.
+ *
+ * This constructor opens the named file in read-only mode and saves
+ * its size.
+ *
+ * \exception IOException
+ * The function throws if the file cannot be opened or its size cannot
+ * be determined.
+ *
+ * \param[in] filename  The name of the file to open.
+ */
+PositionalFile::PositionalFile(std::string const & filename)
+{
+#ifdef ZIPIOS_WINDOWS
+    HANDLE const file(CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr));
+    if(file == INVALID_HANDLE_VALUE)
+    {
+        throw IOException("Error opening Zip archive file for reading in binary mode.");
+    }
+    m_file = file;
+
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(file, &size))
+    {
+        CloseHandle(file);
+        throw IOException("Error retrieving the size of file \"" + filename + "\".");
+    }
+    m_size = static_cast<offset_t>(size.QuadPart);
+#else
+    m_fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if(m_fd < 0)
+    {
+        throw IOException("Error opening Zip archive file for reading in binary mode.");
+    }
+
+    struct stat st;
+    if(fstat(m_fd, &st) != 0)
+    {
+        close(m_fd);                                                                // LCOV_EXCL_LINE
+        throw IOException("Error retrieving the size of file \"" + filename + "\"."); // LCOV_EXCL_LINE
+    }
+    m_size = static_cast<offset_t>(st.st_size);
+#endif
+}
+
+
+/** \fn PositionalFile::PositionalFile(PositionalFile const & src);
+ * \brief The copy constructor is deleted.
+ *
+ * A positional file cannot be copied. Share it using a shared
+ * pointer instead.
+ *
+ * \param[in] src  The source to copy.
+ */
+
+
+/** \fn PositionalFile & PositionalFile::operator = (PositionalFile const & rhs);
+ * \brief The assignment operator is deleted.
+ *
+ * A positional file cannot be copied. Share it using a shared
+ * pointer instead.
+ *
+ * \param[in] rhs  The source to copy.
+ *
+ * \return A reference to this object.
+ */
+
+
+/** \brief Close the file.
+ *
+ * The destructor closes the file descriptor.
+ */
+PositionalFile::~PositionalFile()
+{
+#ifdef ZIPIOS_WINDOWS
+    CloseHandle(m_file);
+#else
+    close(m_fd);
+#endif
+}
+
+
+/** \brief Read data at the specified position.
+ *
+ * This function reads up to \p size bytes from the file at offset
+ * \p position in \p buffer. It only returns less than \p size bytes
+ * when the end of the file is reached.
+ *
+ * The file position is not used nor modified so this function can
+ * be called from any number of threads at the same time.
+ *
+ * \exception IOException
+ * The function throws if the read fails.
+ *
+ * \param[in] position  The offset of the first byte to read.
+ * \param[out] buffer  The buffer where the data gets saved.
+ * \param[in] size  The number of bytes to read.
+ *
+ * \return The number of bytes read, zero at the end of the file.
+ */
+size_t PositionalFile::read(offset_t position, char * buffer, size_t size) const
+{
+    size_t total(0);
+    while(total < size)
+    {
+#ifdef ZIPIOS_WINDOWS
+        OVERLAPPED overlapped = {};
+        uint64_t const pos(position + total);
+        overlapped.Offset = static_cast<DWORD>(pos);
+        overlapped.OffsetHigh = static_cast<DWORD>(pos >> 32);
+        DWORD const request(static_cast<DWORD>(std::min(size - total, static_cast<size_t>(0x40000000))));
+        DWORD count(0);
+        if(!ReadFile(m_file, buffer + total, request, &count, &overlapped))
+        {
+            if(GetLastError() == ERROR_HANDLE_EOF)
+            {
+                break;
+            }
+            throw IOException("Error reading Zip archive file.");
+        }
+#else
+        ssize_t const count(pread(m_fd, buffer + total, size - total, position + total));
+        if(count < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;                                       // LCOV_EXCL_LINE
+            }
+            throw IOException("Error reading Zip archive file."); // LCOV_EXCL_LINE
+        }
+#endif
+        if(count == 0)
+        {
+            break;
+        }
+        total += count;
+    }
+    return total;
+}
+
+
+/** \brief Retrieve the size of the file.
+ *
+ * This function returns the size of the file when it was opened.
+ *
+ * \return The size of the file in bytes.
+ */
+offset_t PositionalFile::size() const
+{
+    return m_size;
+}
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
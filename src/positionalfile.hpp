@@ -0,0 +1,75 @@
+#pragma once
+#ifndef ZIPIOS_POSITIONALFILE_HPP
+#define ZIPIOS_POSITIONALFILE_HPP
+
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2019  Made to Order Software Corporation
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Declaration of the zipios::PositionalFile class.
+ *
+ * The zipios::PositionalFile class gives read access to a file at
+ * any offset without a shared file position.
+ */
+
+#include "zipios/zipios-config.hpp"
+
+#include <memory>
+#include <string>
+
+
+namespace zipios
+{
+
+
+class PositionalFile
+{
+public:
+    typedef std::shared_ptr<PositionalFile>     pointer_t;
+
+                                PositionalFile(std::string const & filename);
+                                PositionalFile(PositionalFile const & src) = delete;
+    PositionalFile &            operator = (PositionalFile const & rhs) = delete;
+                                ~PositionalFile();
+
+    size_t                      read(offset_t position, char * buffer, size_t size) const;
+    offset_t                    size() const;
+
+private:
+    offset_t                    m_size = 0;
+#ifdef ZIPIOS_WINDOWS
+    void *                      m_file = nullptr;
+#else
+    int                         m_fd = -1;
+#endif
+};
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
+#endif
@@ -0,0 +1,288 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2019  Made to Order Software Corporation
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Implementation of the zipios::PositionalInputStreambuf class.
+ *
+ * This file implements a streambuf reading a PositionalFile.
+ */
+
+#include "positionalinputstreambuf.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+
+namespace zipios
+{
+
+
+/** \class PositionalInputStreambuf
+ * \brief An input stream buffer reading a range of a PositionalFile.
+ *
+ * The PositionalInputStreambuf class reads the bytes from \p start
+ * to \p end of a PositionalFile. The streambuf has its own position
+ * so any number of them can read the same file at the same time.
+ *
+ * The positions are offsets in the file, not in the range. This way
+ * the streambuf can be used as is by the ZipInputStreambuf and the
+ * VirtualSeeker. Seeking outside of the range fails and reading stops
+ * at the end of the range.
+ *
+ * Large reads, such as the ones done by the InflateInputStreambuf,
+ * bypass the internal buffer and get read directly in the caller's
+ * buffer.
+ */
+
+
+/** \brief Initialize a positional input stream buffer.
+ *
+ * The streambuf starts at position \p start.
+ *
+ * The buffer comes from \p pool, when specified, and it gets returned
+ * to the pool by the destructor.
+ *
+ * \param[in] file  The file to read from.
+ * \param[in] start  The offset of the first byte of the range.
+ * \param[in] end  The offset just after the last byte of the range.
+ * \param[in] pool  The pool of buffers, may be null.
+ */
+PositionalInputStreambuf::PositionalInputStreambuf(PositionalFile::pointer_t file, offset_t start, offset_t end, InflatePool::pointer_t pool)
+    : m_file(file)
+    , m_start(start)
+    , m_end(std::max(start, end))
+    , m_position(start)
+    , m_pool(pool)
+    //, m_buffer() -- see below
+{
+    InflatePool::getBuffer(m_pool, m_buffer);
+    setg(&m_buffer[0], &m_buffer[0], &m_buffer[0]);
+}
+
+
+/** \fn PositionalInputStreambuf::PositionalInputStreambuf(PositionalInputStreambuf const & src);
+ * \brief The copy constructor is deleted.
+ *
+ * PositionalInputStreambuf objects cannot be copied.
+ *
+ * \param[in] src  The source to copy.
+ */
+
+
+/** \fn PositionalInputStreambuf & PositionalInputStreambuf::operator = (PositionalInputStreambuf const & rhs);
+ * \brief The assignment operator is deleted.
+ *
+ * PositionalInputStreambuf objects cannot be copied.
+ *
+ * \param[in] rhs  The source to copy.
+ *
+ * \return A reference to this object.
+ */
+
+
+/** \brief Clean up the positional input stream buffer.
+ *
+ * The buffer is returned to the pool. The file is shared so it only
+ * gets closed once the last user releases it.
+ */
+PositionalInputStreambuf::~PositionalInputStreambuf()
+{
+    InflatePool::releaseBuffer(m_pool, m_buffer);
+}
+
+
+/** \brief Read more data in the buffer.
+ *
+ * This function reads the next block of data from the file, without
+ * going past the end of the range.
+ *
+ * \return The next character or traits_type::eof() at the end of the range.
+ */
+PositionalInputStreambuf::int_type PositionalInputStreambuf::underflow()
+{
+    if(gptr() < egptr())
+    {
+        return traits_type::to_int_type(*gptr()); // LCOV_EXCL_LINE
+    }
+
+    size_t const size(static_cast<size_t>(std::min(static_cast<offset_t>(m_buffer.size()), m_end - m_position)));
+    size_t const count(size == 0 ? 0 : m_file->read(m_position, &m_buffer[0], size));
+    m_position += count;
+    setg(&m_buffer[0], &m_buffer[0], &m_buffer[0] + count);
+    if(count == 0)
+    {
+        return traits_type::eof();
+    }
+    return traits_type::to_int_type(*gptr());
+}
+
+
+/** \brief Read a block of data.
+ *
+ * This function first returns the data still present in the buffer.
+ * If more is needed and the request is at least as large as the
+ * buffer, the data gets read directly in \p s.
+ *
+ * \param[out] s  The buffer where the data gets saved.
+ * \param[in] n  The number of bytes to read.
+ *
+ * \return The number of bytes read.
+ */
+std::streamsize PositionalInputStreambuf::xsgetn(char_type * s, std::streamsize n)
+{
+    std::streamsize total(0);
+    while(total < n)
+    {
+        std::streamsize const available(egptr() - gptr());
+        if(available > 0)
+        {
+            std::streamsize const size(std::min(available, n - total));
+            memcpy(s + total, gptr(), size);
+            gbump(static_cast<int>(size));
+            total += size;
+            continue;
+        }
+
+        if(n - total < static_cast<std::streamsize>(m_buffer.size()))
+        {
+            if(traits_type::eq_int_type(underflow(), traits_type::eof()))
+            {
+                break;
+            }
+            continue;
+        }
+
+        size_t const size(static_cast<size_t>(std::min(static_cast<offset_t>(n - total), m_end - m_position)));
+        size_t const count(size == 0 ? 0 : m_file->read(m_position, s + total, size));
+        if(count == 0)
+        {
+            break;
+        }
+        m_position += count;
+        total += count;
+    }
+    return total;
+}
+
+
+/** \brief Change the current position.
+ *
+ * This function moves the current position relative to the start,
+ * the current position, or the end of the file. Note that the start
+ * and end are the ones of the file, not of the range.
+ *
+ * Attempting to move outside of the range fails.
+ *
+ * \param[in] off  The offset to apply.
+ * \param[in] dir  The origin of the offset.
+ * \param[in] which  Only std::ios_base::in is supported.
+ *
+ * \return The new position or pos_type(off_type(-1)) on errors.
+ */
+PositionalInputStreambuf::pos_type PositionalInputStreambuf::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which)
+{
+    if((which & std::ios_base::in) == 0)
+    {
+        return pos_type(off_type(-1));
+    }
+
+    offset_t const current(m_position - (egptr() - gptr()));
+    offset_t base(0);
+    switch(dir)
+    {
+    case std::ios_base::beg:
+        break;
+
+    case std::ios_base::cur:
+        base = current;
+        break;
+
+    case std::ios_base::end:
+        base = m_file->size();
+        break;
+
+    default:
+        return pos_type(off_type(-1)); // LCOV_EXCL_LINE
+
+    }
+
+    offset_t const pos(base + off);
+    if(pos < m_start || pos > m_end)
+    {
+        return pos_type(off_type(-1));
+    }
+
+    // keep the buffer if the new position is within it
+    //
+    offset_t const buffer_start(m_position - (egptr() - eback()));
+    if(pos >= buffer_start && pos <= m_position)
+    {
+        setg(eback(), eback() + (pos - buffer_start), egptr());
+    }
+    else
+    {
+        m_position = pos;
+        setg(&m_buffer[0], &m_buffer[0], &m_buffer[0]);
+    }
+
+    return pos_type(pos);
+}
+
+
+/** \brief Change the current position.
+ *
+ * This function moves the current position to the absolute position
+ * \p pos.
+ *
+ * \param[in] pos  The new position.
+ * \param[in] which  Only std::ios_base::in is supported.
+ *
+ * \return The new position or pos_type(off_type(-1)) on errors.
+ */
+PositionalInputStreambuf::pos_type PositionalInputStreambuf::seekpos(pos_type pos, std::ios_base::openmode which)
+{
+    return seekoff(off_type(pos), std::ios_base::beg, which);
+}
+
+
+/** \brief Return the number of bytes still available.
+ *
+ * This function returns the number of bytes left before the end of
+ * the range or -1 once the end was reached.
+ *
+ * \return The number of bytes available or -1.
+ */
+std::streamsize PositionalInputStreambuf::showmanyc()
+{
+    offset_t const size(m_end - m_position + (egptr() - gptr()));
+    return size == 0 ? -1 : static_cast<std::streamsize>(size);
+}
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
@@ -0,0 +1,78 @@
+#pragma once
+#ifndef ZIPIOS_POSITIONALINPUTSTREAMBUF_HPP
+#define ZIPIOS_POSITIONALINPUTSTREAMBUF_HPP
+
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2019  Made to Order Software Corporation
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Declaration of the zipios::PositionalInputStreambuf class.
+ *
+ * The zipios::PositionalInputStreambuf class gives an std::streambuf
+ * interface to a range of bytes of a PositionalFile.
+ */
+
+#include "inflatepool.hpp"
+#include "positionalfile.hpp"
+
+#include <iostream>
+#include <vector>
+
+
+namespace zipios
+{
+
+
+class PositionalInputStreambuf : public std::streambuf
+{
+public:
+                                PositionalInputStreambuf(PositionalFile::pointer_t file, offset_t start, offset_t end, InflatePool::pointer_t pool = InflatePool::pointer_t());
+                                PositionalInputStreambuf(PositionalInputStreambuf const & src) = delete;
+    PositionalInputStreambuf &  operator = (PositionalInputStreambuf const & rhs) = delete;
+    virtual                     ~PositionalInputStreambuf() override;
+
+protected:
+    virtual int_type            underflow() override;
+    virtual std::streamsize     xsgetn(char_type * s, std::streamsize n) override;
+    virtual pos_type            seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which = std::ios_base::in) override;
+    virtual pos_type            seekpos(pos_type pos, std::ios_base::openmode which = std::ios_base::in) override;
+    virtual std::streamsize     showmanyc() override;
+
+private:
+    PositionalFile::pointer_t   m_file;
+    offset_t                    m_start = 0;
+    offset_t                    m_end = 0;
+    offset_t                    m_position = 0;
+    InflatePool::pointer_t      m_pool;
+    std::vector<char>           m_buffer;
+};
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
+#endif
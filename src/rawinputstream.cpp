@@ -0,0 +1,104 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2019  Made to Order Software Corporation
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Implementation of zipios::RawInputStream.
+ *
+ * This file includes the implementation of the zipios::RawInputStream
+ * class which reads the compressed data of an entry.
+ */
+
+#include "rawinputstream.hpp"
+
+
+namespace zipios
+{
+
+
+/** \class RawInputStream
+ * \brief An istream reading the data of an entry as is.
+ *
+ * The ZipFile::getRawInputStream() function returns this stream. It
+ * reads the bytes saved in the archive between the local header of
+ * an entry and the next header, so the compressed data when the entry
+ * is compressed.
+ *
+ * The stream holds a reference to the file or the mapping so it
+ * remains valid after the ZipFile is closed.
+ */
+
+
+/** \brief Initialize a RawInputStream reading a file.
+ *
+ * The data is read with positional reads so the file can be shared
+ * with any number of other streams.
+ *
+ * \param[in] file  The Zip archive.
+ * \param[in] start_pos  The offset of the first byte of data.
+ * \param[in] end_pos  The offset just after the last byte of data.
+ * \param[in] pool  The pool of buffers, may be null.
+ */
+RawInputStream::RawInputStream(PositionalFile::pointer_t file, offset_t start_pos, offset_t end_pos, InflatePool::pointer_t pool)
+    : std::istream(nullptr)
+    //, m_mapped_file() -- auto-init
+    , m_buf(new PositionalInputStreambuf(file, start_pos, end_pos, pool))
+{
+    // properly initialize the stream with the buffer
+    init(m_buf.get());
+}
+
+
+/** \brief Initialize a RawInputStream reading a memory mapped file.
+ *
+ * The data is read directly from the mapping, without any copy.
+ *
+ * \param[in] mapped_file  The memory mapped Zip archive.
+ * \param[in] start_pos  The offset of the first byte of data.
+ * \param[in] end_pos  The offset just after the last byte of data.
+ */
+RawInputStream::RawInputStream(MemoryMappedFile::pointer_t mapped_file, offset_t start_pos, offset_t end_pos)
+    : std::istream(nullptr)
+    , m_mapped_file(mapped_file)
+    , m_buf(new MemoryInputStreambuf(m_mapped_file->data() + start_pos, end_pos - start_pos))
+{
+    // properly initialize the stream with the buffer
+    init(m_buf.get());
+}
+
+
+/** \brief Clean up the RawInputStream.
+ *
+ * The reference to the file or mapping gets released.
+ */
+RawInputStream::~RawInputStream()
+{
+}
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
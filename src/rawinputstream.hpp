@@ -0,0 +1,69 @@
+#pragma once
+#ifndef ZIPIOS_RAWINPUTSTREAM_HPP
+#define ZIPIOS_RAWINPUTSTREAM_HPP
+
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2019  Made to Order Software Corporation
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Define zipios::RawInputStream.
+ *
+ * This file declares the zipios::RawInputStream class used to read
+ * the data of an entry as saved in a Zip archive, without
+ * decompressing it.
+ */
+
+#include "memoryinputstreambuf.hpp"
+#include "memorymappedfile.hpp"
+#include "positionalinputstreambuf.hpp"
+
+#include <memory>
+
+
+namespace zipios
+{
+
+
+class RawInputStream : public std::istream
+{
+public:
+                    RawInputStream(PositionalFile::pointer_t file, offset_t start_pos, offset_t end_pos, InflatePool::pointer_t pool = InflatePool::pointer_t());
+                    RawInputStream(MemoryMappedFile::pointer_t mapped_file, offset_t start_pos, offset_t end_pos);
+                    RawInputStream(RawInputStream const & src) = delete;
+    RawInputStream & operator = (RawInputStream const & rhs) = delete;
+    virtual         ~RawInputStream() override;
+
+private:
+    MemoryMappedFile::pointer_t         m_mapped_file;
+    std::unique_ptr<std::streambuf>     m_buf;
+};
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
+#endif
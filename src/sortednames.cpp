@@ -0,0 +1,442 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2019  Made to Order Software Corporation
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Implementation of the zipios::SortedNames class.
+ *
+ * This file implements the sorted list of names used to search the
+ * entries of a collection by directory or pattern.
+ */
+
+#include "sortednames.hpp"
+
+#include "zipios_common.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+
+namespace zipios
+{
+
+
+/** \class SortedNames
+ * \brief The entries of a collection sorted by name.
+ *
+ * The SortedNames class holds the indexes of the entries of a
+ * collection sorted by name. This allows for listing all the entries
+ * found under a given directory, or the entries matching a pattern
+ * which starts with a literal path, in a time proportional to the
+ * number of entries found instead of the total number of entries.
+ *
+ * The class does not hold the names. Instead, each function receives
+ * a callback which returns the name of the entry at a given index. That
+ * way the ZipEntryTable can use the names found in the Central Directory
+ * without copying them.
+ */
+
+
+/** \struct SortedNames::name_t
+ * \brief A reference to the name of an entry.
+ *
+ * The name is not null terminated, the length is specified in
+ * m_length instead. The name of a directory does not include the
+ * trailing slash.
+ */
+
+
+/** \brief Private definitions of the SortedNames class.
+ *
+ * This name space includes definitions exclusively used by the
+ * SortedNames class.
+ */
+namespace
+{
+
+
+/** \brief Compare a name with a key.
+ *
+ * This function compares the bytes of \p name with the \p length bytes
+ * of \p key, as unsigned characters, like std::string does.
+ *
+ * \param[in] name  The name to compare.
+ * \param[in] key  The key to compare the name with.
+ * \param[in] length  The length of \p key.
+ *
+ * \return -1, 0, or 1 if \p name is smaller, equal, or larger than \p key.
+ */
+int compare_name(SortedNames::name_t const & name, char const * key, size_t length)
+{
+    int const r(memcmp(name.m_name, key, std::min(name.m_length, length)));
+    if(r != 0)
+    {
+        return r < 0 ? -1 : 1;
+    }
+    if(name.m_length == length)
+    {
+        return 0;
+    }
+    return name.m_length < length ? -1 : 1;
+}
+
+
+/** \brief Check whether a name starts with a prefix.
+ *
+ * \param[in] name  The name to check.
+ * \param[in] prefix  The prefix.
+ *
+ * \return true if \p name starts with \p prefix.
+ */
+bool starts_with(SortedNames::name_t const & name, std::string const & prefix)
+{
+    return name.m_length >= prefix.length()
+        && memcmp(name.m_name, prefix.c_str(), prefix.length()) == 0;
+}
+
+
+} // no name namespace
+
+
+/** \brief Sort the entries by name.
+ *
+ * This function sorts the indexes of the \p count entries using the
+ * names returned by \p get_name. Entries with the same name are kept
+ * in their original order.
+ *
+ * \param[in] count  The number of entries.
+ * \param[in] get_name  The function returning the name of an entry.
+ */
+void SortedNames::sort(size_t count, get_name_t const & get_name)
+{
+    m_order.resize(count);
+    for(size_t idx(0); idx < count; ++idx)
+    {
+        m_order[idx] = idx;
+    }
+    std::sort(m_order.begin(), m_order.end(),
+            [&get_name](size_t a, size_t b)
+            {
+                name_t const na(get_name(a));
+                name_t const nb(get_name(b));
+                int const r(compare_name(na, nb.m_name, nb.m_length));
+                return r < 0 || (r == 0 && a < b);
+            });
+}
+
+
+/** \brief Retrieve the number of sorted entries.
+ *
+ * \return The number of entries sorted by the last call to sort().
+ */
+size_t SortedNames::size() const
+{
+    return m_order.size();
+}
+
+
+/** \brief Forget about the sorted entries.
+ *
+ * This function clears the list so sort() has to be called again.
+ */
+void SortedNames::clear()
+{
+    m_order.clear();
+}
+
+
+/** \brief List the entries found in a directory.
+ *
+ * This function appends to \p result the indexes of the entries found
+ * under the \p prefix directory, in name order. The trailing slash of
+ * \p prefix is optional. An empty \p prefix represents the root of the
+ * collection.
+ *
+ * When \p recursive is false, only the entries found directly in that
+ * directory are listed. The entries found in sub-directories are
+ * skipped with a binary search so they do not count in the cost of
+ * the call. Note that a sub-directory is only listed if the collection
+ * has an entry for it.
+ *
+ * \param[in] get_name  The function returning the name of an entry.
+ * \param[in] prefix  The directory to list.
+ * \param[in] recursive  Whether to include the entries of sub-directories.
+ * \param[in,out] result  The vector where the indexes are appended.
+ */
+void SortedNames::listDirectory(get_name_t const & get_name, std::string const & prefix, bool recursive, index_vector_t & result) const
+{
+    std::string directory(prefix);
+    while(!directory.empty() && directory.back() == g_separator)
+    {
+        directory.pop_back();
+    }
+    if(!directory.empty())
+    {
+        directory += g_separator;
+    }
+
+    size_t const max_order(m_order.size());
+    size_t pos(lowerBound(get_name, 0, directory.c_str(), directory.length()));
+    while(pos < max_order)
+    {
+        name_t const name(get_name(m_order[pos]));
+        if(!starts_with(name, directory))
+        {
+            break;
+        }
+        if(!recursive)
+        {
+            char const * start(name.m_name + directory.length());
+            char const * slash(static_cast<char const *>(memchr(start, g_separator, name.m_length - directory.length())));
+            if(slash != nullptr)
+            {
+                // skip the whole sub-directory, all its entries start
+                // with "<sub-directory>/" and '/' + 1 sorts after them
+                //
+                std::string next(name.m_name, slash - name.m_name);
+                next += static_cast<char>(g_separator + 1);
+                pos = lowerBound(get_name, pos, next.c_str(), next.length());
+                continue;
+            }
+        }
+        result.push_back(m_order[pos]);
+        ++pos;
+    }
+}
+
+
+/** \brief List the entries matching a pattern.
+ *
+ * This function appends to \p result the indexes of the entries with
+ * a name matching \p pattern, in name order. See globMatch() for the
+ * supported syntax.
+ *
+ * Only the entries starting with the literal part of the pattern, i.e.
+ * the characters found before the first special character, are checked
+ * so a pattern such as "textures/level3/[a-z]*.png" is fast whatever the
+ * number of entries in the collection.
+ *
+ * \param[in] get_name  The function returning the name of an entry.
+ * \param[in] pattern  The pattern the names have to match.
+ * \param[in,out] result  The vector where the indexes are appended.
+ */
+void SortedNames::glob(get_name_t const & get_name, std::string const & pattern, index_vector_t & result) const
+{
+    std::string const prefix(pattern.substr(0, pattern.find_first_of("*?[\\")));
+
+    size_t const max_order(m_order.size());
+    for(size_t pos(lowerBound(get_name, 0, prefix.c_str(), prefix.length())); pos < max_order; ++pos)
+    {
+        name_t const name(get_name(m_order[pos]));
+        if(!starts_with(name, prefix))
+        {
+            break;
+        }
+        if(globMatch(pattern.c_str(), pattern.length(), name.m_name, name.m_length))
+        {
+            result.push_back(m_order[pos]);
+        }
+    }
+}
+
+
+/** \brief Check whether a name matches a pattern.
+ *
+ * The pattern supports the usual shell wildcards:
+ *
+ * \li "*" matches any number of characters except the separator;
+ * \li "**" matches any number of characters, including separators;
+ * \li "?" matches exactly one character except the separator;
+ * \li "[...]" matches one character from the set, which may include
+ * ranges such as "a-z", and which is negated when it starts with "!"
+ * or "^";
+ * \li "\\" matches the character that follows literally.
+ *
+ * Any other character has to match exactly.
+ *
+ * \param[in] pattern  The pattern.
+ * \param[in] pattern_length  The length of \p pattern.
+ * \param[in] name  The name to check.
+ * \param[in] name_length  The length of \p name.
+ *
+ * \return true if the whole name matches the whole pattern.
+ */
+bool SortedNames::globMatch(char const * pattern, size_t pattern_length, char const * name, size_t name_length)
+{
+    char const * p(pattern);
+    char const * const pe(pattern + pattern_length);
+    char const * n(name);
+    char const * const ne(name + name_length);
+    while(p < pe)
+    {
+        switch(*p)
+        {
+        case '*':
+            {
+                bool const any_depth(p + 1 < pe && p[1] == '*');
+                p += any_depth ? 2 : 1;
+                for(char const * s(n);; ++s)
+                {
+                    if(globMatch(p, pe - p, s, ne - s))
+                    {
+                        return true;
+                    }
+                    if(s >= ne
+                    || (!any_depth && *s == g_separator))
+                    {
+                        return false;
+                    }
+                }
+            }
+            break;
+
+        case '?':
+            if(n >= ne || *n == g_separator)
+            {
+                return false;
+            }
+            ++p;
+            ++n;
+            break;
+
+        case '[':
+            {
+                if(n >= ne || *n == g_separator)
+                {
+                    return false;
+                }
+                char const * q(p + 1);
+                bool negate(false);
+                if(q < pe && (*q == '!' || *q == '^'))
+                {
+                    negate = true;
+                    ++q;
+                }
+                unsigned char const c(*n);
+                bool found(false);
+                for(bool first(true); q < pe && (first || *q != ']'); first = false)
+                {
+                    unsigned char const lo(*q);
+                    unsigned char hi(lo);
+                    if(q + 2 < pe && q[1] == '-' && q[2] != ']')
+                    {
+                        hi = q[2];
+                        q += 3;
+                    }
+                    else
+                    {
+                        ++q;
+                    }
+                    if(c >= lo && c <= hi)
+                    {
+                        found = true;
+                    }
+                }
+                if(q >= pe)
+                {
+                    // no closing bracket, the '[' is taken literally
+                    if(c != '[')
+                    {
+                        return false;
+                    }
+                    ++p;
+                }
+                else
+                {
+                    if(found == negate)
+                    {
+                        return false;
+                    }
+                    p = q + 1;
+                }
+                ++n;
+            }
+            break;
+
+        case '\\':
+            if(p + 1 < pe)
+            {
+                ++p;
+            }
+            if(n >= ne || *n != *p)
+            {
+                return false;
+            }
+            ++p;
+            ++n;
+            break;
+
+        default:
+            if(n >= ne || *n != *p)
+            {
+                return false;
+            }
+            ++p;
+            ++n;
+            break;
+
+        }
+    }
+
+    return n == ne;
+}
+
+
+/** \brief Search the first name larger or equal to a key.
+ *
+ * This function runs a binary search for the first sorted entry, at
+ * or after position \p start, with a name larger or equal to \p key.
+ *
+ * \param[in] get_name  The function returning the name of an entry.
+ * \param[in] start  The position where the search starts.
+ * \param[in] key  The key to search.
+ * \param[in] length  The length of \p key.
+ *
+ * \return The position of that entry or size() if there is none.
+ */
+size_t SortedNames::lowerBound(get_name_t const & get_name, size_t start, char const * key, size_t length) const
+{
+    size_t lo(start);
+    size_t hi(m_order.size());
+    while(lo < hi)
+    {
+        size_t const mid(lo + (hi - lo) / 2);
+        if(compare_name(get_name(m_order[mid]), key, length) < 0)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
@@ -0,0 +1,81 @@
+#pragma once
+#ifndef ZIPIOS_SORTEDNAMES_HPP
+#define ZIPIOS_SORTEDNAMES_HPP
+
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2019  Made to Order Software Corporation
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Declaration of the zipios::SortedNames class.
+ *
+ * The zipios::SortedNames class keeps the entries of a collection
+ * sorted by name so they can be listed by directory or pattern.
+ */
+
+#include "zipios/zipios-config.hpp"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+
+namespace zipios
+{
+
+
+class SortedNames
+{
+public:
+    struct name_t
+    {
+        char const *            m_name = nullptr;
+        size_t                  m_length = 0;
+    };
+
+    typedef std::function<name_t (size_t index)>    get_name_t;
+    typedef std::vector<size_t>                     index_vector_t;
+
+    void                        sort(size_t count, get_name_t const & get_name);
+    size_t                      size() const;
+    void                        clear();
+
+    void                        listDirectory(get_name_t const & get_name, std::string const & prefix, bool recursive, index_vector_t & result) const;
+    void                        glob(get_name_t const & get_name, std::string const & pattern, index_vector_t & result) const;
+
+    static bool                 globMatch(char const * pattern, size_t pattern_length, char const * name, size_t name_length);
+
+private:
+    size_t                      lowerBound(get_name_t const & get_name, size_t start, char const * key, size_t length) const;
+
+    index_vector_t              m_order;
+};
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
+#endif
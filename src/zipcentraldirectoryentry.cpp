@@ -34,6 +34,8 @@
 
 #include "zipios_common.hpp"
 
+#include <algorithm>
+
 
 namespace zipios
 {
@@ -55,6 +57,7 @@ namespace
  * \endcode
  */
 uint32_t const  g_signature = 0x02014b50;
+size_t const    g_header_size = 46;
 
 
 // The zip codes (values are pre-shifted)
@@ -80,6 +83,28 @@ uint16_t const   g_os400         = 0x1200;
 uint16_t const   g_osx           = 0x1300;
 
 
+/** \brief Compute the size of the Zip64 extra field of an entry.
+ *
+ * The Zip64 extended information extra field of a Central Directory
+ * entry only includes the values which do not fit in their 32 bit
+ * field. This function returns the size of that block including its
+ * 4 byte header, or zero when the entry does not need Zip64.
+ *
+ * \param[in] uncompressed_size  The uncompressed size of the entry.
+ * \param[in] compressed_size  The compressed size of the entry.
+ * \param[in] offset  The offset of the local header of the entry.
+ *
+ * \return The size of the Zip64 block or zero.
+ */
+size_t zip64_extra_size(uint64_t uncompressed_size, uint64_t compressed_size, uint64_t offset)
+{
+    size_t const count((uncompressed_size >= 0xFFFFFFFF ? 1 : 0)
+                     + (compressed_size   >= 0xFFFFFFFF ? 1 : 0)
+                     + (offset            >= 0xFFFFFFFF ? 1 : 0));
+    return count == 0 ? 0 : 4 + count * sizeof(uint64_t);
+}
+
+
 /** \brief The header of a ZipCentralDirectoryEntry in a Zip archive.
  *
  * This structure shows how the header of the ZipCentralDirectoryEntry is defined.
@@ -180,17 +205,13 @@ ZipCentralDirectoryEntry::~ZipCentralDirectoryEntry()
  */
 size_t ZipCentralDirectoryEntry::getHeaderSize() const
 {
-    /** \todo
-     * Add support for 64 bit Zip. At this time this function returns
-     * an invalid size if the filename, extra field, or file comment
-     * sizes are more than allowed in an older version of the Zip format.
-     */
     // Note that the structure is 48 bytes because of an alignment
     // and attempting to use options to avoid the alignment would
     // not be portable so we use a hard coded value (yuck!)
     return 46 /* sizeof(ZipCentralDirectoryEntryHeader) */
          + m_filename.length() + (m_is_directory ? 1 : 0)
          + m_extra_field.size()
+         + zip64_extra_size(m_uncompressed_size, m_compressed_size, static_cast<offset_t>(m_entry_offset))
          + m_comment.length();
 }
 
@@ -214,6 +235,11 @@ FileEntry::pointer_t ZipCentralDirectoryEntry::clone() const
  * input stream. If anything goes wrong with the input stream, the read
  * function will throw an error.
  *
+ * The function reads the fixed size part of the header first, then
+ * the variable size part (filename, extra field, and comment) and
+ * finally decodes the whole thing with read(buffer_t const &, size_t &).
+ * This is two I/O calls instead of one per field.
+ *
  * \note
  * While reading the entry is marked as invalid. If the read fails, the
  * entry will remain invalid. On success, the function restores the status
@@ -236,15 +262,72 @@ void ZipCentralDirectoryEntry::read(std::istream& is)
 {
     m_valid = false; // set back to true upon successful completion below.
 
+    // read the fixed size part of the header
+    buffer_t header;
+    zipRead(is, header, g_header_size);
+
     // verify the signature
     uint32_t signature;
-    zipRead(is, signature);
+    size_t pos(0);
+    zipRead(header, pos, signature);
     if(g_signature != signature)
     {
         is.setstate(std::ios::failbit);
         throw IOException("ZipCentralDirectoryEntry::read(): Expected Central Directory entry signature not found");
     }
 
+    // read the filename, extra field, and comment
+    uint16_t filename_len(0);
+    uint16_t extra_field_len(0);
+    uint16_t file_comment_len(0);
+    pos = 28;
+    zipRead(header, pos, filename_len);             // 16
+    zipRead(header, pos, extra_field_len);          // 16
+    zipRead(header, pos, file_comment_len);         // 16
+
+    buffer_t variable;
+    zipRead(is, variable, filename_len + extra_field_len + file_comment_len);
+    header += variable;
+
+    pos = 0;
+    read(header, pos);
+}
+
+
+/** \brief Read a Central Directory entry from a buffer.
+ *
+ * This function decodes one Central Directory entry found in buffer
+ * \p buf at position \p pos. On return, \p pos points right after
+ * the entry, which is where the next entry starts.
+ *
+ * This is used by the ZipFile to parse the whole Central Directory
+ * after reading it in memory with a single read.
+ *
+ * \note
+ * While reading the entry is marked as invalid. If the read fails, the
+ * entry will remain invalid. On success, the function restores the status
+ * back to valid.
+ *
+ * \exception IOException
+ * This exception is thrown if the signature read does not match the
+ * signature of a Central Directory entry or the entry goes beyond the
+ * end of the buffer.
+ *
+ * \param[in] buf  The buffer with the Central Directory.
+ * \param[in,out] pos  The position of the entry in \p buf.
+ */
+void ZipCentralDirectoryEntry::read(buffer_t const & buf, size_t & pos)
+{
+    m_valid = false; // set back to true upon successful completion below.
+
+    // verify the signature
+    uint32_t signature;
+    zipRead(buf, pos, signature);
+    if(g_signature != signature)
+    {
+        throw IOException("ZipCentralDirectoryEntry::read(): Expected Central Directory entry signature not found");
+    }
+
     uint16_t writer_version(0);
     uint16_t compress_method(0);
     uint32_t dosdatetime(0);
@@ -260,27 +343,31 @@ void ZipCentralDirectoryEntry::read(std::istream& is)
     std::string filename;
 
     // read the header
-    zipRead(is, writer_version);                    // 16
-    zipRead(is, m_extract_version);                 // 16
-    zipRead(is, m_general_purpose_bitfield);        // 16
-    zipRead(is, compress_method);                   // 16
-    zipRead(is, dosdatetime);                       // 32
-    zipRead(is, m_crc_32);                          // 32
-    zipRead(is, compressed_size);                   // 32
-    zipRead(is, uncompressed_size);                 // 32
-    zipRead(is, filename_len);                      // 16
-    zipRead(is, extra_field_len);                   // 16
-    zipRead(is, file_comment_len);                  // 16
-    zipRead(is, disk_num_start);                    // 16
-    zipRead(is, intern_file_attr);                  // 16
-    zipRead(is, extern_file_attr);                  // 32
-    zipRead(is, rel_offset_loc_head);               // 32
-    zipRead(is, filename, filename_len);            // string
-    zipRead(is, m_extra_field, extra_field_len);    // buffer
-    zipRead(is, m_comment, file_comment_len);       // string
-    /** \todo check whether this was a 64 bit header and make sure
-     *        to read the 64 bit header too if so
-     */
+    zipRead(buf, pos, writer_version);                  // 16
+    zipRead(buf, pos, m_extract_version);               // 16
+    zipRead(buf, pos, m_general_purpose_bitfield);      // 16
+    zipRead(buf, pos, compress_method);                 // 16
+    zipRead(buf, pos, dosdatetime);                     // 32
+    zipRead(buf, pos, m_crc_32);                        // 32
+    zipRead(buf, pos, compressed_size);                 // 32
+    zipRead(buf, pos, uncompressed_size);               // 32
+    zipRead(buf, pos, filename_len);                    // 16
+    zipRead(buf, pos, extra_field_len);                 // 16
+    zipRead(buf, pos, file_comment_len);                // 16
+    zipRead(buf, pos, disk_num_start);                  // 16
+    zipRead(buf, pos, intern_file_attr);                // 16
+    zipRead(buf, pos, extern_file_attr);                // 32
+    zipRead(buf, pos, rel_offset_loc_head);             // 32
+    zipRead(buf, pos, filename, filename_len);          // string
+    zipRead(buf, pos, m_extra_field, extra_field_len);  // buffer
+    zipRead(buf, pos, m_comment, file_comment_len);     // string
+
+    // sizes and offset of 0xFFFFFFFF are found in the Zip64 extra field
+    uint64_t compressed_size64(compressed_size);
+    uint64_t uncompressed_size64(uncompressed_size);
+    uint64_t rel_offset_loc_head64(rel_offset_loc_head);
+    zipReadZip64Extra(m_extra_field, 0, m_extra_field.size(), uncompressed_size64, compressed_size64, rel_offset_loc_head64);
+    zipRemoveZip64Extra(m_extra_field);
 
     // the FilePath() will remove the trailing slash so make sure
     // to defined the m_is_directory ahead of time!
@@ -290,9 +377,9 @@ void ZipCentralDirectoryEntry::read(std::istream& is)
     DOSDateTime t;
     t.setDOSDateTime(dosdatetime);
     m_unix_time = t.getUnixTimestamp();
-    m_compressed_size = compressed_size;
-    m_uncompressed_size = uncompressed_size;
-    m_entry_offset = rel_offset_loc_head;
+    m_compressed_size = compressed_size64;
+    m_uncompressed_size = uncompressed_size64;
+    m_entry_offset = rel_offset_loc_head64;
     m_filename = FilePath(filename);
 
     // the zipRead() should throw if it is false...
@@ -314,11 +401,13 @@ void ZipCentralDirectoryEntry::read(std::istream& is)
  * knows about the trailing slash as a way to detect a file as a
  * directory.
  *
+ * When the sizes or the offset of the entry do not fit in 32 bits,
+ * the function saves them in a Zip64 extended information extra field.
+ *
  * \exception InvalidStateException
- * The function verifies whether the filename, extra field,
- * file comment, file data, or data offset are not too large.
- * If any one of these parameters is too large, then this
- * exception is raised.
+ * The function verifies whether the filename, extra field, or
+ * file comment are not too large. If any one of these parameters
+ * is too large, then this exception is raised.
  *
  * \param[in] os  The output stream where the data is written.
  *
@@ -327,27 +416,15 @@ void ZipCentralDirectoryEntry::read(std::istream& is)
  */
 void ZipCentralDirectoryEntry::write(std::ostream& os)
 {
-    /** \todo add support for 64 bit entries
-     *        (zip64 is available, just need to add a 64 bit header...)
-     */
+    offset_t const entry_offset(m_entry_offset);
+    size_t const zip64_size(zip64_extra_size(m_uncompressed_size, m_compressed_size, entry_offset));
     if(m_filename.length()  > 0x10000
-    || m_extra_field.size() > 0x10000
+    || m_extra_field.size() + zip64_size > 0x10000
     || m_comment.length()   > 0x10000)
     {
         throw InvalidStateException("ZipCentralDirectoryEntry::write(): file name, comment, or extra field too large to save in a Zip file.");
     }
 
-// Solaris defines _ILP32 for 32 bit platforms
-#if !defined(_ILP32)
-    if(m_compressed_size   >= 0x100000000ULL
-    || m_uncompressed_size >= 0x100000000ULL
-    || m_entry_offset      >= 0x100000000LL)
-    {
-        // This represents really large files which we do not test at this point
-        throw InvalidStateException("ZipCentralDirectoryEntry::write(): The size of this file is too large to fit in a zip archive."); // LCOV_EXCL_LINE
-    }
-#endif
-
     // define version
     uint16_t writer_version = g_zip_format_version;
     // including the "compatibility" code
@@ -381,10 +458,15 @@ void ZipCentralDirectoryEntry::write(std::ostream& os)
     DOSDateTime t;
     t.setUnixTimestamp(m_unix_time);
     uint32_t dosdatetime(t.getDOSDateTime());   // type could be set to DOSDateTime::dosdatetime_t
-    uint32_t compressed_size(m_compressed_size);
-    uint32_t uncompressed_size(m_uncompressed_size);
+    uint16_t extract_version(m_extract_version);
+    if(zip64_size != 0 && extract_version < g_zip64_format_version)
+    {
+        extract_version = g_zip64_format_version;
+    }
+    uint32_t compressed_size(std::min(m_compressed_size, static_cast<size_t>(0xFFFFFFFF)));
+    uint32_t uncompressed_size(std::min(m_uncompressed_size, static_cast<size_t>(0xFFFFFFFF)));
     uint16_t filename_len(filename.length());
-    uint16_t extra_field_len(m_extra_field.size());
+    uint16_t extra_field_len(m_extra_field.size() + zip64_size);
     uint16_t file_comment_len(m_comment.length());
     uint16_t disk_num_start(0);
     uint16_t intern_file_attr(0);
@@ -408,11 +490,11 @@ void ZipCentralDirectoryEntry::write(std::ostream& os)
      * from the file entry.
      */
     uint32_t extern_file_attr(m_is_directory ? 0x41FD0010 : 0x81B40000);
-    uint32_t rel_offset_loc_head(m_entry_offset);
+    uint32_t rel_offset_loc_head(std::min(entry_offset, static_cast<offset_t>(0xFFFFFFFF)));
 
     zipWrite(os, g_signature);                  // 32
     zipWrite(os, writer_version);               // 16
-    zipWrite(os, m_extract_version);            // 16
+    zipWrite(os, extract_version);              // 16
     zipWrite(os, m_general_purpose_bitfield);   // 16
     zipWrite(os, compress_method);              // 16
     zipWrite(os, dosdatetime);                  // 32
@@ -427,6 +509,25 @@ void ZipCentralDirectoryEntry::write(std::ostream& os)
     zipWrite(os, extern_file_attr);             // 32
     zipWrite(os, rel_offset_loc_head);          // 32
     zipWrite(os, filename);                     // string
+    if(zip64_size != 0)
+    {
+        // only the saturated values are saved, in this order
+        uint16_t const block_size(zip64_size - 4);
+        zipWrite(os, g_zip64_extra_id);         // 16
+        zipWrite(os, block_size);               // 16
+        if(m_uncompressed_size >= 0xFFFFFFFF)
+        {
+            zipWrite(os, static_cast<uint64_t>(m_uncompressed_size)); // 64
+        }
+        if(m_compressed_size >= 0xFFFFFFFF)
+        {
+            zipWrite(os, static_cast<uint64_t>(m_compressed_size)); // 64
+        }
+        if(entry_offset >= 0xFFFFFFFF)
+        {
+            zipWrite(os, static_cast<uint64_t>(entry_offset)); // 64
+        }
+    }
     zipWrite(os, m_extra_field);                // buffer
     zipWrite(os, m_comment);                    // string
 }
@@ -35,6 +35,8 @@
 
 #include "ziplocalentry.hpp"
 
+#include "zipios_common.hpp"
+
 
 namespace zipios
 {
@@ -51,6 +53,7 @@ public:
     virtual size_t              getHeaderSize() const override;
 
     virtual void                read(std::istream& is) override;
+    void                        read(buffer_t const & buf, size_t & pos);
     virtual void                write(std::ostream& os) override;
 };
 
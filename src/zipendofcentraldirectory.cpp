@@ -29,8 +29,13 @@
 
 #include "zipendofcentraldirectory.hpp"
 
+#include "ziplocalentry.hpp"
+
 #include "zipios/zipiosexceptions.hpp"
 
+#include <algorithm>
+#include <cstring>
+
 
 namespace zipios
 {
@@ -68,6 +73,88 @@ namespace
 uint32_t const g_signature = 0x06054b50;
 
 
+/** \brief Signature of the Zip64 End of Central Directory locator.
+ *
+ * The four byte signature represents the following value:
+ *
+ * "PK 6.7" -- Zip64 End of Central Directory locator
+ */
+uint32_t const g_zip64_locator_signature = 0x07064b50;
+
+
+/** \brief Signature of the Zip64 End of Central Directory record.
+ *
+ * The four byte signature represents the following value:
+ *
+ * "PK 6.6" -- Zip64 End of Central Directory record
+ */
+uint32_t const g_zip64_signature = 0x06064b50;
+
+
+/** \brief Size of the Zip64 End of Central Directory locator.
+ *
+ * The locator is found immediately before the ZipEndOfCentralDirectory.
+ */
+size_t const g_zip64_locator_size = 20;
+
+
+/** \brief Size of the Zip64 End of Central Directory record.
+ *
+ * The size of the fixed part of the record, without the extensible
+ * data sector, which zipios ignores.
+ */
+size_t const g_zip64_header_size = 56;
+
+
+/** \brief Size of the ZipEndOfCentralDirectory without the comment.
+ *
+ * The fixed part of the ZipEndOfCentralDirectory is 22 bytes: the
+ * signature, 4 x 16 bit disk and entry counters, the 32 bit size
+ * and offset of the Central Directory, and the 16 bit comment length.
+ */
+size_t const g_header_size = 22;
+
+
+/** \brief The largest possible Zip archive comment.
+ *
+ * The length of the comment is saved in a 16 bit field so the
+ * ZipEndOfCentralDirectory cannot start further than this many
+ * bytes plus g_header_size from the end of the archive.
+ */
+size_t const g_max_comment_size = 65535;
+
+
+/** \brief Search a buffer backward for the 'P' of a signature.
+ *
+ * This function returns the position of the last 'P' found in
+ * the first \p size bytes of \p buf, or nullptr if there are none.
+ *
+ * With the GNU C library we use memrchr() which is vectorized. On
+ * other systems we fall back to a simple loop.
+ *
+ * \param[in] buf  The buffer to search.
+ * \param[in] size  The number of bytes to search.
+ *
+ * \return A pointer to the last 'P' or nullptr.
+ */
+char const * find_last_p(char const * buf, size_t size)
+{
+#ifdef __GLIBC__
+    return static_cast<char const *>(memrchr(buf, 'P', size));
+#else
+    while(size > 0)
+    {
+        --size;
+        if(buf[size] == 'P')
+        {
+            return buf + size;
+        }
+    }
+    return nullptr;
+#endif
+}
+
+
 } // no name namespace
 
 
@@ -206,9 +293,8 @@ void ZipEndOfCentralDirectory::setOffset(offset_t start_offset)
 /** \brief Attempt to read an ZipEndOfCentralDirectory structure.
  *
  * This function tries to read an ZipEndOfCentralDirectory structure from the
- * specified buffer. This function expects a BackBuffer, which is used
- * because that is generally the fastest way to read the data (instead of
- * scanning the entire file).
+ * specified buffer. The buffer is generally the tail of the archive as
+ * read by find().
  *
  * \note
  * If a read from the buffer fails, then an exception is raised. Since
@@ -282,6 +368,165 @@ bool ZipEndOfCentralDirectory::read(::zipios::buffer_t const& buf, size_t pos)
 }
 
 
+/** \brief Find and read the ZipEndOfCentralDirectory of an archive.
+ *
+ * This function searches the end of the input stream for the
+ * ZipEndOfCentralDirectory structure and reads it.
+ *
+ * Since the comment cannot be larger than 64Kb, the structure has to
+ * start within the last 65,557 bytes of the archive. The function reads
+ * that tail (or the whole archive if smaller) with a single read and
+ * then searches it backward for the signature. A file which is not a
+ * Zip archive is therefore rejected after reading at most that many
+ * bytes instead of being read entirely.
+ *
+ * As with read(), the first signature found from the end is used.
+ *
+ * If the archive is a Zip64 archive, the Zip64 End of Central Directory
+ * record is read as well and its 64 bit values are used.
+ *
+ * \exception IOException
+ * This exception is raised if the virtual file endings are invalid
+ * (i.e. the start offset is after the end offset) or if the comment
+ * of the structure found is truncated.
+ *
+ * \exception FileCollectionException
+ * This exception is raised if no ZipEndOfCentralDirectory is found.
+ *
+ * \param[in] is  The input stream of the Zip archive.
+ * \param[in] vs  The virtual seeker defining the Zip archive boundaries.
+ *
+ * \return The virtual position of the ZipEndOfCentralDirectory.
+ */
+offset_t ZipEndOfCentralDirectory::find(std::istream& is, VirtualSeeker const& vs)
+{
+    vs.vseekg(is, 0, std::ios::end);
+    offset_t const archive_size(vs.vtellg(is));
+    if(archive_size < 0)
+    {
+        throw IOException("Invalid virtual file endings.");
+    }
+
+    size_t const tail_size(std::min(static_cast<size_t>(archive_size), g_max_comment_size + g_header_size));
+    offset_t const tail_pos(archive_size - static_cast<offset_t>(tail_size));
+    buffer_t tail;
+    vs.vseekg(is, tail_pos, std::ios::beg);
+    zipRead(is, tail, tail_size);
+
+    // the signature cannot start in the last 21 bytes
+    //
+    size_t search_size(tail_size < g_header_size ? 0 : tail_size - g_header_size + 1);
+    while(search_size > 0)
+    {
+        char const * const start(reinterpret_cast<char const *>(&tail[0]));
+        char const * const p(find_last_p(start, search_size));
+        if(p == nullptr)
+        {
+            break;
+        }
+        size_t const pos(p - start);
+        if(read(tail, pos))
+        {
+            offset_t const eocd_pos(tail_pos + pos);
+            readZip64(is, vs, eocd_pos);
+            return eocd_pos;
+        }
+        search_size = pos;
+    }
+
+    throw FileCollectionException("Unable to find zip structure: End-of-central-directory");
+}
+
+
+/** \brief Read the Zip64 End of Central Directory, if present.
+ *
+ * A Zip64 archive, i.e. an archive with more than 65535 entries or
+ * with a Central Directory which lies further than 4Gb or is larger
+ * than 4Gb, has a Zip64 End of Central Directory record. That record
+ * is found using the locator saved just before the
+ * ZipEndOfCentralDirectory.
+ *
+ * If the locator is present, the number of entries, size and offset of
+ * the Central Directory read from the ZipEndOfCentralDirectory get
+ * replaced with the 64 bit values found in the record. Otherwise
+ * nothing changes.
+ *
+ * \exception FileCollectionException
+ * This exception is raised if the locator does not point to a Zip64
+ * End of Central Directory record or if the record counts differ
+ * (which means the archive spans multiple disks.)
+ *
+ * \param[in] is  The input stream of the Zip archive.
+ * \param[in] vs  The virtual seeker defining the Zip archive boundaries.
+ * \param[in] eocd_pos  The virtual position of the ZipEndOfCentralDirectory.
+ */
+void ZipEndOfCentralDirectory::readZip64(std::istream& is, VirtualSeeker const& vs, offset_t eocd_pos)
+{
+    if(eocd_pos < static_cast<offset_t>(g_zip64_locator_size))
+    {
+        return;
+    }
+
+    buffer_t locator;
+    vs.vseekg(is, eocd_pos - g_zip64_locator_size, std::ios::beg);
+    zipRead(is, locator, g_zip64_locator_size);
+
+    size_t pos(0);
+    uint32_t signature;
+    zipRead(locator, pos, signature);                       // 32
+    if(signature != g_zip64_locator_signature)
+    {
+        return;
+    }
+
+    uint32_t disk_number;
+    uint64_t zip64_offset;
+    zipRead(locator, pos, disk_number);                     // 32
+    zipRead(locator, pos, zip64_offset);                    // 64
+    if(zip64_offset > static_cast<uint64_t>(eocd_pos - g_zip64_locator_size))
+    {
+        throw FileCollectionException("Zip64 End of Central Directory locator points outside of the Zip archive");
+    }
+
+    buffer_t record;
+    vs.vseekg(is, zip64_offset, std::ios::beg);
+    zipRead(is, record, g_zip64_header_size);
+
+    pos = 0;
+    zipRead(record, pos, signature);                        // 32
+    if(signature != g_zip64_signature)
+    {
+        throw FileCollectionException("Zip64 End of Central Directory record not found where the locator says it is");
+    }
+
+    uint64_t record_size;
+    uint16_t version;
+    uint32_t central_directory_disk_number;
+    uint64_t central_directory_entries;
+    uint64_t central_directory_total_entries;
+    uint64_t central_directory_size;
+    uint64_t central_directory_offset;
+    zipRead(record, pos, record_size);                      // 64
+    zipRead(record, pos, version);                          // 16
+    zipRead(record, pos, version);                          // 16
+    zipRead(record, pos, disk_number);                      // 32
+    zipRead(record, pos, central_directory_disk_number);    // 32
+    zipRead(record, pos, central_directory_entries);        // 64
+    zipRead(record, pos, central_directory_total_entries);  // 64
+    zipRead(record, pos, central_directory_size);           // 64
+    zipRead(record, pos, central_directory_offset);         // 64
+
+    if(central_directory_entries != central_directory_total_entries)
+    {
+        throw FileCollectionException("Zip64 End of Central Directory with a number of entries and total entries that differ is not supported, spanned zip files are not supported");
+    }
+
+    m_central_directory_entries = central_directory_entries;
+    m_central_directory_size    = central_directory_size;
+    m_central_directory_offset  = central_directory_offset;
+}
+
+
 /** \brief Write the ZipEndOfCentralDirectory structure to a stream.
  *
  * This function writes the currently defined end of central
@@ -296,41 +541,65 @@ bool ZipEndOfCentralDirectory::read(::zipios::buffer_t const& buf, size_t pos)
  * The function does not change the output pointer of the stream
  * before writing to it.
  *
- * \exception FileCollectionException
- * This function throws this exception if the data cannot be saved. In
- * general this means there are too many entries, the size is too large
- * or the comment is more than 64Kb (some of which will be resolved with
- * Zip64 support.)
+ * When the number of entries, the size, or the offset of the Central
+ * Directory do not fit in the ZipEndOfCentralDirectory, the function
+ * first writes a Zip64 End of Central Directory record and its locator
+ * and then the ZipEndOfCentralDirectory with those fields set to
+ * 0xFFFF or 0xFFFFFFFF. The record is saved at the current output
+ * position, so the function must be called right after the Central
+ * Directory was written.
+ *
+ * \exception InvalidStateException
+ * This function throws this exception if the comment is more than
+ * 64Kb.
  *
  * \param[in] os  The output stream where the data is to be saved.
  */
 void ZipEndOfCentralDirectory::write(std::ostream& os)
 {
-    /** \todo
-     * Add support for 64 bit Zip archive. This would allow for pretty
-     * much all the following conditions to be dropped out.
-     */
     if(m_zip_comment.length() > 65535)
     {
         throw InvalidStateException("the Zip archive comment is too large");
     }
-    if(m_central_directory_entries > 65535)
-    {
-        throw InvalidStateException("the number of entries in the Zip archive is too large");
-    }
-// Solaris defines _ILP32 for 32 bit platforms
-#if !defined(_ILP32)
-    if(m_central_directory_size   >= 0x100000000UL
-    || m_central_directory_offset >= 0x100000000L)
+
+    bool const zip64(m_central_directory_entries >= 0xFFFF
+                  || m_central_directory_size    >= 0xFFFFFFFF
+                  || m_central_directory_offset  >= 0xFFFFFFFF);
+    if(zip64)
     {
-        throw FileCollectionException("the Zip archive size or offset are too large"); // LCOV_EXCL_LINE
+        // the record follows the Central Directory, computing its
+        // offset avoids tellp() which fails on outputs such as pipes
+        //
+        uint64_t const zip64_offset(m_central_directory_offset + m_central_directory_size);
+        uint64_t const record_size(g_zip64_header_size - 12);
+        uint16_t const version(ZipLocalEntry::g_zip64_format_version);
+        uint32_t const disk_number32(0);
+        uint32_t const disk_count(1);
+        uint64_t const central_directory_entries64(m_central_directory_entries);
+        uint64_t const central_directory_size64(m_central_directory_size);
+        uint64_t const central_directory_offset64(m_central_directory_offset);
+
+        zipWrite(os, g_zip64_signature);            // 32
+        zipWrite(os, record_size);                  // 64
+        zipWrite(os, version);                      // 16
+        zipWrite(os, version);                      // 16
+        zipWrite(os, disk_number32);                // 32
+        zipWrite(os, disk_number32);                // 32
+        zipWrite(os, central_directory_entries64);  // 64
+        zipWrite(os, central_directory_entries64);  // 64
+        zipWrite(os, central_directory_size64);     // 64
+        zipWrite(os, central_directory_offset64);   // 64
+
+        zipWrite(os, g_zip64_locator_signature);    // 32
+        zipWrite(os, disk_number32);                // 32
+        zipWrite(os, zip64_offset);                 // 64
+        zipWrite(os, disk_count);                   // 32
     }
-#endif
 
     uint16_t const disk_number(0);
-    uint16_t const central_directory_entries(m_central_directory_entries);
-    uint32_t const central_directory_size(m_central_directory_size);
-    uint32_t const central_directory_offset(m_central_directory_offset);
+    uint16_t const central_directory_entries(std::min(m_central_directory_entries, static_cast<size_t>(0xFFFF)));
+    uint32_t const central_directory_size(std::min(m_central_directory_size, static_cast<size_t>(0xFFFFFFFF)));
+    uint32_t const central_directory_offset(std::min(m_central_directory_offset, static_cast<offset_t>(0xFFFFFFFF)));
     uint16_t const comment_len(m_zip_comment.length());
 
     // the total number of entries, across all disks is the same in our
@@ -35,6 +35,8 @@
 
 #include "zipios_common.hpp"
 
+#include "zipios/virtualseeker.hpp"
+
 #include <string>
 
 
@@ -55,9 +57,12 @@ public:
     void                setOffset(offset_t new_offset);
 
     bool                read(::zipios::buffer_t const& buf, size_t pos);
+    offset_t            find(std::istream& is, VirtualSeeker const& vs);
     void                write(std::ostream& os);
 
 private:
+    void                readZip64(std::istream& is, VirtualSeeker const& vs, offset_t eocd_pos);
+
     // some of the fields found in a Zip archive ZipEndOfCentralDirectory
     size_t              m_central_directory_entries = 0;
     size_t              m_central_directory_size = 0;
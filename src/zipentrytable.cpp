@@ -0,0 +1,920 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2019  Made to Order Software Corporation
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Implementation of the zipios::ZipEntryTable class.
+ *
+ * This file parses the Central Directory of a Zip archive in a
+ * compact table of records and the hash tables used to search it.
+ */
+
+#include "zipentrytable.hpp"
+
+#include "crc32.hpp"
+#include "memorymappedfile.hpp"
+#include "zipcentraldirectoryentry.hpp"
+
+#include "zipios/zipiosexceptions.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include <zlib.h>
+
+
+namespace zipios
+{
+
+
+/** \class ZipEntryTable
+ * \brief The compact list of entries of a Zip archive.
+ *
+ * Opening a Zip archive used to create one ZipCentralDirectoryEntry
+ * per entry. Each one of these objects is allocated on the heap and
+ * includes a FilePath (with an os_stat_t structure), a comment, and
+ * an extra field buffer. For archives with millions of entries, that
+ * represents a lot of memory.
+ *
+ * The ZipEntryTable instead keeps the raw Central Directory, which
+ * acts as the pool of names, extra fields, and comments, along with
+ * one small fixed size record per entry and two hash tables used to
+ * search the entries by full name or by basename. The FileEntry
+ * objects are only created on demand by getEntry().
+ *
+ * The table is read-only once created so it can be shared between
+ * all the copies of a ZipFile and used by any number of threads at
+ * the same time.
+ *
+ * The table can also be saved in an index file with saveIndex() and
+ * later be loaded back with loadIndex(). The index file is mapped in
+ * memory and used as is so loading it does not require any parsing.
+ */
+
+
+/** \struct ZipEntryTable::record_t
+ * \brief The fixed size record of one entry.
+ *
+ * This structure holds the fields of a Central Directory entry which
+ * are necessary to search for and read the entry without having to
+ * create a FileEntry object.
+ *
+ * The name is not included in the record. It is found in the Central
+ * Directory buffer at m_header_offset plus the size of the fixed part
+ * of a Central Directory entry. The m_name_length does not include
+ * the trailing slash of a directory name.
+ *
+ * The records are saved as is in the index files so this structure
+ * cannot change without also changing the version of the index.
+ */
+
+
+/** \struct ZipEntryTable::index_key_t
+ * \brief The parameters an index file is attached to.
+ *
+ * An index file is only valid for one specific archive. This structure
+ * holds the information about the archive saved in the index file. If
+ * any one of these parameters changes, the index is ignored.
+ *
+ * The parameters include the size and modification time of the archive
+ * file, the offsets used to access an embedded archive, and the
+ * position, size, and number of entries of the Central Directory as
+ * found in the End of Central Directory.
+ */
+
+
+/** \brief Private definitions of the ZipEntryTable class.
+ *
+ * This name space includes definitions exclusively used by the
+ * ZipEntryTable class.
+ */
+namespace
+{
+
+
+/** \brief The signature of a Central Directory entry.
+ *
+ * The four byte signature represents the following value:
+ *
+ * "PK 1.2" -- Central Directory entry
+ */
+uint32_t const g_signature = 0x02014b50;
+
+
+/** \brief Size of the fixed part of a Central Directory entry.
+ *
+ * A Central Directory entry is composed of this many bytes followed by
+ * the filename, the extra field, and the comment.
+ */
+size_t const g_header_size = 46;
+
+
+/** \brief The magic of an index file.
+ *
+ * Index files start with these 8 characters.
+ */
+char const g_index_magic[8] = { 'Z', 'I', 'P', 'I', 'O', 'S', 'I', 'X' };
+
+
+/** \brief The version of the index file format.
+ *
+ * Whenever the format of the index file changes, including the
+ * ZipEntryTable::record_t structure or the hash function, this
+ * version has to be incremented so older files get ignored.
+ */
+uint32_t const g_index_version = 3;
+
+
+/** \brief A value used to verify the byte order of the index file.
+ *
+ * The index file is saved using the native byte order and alignment
+ * of the computer. It is only meant to be used as a cache on the
+ * computer which created it. This value is used to detect an index
+ * created on a computer with a different byte order.
+ */
+uint32_t const g_index_byte_order = 0x01020304;
+
+
+/** \brief The header of an index file.
+ *
+ * An index file starts with this header. It is followed by the
+ * Central Directory, padded to a multiple of 8 bytes, the records,
+ * and the two hash tables. The m_header_checksum field is the CRC-32
+ * of the header computed with that field set to zero.
+ */
+struct index_header_t
+{
+    char                        m_magic[8];
+    uint32_t                    m_version;
+    uint32_t                    m_byte_order;
+    uint32_t                    m_record_size;
+    uint32_t                    m_checksum;
+    ZipEntryTable::index_key_t  m_key;
+    uint64_t                    m_central_directory_size;
+    uint64_t                    m_hash_size;
+    uint32_t                    m_header_checksum;
+    uint32_t                    m_padding;
+};
+
+
+/** \brief Align a size to 8 bytes.
+ *
+ * The parts of an index file are aligned to 8 bytes so the records
+ * and hash tables can be used directly from the memory mapped file.
+ *
+ * \param[in] size  The size to align.
+ *
+ * \return \p size rounded up to the next multiple of 8.
+ */
+size_t align_size(size_t size)
+{
+    return (size + 7) & ~static_cast<size_t>(7);
+}
+
+
+/** \brief Compute the checksum of an index header.
+ *
+ * The checksum is the CRC-32 of the header with its m_header_checksum
+ * field set to zero.
+ *
+ * \param[in] header  The header to compute the checksum of.
+ *
+ * \return The CRC-32 of the header.
+ */
+uint32_t header_checksum(index_header_t const & header)
+{
+    index_header_t copy(header);
+    copy.m_header_checksum = 0;
+    return updateCrc32(crc32(0L, Z_NULL, 0), &copy, sizeof(copy));
+}
+
+
+/** \brief Compare two index keys.
+ *
+ * \param[in] lhs  The left hand side key.
+ * \param[in] rhs  The right hand side key.
+ *
+ * \return true if all the fields of both keys are equal.
+ */
+bool same_key(ZipEntryTable::index_key_t const & lhs, ZipEntryTable::index_key_t const & rhs)
+{
+    return lhs.m_archive_size               == rhs.m_archive_size
+        && lhs.m_modification_time          == rhs.m_modification_time
+        && lhs.m_start_offset               == rhs.m_start_offset
+        && lhs.m_end_offset                 == rhs.m_end_offset
+        && lhs.m_central_directory_offset   == rhs.m_central_directory_offset
+        && lhs.m_central_directory_size     == rhs.m_central_directory_size
+        && lhs.m_count                      == rhs.m_count;
+}
+
+
+/** \brief Compute the hash of a key.
+ *
+ * This function computes the 32 bit FNV-1a hash of the \p length
+ * bytes at \p key.
+ *
+ * \param[in] key  The key to hash.
+ * \param[in] length  The number of bytes in \p key.
+ *
+ * \return The hash of the key.
+ */
+uint32_t hash_key(char const * key, size_t length)
+{
+    uint32_t hash(2166136261U);
+    for(size_t idx(0); idx < length; ++idx)
+    {
+        hash ^= static_cast<unsigned char>(key[idx]);
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+
+/** \brief Reduce a name to its basename.
+ *
+ * This function moves \p key and reduces \p length so they only
+ * represent the part of the name after the last separator.
+ *
+ * \param[in,out] key  The name to reduce.
+ * \param[in,out] length  The length of the name.
+ */
+void basename(char const * & key, size_t & length)
+{
+    for(size_t idx(length); idx > 0; --idx)
+    {
+        if(key[idx - 1] == g_separator)
+        {
+            key += idx;
+            length -= idx;
+            return;
+        }
+    }
+}
+
+
+} // no name namespace
+
+
+/** \brief Parse a Central Directory in a table of entries.
+ *
+ * This constructor parses the \p count entries found in the
+ * \p central_directory buffer. The buffer is taken over by the
+ * table (it is swapped with an empty buffer) since the names,
+ * extra fields and comments are kept in there.
+ *
+ * \exception IOException
+ * This exception is raised if an entry does not start with the
+ * expected signature or if the buffer is too small for \p count
+ * entries.
+ *
+ * \param[in,out] central_directory  The Central Directory data.
+ * \param[in] count  The number of entries in the Central Directory.
+ */
+ZipEntryTable::ZipEntryTable(buffer_t & central_directory, size_t count)
+    //: m_central_directory() -- see below
+    //, m_records() -- see below
+    //, m_name_hash() -- see below
+    //, m_filename_hash() -- see below
+    //, m_index() -- auto-init
+    //, m_central_directory_data(nullptr) -- see below
+    //, m_central_directory_size(0) -- see below
+    //, m_record_data(nullptr) -- see below
+    //, m_count(0) -- see below
+    //, m_name_hash_data(nullptr) -- see below
+    //, m_filename_hash_data(nullptr) -- see below
+    //, m_hash_size(0) -- see below
+    //, m_checksum(0) -- auto-init
+    //, m_checksum_defined(false) -- auto-init
+    //, m_sorted_names() -- auto-init
+    //, m_sort_names_once() -- auto-init
+{
+    m_central_directory.swap(central_directory);
+    if(m_central_directory.size() > 0xFFFFFFFF)
+    {
+        throw FileCollectionException("the Central Directory is too large to be loaded in memory"); // LCOV_EXCL_LINE
+    }
+
+    m_central_directory_data = m_central_directory.data();
+    m_records.resize(count);
+    m_record_data = m_records.data();
+    m_count = count;
+
+    size_t pos(0);
+    for(size_t idx(0); idx < count; ++idx)
+    {
+        record_t & r(m_records[idx]);
+        r.m_header_offset = static_cast<uint32_t>(pos);
+
+        uint32_t signature;
+        zipRead(m_central_directory, pos, signature);
+        if(g_signature != signature)
+        {
+            throw IOException("ZipCentralDirectoryEntry::read(): Expected Central Directory entry signature not found");
+        }
+
+        uint16_t compress_method(0);
+        uint32_t compressed_size(0);
+        uint32_t uncompressed_size(0);
+        uint16_t filename_len(0);
+        uint16_t extra_field_len(0);
+        uint16_t file_comment_len(0);
+        uint32_t rel_offset_loc_head(0);
+
+        pos += 6;                                                       // skip versions & bitfield
+        zipRead(m_central_directory, pos, compress_method);             // 16
+        zipRead(m_central_directory, pos, r.m_dosdatetime);             // 32
+        zipRead(m_central_directory, pos, r.m_crc_32);                  // 32
+        zipRead(m_central_directory, pos, compressed_size);             // 32
+        zipRead(m_central_directory, pos, uncompressed_size);           // 32
+        zipRead(m_central_directory, pos, filename_len);                // 16
+        zipRead(m_central_directory, pos, extra_field_len);             // 16
+        zipRead(m_central_directory, pos, file_comment_len);            // 16
+        pos += 8;                                                       // skip disk & attributes
+        zipRead(m_central_directory, pos, rel_offset_loc_head);         // 32
+
+        pos += filename_len + extra_field_len + file_comment_len;
+        if(pos > m_central_directory.size())
+        {
+            throw IOException("EOF reached while reading zip archive data from file.");
+        }
+
+        // sizes and offset of 0xFFFFFFFF are found in the Zip64 extra field
+        //
+        r.m_compressed_size = compressed_size;
+        r.m_uncompressed_size = uncompressed_size;
+        r.m_entry_offset = rel_offset_loc_head;
+        zipReadZip64Extra(m_central_directory, r.m_header_offset + g_header_size + filename_len, extra_field_len, r.m_uncompressed_size, r.m_compressed_size, r.m_entry_offset);
+
+        // like the FilePath, ignore the trailing slash of directories
+        //
+        char const * name(getNamePointer(idx));
+        if(filename_len > 0 && name[filename_len - 1] == g_separator)
+        {
+            --filename_len;
+        }
+
+        r.m_compress_method = compress_method;
+        r.m_name_length = filename_len;
+    }
+    m_central_directory_size = pos;
+
+    // the hash tables are at most half full
+    //
+    size_t hash_size(1);
+    while(hash_size < count * 2)
+    {
+        hash_size <<= 1;
+    }
+    m_name_hash.resize(hash_size, 0);
+    m_filename_hash.resize(hash_size, 0);
+    m_name_hash_data = m_name_hash.data();
+    m_filename_hash_data = m_filename_hash.data();
+    m_hash_size = hash_size;
+    for(size_t idx(0); idx < count; ++idx)
+    {
+        char const * name(getNamePointer(idx));
+        size_t const length(m_records[idx].m_name_length);
+        addToHashTable(m_name_hash, name, length, idx, false);
+        addToHashTable(m_filename_hash, name, length, idx, true);
+    }
+}
+
+
+/** \brief Initialize an empty table.
+ *
+ * This constructor is used by loadIndex() which then makes the
+ * table point to the data found in the index file.
+ */
+ZipEntryTable::ZipEntryTable()
+{
+}
+
+
+/** \fn ZipEntryTable::ZipEntryTable(ZipEntryTable const & src);
+ * \brief The copy constructor is deleted.
+ *
+ * The table is shared between ZipFile objects using a shared pointer.
+ *
+ * \param[in] src  The source to copy.
+ */
+
+
+/** \fn ZipEntryTable & ZipEntryTable::operator = (ZipEntryTable const & rhs);
+ * \brief The assignment operator is deleted.
+ *
+ * The table is shared between ZipFile objects using a shared pointer.
+ *
+ * \param[in] rhs  The source to copy.
+ *
+ * \return A reference to this object.
+ */
+
+
+/** \brief Load a table from an index file.
+ *
+ * This function maps the named index file in memory and, if it was
+ * created by saveIndex() with the same \p key, returns a table which
+ * uses the records and hash tables found in that file directly. No
+ * parsing is required so the cost does not depend on the number of
+ * entries.
+ *
+ * If the file does not exist, is not a valid index, was created on a
+ * computer with a different byte order, has a damaged header, is
+ * truncated, or the key does not match, then
+ * the function returns a null pointer and the caller is expected to
+ * parse the Central Directory instead.
+ *
+ * Only the header is verified with a CRC-32. Verifying the records and
+ * hash tables here would defeat the purpose of the index. Instead,
+ * getRecord() and find() verify the record or hash slot they use and
+ * throw a FileCollectionException if it points outside of the table.
+ *
+ * \param[in] index_filename  The name of the index file.
+ * \param[in] key  The parameters of the archive the index has to match.
+ *
+ * \return The table or a null pointer.
+ */
+ZipEntryTable::pointer_t ZipEntryTable::loadIndex(std::string const & index_filename, index_key_t const & key)
+{
+    std::shared_ptr<MemoryMappedFile> index;
+    try
+    {
+        index.reset(new MemoryMappedFile(index_filename));
+    }
+    catch(IOException const &)
+    {
+        return pointer_t();
+    }
+
+    size_t const size(index->size());
+    if(size < sizeof(index_header_t))
+    {
+        return pointer_t();
+    }
+    index_header_t const * header(reinterpret_cast<index_header_t const *>(index->data()));
+    if(memcmp(header->m_magic, g_index_magic, sizeof(g_index_magic)) != 0
+    || header->m_header_checksum != header_checksum(*header)
+    || header->m_version != g_index_version
+    || header->m_byte_order != g_index_byte_order
+    || header->m_record_size != sizeof(record_t)
+    || !same_key(header->m_key, key)
+    || header->m_central_directory_size > size
+    || header->m_hash_size > size
+    || key.m_count > size)
+    {
+        return pointer_t();
+    }
+
+    size_t const central_directory_size(header->m_central_directory_size);
+    size_t const count(key.m_count);
+    size_t const hash_size(header->m_hash_size);
+    size_t const records_offset(sizeof(index_header_t) + align_size(central_directory_size));
+    size_t const name_hash_offset(records_offset + count * sizeof(record_t));
+    size_t const filename_hash_offset(name_hash_offset + hash_size * sizeof(uint32_t));
+    if(filename_hash_offset + hash_size * sizeof(uint32_t) != size
+    || hash_size < count * 2
+    || (hash_size & (hash_size - 1)) != 0)
+    {
+        return pointer_t();
+    }
+
+    char const * data(index->data());
+    std::shared_ptr<ZipEntryTable> table(new ZipEntryTable);
+    table->m_index = index;
+    table->m_central_directory_data = reinterpret_cast<unsigned char const *>(data + sizeof(index_header_t));
+    table->m_central_directory_size = central_directory_size;
+    table->m_record_data = reinterpret_cast<record_t const *>(data + records_offset);
+    table->m_count = count;
+    table->m_name_hash_data = reinterpret_cast<uint32_t const *>(data + name_hash_offset);
+    table->m_filename_hash_data = reinterpret_cast<uint32_t const *>(data + filename_hash_offset);
+    table->m_hash_size = hash_size;
+    table->m_checksum = header->m_checksum;
+    table->m_checksum_defined = true;
+    return table;
+}
+
+
+/** \brief Save this table in an index file.
+ *
+ * This function saves the Central Directory, the records, and the
+ * hash tables in the named index file so they can later be loaded
+ * with loadIndex().
+ *
+ * The file is first saved under a temporary name and then renamed
+ * so another process never sees a partial index.
+ *
+ * \exception IOException
+ * This exception is raised if the index file cannot be created or
+ * written to.
+ *
+ * \param[in] index_filename  The name of the index file.
+ * \param[in] key  The parameters of the archive this index represents.
+ */
+void ZipEntryTable::saveIndex(std::string const & index_filename, index_key_t const & key) const
+{
+    index_header_t header = index_header_t();
+    memcpy(header.m_magic, g_index_magic, sizeof(g_index_magic));
+    header.m_version = g_index_version;
+    header.m_byte_order = g_index_byte_order;
+    header.m_record_size = sizeof(record_t);
+    header.m_checksum = getChecksum();
+    header.m_key = key;
+    header.m_central_directory_size = m_central_directory_size;
+    header.m_hash_size = m_hash_size;
+    header.m_header_checksum = header_checksum(header);
+
+    char const padding[8] = {};
+    size_t const padding_size(align_size(m_central_directory_size) - m_central_directory_size);
+
+    std::string const tmp_filename(index_filename + ".tmp");
+    {
+        std::ofstream os(tmp_filename, std::ios::out | std::ios::binary | std::ios::trunc);
+        if(!os)
+        {
+            throw IOException("Error creating index file \"" + tmp_filename + "\".");
+        }
+
+        os.write(reinterpret_cast<char const *>(&header), sizeof(header));
+        os.write(reinterpret_cast<char const *>(m_central_directory_data), m_central_directory_size);
+        os.write(padding, padding_size);
+        os.write(reinterpret_cast<char const *>(m_record_data), m_count * sizeof(record_t));
+        os.write(reinterpret_cast<char const *>(m_name_hash_data), m_hash_size * sizeof(uint32_t));
+        os.write(reinterpret_cast<char const *>(m_filename_hash_data), m_hash_size * sizeof(uint32_t));
+        os.close();
+        if(!os)
+        {
+            std::remove(tmp_filename.c_str());              // LCOV_EXCL_LINE
+            throw IOException("Error writing index file \"" + tmp_filename + "\"."); // LCOV_EXCL_LINE
+        }
+    }
+
+    if(std::rename(tmp_filename.c_str(), index_filename.c_str()) != 0)
+    {
+        std::remove(tmp_filename.c_str());
+        throw IOException("Error renaming index file \"" + tmp_filename + "\" to \"" + index_filename + "\".");
+    }
+}
+
+
+/** \brief Retrieve the number of entries.
+ *
+ * This function returns the number of entries found in the Central
+ * Directory.
+ *
+ * \return The number of entries in this table.
+ */
+size_t ZipEntryTable::size() const
+{
+    return m_count;
+}
+
+
+/** \brief Retrieve the number of bytes used by the entries.
+ *
+ * This function returns the number of bytes the entries used in the
+ * Central Directory. The ZipFile compares it with the size defined
+ * in the End of Central Directory.
+ *
+ * \return The size of the Central Directory entries in bytes.
+ */
+size_t ZipEntryTable::getCentralDirectorySize() const
+{
+    return m_central_directory_size;
+}
+
+
+/** \brief Retrieve the checksum of the Central Directory.
+ *
+ * This function returns the CRC-32 of the getCentralDirectorySize()
+ * bytes of Central Directory used by the entries. When the table was
+ * loaded from an index, this is the checksum saved in the index,
+ * which the ZipFile can compare against the archive.
+ *
+ * \return The CRC-32 of the Central Directory.
+ */
+uint32_t ZipEntryTable::getChecksum() const
+{
+    if(m_checksum_defined)
+    {
+        return m_checksum;
+    }
+    return updateCrc32(crc32(0L, Z_NULL, 0), m_central_directory_data, m_central_directory_size);
+}
+
+
+/** \brief Retrieve the record of an entry.
+ *
+ * This function returns a reference to the record of the entry
+ * at \p index.
+ *
+ * The records of an index file are not verified when loaded, so the
+ * function makes sure that the name of the entry is within the
+ * Central Directory before returning its record.
+ *
+ * \exception FileCollectionException
+ * The index is out of range or the record points outside of the
+ * Central Directory, which means the index file is damaged.
+ *
+ * \param[in] index  The index of the entry, which must be smaller than size().
+ *
+ * \return A reference to the record of that entry.
+ */
+ZipEntryTable::record_t const & ZipEntryTable::getRecord(size_t index) const
+{
+    if(index >= m_count)
+    {
+        throw FileCollectionException("ZipEntryTable::getRecord(): entry index out of range.");
+    }
+
+    record_t const & record(m_record_data[index]);
+    if(record.m_header_offset > m_central_directory_size
+    || m_central_directory_size - record.m_header_offset < g_header_size + record.m_name_length)
+    {
+        throw FileCollectionException("ZipEntryTable::getRecord(): the record of an entry points outside of the Central Directory; the index file is damaged.");
+    }
+
+    return record;
+}
+
+
+/** \brief Retrieve the name of an entry.
+ *
+ * This function returns the full name of the entry at \p index,
+ * without the trailing slash in case of a directory.
+ *
+ * \param[in] index  The index of the entry, which must be smaller than size().
+ *
+ * \return The name of the entry.
+ */
+std::string ZipEntryTable::getName(size_t index) const
+{
+    return std::string(getNamePointer(index), getRecord(index).m_name_length);
+}
+
+
+/** \brief Search for an entry by name.
+ *
+ * This function searches the table for an entry named \p name. If
+ * \p matchpath is MatchPath::IGNORE, then only the basename of the
+ * entries is compared against \p name.
+ *
+ * When multiple entries have the same name, the first one is found.
+ *
+ * \exception FileCollectionException
+ * A hash slot or a record used by the search is out of range, which
+ * means the index file is damaged.
+ *
+ * \param[in] name  The name of the entry to search.
+ * \param[in] matchpath  Whether the full path or just the basename is matched.
+ * \param[out] index  The index of the entry, if found.
+ *
+ * \return true if the entry was found.
+ */
+bool ZipEntryTable::find(std::string const & name, FileCollection::MatchPath matchpath, size_t & index) const
+{
+    if(matchpath == FileCollection::MatchPath::MATCH)
+    {
+        return findInHashTable(m_name_hash_data, name.c_str(), name.length(), index, false);
+    }
+    return findInHashTable(m_filename_hash_data, name.c_str(), name.length(), index, true);
+}
+
+
+/** \brief Create a FileEntry from a record.
+ *
+ * This function creates a ZipCentralDirectoryEntry for the entry at
+ * \p index. The entry is read from the Central Directory data so it
+ * includes all the fields, including the comment and the extra field.
+ *
+ * Each call creates a new object.
+ *
+ * \param[in] index  The index of the entry, which must be smaller than size().
+ *
+ * \return A shared pointer to the new entry.
+ */
+FileEntry::pointer_t ZipEntryTable::getEntry(size_t index) const
+{
+    // the records are in the same order as the entries in the Central
+    // Directory so the next record tells us where this entry ends
+    //
+    size_t const start(getRecord(index).m_header_offset);
+    size_t const end(index + 1 < m_count ? getRecord(index + 1).m_header_offset : m_central_directory_size);
+    if(end < start)
+    {
+        throw FileCollectionException("ZipEntryTable::getEntry(): the records are not in order; the index file is damaged.");
+    }
+    buffer_t const buffer(m_central_directory_data + start, m_central_directory_data + end);
+
+    std::shared_ptr<ZipCentralDirectoryEntry> entry(new ZipCentralDirectoryEntry);
+    size_t pos(0);
+    entry->read(buffer, pos);
+    return entry;
+}
+
+
+/** \brief List the entries found in a directory.
+ *
+ * This function appends to \p result the indexes of the entries found
+ * under the \p prefix directory, sorted by name. See
+ * SortedNames::listDirectory() for details.
+ *
+ * The names are sorted the first time this function or glob() gets
+ * called. The names are not copied, the sorted list only holds indexes.
+ *
+ * \param[in] prefix  The directory to list.
+ * \param[in] recursive  Whether to include the entries of sub-directories.
+ * \param[in,out] result  The vector where the indexes are appended.
+ */
+void ZipEntryTable::listDirectory(std::string const & prefix, bool recursive, SortedNames::index_vector_t & result) const
+{
+    sortNames();
+    m_sorted_names.listDirectory(getNameFunction(), prefix, recursive, result);
+}
+
+
+/** \brief List the entries matching a pattern.
+ *
+ * This function appends to \p result the indexes of the entries with
+ * a name matching \p pattern, sorted by name. See SortedNames::glob()
+ * for details.
+ *
+ * \param[in] pattern  The pattern the names have to match.
+ * \param[in,out] result  The vector where the indexes are appended.
+ */
+void ZipEntryTable::glob(std::string const & pattern, SortedNames::index_vector_t & result) const
+{
+    sortNames();
+    m_sorted_names.glob(getNameFunction(), pattern, result);
+}
+
+
+/** \brief Retrieve a pointer to the name of an entry.
+ *
+ * The names are not copied out of the Central Directory. This function
+ * returns a pointer to the name of the entry at \p index in there.
+ *
+ * \param[in] index  The index of the entry.
+ *
+ * \return A pointer to the first character of the name.
+ */
+char const * ZipEntryTable::getNamePointer(size_t index) const
+{
+    return reinterpret_cast<char const *>(m_central_directory_data) + m_record_data[index].m_header_offset + g_header_size;
+}
+
+
+/** \brief Create the function used by SortedNames to get the names.
+ *
+ * The function returns the names directly from the Central Directory.
+ *
+ * \return A function returning the name of the entry at a given index.
+ */
+SortedNames::get_name_t ZipEntryTable::getNameFunction() const
+{
+    return [this](size_t index)
+        {
+            SortedNames::name_t result;
+            result.m_length = getRecord(index).m_name_length;
+            result.m_name = getNamePointer(index);
+            return result;
+        };
+}
+
+
+/** \brief Sort the names of the entries.
+ *
+ * This function sorts the names once. The table is read-only so the
+ * order never changes afterward.
+ *
+ * The table is shared between threads so the sort is protected by
+ * std::call_once(). Other threads wait for the sort to be done.
+ */
+void ZipEntryTable::sortNames() const
+{
+    std::call_once(m_sort_names_once, [this]()
+        {
+            m_sorted_names.sort(m_count, getNameFunction());
+        });
+}
+
+
+/** \brief Add an entry to one of the hash tables.
+ *
+ * This function adds the entry at \p index to \p table. If an entry
+ * with the same key is already present, the table is not modified so
+ * the first entry with a given name is the one found.
+ *
+ * The tables use open addressing with linear probing. A slot is set
+ * to the index of the entry plus one, zero marks an empty slot.
+ *
+ * \param[in,out] table  The hash table to update.
+ * \param[in] key  The full name of the entry.
+ * \param[in] length  The length of the name.
+ * \param[in] index  The index of the entry.
+ * \param[in] use_basename  Whether the table is keyed on basenames.
+ */
+void ZipEntryTable::addToHashTable(hash_table_t & table, char const * key, size_t length, size_t index, bool use_basename)
+{
+    if(use_basename)
+    {
+        basename(key, length);
+    }
+
+    size_t existing(0);
+    if(findInHashTable(table.data(), key, length, existing, use_basename))
+    {
+        return;
+    }
+
+    size_t const mask(table.size() - 1);
+    for(size_t slot(hash_key(key, length) & mask);; slot = (slot + 1) & mask)
+    {
+        if(table[slot] == 0)
+        {
+            table[slot] = static_cast<uint32_t>(index + 1);
+            return;
+        }
+    }
+}
+
+
+/** \brief Search for a key in one of the hash tables.
+ *
+ * This function searches \p table for an entry with a name, or
+ * basename, equal to \p key.
+ *
+ * \exception FileCollectionException
+ * A slot of the table or the record it references is out of range.
+ *
+ * \param[in] table  The hash table to search.
+ * \param[in] key  The name to search.
+ * \param[in] length  The length of the name.
+ * \param[out] index  The index of the entry, if found.
+ * \param[in] use_basename  Whether the table is keyed on basenames.
+ *
+ * \return true if the key was found.
+ */
+bool ZipEntryTable::findInHashTable(uint32_t const * table, char const * key, size_t length, size_t & index, bool use_basename) const
+{
+    // a damaged index may have no empty slot, so the number of probes
+    // is limited to the size of the table
+    //
+    size_t const mask(m_hash_size - 1);
+    size_t slot(hash_key(key, length) & mask);
+    for(size_t probe(0); probe < m_hash_size; ++probe, slot = (slot + 1) & mask)
+    {
+        uint32_t const value(table[slot]);
+        if(value == 0)
+        {
+            return false;
+        }
+        if(value > m_count)
+        {
+            throw FileCollectionException("ZipEntryTable::findInHashTable(): hash slot out of range; the index file is damaged.");
+        }
+
+        size_t name_length(getRecord(value - 1).m_name_length);
+        char const * name(getNamePointer(value - 1));
+        if(use_basename)
+        {
+            basename(name, name_length);
+        }
+        if(name_length == length
+        && memcmp(name, key, length) == 0)
+        {
+            index = value - 1;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
@@ -0,0 +1,141 @@
+#pragma once
+#ifndef ZIPIOS_ZIPENTRYTABLE_HPP
+#define ZIPIOS_ZIPENTRYTABLE_HPP
+
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2019  Made to Order Software Corporation
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Declaration of the zipios::ZipEntryTable class.
+ *
+ * The zipios::ZipEntryTable class holds the entries of an opened Zip
+ * archive in a compact, read-only form.
+ */
+
+#include "zipios/filecollection.hpp"
+
+#include "sortednames.hpp"
+#include "zipios_common.hpp"
+
+#include <mutex>
+
+
+namespace zipios
+{
+
+
+class MemoryMappedFile;
+
+
+class ZipEntryTable
+{
+public:
+    typedef std::shared_ptr<ZipEntryTable const>    pointer_t;
+
+    struct record_t
+    {
+        uint64_t                m_entry_offset = 0;
+        uint64_t                m_compressed_size = 0;
+        uint64_t                m_uncompressed_size = 0;
+        uint32_t                m_header_offset = 0;
+        uint32_t                m_crc_32 = 0;
+        uint32_t                m_dosdatetime = 0;
+        uint16_t                m_name_length = 0;
+        uint16_t                m_compress_method = 0;
+    };
+
+    struct index_key_t
+    {
+        uint64_t                m_archive_size = 0;
+        int64_t                 m_modification_time = 0;
+        int64_t                 m_start_offset = 0;
+        int64_t                 m_end_offset = 0;
+        uint64_t                m_central_directory_offset = 0;
+        uint64_t                m_central_directory_size = 0;
+        uint64_t                m_count = 0;
+    };
+
+                                ZipEntryTable(buffer_t & central_directory, size_t count);
+                                ZipEntryTable(ZipEntryTable const & src) = delete;
+    ZipEntryTable &             operator = (ZipEntryTable const & rhs) = delete;
+
+    static pointer_t            loadIndex(std::string const & index_filename, index_key_t const & key);
+    void                        saveIndex(std::string const & index_filename, index_key_t const & key) const;
+
+    size_t                      size() const;
+    size_t                      getCentralDirectorySize() const;
+    uint32_t                    getChecksum() const;
+    record_t const &            getRecord(size_t index) const;
+    std::string                 getName(size_t index) const;
+    bool                        find(std::string const & name, FileCollection::MatchPath matchpath, size_t & index) const;
+    FileEntry::pointer_t        getEntry(size_t index) const;
+    void                        listDirectory(std::string const & prefix, bool recursive, SortedNames::index_vector_t & result) const;
+    void                        glob(std::string const & pattern, SortedNames::index_vector_t & result) const;
+
+private:
+    typedef std::vector<uint32_t>   hash_table_t;
+
+                                ZipEntryTable();
+
+    char const *                getNamePointer(size_t index) const;
+    SortedNames::get_name_t     getNameFunction() const;
+    void                        sortNames() const;
+    void                        addToHashTable(hash_table_t & table, char const * key, size_t length, size_t index, bool use_basename);
+    bool                        findInHashTable(uint32_t const * table, char const * key, size_t length, size_t & index, bool use_basename) const;
+
+    // when the table is created from a Central Directory, the data
+    // is owned by these vectors
+    buffer_t                    m_central_directory;
+    std::vector<record_t>       m_records;
+    hash_table_t                m_name_hash;
+    hash_table_t                m_filename_hash;
+
+    // when the table is loaded from an index, the data is owned by
+    // the memory mapped index file
+    std::shared_ptr<MemoryMappedFile> m_index;
+
+    // the table makes use of the data through these pointers
+    unsigned char const *       m_central_directory_data = nullptr;
+    size_t                      m_central_directory_size = 0;
+    record_t const *            m_record_data = nullptr;
+    size_t                      m_count = 0;
+    uint32_t const *            m_name_hash_data = nullptr;
+    uint32_t const *            m_filename_hash_data = nullptr;
+    size_t                      m_hash_size = 0;
+    uint32_t                    m_checksum = 0;
+    bool                        m_checksum_defined = false;
+
+    // the names get sorted on the first directory or pattern search
+    mutable SortedNames         m_sorted_names;
+    mutable std::once_flag      m_sort_names_once;
+};
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
+#endif
@@ -30,13 +30,29 @@
 
 #include "zipios/zipiosexceptions.hpp"
 
-#include "backbuffer.hpp"
-#include "zipendofcentraldirectory.hpp"
+#include "cachedinputstream.hpp"
+#include "codec.hpp"
+#include "crc32.hpp"
+#include "inflatecheckpoints.hpp"
+#include "inflatepool.hpp"
+#include "memoryinputstreambuf.hpp"
+#include "memorymappedfile.hpp"
+#include "parallelcompressor.hpp"
+#include "positionalinputstreambuf.hpp"
+#include "rawinputstream.hpp"
 #include "zipcentraldirectoryentry.hpp"
+#include "zipendofcentraldirectory.hpp"
+#include "zipentrytable.hpp"
 #include "zipinputstream.hpp"
 #include "zipoutputstream.hpp"
 
+#include <algorithm>
+#include <cstring>
 #include <fstream>
+#include <limits>
+#include <thread>
+
+#include <zlib.h>
 
 
 /** \brief The zipios namespace includes the Zipios library definitions.
@@ -54,6 +70,59 @@ namespace zipios
 {
 
 
+namespace
+{
+
+/** \brief The maximum size of a local header.
+ *
+ * A local header is 30 bytes followed by a filename and an extra
+ * field, both of which are limited to 65535 bytes.
+ */
+offset_t const g_local_header_max_size = 30 + 0xFFFF + 0xFFFF;
+
+
+/** \brief The size of the fixed part of a local header.
+ *
+ * The local header starts with 30 bytes. The last two fields are the
+ * sizes of the filename and extra field which follow.
+ */
+offset_t const g_local_header_size = 30;
+
+
+/** \brief The signature of a local header.
+ *
+ * The first four bytes of a local header are expected to be "PK\3\4".
+ */
+uint32_t const g_local_header_signature = 0x04034B50;
+
+
+/** \brief Read a 16 bit little endian number.
+ *
+ * \param[in] p  A pointer to the two bytes to read.
+ *
+ * \return The number found at \p p.
+ */
+uint16_t get_uint16(unsigned char const * p)
+{
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+
+/** \brief Read a 32 bit little endian number.
+ *
+ * \param[in] p  A pointer to the four bytes to read.
+ *
+ * \return The number found at \p p.
+ */
+uint32_t get_uint32(unsigned char const * p)
+{
+    return static_cast<uint32_t>(get_uint16(p)) | (static_cast<uint32_t>(get_uint16(p + 2)) << 16);
+}
+
+
+} // no name namespace
+
+
 /** \mainpage Zipios
  *
  * \image html zipios.jpg
@@ -68,7 +137,10 @@ namespace zipios
  * A simple virtual file system that mounts regular directories and
  * zip files is also provided (FileCollection).
  *
- * The library is fully re-entrant. It is not otherwise thread safe.
+ * The library is fully re-entrant. Once opened, a ZipFile can also be
+ * read by any number of threads at the same time, see the Threads
+ * section of the ZipFile class. The other objects, including the
+ * input streams, must be used by one thread at a time.
  *
  * The source code is released under the <a
  * href="http://www.gnu.org/copyleft/lesser.html">GNU Lesser General Public
@@ -187,8 +259,10 @@ namespace zipios
  *
  * \warning
  * The CollectionCollection singleton in version 1.x was removed to make
- * the entire library 100% re-entrant without the need to link against
- * a thread library.
+ * the entire library 100% re-entrant. The library now links against the
+ * thread library (the CMake Threads package) since a ZipFile supports
+ * concurrent reads and saveCollectionToArchive() can compress entries
+ * with several threads.
  *
  * \section download Download
  *
@@ -274,11 +348,112 @@ namespace zipios
  */
 
 
+/** \brief The default memory budget of saveCollectionToArchive().
+ *
+ * When saving an archive with several threads, the entries compressed
+ * but not yet written to the output use at most this many bytes.
+ */
+size_t const ZipFile::SAVE_MEMORY_BUDGET_DEFAULT;
+
+
+
 /** \class ZipFile
  * \brief The ZipFile class represents a collection of files.
  *
  * ZipFile is a FileCollection, where the files are stored
  * in a .zip file.
+ *
+ * \par Threads
+ * Once opened, a ZipFile can be shared between threads. The
+ * entries(), getEntry(), getInputStream(), glob(), listDirectory(),
+ * and size() functions can be called by any number of threads at
+ * the same time: the table of entries does not change after the
+ * constructor returns, the indexes built on first use are protected,
+ * and each input stream reads the archive with its own position.
+ * The input streams themselves are not shared, each one must be used
+ * by a single thread at a time. Functions modifying the collection,
+ * such as addEntry(), close(), or the assignment operator, must not
+ * be called while other threads use the ZipFile.
+ *
+ * \par Cache
+ * Entries that get read over and over again can be kept in memory
+ * once decompressed by attaching a cache to the ZipFile with
+ * setCacheBudget(). See EntryCache for details.
+ */
+
+
+/** \enum ZipFile::AccessMode
+ * \brief How the Zip archive file gets accessed.
+ *
+ * By default, a ZipFile opens the archive once and keeps that file
+ * open. The input streams returned by getInputStream() all read the
+ * archive through that same file using positional reads (pread())
+ * limited to the bytes of their entry. They hold a reference to the
+ * file so they remain valid after the ZipFile is closed.
+ *
+ * With AccessMode::MEMORY_MAP, the archive is mapped in memory once
+ * when the ZipFile gets opened. The Central Directory, the local
+ * headers, and the data of the entries are then all read directly
+ * from that mapping. STORED entries are returned without any copy
+ * and the compressed data of DEFLATED entries is passed to zlib as
+ * is. The input streams hold a reference to the mapping so they
+ * remain valid after the ZipFile is closed.
+ *
+ * \var ZipFile::AccessMode ZipFile::AccessMode::STREAM
+ * Open the archive once and read it with positional reads. All the
+ * input streams share that one file descriptor.
+ *
+ * \var ZipFile::AccessMode ZipFile::AccessMode::MEMORY_MAP
+ * Map the archive in memory and read everything from that mapping.
+ */
+
+
+/** \enum ZipFile::ValidationLevel
+ * \brief How much of the archive gets verified.
+ *
+ * When opening a Zip archive, the ZipFile verifies that the Central
+ * Directory is where the End of Central Directory says it is and
+ * that each local header matches its Central Directory entry. That
+ * second check requires one seek and one read per entry which is
+ * slow on archives with many entries. The validation level let you
+ * choose how much of that work is done and when.
+ *
+ * \var ZipFile::ValidationLevel ZipFile::ValidationLevel::NONE
+ * Only read the Central Directory. No consistency checks are done.
+ *
+ * \var ZipFile::ValidationLevel ZipFile::ValidationLevel::CENTRAL_DIRECTORY
+ * Verify that the size of the Central Directory matches the End of
+ * Central Directory information. The local headers are not checked.
+ *
+ * \var ZipFile::ValidationLevel ZipFile::ValidationLevel::LAZY
+ * Verify the Central Directory on open and verify each local header
+ * the first time getInputStream() is called for that entry. This is
+ * nearly free since the local header has to be read at that point
+ * anyway.
+ *
+ * \var ZipFile::ValidationLevel ZipFile::ValidationLevel::FULL
+ * Verify the Central Directory and all the local headers on open.
+ * This is the default.
+ */
+
+
+/** \enum ZipFile::WriteMode
+ * \brief How saveCollectionToArchive() saves the CRC and sizes.
+ *
+ * The CRC and sizes of an entry are only known once all of its data
+ * was compressed, after its local header was written.
+ *
+ * \var ZipFile::WriteMode ZipFile::WriteMode::AUTO
+ * Use WriteMode::DATA_DESCRIPTOR when the output stream cannot tell
+ * its position and WriteMode::SEEK_BACK otherwise. This is the default.
+ *
+ * \var ZipFile::WriteMode ZipFile::WriteMode::SEEK_BACK
+ * Seek back to the local header of each entry to write the CRC and
+ * sizes. The output stream must be seekable.
+ *
+ * \var ZipFile::WriteMode ZipFile::WriteMode::DATA_DESCRIPTOR
+ * Never seek. The CRC and sizes are written in a data descriptor
+ * following the data of each entry.
  */
 
 
@@ -290,6 +465,10 @@ namespace zipios
  * the zip file on 4 bytes. The offset must be written in zip-file
  * byte-order (little endian).
  *
+ * When the start offset does not fit in 32 bits, the last 4 bytes are
+ * set to 0xFFFFFFFF and the 64 bit start offset is written in the 8
+ * bytes just before them.
+ *
  * The program appendzip, which is part of the Zipios distribution can
  * be used to append a Zip archive to a file, e.g. a binary program.
  *
@@ -307,14 +486,23 @@ ZipFile::pointer_t ZipFile::openEmbeddedZipFile(std::string const& name)
 {
     // open zipfile, read 4 last bytes close file
     // create ZipFile object.
-    uint32_t start_offset;
+    uint64_t start_offset;
+    offset_t end_offset(4);
     {
         std::ifstream ifs(name, std::ios::in | std::ios::binary);
         ifs.seekg(-4, std::ios::end);
-        zipRead(ifs, start_offset);
-        // todo: add support for 64 bit (files of more than 4Gb)
+        uint32_t start_offset32;
+        zipRead(ifs, start_offset32);
+        start_offset = start_offset32;
+        if(start_offset32 == 0xFFFFFFFF)
+        {
+            // 64 bit offset saved just before
+            ifs.seekg(-12, std::ios::end);
+            zipRead(ifs, start_offset);
+            end_offset = 12;
+        }
     }
-    return ZipFile::pointer_t(new ZipFile(name, start_offset, 4));
+    return ZipFile::pointer_t(new ZipFile(name, start_offset, end_offset));
 }
 
 
@@ -342,6 +530,22 @@ ZipFile::ZipFile()
  * If the file cannot be opened or the Zip directory cannot
  * be read, then the constructor throws an exception.
  *
+ * When \p index_filename is not empty, the entries are loaded from that
+ * index file instead of parsing the Central Directory. The index is
+ * only used if it was created for this very archive: same size,
+ * modification time, offsets, and End of Central Directory. With
+ * ValidationLevel::FULL, the Central Directory is still read and its
+ * checksum compared with the one saved in the index. When the index
+ * cannot be used, the Central Directory gets parsed as usual and the
+ * index file is (re)created. Failing to save the index is not an error.
+ *
+ * The index file can be saved next to the archive or in a cache
+ * directory. It is memory mapped and only its header gets verified so
+ * opening a large archive with a valid index takes about the same
+ * amount of time whatever the number of entries. A damaged record or
+ * hash table in the index raises a FileCollectionException when the
+ * corresponding entry gets searched or used.
+ *
  * \param[in] filename  The filename of the zip file to open.
  * \param[in] s_off  Offset relative to the start of the file, that
  *                   indicates the beginning of the zip data in the file.
@@ -349,85 +553,150 @@ ZipFile::ZipFile()
  *                   indicates the end of the zip data in the file.
  *                   The offset is a positive number, even though the
  *                   offset is towards the beginning of the file.
+ * \param[in] access_mode  Whether to read the file with streams or to
+ *                         map it in memory.
+ * \param[in] validation_level  How much of the archive gets verified and
+ *                              when.
+ * \param[in] index_filename  The name of an index file to load the
+ *                            entries from, or an empty string.
  */
-ZipFile::ZipFile(std::string const& filename, offset_t s_off, offset_t e_off)
+ZipFile::ZipFile(std::string const& filename, offset_t s_off, offset_t e_off, AccessMode access_mode, ValidationLevel validation_level, std::string const & index_filename)
     : FileCollection(filename)
     , m_vs(s_off, e_off)
+    , m_access_mode(access_mode)
+    , m_validation_level(validation_level)
+    //, m_verified_entries() -- auto-init
+    //, m_mapped_file(nullptr) -- auto-init
+    //, m_positional_file(nullptr) -- auto-init
+    , m_inflate_pool(new InflatePool)
+    //, m_cache(nullptr) -- auto-init
+    , m_inflater(Inflater::create())
 {
-    std::ifstream zipfile(m_filename, std::ios::in | std::ios::binary);
-    if(!zipfile)
+    std::unique_ptr<MemoryInputStreambuf> mbuf;
+    std::unique_ptr<PositionalInputStreambuf> pbuf;
+    std::istream zipfile(nullptr);
+    if(m_access_mode == AccessMode::MEMORY_MAP)
     {
-        throw IOException("Error opening Zip archive file for reading in binary mode.");
+        m_mapped_file.reset(new MemoryMappedFile(m_filename));
+        mbuf.reset(new MemoryInputStreambuf(m_mapped_file->data(), m_mapped_file->size()));
+        zipfile.rdbuf(mbuf.get());
+    }
+    else
+    {
+        m_positional_file.reset(new PositionalFile(m_filename));
+        pbuf.reset(new PositionalInputStreambuf(m_positional_file, 0, m_positional_file->size()));
+        zipfile.rdbuf(pbuf.get());
     }
 
     // Find and read the End of Central Directory.
     ZipEndOfCentralDirectory eocd;
+    offset_t const eocd_pos(eocd.find(zipfile, m_vs));
+
+    // The Central Directory is expected to be between its offset and the
+    // End of Central Directory; read all of it at once and then parse
+    // the entries from memory
+    //
+    if(eocd.getOffset() > eocd_pos)
+    {
+        throw FileCollectionException("Zip file consistency problem. Zip file data fields are inconsistent with zip file layout.");
+    }
+    // The index, if any, replaces the Central Directory when it was
+    // created for this very archive
+    //
+    ZipEntryTable::index_key_t key;
+    std::shared_ptr<ZipEntryTable const> table;
+    bool save_index(false);
+    if(!index_filename.empty())
     {
-        BackBuffer bb(zipfile, m_vs);
-        ssize_t read_p(-1);
-        for(;;)
+        FilePath const archive(m_filename);
+        key.m_archive_size = archive.fileSize();
+        key.m_modification_time = archive.lastModificationTime();
+        offset_t start_offset(0);
+        offset_t end_offset(0);
+        m_vs.getOffsets(start_offset, end_offset);
+        key.m_start_offset = start_offset;
+        key.m_end_offset = end_offset;
+        key.m_central_directory_offset = eocd.getOffset();
+        key.m_central_directory_size = eocd.getCentralDirectorySize();
+        key.m_count = eocd.getCount();
+        table = ZipEntryTable::loadIndex(index_filename, key);
+    }
+
+    if(!table || m_validation_level == ValidationLevel::FULL)
+    {
+        buffer_t central_directory;
+        m_vs.vseekg(zipfile, eocd.getOffset(), std::ios::beg);
+        zipRead(zipfile, central_directory, eocd_pos - eocd.getOffset());
+
+        if(table)
         {
-            if(read_p < 0)
-            {
-                if(!bb.readChunk(read_p))
-                {
-                    throw FileCollectionException("Unable to find zip structure: End-of-central-directory");
-                }
-            }
-            // Note: this is pretty fast since it reads from 'bb' which
-            //       caches the buffer the readChunk() function just read.
+            // make sure the index still represents this Central Directory
             //
-            if(eocd.read(bb, read_p))
+            size_t const size(std::min(table->getCentralDirectorySize(), central_directory.size()));
+            if(updateCrc32(crc32(0L, Z_NULL, 0), central_directory.data(), size) != table->getChecksum())
             {
-                // found it!
-                break;
+                table.reset();
             }
-            --read_p;
         }
-    }
-
-    // Position read pointer to start of first entry in central dir.
-    m_vs.vseekg(zipfile, eocd.getOffset(), std::ios::beg);
 
-    // TBD -- is that ", 0" still necessary? (With VC2012 and better)
-    // Give the second argument in the next line to keep Visual C++ quiet
-    //m_entries.resize(eocd.totalCount(), 0);
-    m_entries.resize(eocd.getCount());
-
-    size_t const max_entry(eocd.getCount());
-    for(size_t entry_num(0); entry_num < max_entry; ++entry_num)
-    {
-        m_entries[entry_num] = FileEntry::pointer_t(new ZipCentralDirectoryEntry);
-        m_entries[entry_num].get()->read(zipfile);
+        if(!table)
+        {
+            // Parse the entries in a compact table, the FileEntry objects
+            // only get created on demand
+            //
+            table.reset(new ZipEntryTable(central_directory, eocd.getCount()));
+            save_index = !index_filename.empty();
+        }
     }
+    m_entry_table = table;
 
     // Consistency check #1:
-    // The virtual seeker position is exactly the start offset of the
-    // Central Directory plus the Central Directory size
+    // The entries use exactly the Central Directory size
     //
-    offset_t const pos(m_vs.vtellg(zipfile));
-    if(static_cast<offset_t>(eocd.getOffset() + eocd.getCentralDirectorySize()) != pos)
+    if(m_validation_level != ValidationLevel::NONE)
     {
-        throw FileCollectionException("Zip file consistency problem. Zip file data fields are inconsistent with zip file layout.");
+        if(eocd.getCentralDirectorySize() != table->getCentralDirectorySize())
+        {
+            throw FileCollectionException("Zip file consistency problem. Zip file data fields are inconsistent with zip file layout.");
+        }
     }
 
     // Consistency check #2:
     // Are local headers consistent with CD headers?
     //
-    for(auto it = m_entries.begin(); it != m_entries.end(); ++it)
-    {
-        /** \TODO
-         * Make sure the entry offset is properly defined by
-         * ZipCentralDirectoryEntry.
-         *
-         * Also the isEqual() is a quite advanced (slow) test here!
-         */
-        m_vs.vseekg(zipfile, (*it)->getEntryOffset(), std::ios::beg);
-        ZipLocalEntry zlh;
-        zlh.read(zipfile);
-        if(!zipfile || !zlh.isEqual(**it))
+    // With ValidationLevel::LAZY this is done by getInputStream()
+    //
+    if(m_validation_level == ValidationLevel::FULL)
+    {
+        size_t const max_entry(table->size());
+        for(size_t idx(0); idx < max_entry; ++idx)
         {
-            throw FileCollectionException("Zip file consistency problem. Zip file data fields are inconsistent with zip file layout.");
+            /** \TODO
+             * The isEqual() is a quite advanced (slow) test here!
+             */
+            m_vs.vseekg(zipfile, table->getRecord(idx).m_entry_offset, std::ios::beg);
+            ZipLocalEntry zlh;
+            zlh.read(zipfile);
+            if(!zipfile || !zlh.isEqual(*table->getEntry(idx)))
+            {
+                throw FileCollectionException("Zip file consistency problem. Zip file data fields are inconsistent with zip file layout.");
+            }
+        }
+    }
+    else if(m_validation_level == ValidationLevel::LAZY)
+    {
+        m_verified_entries.reset(new verified_entries_t(table->size()));
+    }
+
+    if(save_index)
+    {
+        try
+        {
+            table->saveIndex(index_filename, key);
+        }
+        catch(IOException const &)
+        {
+            // the index is just a cache, the archive is still valid
         }
     }
 
@@ -436,6 +705,97 @@ ZipFile::ZipFile(std::string const& filename, offset_t s_off, offset_t e_off)
 }
 
 
+/** \brief Copy a ZipFile.
+ *
+ * This constructor copies \p src. The FileEntry objects, if already
+ * created, get cloned by the FileCollection copy constructor. The
+ * table of entries, the opened file, the pool of zlib states, the
+ * list of entries already verified, and the checkpoints are shared
+ * with \p src.
+ *
+ * \note
+ * A ZipFile can be used by multiple threads at once so there is no
+ * need to copy it for that purpose.
+ *
+ * \param[in] src  The ZipFile to copy.
+ */
+ZipFile::ZipFile(ZipFile const & src)
+    : FileCollection(src)
+    , m_vs(src.m_vs)
+    , m_access_mode(src.m_access_mode)
+    , m_validation_level(src.m_validation_level)
+    , m_verified_entries(src.m_verified_entries)
+    , m_mapped_file(src.m_mapped_file)
+    , m_positional_file(src.m_positional_file)
+    , m_inflate_pool(src.m_inflate_pool)
+    , m_cache(std::atomic_load(&src.m_cache))
+    , m_inflater(std::atomic_load(&src.m_inflater))
+    , m_entry_table(src.m_entry_table)
+    //, m_entries_mutex() -- auto-init
+    //, m_table_entries() -- see below
+    , m_entries_loaded(src.m_entries_loaded.load())
+    //, m_checkpoints_mutex() -- auto-init
+    //, m_checkpoint_interval(0) -- see below
+    //, m_checkpoints() -- see below
+    , m_use_checkpoints(src.m_use_checkpoints.load())
+    , m_verify_crc(src.m_verify_crc.load())
+{
+    m_table_entries = src.cloneTableEntries();
+
+    std::lock_guard<std::mutex> guard(src.m_checkpoints_mutex);
+    m_checkpoint_interval = src.m_checkpoint_interval;
+    m_checkpoints = src.m_checkpoints;
+}
+
+
+/** \brief Copy a ZipFile in this ZipFile.
+ *
+ * This function replaces the content of this ZipFile with a copy
+ * of \p rhs. See the copy constructor for details.
+ *
+ * \param[in] rhs  The ZipFile to copy.
+ *
+ * \return A reference to this ZipFile.
+ */
+ZipFile & ZipFile::operator = (ZipFile const & rhs)
+{
+    if(this != &rhs)
+    {
+        FileCollection::operator = (rhs);
+        m_vs = rhs.m_vs;
+        m_access_mode = rhs.m_access_mode;
+        m_validation_level = rhs.m_validation_level;
+        m_verified_entries = rhs.m_verified_entries;
+        m_mapped_file = rhs.m_mapped_file;
+        m_positional_file = rhs.m_positional_file;
+        m_inflate_pool = rhs.m_inflate_pool;
+        std::atomic_store(&m_cache, std::atomic_load(&rhs.m_cache));
+        std::atomic_store(&m_inflater, std::atomic_load(&rhs.m_inflater));
+        m_entry_table = rhs.m_entry_table;
+        {
+            FileEntry::vector_t table_entries(rhs.cloneTableEntries());
+            std::lock_guard<std::mutex> guard(m_entries_mutex);
+            m_table_entries.swap(table_entries);
+        }
+        m_entries_loaded = rhs.m_entries_loaded.load();
+
+        size_t interval(0);
+        checkpoints_t checkpoints;
+        {
+            std::lock_guard<std::mutex> guard(rhs.m_checkpoints_mutex);
+            interval = rhs.m_checkpoint_interval;
+            checkpoints = rhs.m_checkpoints;
+        }
+        std::lock_guard<std::mutex> guard(m_checkpoints_mutex);
+        m_checkpoint_interval = interval;
+        m_checkpoints.swap(checkpoints);
+        m_use_checkpoints = rhs.m_use_checkpoints.load();
+        m_verify_crc = rhs.m_verify_crc.load();
+    }
+    return *this;
+}
+
+
 /** \brief Create a clone of this ZipFile.
  *
  * This function creates a heap allocated clone of the ZipFile object.
@@ -459,6 +819,192 @@ ZipFile::~ZipFile()
 }
 
 
+/** \brief Close the ZipFile.
+ *
+ * This function closes the collection and releases the memory
+ * mapping, if any. Input streams that are still in use keep their
+ * own reference to the mapping.
+ */
+void ZipFile::close()
+{
+    m_mapped_file.reset();
+    m_positional_file.reset();
+    m_inflate_pool.reset();
+    std::atomic_store(&m_cache, EntryCache::pointer_t());
+    m_entry_table.reset();
+    {
+        std::lock_guard<std::mutex> guard(m_entries_mutex);
+        m_table_entries.clear();
+    }
+    m_entries_loaded = false;
+    {
+        std::lock_guard<std::mutex> guard(m_checkpoints_mutex);
+        m_checkpoints.clear();
+    }
+    FileCollection::close();
+}
+
+
+/** \brief Add an entry to this ZipFile.
+ *
+ * This function first creates the FileEntry objects of all the entries
+ * found in the Zip archive, then it adds \p entry to the collection.
+ *
+ * \note
+ * The new entry is only added to the collection. It is not written to
+ * the Zip archive.
+ *
+ * \param[in] entry  The entry to add to the ZipFile.
+ */
+void ZipFile::addEntry(FileEntry const & entry)
+{
+    if(isValid())
+    {
+        loadEntries();
+    }
+    FileCollection::addEntry(entry);
+}
+
+
+/** \brief Retrieve the array of entries.
+ *
+ * This function creates the FileEntry objects of all the entries of
+ * the Zip archive the first time it gets called. The objects are kept
+ * in the collection so further calls return the same objects.
+ *
+ * \return A vector containing the entries of this ZipFile.
+ */
+FileEntry::vector_t ZipFile::entries() const
+{
+    mustBeValid();
+    loadEntries();
+
+    return FileCollection::entries();
+}
+
+
+/** \brief Retrieve the interval between checkpoints.
+ *
+ * This function returns the interval defined with
+ * setCheckpointInterval().
+ *
+ * \return The number of uncompressed bytes between checkpoints, or
+ *         zero when no checkpoints get recorded.
+ */
+size_t ZipFile::getCheckpointInterval() const
+{
+    std::lock_guard<std::mutex> guard(m_checkpoints_mutex);
+    return m_checkpoint_interval;
+}
+
+
+/** \brief Check whether the CRC-32 of the entries gets verified.
+ *
+ * \return true if the CRC-32 of the data read gets verified.
+ *
+ * \sa setCrcVerification()
+ */
+bool ZipFile::getCrcVerification() const
+{
+    return m_verify_crc;
+}
+
+
+/** \brief Get an entry from this ZipFile.
+ *
+ * This function searches the compact table of entries for an entry
+ * named \p name. The FileEntry object of an entry only gets created
+ * the first time it is requested. The same object is returned each
+ * time, including by entries(), glob(), and listDirectory(), so
+ * changes made to it are kept.
+ *
+ * \param[in] name  A string containing the name of the entry to get.
+ * \param[in] matchpath  Speficy MatchPath::MATCH, if the path should match
+ *                       as well, specify MatchPath::IGNORE, if the path
+ *                       should be ignored.
+ *
+ * \return A shared pointer to the found entry. The returned pointer
+ *         is null if no entry is found.
+ */
+FileEntry::pointer_t ZipFile::getEntry(std::string const & name, MatchPath matchpath) const
+{
+    mustBeValid();
+
+    if(m_entries_loaded || m_entry_table == nullptr)
+    {
+        return FileCollection::getEntry(name, matchpath);
+    }
+
+    size_t index(0);
+    if(!m_entry_table->find(name, matchpath, index))
+    {
+        return FileEntry::pointer_t();
+    }
+    return getTableEntry(index);
+}
+
+
+/** \brief Retrieve the access mode of this ZipFile.
+ *
+ * This function returns the access mode specified when opening
+ * the Zip archive.
+ *
+ * \return The access mode of this ZipFile.
+ */
+ZipFile::AccessMode ZipFile::getAccessMode() const
+{
+    return m_access_mode;
+}
+
+
+/** \brief Retrieve the statistics of the cache of this ZipFile.
+ *
+ * This function returns the number of hits, misses, and evictions of
+ * the cache as well as its current size. If no cache is attached to
+ * this ZipFile, all the fields are zero.
+ *
+ * \return A copy of the statistics of the cache.
+ *
+ * \sa setCacheBudget()
+ */
+EntryCache::statistics_t ZipFile::getCacheStatistics() const
+{
+    EntryCache::pointer_t cache(std::atomic_load(&m_cache));
+    if(cache == nullptr)
+    {
+        return EntryCache::statistics_t();
+    }
+    return cache->getStatistics();
+}
+
+
+/** \brief Retrieve the inflater of this ZipFile.
+ *
+ * This function returns the inflater used to decompress whole entries.
+ *
+ * \return The inflater of this ZipFile.
+ *
+ * \sa setInflater()
+ */
+Inflater::pointer_t ZipFile::getInflater() const
+{
+    return std::atomic_load(&m_inflater);
+}
+
+
+/** \brief Retrieve the validation level of this ZipFile.
+ *
+ * This function returns the validation level specified when opening
+ * the Zip archive.
+ *
+ * \return The validation level of this ZipFile.
+ */
+ZipFile::ValidationLevel ZipFile::getValidationLevel() const
+{
+    return m_validation_level;
+}
+
+
 /** \brief Retrieve a pointer to a file in the Zip archive.
  *
  * This function returns a shared pointer to an istream defined from the
@@ -484,6 +1030,10 @@ ZipFile::~ZipFile()
  * returns the uncompressed data transparently to you (outside of the
  * time it takes to decompress the data, of course.)
  *
+ * When a cache is attached to this ZipFile (see setCacheBudget()),
+ * the whole entry gets decompressed in the cache the first time it
+ * is read and the returned stream reads from that cached copy.
+ *
  * \param[in] entry_name  The name of the file to search in the collection.
  * \param[in] matchpath  Whether the full path or just the filename is matched.
  *
@@ -497,47 +1047,1087 @@ ZipFile::stream_pointer_t ZipFile::getInputStream(std::string const& entry_name,
 {
     mustBeValid();
 
-    FileEntry::pointer_t entry(getEntry(entry_name, matchpath));
-    if(entry)
+    size_t index(0);
+    if(m_entry_table == nullptr
+    || !m_entry_table->find(entry_name, matchpath, index))
     {
-        stream_pointer_t zis(new ZipInputStream(m_filename, entry->getEntryOffset() + m_vs.startOffset()));
-        return zis;
+        // no entry with that name (and match) available
+        return nullptr;
     }
+    ZipEntryTable::record_t const & record(m_entry_table->getRecord(index));
 
-    // no entry with that name (and match) available
-    return nullptr;
-}
+    EntryCache::pointer_t cache(std::atomic_load(&m_cache));
+    if(cache != nullptr)
+    {
+        // the cache uses the name of the entry as found so the same
+        // entry gets found whatever the matchpath used
+        //
+        std::string const name(m_entry_table->getName(index));
+        EntryCache::data_t data(cache->find(name));
+        if(data == nullptr
+        && record.m_uncompressed_size <= cache->getBudget())
+        {
+            std::shared_ptr<std::vector<char>> buffer(new std::vector<char>(record.m_uncompressed_size));
+            readEntryData(index, buffer->empty() ? nullptr : &(*buffer)[0]);
+            cache->insert(name, buffer);
+            data = buffer;
+        }
+        if(data != nullptr)
+        {
+            return stream_pointer_t(new CachedInputStream(data));
+        }
+    }
 
+    offset_t const entry_offset(record.m_entry_offset + m_vs.startOffset());
 
-/** \brief Create a Zip archive from the specified FileCollection.
- *
- * This function is expected to be used with a DirectoryCollection
- * that you created to save the collection in an archive.
- *
- * \param[in,out] os  The output stream where the Zip archive is saed.
- * \param[in] collection  The collection to save in this output stream.
- * \param[in] zip_comment  The global comment of the Zip archive.
- */
-void ZipFile::saveCollectionToArchive(std::ostream & os, FileCollection & collection, std::string const & zip_comment)
-{
-    try
+    // the CRC and sizes for entries with a trailing data descriptor
+    //
+    ZipLocalEntry central_entry;
+    central_entry.setSize(record.m_uncompressed_size);
+    central_entry.setCompressedSize(record.m_compressed_size);
+    central_entry.setCrc(record.m_crc_32);
+
+    std::shared_ptr<ZipInputStream> zis;
+    if(m_mapped_file != nullptr)
     {
-        ZipOutputStream output_stream(os);
+        zis.reset(new ZipInputStream(m_mapped_file, entry_offset, m_inflate_pool, &central_entry));
+    }
+    else
+    {
+        // the stream cannot go past the largest possible local header
+        // followed by the compressed data and one more byte (zlib wants
+        // to see one byte after the compressed data) nor past the end
+        // of the archive
+        //
+        offset_t const end(std::min(
+                  static_cast<offset_t>(entry_offset + g_local_header_max_size + record.m_compressed_size + 1)
+                , m_positional_file->size() - m_vs.endOffset()));
+        zis.reset(new ZipInputStream(m_positional_file, entry_offset, end, m_inflate_pool, &central_entry));
+    }
 
-        output_stream.setComment(zip_comment);
+    if(m_use_checkpoints
+    && static_cast<StorageMethod>(record.m_compress_method) == StorageMethod::DEFLATED)
+    {
+        zis->setCheckpoints(getCheckpoints(index));
+    }
 
-        FileEntry::vector_t entries(collection.entries());
-        for(auto it(entries.begin()); it != entries.end(); ++it)
+    if(m_verify_crc)
+    {
+        zis->setCrcVerification(record.m_crc_32);
+    }
+
+    if(m_validation_level == ValidationLevel::LAZY
+    && !(*m_verified_entries)[index])
+    {
+        // the stream already read the local header, compare it now
+        //
+        if(!zis->getLocalEntry().isEqual(*m_entry_table->getEntry(index)))
         {
-            output_stream.putNextEntry(*it);
-            // get an InputStream if available (i.e. directories do not have an input stream)
-            if(!(*it)->isDirectory())
+            throw FileCollectionException("Zip file consistency problem. Zip file data fields are inconsistent with zip file layout.");
+        }
+        (*m_verified_entries)[index] = true;
+    }
+
+    return zis;
+}
+
+
+/** \brief Retrieve the compressed data of a file in the Zip archive.
+ *
+ * This function returns a stream reading the data of the named entry
+ * exactly as it is saved in the Zip archive. For a STORED entry, that
+ * is the data of the file. For the other methods, that is the
+ * compressed data, which getEntry() describes: FileEntry::getMethod()
+ * returns the method used to compress it, FileEntry::getCompressedSize()
+ * the number of bytes the stream returns, and FileEntry::getCrc() the
+ * CRC of the uncompressed data.
+ *
+ * The data can be saved in another archive without recompressing it
+ * with ZipOutputStream::putRawEntry(). The saveCollectionToArchive()
+ * function does so automatically.
+ *
+ * The function returns nullptr if there is no entry with the
+ * specified name in this ZipFile.
+ *
+ * \note
+ * The entry cache is not used by this function.
+ *
+ * \exception FileCollectionException
+ * The local header of the entry is invalid or its data goes past the
+ * end of the archive.
+ *
+ * \param[in] entry_name  The name of the file to search in the collection.
+ * \param[in] matchpath  Whether the full path or just the filename is matched.
+ *
+ * \return A shared pointer to an open istream reading the raw data of
+ *         the specified entry.
+ *
+ * \sa getInputStream()
+ */
+ZipFile::stream_pointer_t ZipFile::getRawInputStream(std::string const & entry_name, MatchPath matchpath)
+{
+    mustBeValid();
+
+    size_t index(0);
+    if(m_entry_table == nullptr
+    || !m_entry_table->find(entry_name, matchpath, index))
+    {
+        // no entry with that name (and match) available
+        return nullptr;
+    }
+
+    offset_t const data_offset(getEntryDataOffset(index));
+    offset_t const data_end(data_offset + m_entry_table->getRecord(index).m_compressed_size);
+    if(m_mapped_file != nullptr)
+    {
+        return stream_pointer_t(new RawInputStream(m_mapped_file, data_offset, data_end));
+    }
+    return stream_pointer_t(new RawInputStream(m_positional_file, data_offset, data_end, m_inflate_pool));
+}
+
+
+/** \brief Read the whole data of an entry in a buffer.
+ *
+ * This function decompresses the entry named \p entry_name directly
+ * in \p buffer. This is much faster than reading the stream returned
+ * by getInputStream() when the whole entry is needed: the data of a
+ * STORED entry is read with a single read, and the data of a DEFLATED
+ * entry is inflated directly in \p buffer, without going through the
+ * buffers of a stream.
+ *
+ * The uncompressed size of the entry, which \p buffer must be able to
+ * hold, is available with getEntry() and FileEntry::getSize().
+ *
+ * \exception FileCollectionException
+ * The entry does not exist, \p buffer is too small, or the entry is
+ * invalid or uses an unsupported compression method.
+ *
+ * \exception IOException
+ * The archive cannot be read, the compressed data is invalid, or the
+ * CRC-32 of the data does not match (see setCrcVerification()).
+ *
+ * \param[in] entry_name  The name of the entry to read.
+ * \param[out] buffer  The buffer receiving the data.
+ * \param[in] size  The size of \p buffer.
+ * \param[in] matchpath  Whether the full path or just the filename is matched.
+ *
+ * \return The number of bytes saved in \p buffer.
+ *
+ * \sa getInputStream()
+ */
+size_t ZipFile::readEntry(std::string const & entry_name, char * buffer, size_t size, MatchPath matchpath) const
+{
+    mustBeValid();
+
+    size_t const index(findEntryIndex(entry_name, matchpath));
+    size_t const uncompressed_size(m_entry_table->getRecord(index).m_uncompressed_size);
+    if(size < uncompressed_size)
+    {
+        throw FileCollectionException("The buffer is too small to receive the data of \"" + entry_name + "\".");
+    }
+
+    readEntryData(index, buffer);
+
+    return uncompressed_size;
+}
+
+
+/** \brief Read the whole data of an entry in a vector.
+ *
+ * This function works like the other readEntry() function except
+ * that the vector returned is allocated with the uncompressed size
+ * of the entry as found in the Central Directory.
+ *
+ * \exception FileCollectionException
+ * The entry does not exist, or the entry is invalid or uses an
+ * unsupported compression method.
+ *
+ * \exception IOException
+ * The archive cannot be read, the compressed data is invalid, or the
+ * CRC-32 of the data does not match (see setCrcVerification()).
+ *
+ * \param[in] entry_name  The name of the entry to read.
+ * \param[in] matchpath  Whether the full path or just the filename is matched.
+ *
+ * \return The data of the entry.
+ */
+std::vector<char> ZipFile::readEntry(std::string const & entry_name, MatchPath matchpath) const
+{
+    mustBeValid();
+
+    size_t const index(findEntryIndex(entry_name, matchpath));
+    std::vector<char> result(m_entry_table->getRecord(index).m_uncompressed_size);
+    readEntryData(index, result.empty() ? nullptr : &result[0]);
+
+    return result;
+}
+
+
+/** \brief Retrieve the entries matching a pattern.
+ *
+ * This function searches the compact table of entries for the entries
+ * with a name matching \p pattern. The names are sorted in place, in
+ * the table, so the FileEntry objects are only created for the entries
+ * being returned.
+ *
+ * See FileCollection::glob() for the syntax of the pattern.
+ *
+ * \param[in] pattern  The pattern the names of the entries have to match.
+ *
+ * \return The matching entries sorted by name.
+ */
+FileEntry::vector_t ZipFile::glob(std::string const & pattern) const
+{
+    mustBeValid();
+
+    if(m_entries_loaded || m_entry_table == nullptr)
+    {
+        return FileCollection::glob(pattern);
+    }
+
+    SortedNames::index_vector_t indexes;
+    m_entry_table->glob(pattern, indexes);
+
+    FileEntry::vector_t result;
+    result.reserve(indexes.size());
+    for(auto const & idx : indexes)
+    {
+        result.push_back(getTableEntry(idx));
+    }
+    return result;
+}
+
+
+/** \brief Retrieve the entries found in a directory.
+ *
+ * This function searches the compact table of entries for the entries
+ * found in the \p prefix directory. Like glob(), only the FileEntry
+ * objects of the entries being returned get created.
+ *
+ * See FileCollection::listDirectory() for details.
+ *
+ * \param[in] prefix  The name of the directory to list.
+ * \param[in] recursive  Whether the entries of sub-directories are included.
+ *
+ * \return The entries of that directory sorted by name.
+ */
+FileEntry::vector_t ZipFile::listDirectory(std::string const & prefix, bool recursive) const
+{
+    mustBeValid();
+
+    if(m_entries_loaded || m_entry_table == nullptr)
+    {
+        return FileCollection::listDirectory(prefix, recursive);
+    }
+
+    SortedNames::index_vector_t indexes;
+    m_entry_table->listDirectory(prefix, recursive, indexes);
+
+    FileEntry::vector_t result;
+    result.reserve(indexes.size());
+    for(auto const & idx : indexes)
+    {
+        result.push_back(getTableEntry(idx));
+    }
+    return result;
+}
+
+
+/** \brief Load the checkpoints of an entry.
+ *
+ * This function loads checkpoints previously saved with
+ * saveCheckpoints() for the entry named \p entry_name. The streams
+ * returned by getInputStream() for that entry then use them to seek.
+ *
+ * The checkpoints are ignored if they were saved for a different entry
+ * (the CRC and the sizes of the entry are saved with the checkpoints)
+ * or if the data is not valid.
+ *
+ * \exception FileCollectionException
+ * The entry does not exist.
+ *
+ * \param[in] entry_name  The name of the entry.
+ * \param[in] is  The stream to read the checkpoints from.
+ *
+ * \return true if the checkpoints were loaded.
+ *
+ * \sa saveCheckpoints()
+ * \sa setCheckpointInterval()
+ */
+bool ZipFile::loadCheckpoints(std::string const & entry_name, std::istream & is)
+{
+    mustBeValid();
+
+    size_t const index(findEntryIndex(entry_name, MatchPath::MATCH));
+    ZipEntryTable::record_t const & record(m_entry_table->getRecord(index));
+    if(static_cast<StorageMethod>(record.m_compress_method) != StorageMethod::DEFLATED)
+    {
+        return false;
+    }
+
+    std::shared_ptr<InflateCheckpoints> checkpoints(InflateCheckpoints::load(is, record.m_crc_32, record.m_compressed_size, record.m_uncompressed_size));
+    if(checkpoints == nullptr)
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> guard(m_checkpoints_mutex);
+    m_checkpoints[index] = checkpoints;
+    m_use_checkpoints = true;
+    return true;
+}
+
+
+/** \brief Save the checkpoints of an entry.
+ *
+ * This function saves the checkpoints of the DEFLATED entry named
+ * \p entry_name to \p os. If the entry was not yet inflated up to its
+ * end, the function first does so to record all the checkpoints, which
+ * takes as long as reading the entry once.
+ *
+ * The saved checkpoints can be loaded back with loadCheckpoints(),
+ * even by another process.
+ *
+ * \exception FileCollectionException
+ * The entry does not exist, is not DEFLATED, or no checkpoint interval
+ * was defined.
+ *
+ * \exception IOException
+ * The entry cannot be inflated or \p os cannot be written to.
+ *
+ * \param[in] entry_name  The name of the entry.
+ * \param[in] os  The stream where the checkpoints get written.
+ *
+ * \sa loadCheckpoints()
+ * \sa setCheckpointInterval()
+ */
+void ZipFile::saveCheckpoints(std::string const & entry_name, std::ostream & os)
+{
+    mustBeValid();
+
+    size_t const index(findEntryIndex(entry_name, MatchPath::MATCH));
+    ZipEntryTable::record_t const & record(m_entry_table->getRecord(index));
+    if(static_cast<StorageMethod>(record.m_compress_method) != StorageMethod::DEFLATED)
+    {
+        throw FileCollectionException("Checkpoints are only available for DEFLATED entries.");
+    }
+
+    std::shared_ptr<InflateCheckpoints> checkpoints(getCheckpoints(index));
+    if(checkpoints == nullptr)
+    {
+        throw FileCollectionException("Define a checkpoint interval before saving checkpoints.");
+    }
+
+    if(!checkpoints->isComplete())
+    {
+        // inflate the rest of the entry, starting at the last checkpoint
+        //
+        stream_pointer_t is(getInputStream(entry_name));
+        InflateCheckpoints::checkpoint_t const * last(checkpoints->findCheckpoint(record.m_uncompressed_size));
+        if(last != nullptr)
+        {
+            is->seekg(last->m_out);
+        }
+        is->ignore(std::numeric_limits<std::streamsize>::max());
+        if(!checkpoints->isComplete())
+        {
+            throw IOException("The data of \"" + entry_name + "\" could not be inflated.");
+        }
+    }
+
+    checkpoints->save(os);
+}
+
+
+/** \brief Attach a cache of decompressed entries to this ZipFile.
+ *
+ * Once a budget is defined, the getInputStream() function decompresses
+ * the whole entry in the cache the first time it gets read and all the
+ * following calls for that entry return a stream reading the cached
+ * data, until the entry gets evicted. The cache holds at most
+ * \p budget bytes of decompressed data; entries larger than that are
+ * read as usual.
+ *
+ * Changing the budget of an existing cache keeps the cached entries
+ * that still fit. Setting the budget to zero removes the cache.
+ *
+ * The cache is shared with the copies of this ZipFile.
+ *
+ * \param[in] budget  The maximum number of bytes to cache, or zero.
+ *
+ * \sa getCacheStatistics()
+ */
+void ZipFile::setCacheBudget(size_t budget)
+{
+    if(budget == 0)
+    {
+        std::atomic_store(&m_cache, EntryCache::pointer_t());
+        return;
+    }
+
+    EntryCache::pointer_t cache(std::atomic_load(&m_cache));
+    if(cache != nullptr)
+    {
+        cache->setBudget(budget);
+    }
+    else
+    {
+        std::atomic_store(&m_cache, EntryCache::pointer_t(new EntryCache(budget)));
+    }
+}
+
+
+/** \brief Record checkpoints to seek in DEFLATED entries.
+ *
+ * By default, seeking backward in the stream of a DEFLATED entry
+ * restarts the inflation from the beginning of the entry, and seeking
+ * forward inflates all the data up to the new position.
+ *
+ * Once an interval is defined, the streams record a checkpoint every
+ * \p interval bytes of uncompressed data while they inflate. The
+ * checkpoints are shared by all the streams of an entry and a seek
+ * then costs at most \p interval bytes of inflation. Each checkpoint
+ * keeps 32Kb of data in memory so for large entries an interval of
+ * 1Mb or more is a good choice.
+ *
+ * Changing the interval only affects the entries which do not have
+ * checkpoints yet. Setting it back to zero stops the recording of
+ * checkpoints for new entries.
+ *
+ * \param[in] interval  The number of uncompressed bytes between
+ *                      checkpoints, or zero.
+ *
+ * \sa saveCheckpoints()
+ * \sa loadCheckpoints()
+ */
+void ZipFile::setCheckpointInterval(size_t interval)
+{
+    std::lock_guard<std::mutex> guard(m_checkpoints_mutex);
+    m_checkpoint_interval = interval;
+    if(interval > 0)
+    {
+        m_use_checkpoints = true;
+    }
+}
+
+
+/** \brief Verify the CRC-32 of the entries being read.
+ *
+ * By default, the data of the entries is returned as is. When the
+ * verification is turned on, the CRC-32 of the data is computed while
+ * it gets read and compared with the CRC-32 found in the Central
+ * Directory:
+ *
+ * \li readEntry() throws an IOException if the CRC differs;
+ * \li the streams returned by getInputStream() fail (the bad bit gets
+ *     set) when they reach the end of the entry and the CRC differs;
+ *     the streams of STORED entries of a memory mapped archive are
+ *     verified immediately and getInputStream() throws;
+ * \li entries are verified before being saved in the cache.
+ *
+ * A stream which skips data cannot compute the CRC and so does not
+ * verify it. This happens when seeking forward in a STORED entry or
+ * when a DEFLATED entry restarts from a checkpoint past the data
+ * already read.
+ *
+ * The CRC-32 is computed with the PCLMULQDQ instruction when available
+ * so the verification costs little compared to the decompression.
+ *
+ * \param[in] verify  Whether to verify the CRC-32 of the data.
+ */
+void ZipFile::setCrcVerification(bool verify)
+{
+    m_verify_crc = verify;
+}
+
+
+/** \brief Change the inflater used to decompress whole entries.
+ *
+ * The readEntry() function and the cache (see setCacheBudget())
+ * decompress whole DEFLATED entries at once. They do so with the
+ * inflater of the ZipFile which by default is the fastest inflater
+ * available, see Inflater::create().
+ *
+ * The input streams returned by getInputStream() do not use the
+ * inflater since they need to decompress the data in small chunks.
+ *
+ * The inflater is shared with the copies of this ZipFile.
+ *
+ * \param[in] inflater  The new inflater, or nullptr to go back to the
+ *                      default inflater.
+ */
+void ZipFile::setInflater(Inflater::pointer_t inflater)
+{
+    if(inflater == nullptr)
+    {
+        inflater = Inflater::create();
+    }
+    std::atomic_store(&m_inflater, inflater);
+}
+
+
+/** \brief Retrieve the number of entries in this ZipFile.
+ *
+ * This function returns the number of entries found in the Zip
+ * archive without creating the FileEntry objects.
+ *
+ * \return The number of entries in the ZipFile.
+ */
+size_t ZipFile::size() const
+{
+    mustBeValid();
+
+    if(m_entries_loaded || m_entry_table == nullptr)
+    {
+        return FileCollection::size();
+    }
+    return m_entry_table->size();
+}
+
+
+/** \brief Create the FileEntry objects of all the entries.
+ *
+ * This function creates a ZipCentralDirectoryEntry for each entry of
+ * the compact table and saves them in the collection. It only does so
+ * once.
+ *
+ * The entries are created under a lock and m_entries_loaded is only
+ * set once they are all available. That way, other threads either
+ * use the table or the complete list of entries.
+ */
+void ZipFile::loadEntries() const
+{
+    if(m_entries_loaded || m_entry_table == nullptr)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(m_entries_mutex);
+    if(!m_entries_loaded)
+    {
+        FileEntry::vector_t & entries(const_cast<ZipFile *>(this)->m_entries);
+        size_t const max_entry(m_entry_table->size());
+        entries.reserve(entries.size() + max_entry);
+        for(size_t idx(0); idx < max_entry; ++idx)
+        {
+            if(idx < m_table_entries.size()
+            && m_table_entries[idx] != nullptr)
+            {
+                entries.push_back(m_table_entries[idx]);
+            }
+            else
+            {
+                entries.push_back(m_entry_table->getEntry(idx));
+            }
+        }
+        m_table_entries.clear();
+
+        m_entries_loaded = true;
+    }
+}
+
+
+/** \brief Retrieve the FileEntry object of an entry of the table.
+ *
+ * This function creates the FileEntry object of the entry at \p index
+ * the first time it gets called and returns the same object afterward,
+ * so a name always maps to the same object. Once loadEntries() was
+ * called, the object is the one found in the collection.
+ *
+ * \param[in] index  The index of the entry in the table.
+ *
+ * \return The FileEntry object of that entry.
+ */
+FileEntry::pointer_t ZipFile::getTableEntry(size_t index) const
+{
+    std::lock_guard<std::mutex> guard(m_entries_mutex);
+    if(m_entries_loaded)
+    {
+        // loadEntries() moved the objects to the collection, which
+        // was empty before, so the indexes did not change
+        return m_entries[index];
+    }
+
+    if(m_table_entries.empty())
+    {
+        m_table_entries.resize(m_entry_table->size());
+    }
+    FileEntry::pointer_t & entry(m_table_entries[index]);
+    if(entry == nullptr)
+    {
+        entry = m_entry_table->getEntry(index);
+    }
+    return entry;
+}
+
+
+/** \brief Copy the FileEntry objects created from the table.
+ *
+ * The copies of a ZipFile get their own copy of the FileEntry objects,
+ * like the entries of a FileCollection, including those created by
+ * getTableEntry().
+ *
+ * \return A vector with a clone of each entry created so far.
+ */
+FileEntry::vector_t ZipFile::cloneTableEntries() const
+{
+    std::lock_guard<std::mutex> guard(m_entries_mutex);
+    FileEntry::vector_t result(m_table_entries.size());
+    for(size_t idx(0); idx < m_table_entries.size(); ++idx)
+    {
+        if(m_table_entries[idx] != nullptr)
+        {
+            result[idx] = m_table_entries[idx]->clone();
+        }
+    }
+    return result;
+}
+
+
+/** \brief Search the table of entries for a name.
+ *
+ * \exception FileCollectionException
+ * No entry named \p entry_name exists in this ZipFile.
+ *
+ * \param[in] entry_name  The name of the entry to search.
+ * \param[in] matchpath  Whether the full path or just the filename is matched.
+ *
+ * \return The index of the entry in the table of entries.
+ */
+size_t ZipFile::findEntryIndex(std::string const & entry_name, MatchPath matchpath) const
+{
+    size_t index(0);
+    if(m_entry_table == nullptr
+    || !m_entry_table->find(entry_name, matchpath, index))
+    {
+        throw FileCollectionException("No entry named \"" + entry_name + "\" in this Zip archive.");
+    }
+    return index;
+}
+
+
+/** \brief Read bytes from the archive file.
+ *
+ * This function copies \p size bytes found at \p position in the
+ * archive file to \p buffer. The file is accessed through the memory
+ * mapping or the positional file, depending on the access mode.
+ *
+ * \param[in] position  The offset of the first byte to read.
+ * \param[out] buffer  The buffer receiving the data.
+ * \param[in] size  The number of bytes to read.
+ *
+ * \return The number of bytes read, less than \p size at the end of
+ *         the file.
+ */
+size_t ZipFile::readArchive(offset_t position, char * buffer, size_t size) const
+{
+    if(m_mapped_file != nullptr)
+    {
+        if(position < 0
+        || static_cast<size_t>(position) >= m_mapped_file->size())
+        {
+            return 0;
+        }
+        size = std::min(size, m_mapped_file->size() - static_cast<size_t>(position));
+        memcpy(buffer, m_mapped_file->data() + position, size);
+        return size;
+    }
+
+    return m_positional_file->read(position, buffer, size);
+}
+
+
+/** \brief Check whether an entry can be saved without recompression.
+ *
+ * This function returns true when \p entry is one of the entries of
+ * this ZipFile and its method and level were not changed, in which
+ * case saveCollectionToArchive() copies its compressed data as is.
+ *
+ * A Zip archive does not record the compression level, so the entries
+ * of a ZipFile have the default level. Any other level means the entry
+ * has to be compressed again (or stored when the level is
+ * FileEntry::COMPRESSION_LEVEL_NONE). The level of STORED entries does
+ * not matter.
+ *
+ * \param[in] entry  The entry to check.
+ *
+ * \return true if the raw data of the entry can be copied.
+ */
+bool ZipFile::isRawCopyPossible(FileEntry const & entry) const
+{
+    size_t index(0);
+    if(m_entry_table == nullptr
+    || !m_entry_table->find(entry.getName(), MatchPath::MATCH, index))
+    {
+        return false;
+    }
+
+    // the entry may have been replaced with addEntry()
+    //
+    ZipEntryTable::record_t const & record(m_entry_table->getRecord(index));
+    if(entry.getCompressedSize() != record.m_compressed_size
+    || entry.getSize() != record.m_uncompressed_size
+    || entry.getCrc() != record.m_crc_32
+    || entry.getMethod() != static_cast<StorageMethod>(record.m_compress_method))
+    {
+        return false;
+    }
+
+    return entry.getMethod() == StorageMethod::STORED
+        || entry.getLevel() == FileEntry::COMPRESSION_LEVEL_DEFAULT;
+}
+
+
+/** \brief Find the data of an entry.
+ *
+ * This function reads the local header of the entry at \p index and
+ * returns the offset of its data in the archive file. When the ZipFile
+ * uses ValidationLevel::LAZY, the local header gets verified the first
+ * time, as getInputStream() does.
+ *
+ * \exception FileCollectionException
+ * The local header is invalid, does not match the Central Directory,
+ * or the data goes past the end of the archive.
+ *
+ * \param[in] index  The index of the entry in the table of entries.
+ *
+ * \return The offset of the first byte of data of the entry.
+ */
+offset_t ZipFile::getEntryDataOffset(size_t index) const
+{
+    ZipEntryTable::record_t const & record(m_entry_table->getRecord(index));
+    offset_t const entry_offset(record.m_entry_offset + m_vs.startOffset());
+    offset_t const archive_end((m_mapped_file != nullptr
+                                    ? static_cast<offset_t>(m_mapped_file->size())
+                                    : m_positional_file->size()) - m_vs.endOffset());
+
+    unsigned char header[g_local_header_size];
+    if(entry_offset + g_local_header_size > archive_end
+    || readArchive(entry_offset, reinterpret_cast<char *>(header), sizeof(header)) != sizeof(header)
+    || get_uint32(header) != g_local_header_signature)
+    {
+        throw FileCollectionException("Zip file consistency problem. Local header of an entry not found.");
+    }
+
+    // the filename and extra field lengths are the last two fields
+    //
+    offset_t const header_size(g_local_header_size + get_uint16(header + 26) + get_uint16(header + 28));
+    offset_t const data_offset(entry_offset + header_size);
+    if(data_offset + static_cast<offset_t>(record.m_compressed_size) > archive_end)
+    {
+        throw FileCollectionException("Zip file consistency problem. The data of an entry goes past the end of the archive.");
+    }
+
+    if(m_validation_level == ValidationLevel::LAZY
+    && !(*m_verified_entries)[index])
+    {
+        std::vector<char> local_header(header_size);
+        if(readArchive(entry_offset, &local_header[0], header_size) != static_cast<size_t>(header_size))
+        {
+            throw FileCollectionException("Zip file consistency problem. Local header of an entry not found.");
+        }
+        MemoryInputStreambuf buf(&local_header[0], header_size);
+        std::istream is(&buf);
+        is.exceptions(std::ios::eofbit | std::ios::failbit | std::ios::badbit);
+        ZipLocalEntry local_entry;
+        local_entry.read(is);
+        if(!local_entry.isEqual(*m_entry_table->getEntry(index)))
+        {
+            throw FileCollectionException("Zip file consistency problem. Zip file data fields are inconsistent with zip file layout.");
+        }
+        (*m_verified_entries)[index] = true;
+    }
+
+    return data_offset;
+}
+
+
+/** \brief Read the whole data of an entry.
+ *
+ * This function saves the uncompressed data of the entry at \p index
+ * in \p buffer, which must be at least as large as the uncompressed
+ * size of the entry.
+ *
+ * When the CRC-32 verification is turned on, the CRC of the data is
+ * compared with the CRC found in the Central Directory.
+ *
+ * \exception FileCollectionException
+ * The entry is invalid or uses an unsupported compression method.
+ *
+ * \exception IOException
+ * The data cannot be read or its CRC-32 does not match.
+ *
+ * \param[in] index  The index of the entry in the table of entries.
+ * \param[out] buffer  The buffer receiving the data.
+ */
+void ZipFile::readEntryData(size_t index, char * buffer) const
+{
+    ZipEntryTable::record_t const & record(m_entry_table->getRecord(index));
+    offset_t const data_offset(getEntryDataOffset(index));
+
+    switch(static_cast<StorageMethod>(record.m_compress_method))
+    {
+    case StorageMethod::STORED:
+        if(record.m_compressed_size != record.m_uncompressed_size)
+        {
+            throw FileCollectionException("Zip file consistency problem. The sizes of a stored entry differ.");
+        }
+        if(record.m_uncompressed_size > 0
+        && readArchive(data_offset, buffer, record.m_uncompressed_size) != record.m_uncompressed_size)
+        {
+            throw IOException("Error reading the data of a Zip archive entry."); // LCOV_EXCL_LINE
+        }
+        break;
+
+    default:
+        decompressEntryData(index, data_offset, buffer);
+        break;
+
+    }
+
+    if(m_verify_crc
+    && updateCrc32(0, buffer, record.m_uncompressed_size) != record.m_crc_32)
+    {
+        throw IOException("ZipFile::readEntry(): the CRC-32 of the data does not match the CRC-32 of the entry.");
+    }
+}
+
+
+/** \brief Decompress the whole data of an entry.
+ *
+ * This function decompresses the data of a compressed entry directly
+ * in \p buffer. DEFLATED entries are decompressed using the inflater
+ * of this ZipFile and the other entries using the Codec of their
+ * method.
+ *
+ * With a memory mapped archive, the compressed data is used in place.
+ * Otherwise it is first read in memory with a single read.
+ *
+ * \exception FileCollectionException
+ * The compression method of the entry is not supported.
+ *
+ * \exception IOException
+ * The compressed data is invalid or its size does not match the
+ * sizes found in the Central Directory.
+ *
+ * \param[in] index  The index of the entry in the table of entries.
+ * \param[in] data_offset  The offset of the compressed data.
+ * \param[out] buffer  The buffer receiving the data.
+ */
+void ZipFile::decompressEntryData(size_t index, offset_t data_offset, char * buffer) const
+{
+    ZipEntryTable::record_t const & record(m_entry_table->getRecord(index));
+    StorageMethod const method(static_cast<StorageMethod>(record.m_compress_method));
+
+    // throws if the method is not supported
+    Codec::pointer_t codec(method == StorageMethod::DEFLATED ? Codec::pointer_t() : Codec::create(method));
+
+    // verify the size before allocating a buffer, the Central Directory
+    // could be lying
+    //
+    uint64_t const archive_size(m_mapped_file != nullptr
+                                    ? static_cast<uint64_t>(m_mapped_file->size())
+                                    : static_cast<uint64_t>(m_positional_file->size()));
+    if(data_offset < 0
+    || static_cast<uint64_t>(data_offset) > archive_size
+    || record.m_compressed_size > archive_size - data_offset)
+    {
+        throw IOException("ZipFile::readEntry(): the compressed data of the entry is not in the Zip archive.");
+    }
+
+    std::vector<char> compressed;
+    char const * input(nullptr);
+    if(m_mapped_file != nullptr)
+    {
+        input = m_mapped_file->data() + data_offset;
+    }
+    else if(record.m_compressed_size > 0)
+    {
+        compressed.resize(record.m_compressed_size);
+        if(readArchive(data_offset, &compressed[0], compressed.size()) != compressed.size())
+        {
+            throw IOException("Error reading the data of a Zip archive entry."); // LCOV_EXCL_LINE
+        }
+        input = &compressed[0];
+    }
+
+    if(codec != nullptr)
+    {
+        codec->decompressAll(input, record.m_compressed_size, buffer, record.m_uncompressed_size);
+    }
+    else
+    {
+        std::atomic_load(&m_inflater)->inflate(input, record.m_compressed_size, buffer, record.m_uncompressed_size);
+    }
+}
+
+
+/** \brief Retrieve the checkpoints of an entry.
+ *
+ * This function returns the checkpoints of the entry at \p index. If
+ * the entry has no checkpoints yet and a checkpoint interval was
+ * defined, an empty set of checkpoints gets created.
+ *
+ * \param[in] index  The index of the entry in the table of entries.
+ *
+ * \return The checkpoints or a null pointer.
+ */
+std::shared_ptr<InflateCheckpoints> ZipFile::getCheckpoints(size_t index)
+{
+    std::lock_guard<std::mutex> guard(m_checkpoints_mutex);
+    auto it(m_checkpoints.find(index));
+    if(it != m_checkpoints.end())
+    {
+        return it->second;
+    }
+    if(m_checkpoint_interval == 0)
+    {
+        return std::shared_ptr<InflateCheckpoints>();
+    }
+
+    ZipEntryTable::record_t const & record(m_entry_table->getRecord(index));
+    std::shared_ptr<InflateCheckpoints> checkpoints(new InflateCheckpoints(m_checkpoint_interval, record.m_crc_32, record.m_compressed_size, record.m_uncompressed_size));
+    m_checkpoints[index] = checkpoints;
+    return checkpoints;
+}
+
+
+/** \brief Create a Zip archive from the specified FileCollection.
+ *
+ * This function is expected to be used with a DirectoryCollection
+ * that you created to save the collection in an archive.
+ *
+ * With WriteMode::SEEK_BACK, the local header of each entry gets
+ * written again once its CRC and sizes are known, which requires
+ * \p os to be seekable. With WriteMode::DATA_DESCRIPTOR, the output
+ * never seeks and each entry is followed by a data descriptor, so the
+ * archive can be written to a pipe, a socket, or std::cout. The
+ * archive must then be the only thing written to \p os. The default,
+ * WriteMode::AUTO, uses data descriptors only when \p os cannot tell
+ * its position.
+ *
+ * When \p collection is a ZipFile, the entries which method and level
+ * were not changed get copied without being decompressed and
+ * compressed again (see getRawInputStream()). This makes merging and
+ * filtering archives much faster. The data of those entries is copied
+ * as is, so it does not get verified even when CRC verification is
+ * turned on.
+ *
+ * When \p thread_count is more than one, that many threads compress
+ * the following entries in memory while the calling thread writes the
+ * entries to \p os in order. Use zero to get one thread per core. The
+ * compressed entries waiting to be written use at most \p memory_budget
+ * bytes; an entry which does not fit in that budget at all gets
+ * compressed by the calling thread directly in \p os. Each entry gets
+ * compressed exactly as with one thread so the archive is the same
+ * byte for byte whatever the number of threads. The \p collection must
+ * support concurrent calls to getInputStream(), which is the case of
+ * the collections offered by Zipios.
+ *
+ * When \p deflate_thread_count is more than one, the data of each
+ * DEFLATED entry larger than a block also gets compressed in blocks by
+ * that many threads (see ZipOutputStream::setThreadCount()), which
+ * speeds up saving very large entries. This is off by default because
+ * the compressed data is then slightly larger and not the same as the
+ * one saved with a single thread. It is the same whatever the number
+ * of threads once there are more than one, though.
+ *
+ * \param[in,out] os  The output stream where the Zip archive is saed.
+ * \param[in] collection  The collection to save in this output stream.
+ * \param[in] zip_comment  The global comment of the Zip archive.
+ * \param[in] write_mode  How the CRC and sizes of the entries are saved.
+ * \param[in] thread_count  The number of threads compressing entries, or
+ *                          zero for one per core.
+ * \param[in] memory_budget  The maximum number of bytes used by entries
+ *                           compressed in advance.
+ * \param[in] deflate_thread_count  The number of threads compressing the
+ *                                  blocks of each DEFLATED entry.
+ */
+void ZipFile::saveCollectionToArchive(std::ostream & os, FileCollection & collection, std::string const & zip_comment, WriteMode write_mode, size_t thread_count, size_t memory_budget, size_t deflate_thread_count)
+{
+    try
+    {
+        bool const streaming(write_mode == WriteMode::DATA_DESCRIPTOR
+                         || (write_mode == WriteMode::AUTO && os.tellp() < 0));
+
+        ZipOutputStream output_stream(os);
+
+        output_stream.setComment(zip_comment);
+        output_stream.setStreaming(streaming);
+        output_stream.setThreadCount(deflate_thread_count);
+
+        ZipFile * zip_file(dynamic_cast<ZipFile *>(&collection));
+
+        FileEntry::vector_t entries(collection.entries());
+
+        // decide how each entry gets saved before the threads start
+        // modifying the entries they compress; these entries must be
+        // the objects saved in the Central Directory
+        //
+        if(thread_count == 0)
+        {
+            thread_count = std::max(1U, std::thread::hardware_concurrency());
+        }
+        std::vector<bool> raw_copy(entries.size());
+        FileEntry::vector_t jobs(entries.size());
+        bool has_jobs(false);
+        for(size_t idx(0); idx < entries.size(); ++idx)
+        {
+            FileEntry::pointer_t & entry(entries[idx]);
+            if(entry->isDirectory())
+            {
+                continue;
+            }
+            if(zip_file != nullptr
+            && zip_file->isRawCopyPossible(*entry))
+            {
+                raw_copy[idx] = true;
+            }
+            else if(thread_count > 1
+                 && ParallelCompressor::getMemoryBound(*entry) <= memory_budget)
+            {
+                if(dynamic_cast<ZipCentralDirectoryEntry *>(entry.get()) == nullptr)
+                {
+                    entry.reset(new ZipCentralDirectoryEntry(*entry));
+                }
+                jobs[idx] = entry;
+                has_jobs = true;
+            }
+        }
+        std::unique_ptr<ParallelCompressor> compressor;
+        if(has_jobs)
+        {
+            compressor.reset(new ParallelCompressor(collection, jobs, thread_count, streaming, deflate_thread_count, memory_budget));
+        }
+
+        for(size_t idx(0); idx < entries.size(); ++idx)
+        {
+            FileEntry::pointer_t const & entry(entries[idx]);
+            if(raw_copy[idx])
+            {
+                FileCollection::stream_pointer_t is(zip_file->getRawInputStream(entry->getName()));
+                output_stream.putRawEntry(entry, *is);
+            }
+            else if(jobs[idx] != nullptr)
+            {
+                // the local header must use Zip64 when the one written
+                // by putNextEntry() would
+                //
+                char const * data(compressor->getCompressedData(idx));
+                MemoryInputStreambuf buf(data, entry->getCompressedSize());
+                std::istream is(&buf);
+                output_stream.putRawEntry(entry, is, static_cast<ZipLocalEntry *>(entry.get())->isZip64());
+                compressor->release(idx);
+            }
+            else
             {
-                FileCollection::stream_pointer_t is(collection.getInputStream((*it)->getName()));
-                if(is)
+                // get an InputStream if available (i.e. directories do not have an input stream)
+                FileCollection::stream_pointer_t is;
+                if(!entry->isDirectory())
                 {
-                    output_stream << is->rdbuf();
+                    is = collection.getInputStream(entry->getName());
                 }
+                output_stream.putEntry(entry, is.get());
             }
         }
 
@@ -29,8 +29,6 @@
 
 #include "zipinputstream.hpp"
 
-#include <fstream>
-
 
 namespace zipios
 {
@@ -50,19 +48,48 @@ namespace zipios
  */
 
 
-/** \brief Initialize a ZipInputStream from a filename and position.
+/** \brief Initialize a ZipInputStream from a file and a range.
+ *
+ * This constructor creates a ZIP file stream reading the entry which
+ * local header starts at \p pos. The data is read with positional
+ * reads so the file can be shared with any number of other streams.
+ * The stream never reads at or after \p end_pos.
+ *
+ * \param[in] file  The Zip archive.
+ * \param[in] pos  Position of the local header of the entry to read.
+ * \param[in] end_pos  Position at which the data of the entry ends at the latest.
+ * \param[in] pool  The pool of zlib states and buffers, may be null.
+ * \param[in] central_entry  The Central Directory entry, needed when the
+ *                           entry has a trailing data descriptor.
+ */
+ZipInputStream::ZipInputStream(PositionalFile::pointer_t file, std::streampos pos, offset_t end_pos, InflatePool::pointer_t pool, FileEntry const * central_entry)
+    : std::istream(nullptr)
+    , m_pbuf(new PositionalInputStreambuf(file, pos, end_pos, pool))
+    , m_izf(new ZipInputStreambuf(m_pbuf.get(), pos, pool, central_entry))
+{
+    // properly initialize the stream with the newly allocated buffer
+    init(m_izf.get());
+}
+
+
+/** \brief Initialize a ZipInputStream from a memory mapped file.
  *
- * This constructor creates a ZIP file stream by attaching itself to
- * a file as defined by the specified filename and a position to the
- * header of the file being read.
+ * This constructor creates a ZIP file stream reading its data directly
+ * from the memory mapped Zip archive. The stream keeps a reference to
+ * the mapping so it remains valid even if the ZipFile gets destroyed
+ * first.
  *
- * \param[in] filename  The name of a valid zip file.
- * \param[in] pos position to reposition the istream to before reading.
+ * \param[in] mapped_file  The memory mapped Zip archive.
+ * \param[in] pos  Position of the local header of the entry to read.
+ * \param[in] pool  The pool of zlib states and buffers, may be null.
+ * \param[in] central_entry  The Central Directory entry, needed when the
+ *                           entry has a trailing data descriptor.
  */
-ZipInputStream::ZipInputStream(std::string const& filename, std::streampos pos)
+ZipInputStream::ZipInputStream(MemoryMappedFile::pointer_t mapped_file, std::streampos pos, InflatePool::pointer_t pool, FileEntry const * central_entry)
     : std::istream(nullptr)
-    , m_ifs(new std::ifstream(filename, std::ios::in | std::ios::binary))
-    , m_izf(new ZipInputStreambuf(m_ifs->rdbuf(), pos))
+    , m_mapped_file(mapped_file)
+    , m_mbuf(new MemoryInputStreambuf(m_mapped_file->data(), m_mapped_file->size()))
+    , m_izf(new ZipInputStreambuf(m_mbuf.get(), pos, pool, central_entry))
 {
     // properly initialize the stream with the newly allocated buffer
     init(m_izf.get());
@@ -79,6 +106,44 @@ ZipInputStream::~ZipInputStream()
 }
 
 
+/** \brief Retrieve the local header of the entry being read.
+ *
+ * This function returns the local header as read from the Zip archive
+ * when this stream was created.
+ *
+ * \return A reference to the local entry.
+ */
+ZipLocalEntry const & ZipInputStream::getLocalEntry() const
+{
+    return m_izf->getLocalEntry();
+}
+
+
+/** \brief Attach checkpoints to the data of this entry.
+ *
+ * The checkpoints make seeking in a DEFLATED entry faster. They are
+ * ignored by the other storage methods.
+ *
+ * \param[in] checkpoints  The checkpoints of this entry.
+ */
+void ZipInputStream::setCheckpoints(InflateCheckpoints::pointer_t checkpoints)
+{
+    m_izf->setCheckpoints(checkpoints);
+}
+
+
+/** \brief Verify the CRC-32 of the data of this entry.
+ *
+ * See ZipInputStreambuf::setCrcVerification() for details.
+ *
+ * \param[in] crc_32  The expected CRC-32 of the data.
+ */
+void ZipInputStream::setCrcVerification(uint32_t crc_32)
+{
+    m_izf->setCrcVerification(crc_32);
+}
+
+
 } // zipios namespace
 
 // Local Variables:
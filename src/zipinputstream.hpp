@@ -32,6 +32,9 @@
  * have been compressed using the zlib library.
  */
 
+#include "memoryinputstreambuf.hpp"
+#include "memorymappedfile.hpp"
+#include "positionalinputstreambuf.hpp"
 #include "zipinputstreambuf.hpp"
 
 
@@ -43,14 +46,21 @@ namespace zipios
 class ZipInputStream : public std::istream
 {
 public:
-                    ZipInputStream(std::string const& filename, std::streampos pos = 0);
+                    ZipInputStream(PositionalFile::pointer_t file, std::streampos pos, offset_t end_pos, InflatePool::pointer_t pool = InflatePool::pointer_t(), FileEntry const * central_entry = nullptr);
+                    ZipInputStream(MemoryMappedFile::pointer_t mapped_file, std::streampos pos = 0, InflatePool::pointer_t pool = InflatePool::pointer_t(), FileEntry const * central_entry = nullptr);
                     ZipInputStream(ZipInputStream const& src) = delete;
                     ZipInputStream const& operator = (ZipInputStream const& src) = delete;
     virtual         ~ZipInputStream() override;
 
+    ZipLocalEntry const &   getLocalEntry() const;
+    void                    setCheckpoints(InflateCheckpoints::pointer_t checkpoints);
+    void                    setCrcVerification(uint32_t crc_32);
+
 private:
-    std::unique_ptr<std::ifstream>      m_ifs;
-    std::unique_ptr<ZipInputStreambuf>  m_izf;
+    MemoryMappedFile::pointer_t             m_mapped_file;
+    std::unique_ptr<MemoryInputStreambuf>   m_mbuf;
+    std::unique_ptr<PositionalInputStreambuf> m_pbuf;
+    std::unique_ptr<ZipInputStreambuf>      m_izf;
 };
 
 
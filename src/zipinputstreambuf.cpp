@@ -29,6 +29,11 @@
 
 #include "zipios/zipiosexceptions.hpp"
 
+#include "crc32.hpp"
+#include "memoryinputstreambuf.hpp"
+
+#include <cstring>
+
 
 namespace zipios
 {
@@ -40,6 +45,29 @@ namespace zipios
  * The ZipInputStreambuf class is a Zip input streambuf filter that
  * automatically decompresses input data that was compressed using
  * the zlib library.
+ *
+ * When reading from a MemoryInputStreambuf, the data of STORED entries
+ * is returned directly from memory without any copy.
+ *
+ * The data of STORED entries supports seeking in constant time. The
+ * position is relative to the start of the data of the entry and
+ * the stream cannot seek or read outside of that data. The data of
+ * DEFLATED entries supports seeking too, see InflateInputStreambuf
+ * for details.
+ *
+ * The entries compressed with the other methods supported by a Codec,
+ * such as LZMA and Zstandard, are decompressed by that codec. Seeking
+ * forward in such an entry decompresses and drops the data up to the
+ * new position and seeking backward restarts the decompression from
+ * the beginning of the data.
+ *
+ * When setCrcVerification() was called, the CRC-32 of the data gets
+ * computed while it is being read and compared with the expected CRC
+ * once the end of the entry is reached.
+ *
+ * The local header of an entry with a trailing data descriptor does
+ * not include the CRC and sizes. These entries can only be read when
+ * the Central Directory entry is given to the constructor.
  */
 
 
@@ -51,11 +79,23 @@ namespace zipios
  * \param[in,out] inbuf  The streambuf to use for input.
  * \param[in] start_pos  A position to reset the inbuf to before reading.
  *                       Specify -1 to read from the current position.
+ * \param[in] pool  The pool of zlib states and buffers, may be null.
+ * \param[in] central_entry  The Central Directory entry of the entry being
+ *                           read, used when the local header has a trailing
+ *                           data descriptor. May be null.
  */
-ZipInputStreambuf::ZipInputStreambuf(std::streambuf *inbuf, offset_t start_pos)
-    : InflateInputStreambuf(inbuf, start_pos)
+ZipInputStreambuf::ZipInputStreambuf(std::streambuf *inbuf, offset_t start_pos, InflatePool::pointer_t pool, FileEntry const * central_entry)
+    : InflateInputStreambuf(inbuf, start_pos, pool)
     //, m_current_entry() -- auto-init
     //, m_remain(0) -- auto-init
+    //, m_verify_crc(false) -- auto-init
+    //, m_expected_crc(0) -- auto-init
+    //, m_crc(0) -- auto-init
+    //, m_crc_position(0) -- auto-init
+    //, m_codec() -- auto-init
+    //, m_codec_input(nullptr) -- auto-init
+    //, m_codec_input_size(0) -- auto-init
+    //, m_codec_end(false) -- auto-init
 {
     // read the zip local header
     std::istream is(m_inbuf); // istream does not destroy the streambuf.
@@ -65,26 +105,54 @@ ZipInputStreambuf::ZipInputStreambuf(std::streambuf *inbuf, offset_t start_pos)
     m_current_entry.read(is);
     if(m_current_entry.isValid() && m_current_entry.hasTrailingDataDescriptor())
     {
-        throw FileCollectionException("Trailing data descriptor in zip file not supported");
+        if(central_entry == nullptr)
+        {
+            throw FileCollectionException("Trailing data descriptor in zip file not supported");
+        }
+
+        // the CRC and sizes in the local header are zero, use the ones
+        // of the Central Directory instead
+        //
+        m_current_entry.setSize(central_entry->getSize());
+        m_current_entry.setCompressedSize(central_entry->getCompressedSize());
+        m_current_entry.setCrc(central_entry->getCrc());
     }
 
     switch(m_current_entry.getMethod())
     {
     case StorageMethod::DEFLATED:
         reset() ; // reset inflatestream data structures
+        m_uncompressed_size = m_current_entry.getSize();
 //std::cerr << "deflated" << std::endl;
         break;
 
     case StorageMethod::STORED:
+        if(m_memory_inbuf != nullptr)
+        {
+            // the data is in memory, use it as is (zero copy)
+            size_t const size(std::min(static_cast<size_t>(m_current_entry.getSize()), m_memory_inbuf->remaining()));
+            char * const start(const_cast<char *>(m_memory_inbuf->current()));
+            setg(start, start, start + size);
+            m_memory_inbuf->pubseekoff(size, std::ios::cur);
+            m_uncompressed_size = size;
+            break;
+        }
         m_remain = m_current_entry.getSize();
+        m_uncompressed_size = m_remain;
+        m_data_start = m_inbuf->pubseekoff(0, std::ios::cur, std::ios::in);
         // Force underflow on first read:
-        setg(&m_outvec[0], &m_outvec[0] + getBufferSize(), &m_outvec[0] + getBufferSize());
+        setg(&m_outvec[0], &m_outvec[0], &m_outvec[0]);
 //std::cerr << "stored" << std::endl;
         break;
 
     default:
-        // file not supported... sorry!
-        throw FileCollectionException("Unsupported compression format");
+        // throws if the method is not supported... sorry!
+        m_codec = Codec::create(m_current_entry.getMethod());
+        m_uncompressed_size = m_current_entry.getSize();
+        m_data_start = m_inbuf->pubseekoff(0, std::ios::cur, std::ios::in);
+        m_codec->startDecompression(m_uncompressed_size);
+        setg(&m_outvec[0], &m_outvec[0], &m_outvec[0]);
+        break;
 
     }
 }
@@ -110,12 +178,116 @@ ZipInputStreambuf::~ZipInputStreambuf()
 }
 
 
+/** \brief Retrieve the local header of the entry being read.
+ *
+ * This function returns the local header which the constructor read
+ * from the input streambuf. The ZipFile uses it to verify the entry
+ * when opened with ZipFile::ValidationLevel::LAZY.
+ *
+ * \return A reference to the local entry.
+ */
+ZipLocalEntry const & ZipInputStreambuf::getLocalEntry() const
+{
+    return m_current_entry;
+}
+
+
+/** \brief Verify the CRC-32 of the data of the entry.
+ *
+ * This function turns on the verification of the CRC-32 of the data.
+ * The CRC gets computed as the data is read. Once the last byte of the
+ * entry was read, the CRC is compared with \p crc_32 and the stream
+ * fails if they differ.
+ *
+ * The CRC can only be verified if all the data gets read. Seeking
+ * backward is fine, but once the stream skips data (seeking forward in
+ * a STORED entry or restarting from a checkpoint) the CRC is not
+ * verified anymore.
+ *
+ * When the data of a STORED entry is in memory, the CRC is verified
+ * immediately.
+ *
+ * \exception IOException
+ * The data of a STORED entry in memory does not match \p crc_32.
+ *
+ * \param[in] crc_32  The expected CRC-32 of the data, as found in the
+ *                    Central Directory.
+ */
+void ZipInputStreambuf::setCrcVerification(uint32_t crc_32)
+{
+    m_verify_crc = true;
+    m_expected_crc = crc_32;
+    m_crc = 0;
+    m_crc_position = 0;
+
+    if(m_current_entry.getMethod() == StorageMethod::STORED
+    && m_memory_inbuf != nullptr)
+    {
+        // the get area is the whole entry
+        //
+        updateCrc(0, eback(), egptr() - eback());
+    }
+}
+
+
+/** \brief Add data to the CRC-32 of the entry.
+ *
+ * This function adds the part of \p data which was not yet included
+ * in the CRC. When the whole entry was included, the CRC gets compared
+ * with the expected CRC.
+ *
+ * \exception IOException
+ * The CRC of the data does not match the expected CRC.
+ *
+ * \param[in] position  The position of \p data in the entry.
+ * \param[in] data  The data which was just read.
+ * \param[in] size  The number of bytes in \p data.
+ */
+void ZipInputStreambuf::updateCrc(offset_t position, char const * data, size_t size)
+{
+    if(!m_verify_crc
+    || m_crc_position < 0)
+    {
+        return;
+    }
+
+    if(position > m_crc_position)
+    {
+        // some data was skipped, the CRC cannot be computed anymore
+        //
+        m_crc_position = -1;
+        return;
+    }
+
+    offset_t const end(position + static_cast<offset_t>(size));
+    if(end <= m_crc_position)
+    {
+        // that data was already included
+        //
+        return;
+    }
+
+    m_crc = updateCrc32(m_crc, data + (m_crc_position - position), end - m_crc_position);
+    m_crc_position = end;
+
+    if(m_crc_position == m_uncompressed_size
+    && m_crc != m_expected_crc)
+    {
+        m_verify_crc = false;
+        throw IOException("ZipInputStreambuf: the CRC-32 of the data does not match the CRC-32 of the entry.");
+    }
+}
+
+
 /** \brief Called when more data is required.
  *
  * The function ensures that at least one byte is available
  * in the input area by updating the pointers to the input area
  * and reading more data in from the input sequence if required.
  *
+ * \exception IOException
+ * The CRC-32 is being verified and it does not match.
+ *
  * \return The value of that character on success or
  *         std::streambuf::traits_type::eof() on failure.
  */
@@ -124,8 +296,20 @@ std::streambuf::int_type ZipInputStreambuf::underflow()
     switch(m_current_entry.getMethod())
     {
     case StorageMethod::DEFLATED:
+    {
+        // an empty entry saved in seek back mode has no deflate data
+        // at all, not even the final empty block
+        //
+        if(m_current_entry.getCompressedSize() == 0)
+        {
+            return traits_type::eof();
+        }
+
         // inflate class takes care of it in this case
-        return InflateInputStreambuf::underflow();
+        std::streambuf::int_type const c(InflateInputStreambuf::underflow());
+        updateCrc(m_out_position - (egptr() - eback()), eback(), egptr() - eback());
+        return c;
+    }
 
     case StorageMethod::STORED:
     {
@@ -137,6 +321,7 @@ std::streambuf::int_type ZipInputStreambuf::underflow()
         if(g > 0)
         {
             // we got some data, return it
+            updateCrc(m_uncompressed_size - m_remain - g, &m_outvec[0], g);
             return traits_type::to_int_type(*gptr());
         }
 
@@ -145,6 +330,11 @@ std::streambuf::int_type ZipInputStreambuf::underflow()
     }
 
     default:
+        if(m_codec != nullptr)
+        {
+            return decompress();
+        }
+
         // This should NEVER be reached or the constructor let something
         // go through that should not have gone through
         throw std::logic_error("ZipInputStreambuf::underflow(): unknown storage method"); // LCOV_EXCL_LINE
@@ -153,6 +343,261 @@ std::streambuf::int_type ZipInputStreambuf::underflow()
 }
 
 
+/** \brief Decompress more data with the codec of the entry.
+ *
+ * This function fills the output buffer with the data decompressed
+ * by the codec. The codec reads the compressed data directly from
+ * memory when available.
+ *
+ * The function never returns more data than the uncompressed size of
+ * the entry.
+ *
+ * \exception IOException
+ * The compressed data is invalid or truncated, or the CRC-32 is being
+ * verified and it does not match.
+ *
+ * \return The value of the next character or
+ *         std::streambuf::traits_type::eof() at the end of the entry.
+ */
+std::streambuf::int_type ZipInputStreambuf::decompress()
+{
+    char * output(&m_outvec[0]);
+    size_t output_size(std::min(static_cast<offset_t>(getBufferSize()), m_uncompressed_size - m_out_position));
+    while(output_size > 0 && !m_codec_end)
+    {
+        if(m_codec_input_size == 0)
+        {
+            if(m_memory_inbuf != nullptr)
+            {
+                m_codec_input = m_memory_inbuf->current();
+                m_codec_input_size = m_memory_inbuf->remaining();
+                m_memory_inbuf->pubseekoff(m_codec_input_size, std::ios::cur);
+            }
+            else
+            {
+                std::streamsize const bc(m_inbuf->sgetn(&m_invec[0], getBufferSize()));
+                m_codec_input = &m_invec[0];
+                m_codec_input_size = bc > 0 ? bc : 0;
+            }
+            if(m_codec_input_size == 0)
+            {
+                throw IOException("ZipInputStreambuf::decompress(): the compressed data is truncated.");
+            }
+        }
+        m_codec_end = m_codec->decompress(m_codec_input, m_codec_input_size, output, output_size);
+    }
+
+    size_t const size(output - &m_outvec[0]);
+    setg(&m_outvec[0], &m_outvec[0], output);
+    m_out_position += size;
+    if(size == 0)
+    {
+        return traits_type::eof();
+    }
+
+    updateCrc(m_out_position - size, &m_outvec[0], size);
+    return traits_type::to_int_type(*gptr());
+}
+
+
+/** \brief Restart the decompression at the beginning of the data.
+ *
+ * This function repositions the input streambuf at the start of the
+ * compressed data and resets the codec.
+ *
+ * \return true if the decompression can restart.
+ */
+bool ZipInputStreambuf::restartCodec()
+{
+    if(m_data_start < 0
+    || m_inbuf->pubseekpos(m_data_start, std::ios::in) != m_data_start)
+    {
+        return false;
+    }
+
+    m_codec->startDecompression(m_uncompressed_size);
+    m_codec_input = nullptr;
+    m_codec_input_size = 0;
+    m_codec_end = false;
+    m_out_position = 0;
+    setg(&m_outvec[0], &m_outvec[0], &m_outvec[0]);
+
+    return true;
+}
+
+
+/** \brief Seek to a new position in the data of the entry.
+ *
+ * The position is relative to the start of the uncompressed data of
+ * the entry. Seeking in a STORED entry only moves the get pointer or
+ * the position of the input streambuf so it takes constant time. See
+ * InflateInputStreambuf::seekpos() for DEFLATED entries.
+ *
+ * In an entry decompressed by a codec, seeking forward decompresses
+ * the data up to the new position. Seeking backward first restarts
+ * the decompression from the beginning of the data.
+ *
+ * \param[in] off  The offset to seek to.
+ * \param[in] dir  Where \p off is relative to.
+ * \param[in] which  Must include std::ios_base::in.
+ *
+ * \return The new position or -1 on failure.
+ */
+ZipInputStreambuf::pos_type ZipInputStreambuf::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which)
+{
+    if(m_current_entry.getMethod() == StorageMethod::DEFLATED)
+    {
+        return InflateInputStreambuf::seekoff(off, dir, which);
+    }
+
+    if((which & std::ios_base::in) == 0)
+    {
+        return pos_type(off_type(-1));
+    }
+
+    // the buffer ends where the data not yet read starts
+    //
+    offset_t const buffer_end(m_codec != nullptr ? m_out_position : m_uncompressed_size - m_remain);
+    offset_t base(0);
+    switch(dir)
+    {
+    case std::ios_base::beg:
+        break;
+
+    case std::ios_base::cur:
+        base = buffer_end - (egptr() - gptr());
+        break;
+
+    case std::ios_base::end:
+        base = m_uncompressed_size;
+        break;
+
+    default:
+        return pos_type(off_type(-1)); // LCOV_EXCL_LINE
+
+    }
+
+    offset_t const pos(base + off);
+    if(pos < 0 || pos > m_uncompressed_size)
+    {
+        return pos_type(off_type(-1));
+    }
+
+    // when the data is in memory, the buffer is the entire entry
+    //
+    offset_t const buffer_start(buffer_end - (egptr() - eback()));
+    if(pos >= buffer_start && pos <= buffer_end)
+    {
+        setg(eback(), eback() + (pos - buffer_start), egptr());
+        return pos_type(pos);
+    }
+
+    if(m_codec != nullptr)
+    {
+        if(pos < buffer_start
+        && !restartCodec())
+        {
+            return pos_type(off_type(-1));
+        }
+        while(m_out_position < pos)
+        {
+            setg(eback(), egptr(), egptr());
+            if(traits_type::eq_int_type(decompress(), traits_type::eof()))
+            {
+                return pos_type(off_type(-1));
+            }
+        }
+        setg(eback(), eback() + (pos - (m_out_position - (egptr() - eback()))), egptr());
+        return pos_type(pos);
+    }
+
+    offset_t const position(m_data_start + pos);
+    if(m_data_start < 0
+    || m_inbuf->pubseekpos(position, std::ios::in) != position)
+    {
+        return pos_type(off_type(-1));
+    }
+    m_remain = m_uncompressed_size - pos;
+    setg(&m_outvec[0], &m_outvec[0], &m_outvec[0]);
+
+    return pos_type(pos);
+}
+
+
+/** \brief Seek to a new position in the data of the entry.
+ *
+ * This function is the same as seekoff() with std::ios_base::beg.
+ *
+ * \param[in] pos  The position to seek to.
+ * \param[in] which  Must include std::ios_base::in.
+ *
+ * \return The new position or -1 on failure.
+ */
+ZipInputStreambuf::pos_type ZipInputStreambuf::seekpos(pos_type pos, std::ios_base::openmode which)
+{
+    return seekoff(off_type(pos), std::ios_base::beg, which);
+}
+
+
+/** \brief Return the number of bytes available.
+ *
+ * For a STORED entry, the number of bytes left in the entry is known
+ * exactly. It is returned once the buffer is empty, or -1 once the end
+ * of the entry was reached.
+ *
+ * \return The number of bytes still available, 0 if unknown, or -1.
+ */
+std::streamsize ZipInputStreambuf::showmanyc()
+{
+    if(m_current_entry.getMethod() != StorageMethod::STORED)
+    {
+        return InflateInputStreambuf::showmanyc();
+    }
+
+    return m_remain > 0 ? m_remain : -1;
+}
+
+
+/** \brief Read a block of data.
+ *
+ * For a STORED entry read from a stream, this function first returns
+ * the buffered data. If more is needed and the request is at least as
+ * large as the buffer, the data gets read directly in \p s.
+ *
+ * \param[out] s  The buffer where the data gets saved.
+ * \param[in] n  The number of bytes to read.
+ *
+ * \return The number of bytes read.
+ */
+std::streamsize ZipInputStreambuf::xsgetn(char_type * s, std::streamsize n)
+{
+    if(m_current_entry.getMethod() != StorageMethod::STORED
+    || m_memory_inbuf != nullptr)
+    {
+        return InflateInputStreambuf::xsgetn(s, n);
+    }
+
+    std::streamsize total(std::min(n, static_cast<std::streamsize>(egptr() - gptr())));
+    memcpy(s, gptr(), total);
+    setg(eback(), gptr() + total, egptr());
+
+    if(n - total >= static_cast<std::streamsize>(getBufferSize()))
+    {
+        std::streamsize const g(m_inbuf->sgetn(s + total, std::min(static_cast<offset_t>(n - total), m_remain)));
+        offset_t const position(m_uncompressed_size - m_remain);
+        m_remain -= g;
+        updateCrc(position, s + total, g);
+        total += g;
+    }
+    else if(total < n)
+    {
+        total += InflateInputStreambuf::xsgetn(s + total, n - total);
+    }
+
+    return total;
+}
+
+
 } // namespace
 
 // Local Variables:
@@ -30,8 +30,8 @@
  * used to read the data of files found in a Zip archive.
  */
 
+#include "codec.hpp"
 #include "inflateinputstreambuf.hpp"
-
 #include "ziplocalentry.hpp"
 
 
@@ -42,18 +42,37 @@ namespace zipios
 class ZipInputStreambuf : public InflateInputStreambuf
 {
 public:
-                            ZipInputStreambuf(std::streambuf * inbuf, offset_t start_pos = -1);
+                            ZipInputStreambuf(std::streambuf * inbuf, offset_t start_pos = -1, InflatePool::pointer_t pool = InflatePool::pointer_t(), FileEntry const * central_entry = nullptr);
                             ZipInputStreambuf(ZipInputStreambuf const & src) = delete;
     ZipInputStreambuf &     operator = (ZipInputStreambuf const & rhs) = delete;
     virtual                 ~ZipInputStreambuf() override;
 
+    ZipLocalEntry const &   getLocalEntry() const;
+    void                    setCrcVerification(uint32_t crc_32);
+
 protected:
     virtual std::streambuf::int_type    underflow() override;
+    virtual pos_type        seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which = std::ios_base::in | std::ios_base::out) override;
+    virtual pos_type        seekpos(pos_type pos, std::ios_base::openmode which = std::ios_base::in | std::ios_base::out) override;
+    virtual std::streamsize showmanyc() override;
+    virtual std::streamsize xsgetn(char_type * s, std::streamsize n) override;
 
 private:
+    void                    updateCrc(offset_t position, char const * data, size_t size);
+    std::streambuf::int_type    decompress();
+    bool                    restartCodec();
+
     ZipLocalEntry           m_current_entry;
     offset_t                m_remain = 0;     // For STORED entry only. the number of bytes that
                                               // has not been put in the m_outvec yet.
+    bool                    m_verify_crc = false;
+    uint32_t                m_expected_crc = 0;
+    uint32_t                m_crc = 0;
+    offset_t                m_crc_position = 0;
+    Codec::pointer_t        m_codec;
+    char const *            m_codec_input = nullptr;
+    size_t                  m_codec_input_size = 0;
+    bool                    m_codec_end = false;
 };
 
 
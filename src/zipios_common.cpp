@@ -31,6 +31,8 @@
 
 #include "zipios/zipiosexceptions.hpp"
 
+#include <algorithm>
+
 
 namespace zipios
 {
@@ -51,6 +53,15 @@ namespace zipios
 char const g_separator = '/';
 
 
+/** \brief The header ID of the Zip64 extended information extra field.
+ *
+ * The extra field of a header is composed of blocks, each starting
+ * with a 16 bit ID and a 16 bit size. The block with this ID holds
+ * the 64 bit sizes and offset of an entry.
+ */
+uint16_t const g_zip64_extra_id = 0x0001;
+
+
 /** \typedef std::ostringstream OutputStringStream;
  * \brief An output stream using strings.
  *
@@ -71,6 +82,16 @@ char const g_separator = '/';
  */
 
 
+void zipRead(std::istream& is, uint64_t& value)
+{
+    uint32_t low;
+    uint32_t high;
+    zipRead(is, low);
+    zipRead(is, high);
+    value = (static_cast<uint64_t>(high) << 32) | low;
+}
+
+
 void zipRead(std::istream& is, uint32_t& value)
 {
     unsigned char buf[sizeof(value)];
@@ -163,6 +184,16 @@ void zipRead(std::istream& is, std::string& str, ssize_t const count)
 }
 
 
+void zipRead(buffer_t const& is, size_t& pos, uint64_t& value)
+{
+    uint32_t low;
+    uint32_t high;
+    zipRead(is, pos, low);
+    zipRead(is, pos, high);
+    value = (static_cast<uint64_t>(high) << 32) | low;
+}
+
+
 void zipRead(buffer_t const& is, size_t& pos, uint32_t& value)
 {
     if(pos + sizeof(value) > is.size())
@@ -234,6 +265,112 @@ void zipRead(buffer_t const& is, size_t& pos, std::string& str, ssize_t const co
 }
 
 
+/** \brief Read the Zip64 extended information extra field.
+ *
+ * When a size or offset does not fit in the 32 bit field of a header,
+ * that field is set to 0xFFFFFFFF and the actual 64 bit value is saved
+ * in the Zip64 extended information extra field (header ID 0x0001).
+ * The values found there are, in order, the uncompressed size, the
+ * compressed size, and the offset of the local header. Only the values
+ * which are saturated in the header are present.
+ *
+ * This function searches the extra field defined by the \p size bytes
+ * found at \p pos in \p is. If a Zip64 block is found, the parameters
+ * which are set to 0xFFFFFFFF get replaced with the 64 bit values.
+ * Otherwise the parameters are not modified.
+ *
+ * \exception IOException
+ * The function throws if the Zip64 block is too small for the number
+ * of saturated values.
+ *
+ * \param[in] is  The buffer with the extra field.
+ * \param[in] pos  The position of the extra field in \p is.
+ * \param[in] size  The size of the extra field.
+ * \param[in,out] uncompressed_size  The uncompressed size.
+ * \param[in,out] compressed_size  The compressed size.
+ * \param[in,out] offset  The offset of the local header.
+ */
+void zipReadZip64Extra(buffer_t const& is, size_t pos, size_t const size, uint64_t& uncompressed_size, uint64_t& compressed_size, uint64_t& offset)
+{
+    size_t const end(std::min(pos + size, is.size()));
+    while(pos + 4 <= end)
+    {
+        uint16_t id;
+        uint16_t block_size;
+        zipRead(is, pos, id);
+        zipRead(is, pos, block_size);
+        if(pos + block_size > end)
+        {
+            // invalid extra field, ignore the rest
+            return;
+        }
+        if(id == g_zip64_extra_id)
+        {
+            size_t const block_end(pos + block_size);
+            uint64_t * values[] = { &uncompressed_size, &compressed_size, &offset };
+            for(auto v : values)
+            {
+                if(*v == 0xFFFFFFFF)
+                {
+                    if(pos + sizeof(uint64_t) > block_end)
+                    {
+                        throw IOException("the Zip64 extended information extra field is too small.");
+                    }
+                    zipRead(is, pos, *v);
+                }
+            }
+            return;
+        }
+        pos += block_size;
+    }
+}
+
+
+/** \brief Remove the Zip64 extended information from an extra field.
+ *
+ * The Zip64 extended information extra field (header ID 0x0001) is
+ * generated by the write() functions of the entries whenever a size
+ * or an offset does not fit in its 32 bit field. The block read from
+ * an existing archive is removed so it does not get duplicated or
+ * saved with stale values when the entry is written to another
+ * archive.
+ *
+ * If the extra field is invalid, it is left untouched.
+ *
+ * \param[in,out] extra_field  The extra field to clean up.
+ */
+void zipRemoveZip64Extra(buffer_t& extra_field)
+{
+    size_t pos(0);
+    while(pos + 4 <= extra_field.size())
+    {
+        size_t const start(pos);
+        uint16_t id;
+        uint16_t block_size;
+        zipRead(extra_field, pos, id);
+        zipRead(extra_field, pos, block_size);
+        if(pos + block_size > extra_field.size())
+        {
+            // invalid extra field, keep it as is
+            return;
+        }
+        pos += block_size;
+        if(id == g_zip64_extra_id)
+        {
+            extra_field.erase(extra_field.begin() + start, extra_field.begin() + pos);
+            pos = start;
+        }
+    }
+}
+
+
+void zipWrite(std::ostream& os, uint64_t const& value)
+{
+    zipWrite(os, static_cast<uint32_t>(value));
+    zipWrite(os, static_cast<uint32_t>(value >> 32));
+}
+
+
 void zipWrite(std::ostream& os, uint32_t const& value)
 {
     char buf[sizeof(value)];
@@ -62,15 +62,22 @@ uint32_t const      g_signature = 0x04034b50;
 /** \brief A bit in the general purpose flags.
  *
  * This mask is used to know whether the size and CRC are saved in
- * the header or after the header. At this time Zipios does not
- * support such trailing data as it makes use of the compressed
- * and uncompressed sizes to properly stream the output data.
+ * the header or in a data descriptor after the data of the entry.
  *
  * This is bit 3. (see point 4.4.4 in doc/zip-format.txt)
  */
 uint16_t const      g_trailing_data_descriptor = 1 << 3;
 
 
+/** \brief The size of the Zip64 extra field of a local entry.
+ *
+ * When the local header uses Zip64, it includes both, the uncompressed
+ * and the compressed sizes, in a Zip64 extended information extra
+ * field. This is the size of that block including its 4 byte header.
+ */
+size_t const        g_zip64_extra_size = 4 + 8 + 8;
+
+
 /** \brief ZipLocalEntry Header
  *
  * This structure shows how the header of the ZipLocalEntry is defined.
@@ -126,6 +133,7 @@ ZipLocalEntry::ZipLocalEntry()
     //, m_general_purpose_bitfield(0) -- auto-init
     //, m_is_directory(false)
     //, m_compressed_size(0) -- auto-init
+    //, m_zip64(false) -- auto-init
 {
 }
 
@@ -144,6 +152,7 @@ ZipLocalEntry::ZipLocalEntry(FileEntry const & src)
     //, m_general_purpose_bitfield(0) -- auto-init
     , m_is_directory(src.isDirectory())
     //, m_compressed_size(0) -- auto-init
+    //, m_zip64(false) -- auto-init
 {
 }
 
@@ -212,6 +221,22 @@ bool ZipLocalEntry::isEqual(FileEntry const & file_entry) const
     {
         return false;
     }
+    if(hasTrailingDataDescriptor()
+    || ze->hasTrailingDataDescriptor())
+    {
+        // the CRC and sizes of a local header followed by a data
+        // descriptor are zero, ignore them
+        //
+        ZipLocalEntry copy(*this);
+        copy.m_uncompressed_size = ze->m_uncompressed_size;
+        copy.m_crc_32 = ze->m_crc_32;
+        copy.m_has_crc_32 = ze->m_has_crc_32;
+        return copy.FileEntry::isEqual(file_entry)
+            && m_extract_version          == ze->m_extract_version
+            && m_general_purpose_bitfield == ze->m_general_purpose_bitfield
+            && m_is_directory             == ze->m_is_directory;
+    }
+
     return FileEntry::isEqual(file_entry)
         && m_extract_version          == ze->m_extract_version
         && m_general_purpose_bitfield == ze->m_general_purpose_bitfield
@@ -250,7 +275,8 @@ size_t ZipLocalEntry::getHeaderSize() const
     // not be portable so we use a hard coded value (yuck!)
     return 30 /* sizeof(ZipLocalEntryHeader) */
          + m_filename.length() + (m_is_directory ? 1 : 0)
-         + m_extra_field.size();
+         + m_extra_field.size()
+         + (m_zip64 ? g_zip64_extra_size : 0);
 }
 
 
@@ -301,13 +327,17 @@ void ZipLocalEntry::setCrc(uint32_t crc)
  *      uncompressed size               -- 32 or 64 bit
  * \endcode
  *
- * When a trailing data buffer is defined, the header has the compressed
- * and uncompressed sizes set to zero.
+ * When a trailing data buffer is defined, the header has the CRC and
+ * the compressed and uncompressed sizes set to zero. The sizes are
+ * saved using 64 bits when the local header uses Zip64.
  *
- * \note
- * Zipios does not support such a scheme.
+ * The ZipFile class gets the CRC and sizes of such entries from the
+ * Central Directory and the ZipStreamReader class reads the data
+ * descriptor.
  *
  * \return true if this file makes use of a trailing data buffer.
+ *
+ * \sa setTrailingDataDescriptor()
  */
 bool ZipLocalEntry::hasTrailingDataDescriptor() const
 {
@@ -315,6 +345,91 @@ bool ZipLocalEntry::hasTrailingDataDescriptor() const
 }
 
 
+/** \brief Define whether the entry has a trailing data descriptor.
+ *
+ * The ZipOutputStreambuf sets this flag on all the entries it writes
+ * to an output which cannot seek. The local header is then written
+ * with a CRC and sizes of zero and the actual values are written in
+ * a data descriptor after the data of the entry.
+ *
+ * \param[in] trailing  Whether the entry has a trailing data descriptor.
+ *
+ * \sa hasTrailingDataDescriptor()
+ */
+void ZipLocalEntry::setTrailingDataDescriptor(bool trailing)
+{
+    if(trailing)
+    {
+        m_general_purpose_bitfield |= g_trailing_data_descriptor;
+    }
+    else
+    {
+        m_general_purpose_bitfield &= ~g_trailing_data_descriptor;
+    }
+}
+
+
+/** \brief Check whether the local header uses the Zip64 format.
+ *
+ * When this function returns true, the write() function saves the
+ * sizes of the entry in a Zip64 extended information extra field.
+ *
+ * \return true if the local header is saved using Zip64.
+ *
+ * \sa setZip64()
+ */
+bool ZipLocalEntry::isZip64() const
+{
+    return m_zip64;
+}
+
+
+/** \brief Define what the compression method requires in the headers.
+ *
+ * Some compression methods require a newer version of the Zip format
+ * to extract the entry and some use bits of the general purpose bit
+ * field to describe the compressed data. The ZipOutputStreambuf calls
+ * this function before writing the header of such entries.
+ *
+ * The version needed to extract the entry is only ever increased.
+ *
+ * \param[in] extract_version  The version required by the method.
+ * \param[in] flags  The general purpose flags required by the method.
+ */
+void ZipLocalEntry::setMethodRequirements(uint16_t extract_version, uint16_t flags)
+{
+    if(m_extract_version < extract_version)
+    {
+        m_extract_version = extract_version;
+    }
+    m_general_purpose_bitfield |= flags;
+}
+
+
+/** \brief Define whether the local header uses the Zip64 format.
+ *
+ * The local header is written before the data of the entry so its
+ * size cannot change once the data was saved. The ZipOutputStreambuf
+ * calls this function before writing the header the first time with
+ * true whenever the sizes of the entry may not fit in 32 bits.
+ *
+ * Turning Zip64 on also bumps the version needed to extract the
+ * entry to 4.5.
+ *
+ * \param[in] zip64  Whether the local header uses Zip64.
+ *
+ * \sa isZip64()
+ */
+void ZipLocalEntry::setZip64(bool zip64)
+{
+    m_zip64 = zip64;
+    if(m_zip64 && m_extract_version < g_zip64_format_version)
+    {
+        m_extract_version = g_zip64_format_version;
+    }
+}
+
+
 /** \brief Read one local entry from \p is.
  *
  * This function verifies that the input stream starts with a local entry
@@ -370,10 +485,14 @@ void ZipLocalEntry::read(std::istream& is)
     zipRead(is, extra_field_len);                   // 16
     zipRead(is, filename, filename_len);            // string
     zipRead(is, m_extra_field, extra_field_len);    // buffer
-    /** \todo add support for zip64, some of those parameters
-     *        may be 0xFFFFF...FFFF in which case the 64 bit
-     *        header should be read
-     */
+
+    // sizes of 0xFFFFFFFF are found in the Zip64 extra field
+    uint64_t compressed_size64(compressed_size);
+    uint64_t uncompressed_size64(uncompressed_size);
+    uint64_t no_offset(0);
+    zipReadZip64Extra(m_extra_field, 0, m_extra_field.size(), uncompressed_size64, compressed_size64, no_offset);
+    m_zip64 = compressed_size == 0xFFFFFFFF || uncompressed_size == 0xFFFFFFFF;
+    zipRemoveZip64Extra(m_extra_field);
 
     // the FilePath() will remove the trailing slash so make sure
     // to defined the m_is_directory ahead of time!
@@ -383,8 +502,8 @@ void ZipLocalEntry::read(std::istream& is)
     DOSDateTime t;
     t.setDOSDateTime(dosdatetime);
     m_unix_time = t.getUnixTimestamp();
-    m_compressed_size = compressed_size;
-    m_uncompressed_size = uncompressed_size;
+    m_compressed_size = compressed_size64;
+    m_uncompressed_size = uncompressed_size64;
     m_filename = FilePath(filename);
 
     m_valid = true;
@@ -396,6 +515,14 @@ void ZipLocalEntry::read(std::istream& is)
  * This function writes this ZipLocalEntry header to the specified
  * output stream.
  *
+ * When isZip64() is true, the sizes are saved in a Zip64 extended
+ * information extra field.
+ *
+ * \exception InvalidStateException
+ * This exception is raised if the file name or the extra field are
+ * too large or if one of the sizes does not fit in 32 bits and the
+ * header does not use Zip64.
+ *
  * \exception IOException
  * If an error occurs while writing to the output stream, the function
  * throws an IOException.
@@ -405,26 +532,21 @@ void ZipLocalEntry::read(std::istream& is)
 void ZipLocalEntry::write(std::ostream& os)
 {
     if(m_filename.length()  > 0x10000
-    || m_extra_field.size() > 0x10000)
+    || m_extra_field.size() + (m_zip64 ? g_zip64_extra_size : 0) > 0x10000)
     {
         throw InvalidStateException("ZipLocalEntry::write(): file name or extra field too large to save in a Zip file.");
     }
 
-    /** todo: add support for 64 bit zip archive
-     */
-// Solaris defines _ILP32 for 32 bit platforms
-#if !defined(_ILP32)
-    if(m_compressed_size   >= 0x100000000UL
-    || m_uncompressed_size >= 0x100000000UL)
+    if(!m_zip64
+    && (m_compressed_size   >= 0xFFFFFFFF
+     || m_uncompressed_size >= 0xFFFFFFFF))
     {
-        // these are really big files, we do not currently test such so ignore in coverage
-        //
         // Note: The compressed size is known at the end, we seek back to
-        //       this header and resave it with the info; thus the error
-        //       is caught then if it was not out of bounds earlier.
-        throw InvalidStateException("The size of this file is too large to fit in a zip archive."); // LCOV_EXCL_LINE
+        //       this header and resave it with the info; the size of the
+        //       header cannot change at that point so we cannot switch
+        //       to Zip64 then
+        throw InvalidStateException("ZipLocalEntry::write(): The size of this file is too large to fit in a zip archive without Zip64.");
     }
-#endif
 
     std::string filename(m_filename);
     if(m_is_directory)
@@ -441,10 +563,14 @@ void ZipLocalEntry::write(std::ostream& os)
     DOSDateTime t;
     t.setUnixTimestamp(m_unix_time);
     uint32_t dosdatetime(t.getDOSDateTime());       // type could use DOSDateTime::dosdatetime_t
-    uint32_t compressed_size(m_compressed_size);
-    uint32_t uncompressed_size(m_uncompressed_size);
+    // with a trailing data descriptor the CRC and sizes are saved
+    // after the data
+    bool const descriptor(hasTrailingDataDescriptor());
+    uint32_t crc_32(descriptor ? 0 : m_crc_32);
+    uint32_t compressed_size(m_zip64 ? 0xFFFFFFFF : (descriptor ? 0 : m_compressed_size));
+    uint32_t uncompressed_size(m_zip64 ? 0xFFFFFFFF : (descriptor ? 0 : m_uncompressed_size));
     uint16_t filename_len(filename.length());
-    uint16_t extra_field_len(m_extra_field.size());
+    uint16_t extra_field_len(m_extra_field.size() + (m_zip64 ? g_zip64_extra_size : 0));
 
     // See the ZipLocalEntryHeader for more details
     zipWrite(os, g_signature);                  // 32
@@ -452,12 +578,22 @@ void ZipLocalEntry::write(std::ostream& os)
     zipWrite(os, m_general_purpose_bitfield);   // 16
     zipWrite(os, compress_method);              // 16
     zipWrite(os, dosdatetime);                  // 32
-    zipWrite(os, m_crc_32);                     // 32
+    zipWrite(os, crc_32);                       // 32
     zipWrite(os, compressed_size);              // 32
     zipWrite(os, uncompressed_size);            // 32
     zipWrite(os, filename_len);                 // 16
     zipWrite(os, extra_field_len);              // 16
     zipWrite(os, filename);                     // string
+    if(m_zip64)
+    {
+        uint16_t const zip64_size(g_zip64_extra_size - 4);
+        uint64_t const uncompressed_size64(descriptor ? 0 : m_uncompressed_size);
+        uint64_t const compressed_size64(descriptor ? 0 : m_compressed_size);
+        zipWrite(os, g_zip64_extra_id);         // 16
+        zipWrite(os, zip64_size);               // 16
+        zipWrite(os, uncompressed_size64);      // 64
+        zipWrite(os, compressed_size64);        // 64
+    }
     zipWrite(os, m_extra_field);                // buffer
 }
 
@@ -44,6 +44,7 @@ class ZipLocalEntry : public FileEntry
 public:
     // Zip file format version
     static uint16_t const       g_zip_format_version = 20; // 2.0
+    static uint16_t const       g_zip64_format_version = 45; // 4.5
 
                                 ZipLocalEntry();
                                 ZipLocalEntry(FileEntry const & src);
@@ -58,6 +59,10 @@ public:
     virtual void                setCrc(crc32_t crc) override;
 
     bool                        hasTrailingDataDescriptor() const;
+    bool                        isZip64() const;
+    void                        setMethodRequirements(uint16_t extract_version, uint16_t flags);
+    void                        setTrailingDataDescriptor(bool trailing);
+    void                        setZip64(bool zip64);
 
     virtual void                read(std::istream& is) override;
     virtual void                write(std::ostream& os) override;
@@ -67,6 +72,7 @@ protected:
     uint16_t                    m_general_purpose_bitfield = 0;
     bool                        m_is_directory = false;
     size_t                      m_compressed_size = 0;
+    bool                        m_zip64 = false;
 };
 
 
@@ -141,6 +141,65 @@ void ZipOutputStream::putNextEntry(FileEntry::pointer_t entry)
 }
 
 
+/** \brief Add an entry with its compressed data.
+ *
+ * This function saves the header of the entry followed by the data
+ * read from \p is, which is copied without being recompressed:
+ *
+ * \code
+ *      os.putRawEntry(entry, *zip_file->getRawInputStream(entry->getName()));
+ * \endcode
+ *
+ * The method, CRC and sizes of \p entry are saved verbatim so they
+ * must describe the data. See ZipOutputStreambuf::putRawEntry() for
+ * details.
+ *
+ * \param[in] entry  The FileEntry to add to the output stream.
+ * \param[in] is  The stream to read the compressed data from.
+ * \param[in] zip64  Force the use of Zip64 in the local header.
+ */
+void ZipOutputStream::putRawEntry(FileEntry::pointer_t entry, std::istream & is, bool zip64)
+{
+    ZipCentralDirectoryEntry * central_directory_entry(dynamic_cast<ZipCentralDirectoryEntry *>(entry.get()));
+    if(central_directory_entry == nullptr)
+    {
+        entry.reset(new ZipCentralDirectoryEntry(*entry));
+    }
+
+    m_ozf->putRawEntry(entry, is, zip64);
+}
+
+
+/** \brief Add an entry and its data to the output stream.
+ *
+ * This function calls putNextEntry() and then copies all the data of
+ * \p is to this stream, which compresses it as required by \p entry.
+ * The entry remains open so its CRC and sizes are only known once
+ * closeEntry() or the next putNextEntry() gets called.
+ *
+ * \param[in] entry  The FileEntry to add to the output stream.
+ * \param[in] is  The stream with the data of the entry. May be null
+ *                for entries without data, such as directories.
+ */
+void ZipOutputStream::putEntry(FileEntry::pointer_t entry, std::istream * is)
+{
+    putNextEntry(entry);
+    if(is != nullptr)
+    {
+        *this << is->rdbuf();
+
+        // inserting an empty entry sets the failbit which
+        // would prevent the following entries from being
+        // written
+        //
+        if(!bad())
+        {
+            clear();
+        }
+    }
+}
+
+
 /** \brief Set the global comment.
  *
  * This function is used to setup the Global Comment of the Zip archive
@@ -157,6 +216,30 @@ void ZipOutputStream::setComment(std::string const & comment)
 }
 
 
+/** \brief Write the archive without seeking.
+ *
+ * See ZipOutputStreambuf::setStreaming() for details.
+ *
+ * \param[in] streaming  Whether the output is written without seeking.
+ */
+void ZipOutputStream::setStreaming(bool streaming)
+{
+    m_ozf->setStreaming(streaming);
+}
+
+
+/** \brief Compress the DEFLATED entries with several threads.
+ *
+ * See ZipOutputStreambuf::setThreadCount() for details.
+ *
+ * \param[in] thread_count  The number of threads compressing each entry.
+ */
+void ZipOutputStream::setThreadCount(size_t thread_count)
+{
+    m_ozf->setThreadCount(thread_count);
+}
+
+
 } // zipios namespace
 
 // Local Variables:
@@ -48,7 +48,11 @@ public:
     void            close();
     void            finish();
     void            putNextEntry(FileEntry::pointer_t entry);
+    void            putEntry(FileEntry::pointer_t entry, std::istream * is);
+    void            putRawEntry(FileEntry::pointer_t entry, std::istream & is, bool zip64 = false);
     void            setComment(std::string const & comment);
+    void            setStreaming(bool streaming);
+    void            setThreadCount(size_t thread_count);
 
 private:
     std::unique_ptr<std::ofstream>      m_ofs;
@@ -30,8 +30,12 @@
 
 #include "zipios/zipiosexceptions.hpp"
 
+#include "crc32.hpp"
 #include "ziplocalentry.hpp"
 #include "zipendofcentraldirectory.hpp"
+#include "zipios_common.hpp"
+
+#include <algorithm>
 
 
 namespace zipios
@@ -42,6 +46,25 @@ namespace
 {
 
 
+/** \brief The signature of a data descriptor.
+ *
+ * The signature is optional, but readers which cannot use the Central
+ * Directory need it to find the end of STORED entries.
+ */
+uint32_t const      g_data_descriptor_signature = 0x08074b50;
+
+
+/** \brief An empty deflate stream.
+ *
+ * zlib outputs nothing for an empty entry. In streaming mode, a reader
+ * which does not use the Central Directory needs a valid deflate stream
+ * to know where the data ends so this final empty block is written
+ * instead. When seeking back, the local header has the real sizes and
+ * the entry is saved without any data as before.
+ */
+char const          g_empty_deflate_stream[2] = { 0x03, 0x00 };
+
+
 /** \brief Help function used to write the central directory.
  *
  * When you create a Zip archive, it includes a central directory where
@@ -52,11 +75,12 @@ namespace
  * \param[in] os  The output stream.
  * \param[in] entries  The array of entries to save in this central directory.
  * \param[in] comment  The zip archive global comment.
+ * \param[in] offset  The position of the central directory in the archive.
  */
-void writeZipCentralDirectory(std::ostream &os, FileEntry::vector_t& entries, std::string const& comment)
+void writeZipCentralDirectory(std::ostream &os, FileEntry::vector_t& entries, std::string const& comment, offset_t offset)
 {
     ZipEndOfCentralDirectory eocd(comment);
-    eocd.setOffset(os.tellp());  // start position
+    eocd.setOffset(offset);  // start position
     eocd.setCount(entries.size());
 
     size_t central_directory_size(0);
@@ -79,6 +103,16 @@ void writeZipCentralDirectory(std::ostream &os, FileEntry::vector_t& entries, st
  *
  * The ZipOutputStreambuf class is a zip archive output
  * streambuf filter.
+ *
+ * The entries are STORED, DEFLATED, or compressed by the Codec of
+ * their method, such as LZMA or Zstandard.
+ *
+ * By default, the local header of each entry gets written a second
+ * time once the CRC and sizes of the entry are known, which requires
+ * the output to be seekable. In streaming mode (see setStreaming())
+ * the output never seeks: the local headers are marked as having a
+ * trailing data descriptor and the CRC and sizes are written after
+ * the data of each entry instead.
  */
 
 
@@ -94,8 +128,12 @@ ZipOutputStreambuf::ZipOutputStreambuf(std::streambuf * outbuf)
     //, m_zip_comment("") -- auto-init
     //, m_entries() -- auto-init
     //, m_compression_level(FileEntry::COMPRESSION_LEVEL_DEFAULT) -- auto-init
+    //, m_codec() -- auto-init
     //, m_open_entry(false) -- auto-init
     //, m_open(true) -- auto-init
+    //, m_streaming(false) -- auto-init
+    //, m_position(0) -- auto-init
+    //, m_thread_count(1) -- auto-init
 {
 }
 
@@ -145,12 +183,41 @@ void ZipOutputStreambuf::closeEntry()
         break;
 
     default:
-        closeStream();
+        if(m_codec != nullptr)
+        {
+            overflow(); // flush
+            compress(true);
+            m_codec.reset();
+        }
+        else
+        {
+            closeStream();
+            if(m_streaming
+            && m_written_bytes == 0)
+            {
+                if(m_outbuf->sputn(g_empty_deflate_stream, sizeof(g_empty_deflate_stream)) != sizeof(g_empty_deflate_stream))
+                {
+                    throw IOException("ZipOutputStreambuf::closeEntry(): write to buffer failed."); // LCOV_EXCL_LINE
+                }
+                m_written_bytes += sizeof(g_empty_deflate_stream);
+            }
+        }
         break;
 
     }
 
-    updateEntryHeaderInfo();
+    if(m_streaming)
+    {
+        FileEntry::pointer_t entry(m_entries.back());
+        entry->setSize(getSize());
+        entry->setCrc(getCrc32());
+        entry->setCompressedSize(m_written_bytes);
+        writeDataDescriptor();
+    }
+    else
+    {
+        updateEntryHeaderInfo();
+    }
     setEntryClosedState();
 }
 
@@ -183,7 +250,7 @@ void ZipOutputStreambuf::finish()
 
     std::ostream os(m_outbuf);
     closeEntry();
-    writeZipCentralDirectory(os, m_entries, m_zip_comment);
+    writeZipCentralDirectory(os, m_entries, m_zip_comment, m_streaming ? m_position : static_cast<offset_t>(os.tellp()));
 }
 
 
@@ -195,6 +262,12 @@ void ZipOutputStreambuf::finish()
  * If a previous entry was still open, the function calls closeEntry()
  * first.
  *
+ * The local header uses Zip64 when the entry starts after 4Gb or when
+ * the size of the entry, as returned by getSize(), may result in more
+ * than 4Gb of data. If the size of the entry is not known ahead of time
+ * and the entry ends up larger than 4Gb, closing the entry fails with
+ * an InvalidStateException.
+ *
  * \param[in] entry  The entry to be saved and made current.
  */
 void ZipOutputStreambuf::putNextEntry(FileEntry::pointer_t entry)
@@ -213,14 +286,28 @@ void ZipOutputStreambuf::putNextEntry(FileEntry::pointer_t entry)
         m_compression_level = entry->getLevel();
     }
     m_overflown_bytes = 0;
+    m_written_bytes = 0;
     switch(m_compression_level)
     {
     case FileEntry::COMPRESSION_LEVEL_NONE:
         setp(&m_invec[0], &m_invec[0] + getBufferSize());
+        m_crc32 = crc32(0, Z_NULL, 0);
         break;
 
     default:
-        init(m_compression_level);
+        if(entry->getMethod() == StorageMethod::DEFLATED)
+        {
+            init(m_compression_level, m_thread_count);
+        }
+        else
+        {
+            // throws if the method is not supported
+            m_codec = Codec::create(entry->getMethod());
+            m_codec->startCompression(m_compression_level, entry->getSize());
+            static_cast<ZipLocalEntry *>(entry.get())->setMethodRequirements(m_codec->getExtractVersion(), m_codec->getGeneralPurposeFlags());
+            setp(&m_invec[0], &m_invec[0] + getBufferSize());
+            m_crc32 = crc32(0, Z_NULL, 0);
+        }
         break;
 
     }
@@ -230,17 +317,109 @@ void ZipOutputStreambuf::putNextEntry(FileEntry::pointer_t entry)
     std::ostream os(m_outbuf);
 
     // Update entry header info
-    entry->setEntryOffset(os.tellp());
+    offset_t const entry_offset(m_streaming ? m_position : static_cast<offset_t>(os.tellp()));
+    entry->setEntryOffset(entry_offset);
+    ZipLocalEntry * local_entry(static_cast<ZipLocalEntry *>(entry.get()));
+    local_entry->setTrailingDataDescriptor(m_streaming);
+
+    // the size of the local header cannot change once the data was
+    // written so decide now whether the entry may need Zip64; an entry
+    // past 4Gb also uses Zip64 so its local and central directory
+    // headers agree on the version needed to extract it
+    //
+    size_t bound(entry->getSize());
+    if(m_codec != nullptr)
+    {
+        bound = m_codec->getCompressBound(bound);
+    }
+    else if(m_compression_level != FileEntry::COMPRESSION_LEVEL_NONE)
+    {
+        // same as zlib deflateBound()
+        bound += (bound >> 12) + (bound >> 14) + (bound >> 25) + 13;
+    }
+    local_entry->setZip64(bound >= 0xFFFFFFFF || entry_offset >= 0xFFFFFFFF);
+
     /** \TODO
      * Rethink the design as we have to force a call to the correct
      * write() function?
      */
-    static_cast<ZipLocalEntry *>(entry.get())->ZipLocalEntry::write(os);
+    local_entry->ZipLocalEntry::write(os);
+    m_position = entry_offset + local_entry->ZipLocalEntry::getHeaderSize();
 
     m_open_entry = true;
 }
 
 
+/** \brief Add an entry with data which is already compressed.
+ *
+ * This function saves the local header of \p entry and then copies
+ * the data read from \p is as is. The method, CRC, compressed size,
+ * and uncompressed size of \p entry must describe that data, which is
+ * the case of the entries of a ZipFile and the streams returned by
+ * ZipFile::getRawInputStream(). The level of \p entry must not be
+ * FileEntry::COMPRESSION_LEVEL_NONE unless the method is STORED.
+ *
+ * Since all the information is known before the data gets written,
+ * the local header is complete and never gets written a second time.
+ * In streaming mode, it still gets followed by a data descriptor.
+ *
+ * The local header uses Zip64 when the sizes or the offset of the
+ * entry require it, or when \p zip64 is true. The latter is used
+ * to save data compressed with putNextEntry() in another buffer
+ * exactly as putNextEntry() would have saved it here.
+ *
+ * The entry is closed on return.
+ *
+ * \exception IOException
+ * The stream \p is ends before the compressed size of \p entry was read.
+ *
+ * \param[in] entry  The entry to be saved.
+ * \param[in] is  The stream to read the raw data from.
+ * \param[in] zip64  Force the use of Zip64 in the local header.
+ */
+void ZipOutputStreambuf::putRawEntry(FileEntry::pointer_t entry, std::istream & is, bool zip64)
+{
+    closeEntry();
+
+    m_entries.push_back(entry);
+
+    std::ostream os(m_outbuf);
+
+    offset_t const entry_offset(m_streaming ? m_position : static_cast<offset_t>(os.tellp()));
+    entry->setEntryOffset(entry_offset);
+    ZipLocalEntry * local_entry(static_cast<ZipLocalEntry *>(entry.get()));
+    local_entry->setTrailingDataDescriptor(m_streaming);
+    local_entry->setZip64(zip64
+                       || entry->getCompressedSize() >= 0xFFFFFFFF
+                       || entry->getSize()           >= 0xFFFFFFFF
+                       || entry_offset               >= 0xFFFFFFFF);
+    local_entry->ZipLocalEntry::write(os);
+    m_position = entry_offset + local_entry->ZipLocalEntry::getHeaderSize();
+
+    // copy the data as is
+    //
+    size_t remaining(entry->getCompressedSize());
+    while(remaining > 0)
+    {
+        size_t const size(std::min(remaining, m_invec.size()));
+        if(static_cast<size_t>(is.rdbuf()->sgetn(&m_invec[0], size)) != size)
+        {
+            throw IOException("ZipOutputStreambuf::putRawEntry(): the raw data of the entry is shorter than its compressed size.");
+        }
+        if(static_cast<size_t>(m_outbuf->sputn(&m_invec[0], size)) != size)
+        {
+            throw IOException("ZipOutputStreambuf::putRawEntry(): write to buffer failed."); // LCOV_EXCL_LINE
+        }
+        remaining -= size;
+    }
+
+    if(m_streaming)
+    {
+        writeDataDescriptor();
+    }
+}
+
+
 /** \brief Set the archive comment.
  *
  * This function saves a global comment for the Zip archive.
@@ -259,6 +438,57 @@ void ZipOutputStreambuf::setComment(std::string const& comment)
 }
 
 
+/** \brief Write the archive without ever seeking.
+ *
+ * In streaming mode, the output streambuf is never asked to seek or
+ * to tell its position so the archive can be written to a pipe or a
+ * socket. Each entry is followed by a data descriptor with its CRC
+ * and sizes and general purpose bit 3 is set in its headers.
+ *
+ * The offsets saved in the Central Directory are computed from the
+ * number of bytes written, starting at zero. So the archive must be
+ * the only thing written to the output.
+ *
+ * \note
+ * The local header still uses Zip64 only when the size of the entry
+ * given to putNextEntry() requires it. An entry which ends up larger
+ * than 4Gb otherwise fails with an InvalidStateException.
+ *
+ * \exception InvalidStateException
+ * An entry was already written.
+ *
+ * \param[in] streaming  Whether the output is written without seeking.
+ */
+void ZipOutputStreambuf::setStreaming(bool streaming)
+{
+    if(!m_entries.empty())
+    {
+        throw InvalidStateException("ZipOutputStreambuf::setStreaming(): the mode cannot be changed once entries were written.");
+    }
+    m_streaming = streaming;
+}
+
+
+/** \brief Compress the DEFLATED entries with several threads.
+ *
+ * By default, the data of each entry gets compressed by the calling
+ * thread. When \p thread_count is more than one, the data of the
+ * following DEFLATED entries gets cut in blocks compressed by that
+ * many threads (see ParallelDeflater). This is useful to save very
+ * large entries faster.
+ *
+ * The resulting data is a standard deflate stream, although slightly
+ * larger than the one produced by a single thread. It does not depend
+ * on the number of threads as long as there are more than one.
+ *
+ * \param[in] thread_count  The number of threads compressing each entry.
+ */
+void ZipOutputStreambuf::setThreadCount(size_t thread_count)
+{
+    m_thread_count = thread_count;
+}
+
+
 //
 // Protected and private methods
 //
@@ -283,6 +513,7 @@ int ZipOutputStreambuf::overflow(int c)
     {
         // Ok, we are STORED, so we handle it ourselves to avoid "side
         // effects" from zlib, which adds markers every now and then.
+        m_crc32 = updateCrc32(m_crc32, &m_invec[0], size);
         size_t const bc(m_outbuf->sputn(&m_invec[0], size));
         if(size != bc)
         {
@@ -291,6 +522,7 @@ int ZipOutputStreambuf::overflow(int c)
             // inside the same loop in ZipFile::saveCollectionToArchive()
             throw IOException("ZipOutputStreambuf::overflow(): write to buffer failed."); // LCOV_EXCL_LINE
         }
+        m_written_bytes += size;
         setp(&m_invec[0], &m_invec[0] + getBufferSize());
 
         if(c != EOF)
@@ -303,12 +535,61 @@ int ZipOutputStreambuf::overflow(int c)
     }
 
     default:
+        if(m_codec != nullptr)
+        {
+            m_crc32 = updateCrc32(m_crc32, &m_invec[0], size);
+            compress(false);
+            setp(&m_invec[0], &m_invec[0] + getBufferSize());
+
+            if(c != EOF)
+            {
+                *pptr() = c;
+                pbump(1);
+            }
+
+            return 0;
+        }
         return DeflateOutputStreambuf::overflow(c);
 
     }
 }
 
 
+/** \brief Compress the buffered data with the codec of the entry.
+ *
+ * This function gives the data found in the put area to the codec and
+ * writes the compressed data to the output streambuf.
+ *
+ * When \p finish is true, the function also writes the data that the
+ * codec still buffers. The put area must be empty in that case.
+ *
+ * \exception IOException
+ * The codec fails or the compressed data cannot be written.
+ *
+ * \param[in] finish  Whether this is the end of the entry.
+ */
+void ZipOutputStreambuf::compress(bool finish)
+{
+    char const * input(pbase());
+    size_t input_size(pptr() - pbase());
+    bool done(false);
+    while(input_size > 0 || (finish && !done))
+    {
+        char * output(&m_outvec[0]);
+        size_t output_size(m_outvec.size());
+        done = m_codec->compress(input, input_size, output, output_size, finish);
+
+        size_t const size(output - &m_outvec[0]);
+        if(size > 0
+        && static_cast<size_t>(m_outbuf->sputn(&m_outvec[0], size)) != size)
+        {
+            throw IOException("ZipOutputStreambuf::compress(): write to buffer failed."); // LCOV_EXCL_LINE
+        }
+        m_written_bytes += size;
+    }
+}
+
+
 
 /** \brief Implement the sync() functionality.
  *
@@ -361,7 +642,7 @@ void ZipOutputStreambuf::updateEntryHeaderInfo()
     }
 
     std::ostream os(m_outbuf);
-    int const curr_pos(os.tellp());
+    offset_t const curr_pos(os.tellp());
 
     // update fields in m_entries.back()
     FileEntry::pointer_t entry(m_entries.back());
@@ -384,6 +665,55 @@ void ZipOutputStreambuf::updateEntryHeaderInfo()
 }
 
 
+/** \brief Write the data descriptor of the last entry.
+ *
+ * In streaming mode, the CRC and sizes of the entry are written in a
+ * data descriptor right after its data instead of being saved in the
+ * local header. The sizes use 64 bits when the local header uses
+ * Zip64.
+ *
+ * The CRC and sizes must already be saved in the entry.
+ *
+ * \exception InvalidStateException
+ * The entry is too large for a local header which does not use Zip64.
+ */
+void ZipOutputStreambuf::writeDataDescriptor()
+{
+    FileEntry::pointer_t entry(m_entries.back());
+    size_t const compressed_size(entry->getCompressedSize());
+    size_t const uncompressed_size(entry->getSize());
+
+    bool const zip64(static_cast<ZipLocalEntry *>(entry.get())->isZip64());
+    if(!zip64
+    && (compressed_size   >= 0xFFFFFFFF
+     || uncompressed_size >= 0xFFFFFFFF))
+    {
+        throw InvalidStateException("ZipOutputStreambuf::writeDataDescriptor(): The size of this file is too large to fit in a zip archive without Zip64.");
+    }
+
+    std::ostream os(m_outbuf);
+    uint32_t const crc_32(entry->getCrc());
+    zipWrite(os, g_data_descriptor_signature);      // 32
+    zipWrite(os, crc_32);                           // 32
+    if(zip64)
+    {
+        uint64_t const compressed_size64(compressed_size);
+        uint64_t const uncompressed_size64(uncompressed_size);
+        zipWrite(os, compressed_size64);            // 64
+        zipWrite(os, uncompressed_size64);          // 64
+        m_position += compressed_size + 24;
+    }
+    else
+    {
+        uint32_t const compressed_size32(compressed_size);
+        uint32_t const uncompressed_size32(uncompressed_size);
+        zipWrite(os, compressed_size32);            // 32
+        zipWrite(os, uncompressed_size32);          // 32
+        m_position += compressed_size + 16;
+    }
+}
+
+
 } // zipios namespace
 
 // Local Variables:
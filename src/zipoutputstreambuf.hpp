@@ -29,6 +29,7 @@
  * This class is used to save files in a Zip archive.
  */
 
+#include "codec.hpp"
 #include "deflateoutputstreambuf.hpp"
 
 #include "zipios/fileentry.hpp"
@@ -50,21 +51,30 @@ public:
     void                        close();
     void                        finish();
     void                        putNextEntry(FileEntry::pointer_t entry);
+    void                        putRawEntry(FileEntry::pointer_t entry, std::istream & is, bool zip64 = false);
     void                        setComment(std::string const& comment);
+    void                        setStreaming(bool streaming);
+    void                        setThreadCount(size_t thread_count);
 
 protected:
     virtual int                 overflow(int c = EOF) override;
     virtual int                 sync() override;
 
 private:
+    void                        compress(bool finish);
     void                        setEntryClosedState();
     void                        updateEntryHeaderInfo();
+    void                        writeDataDescriptor();
 
     std::string                 m_zip_comment;
     FileEntry::vector_t         m_entries;
     FileEntry::CompressionLevel m_compression_level = FileEntry::COMPRESSION_LEVEL_DEFAULT;
+    Codec::pointer_t            m_codec;
     bool                        m_open_entry = false;
     bool                        m_open = true;
+    bool                        m_streaming = false;
+    offset_t                    m_position = 0;
+    size_t                      m_thread_count = 1;
 };
 
 
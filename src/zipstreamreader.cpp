@@ -0,0 +1,182 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2019  Made to Order Software Corporation
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Implementation of the zipios::ZipStreamReader class.
+ *
+ * This file implements the reader of Zip archives coming from streams
+ * which cannot seek.
+ */
+
+#include "zipios/zipstreamreader.hpp"
+
+#include "zipios/zipiosexceptions.hpp"
+
+#include "zipstreamreaderstreambuf.hpp"
+
+
+namespace zipios
+{
+
+
+/** \class ZipStreamReader
+ * \brief Read a Zip archive from a stream which cannot seek.
+ *
+ * The ZipFile class needs to seek to the end of the archive to read
+ * the central directory first. An archive received through a pipe or
+ * from stdin has to be saved to a file before a ZipFile can open it.
+ *
+ * The ZipStreamReader reads the archive from the start to the end
+ * instead. It walks the local headers which precede the data of each
+ * entry and stops once it finds the central directory:
+ *
+ * \code
+ *      zipios::ZipStreamReader reader(std::cin);
+ *      for(;;)
+ *      {
+ *          zipios::FileEntry::pointer_t entry(reader.getNextEntry());
+ *          if(entry == nullptr)
+ *          {
+ *              break;
+ *          }
+ *          zipios::ZipStreamReader::stream_pointer_t is(reader.getInputStream());
+ *          ...read the data of entry from *is...
+ *      }
+ * \endcode
+ *
+ * Entries with a trailing data descriptor, as written by tools which
+ * cannot seek back to the local header, are supported. The CRC and
+ * sizes of such an entry are zero until all of its data was read.
+ * The entry returned by getNextEntry() is updated at that point.
+ *
+ * The data of each entry is verified against its CRC and sizes. An
+ * error makes the stream bad. Errors found while skipping the data of
+ * an entry which was not read are reported by getNextEntry().
+ *
+ * \note
+ * The information found only in the central directory, such as the
+ * comment of an entry, is not available.
+ */
+
+
+/** \brief Initialize a reader from an input stream.
+ *
+ * The archive is read through the stream buffer of \p is. The stream
+ * must remain valid as long as the reader is used.
+ *
+ * \exception InvalidException
+ * The stream has no stream buffer.
+ *
+ * \param[in] is  The stream to read the archive from.
+ */
+ZipStreamReader::ZipStreamReader(std::istream & is)
+    : ZipStreamReader(is.rdbuf())
+{
+}
+
+
+/** \brief Initialize a reader from a stream buffer.
+ *
+ * The archive is read sequentially from \p inbuf, which does not need
+ * to support seeking. The stream buffer must remain valid as long as
+ * the reader is used.
+ *
+ * \exception InvalidException
+ * The \p inbuf parameter is a null pointer.
+ *
+ * \param[in] inbuf  The stream buffer to read the archive from.
+ */
+ZipStreamReader::ZipStreamReader(std::streambuf * inbuf)
+    //: m_streambuf() -- auto-init
+    //, m_entry() -- auto-init
+{
+    if(inbuf == nullptr)
+    {
+        throw InvalidException("ZipStreamReader::ZipStreamReader(): the input stream buffer cannot be null.");
+    }
+    m_streambuf.reset(new ZipStreamReaderStreambuf(inbuf));
+}
+
+
+/** \brief Clean up the reader.
+ *
+ * The streams returned by getInputStream() cannot be used anymore.
+ */
+ZipStreamReader::~ZipStreamReader()
+{
+}
+
+
+/** \brief Read the next entry of the archive.
+ *
+ * This function skips the data of the current entry, if any is left,
+ * and reads the header of the next entry.
+ *
+ * \exception FileCollectionException
+ * The input is not a Zip archive or the entry uses a compression method
+ * not supported by this build of Zipios.
+ *
+ * \exception IOException
+ * The archive is truncated or the data of the skipped entry is invalid.
+ *
+ * \return The next entry or a null pointer once all the entries were read.
+ */
+FileEntry::pointer_t ZipStreamReader::getNextEntry()
+{
+    m_entry.reset();
+    m_entry = m_streambuf->nextEntry();
+    return m_entry;
+}
+
+
+/** \brief Get a stream to read the data of the current entry.
+ *
+ * The returned stream reads the uncompressed data of the entry last
+ * returned by getNextEntry(). It cannot seek.
+ *
+ * All the streams returned by this function share the same stream
+ * buffer. Once getNextEntry() gets called again, they read the data of
+ * the next entry. They must not be used after the reader is destroyed.
+ *
+ * \exception InvalidStateException
+ * There is no current entry.
+ *
+ * \return A stream to read the data of the current entry.
+ */
+ZipStreamReader::stream_pointer_t ZipStreamReader::getInputStream()
+{
+    if(m_entry == nullptr)
+    {
+        throw InvalidStateException("ZipStreamReader::getInputStream(): there is no current entry, call getNextEntry() first.");
+    }
+    return stream_pointer_t(new std::istream(m_streambuf.get()));
+}
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
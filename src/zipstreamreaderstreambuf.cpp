@@ -0,0 +1,813 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2019  Made to Order Software Corporation
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Implementation of the zipios::ZipStreamReaderStreambuf class.
+ *
+ * This file implements the stream buffer used by the ZipStreamReader
+ * to read the entries of a Zip archive sequentially.
+ */
+
+#include "zipstreamreaderstreambuf.hpp"
+
+#include "zipios/zipiosexceptions.hpp"
+
+#include "crc32.hpp"
+#include "zipios_common.hpp"
+
+#include <climits>
+#include <cstring>
+#include <limits>
+#include <sstream>
+
+
+namespace zipios
+{
+
+
+namespace
+{
+
+
+/** \brief The signature of a local header.
+ *
+ * Each entry of a Zip archive starts with a local header.
+ */
+uint32_t const      g_local_header_signature = 0x04034b50;
+
+
+/** \brief The signature of a central directory header.
+ *
+ * The central directory follows the last entry. Once found, the
+ * reader knows that there are no more entries.
+ */
+uint32_t const      g_central_directory_signature = 0x02014b50;
+
+
+/** \brief The signature of the end of central directory record.
+ *
+ * An archive without any entry starts with this record.
+ */
+uint32_t const      g_end_of_central_directory_signature = 0x06054b50;
+
+
+/** \brief The signature of the Zip64 end of central directory record.
+ *
+ * This record is never found before the central directory, it is
+ * checked for completeness.
+ */
+uint32_t const      g_zip64_end_of_central_directory_signature = 0x06064b50;
+
+
+/** \brief The signature of a data descriptor.
+ *
+ * The signature of a data descriptor is optional. The same signature
+ * is also used as a marker at the start of split archives.
+ */
+uint32_t const      g_data_descriptor_signature = 0x08074b50;
+
+
+/** \brief The size of the fixed part of a local header.
+ *
+ * The file name and the extra field follow these 30 bytes.
+ */
+size_t const        g_local_header_size = 30;
+
+
+/** \brief The size of a data descriptor with 32 bit sizes.
+ *
+ * This size includes the optional signature.
+ */
+size_t const        g_data_descriptor_size = 16;
+
+
+/** \brief The size of a data descriptor with 64 bit sizes.
+ *
+ * This size includes the optional signature.
+ */
+size_t const        g_zip64_data_descriptor_size = 24;
+
+
+/** \brief Read a 16 bit little endian number.
+ *
+ * \param[in] data  The bytes to read.
+ *
+ * \return The number.
+ */
+uint16_t readUInt16(char const * data)
+{
+    unsigned char const * d(reinterpret_cast<unsigned char const *>(data));
+    return static_cast<uint16_t>(d[0] | (d[1] << 8));
+}
+
+
+/** \brief Read a 32 bit little endian number.
+ *
+ * \param[in] data  The bytes to read.
+ *
+ * \return The number.
+ */
+uint32_t readUInt32(char const * data)
+{
+    return readUInt16(data) | (static_cast<uint32_t>(readUInt16(data + 2)) << 16);
+}
+
+
+/** \brief Read a 64 bit little endian number.
+ *
+ * \param[in] data  The bytes to read.
+ *
+ * \return The number.
+ */
+uint64_t readUInt64(char const * data)
+{
+    return readUInt32(data) | (static_cast<uint64_t>(readUInt32(data + 4)) << 32);
+}
+
+
+} // no name namespace
+
+
+
+/** \class ZipStreamReaderStreambuf
+ * \brief Read the entries of a Zip archive from a stream.
+ *
+ * This stream buffer reads a Zip archive from the beginning to the end,
+ * without ever seeking. The nextEntry() function reads the next local
+ * header and the stream buffer then returns the uncompressed data of
+ * that entry.
+ *
+ * All the input is read through an internal buffer. This way the data
+ * found after the end of the compressed data of an entry is still
+ * available to read the data descriptor and the next local header.
+ *
+ * When an entry has a trailing data descriptor, its CRC and sizes are
+ * only known once all of its data was read. The compressed methods know
+ * where their data ends. The size of a STORED entry is found by
+ * searching for the signature of the data descriptor followed by the
+ * CRC and sizes of the data found so far.
+ *
+ * The CRC and sizes of each entry are always verified since, unlike
+ * with a ZipFile, there is no central directory to compare them with.
+ */
+
+
+
+/** \brief Initialize a ZipStreamReaderStreambuf.
+ *
+ * The input stream buffer is read sequentially. It does not need to
+ * support seeking.
+ *
+ * \param[in] inbuf  The stream buffer to read the archive from.
+ */
+ZipStreamReaderStreambuf::ZipStreamReaderStreambuf(std::streambuf * inbuf)
+    : m_inbuf(inbuf)
+    , m_state(InflatePool::getState(InflatePool::pointer_t()))
+    , m_invec(m_state->m_invec)
+    , m_outvec(m_state->m_outvec)
+    //, m_in_position(0) -- auto-init
+    //, m_in_end(0) -- auto-init
+    //, m_first_header(true) -- auto-init
+    //, m_end_of_archive(false) -- auto-init
+    //, m_entry() -- auto-init
+    //, m_format(data_format_t::STORED) -- auto-init
+    //, m_codec() -- auto-init
+    //, m_remaining(0) -- auto-init
+    //, m_compressed_size(0) -- auto-init
+    //, m_uncompressed_size(0) -- auto-init
+    //, m_crc(0) -- auto-init
+    //, m_end_of_data(false) -- auto-init
+    //, m_end_of_entry(true) -- auto-init
+{
+    m_invec.resize(getBufferSize());
+    m_outvec.resize(getBufferSize());
+}
+
+
+/** \brief Clean up the stream buffer.
+ *
+ * The destructor releases the zlib state.
+ */
+ZipStreamReaderStreambuf::~ZipStreamReaderStreambuf()
+{
+    InflatePool::releaseState(InflatePool::pointer_t(), m_state);
+}
+
+
+/** \brief Read the local header of the next entry.
+ *
+ * This function skips the data of the current entry, if any is left,
+ * then reads the next local header.
+ *
+ * Once the central directory is found, the function returns a null
+ * pointer. It also returns a null pointer if the input ends right
+ * after an entry.
+ *
+ * The returned entry is updated with the CRC and sizes found in the
+ * data descriptor once its data was read.
+ *
+ * \exception FileCollectionException
+ * The input is not a Zip archive or the entry uses a compression method
+ * not supported by this build of Zipios.
+ *
+ * \exception IOException
+ * The archive is truncated or the data of the entry skipped is invalid.
+ *
+ * \return The next entry or a null pointer.
+ */
+FileEntry::pointer_t ZipStreamReaderStreambuf::nextEntry()
+{
+    while(!m_end_of_entry)
+    {
+        setg(eback(), egptr(), egptr());
+        underflow();
+    }
+    setg(nullptr, nullptr, nullptr);
+    m_entry.reset();
+
+    if(m_end_of_archive)
+    {
+        return FileEntry::pointer_t();
+    }
+
+    if(!fill(4))
+    {
+        if(available() == 0)
+        {
+            m_end_of_archive = true;
+            return FileEntry::pointer_t();
+        }
+        throw IOException("ZipStreamReaderStreambuf::nextEntry(): the archive is truncated.");
+    }
+
+    uint32_t signature(readUInt32(m_invec.data() + m_in_position));
+    if(m_first_header
+    && signature == g_data_descriptor_signature)
+    {
+        // marker found at the start of split archives
+        //
+        consume(4);
+        if(!fill(4))
+        {
+            throw IOException("ZipStreamReaderStreambuf::nextEntry(): the archive is truncated.");
+        }
+        signature = readUInt32(m_invec.data() + m_in_position);
+    }
+    m_first_header = false;
+
+    if(signature == g_central_directory_signature
+    || signature == g_end_of_central_directory_signature
+    || signature == g_zip64_end_of_central_directory_signature)
+    {
+        m_end_of_archive = true;
+        return FileEntry::pointer_t();
+    }
+    if(signature != g_local_header_signature)
+    {
+        throw FileCollectionException("ZipStreamReaderStreambuf::nextEntry(): expected a local header but got some other data.");
+    }
+
+    if(!fill(g_local_header_size))
+    {
+        throw IOException("ZipStreamReaderStreambuf::nextEntry(): the archive is truncated.");
+    }
+    char const * header(m_invec.data() + m_in_position);
+    size_t const header_size(g_local_header_size
+                           + readUInt16(header + 26)
+                           + readUInt16(header + 28));
+    if(!fill(header_size))
+    {
+        throw IOException("ZipStreamReaderStreambuf::nextEntry(): the archive is truncated.");
+    }
+
+    std::istringstream is(std::string(m_invec.data() + m_in_position, header_size));
+    std::shared_ptr<ZipLocalEntry> entry(new ZipLocalEntry);
+    entry->read(is);
+    consume(header_size);
+
+    bool const descriptor(entry->hasTrailingDataDescriptor());
+    switch(entry->getMethod())
+    {
+    case StorageMethod::STORED:
+        if(descriptor && entry->getCompressedSize() == 0)
+        {
+            m_format = data_format_t::STORED_SCAN;
+        }
+        else
+        {
+            m_format = data_format_t::STORED;
+        }
+        m_remaining = entry->getCompressedSize();
+        break;
+
+    case StorageMethod::DEFLATED:
+        {
+            z_stream & zs(m_state->m_zs);
+            int err(Z_OK);
+            if(m_state->m_zs_initialized)
+            {
+                err = inflateReset(&zs);
+            }
+            else
+            {
+                zs.zalloc = Z_NULL;
+                zs.zfree  = Z_NULL;
+                zs.opaque = Z_NULL;
+                err = inflateInit2(&zs, -MAX_WBITS);
+                m_state->m_zs_initialized = err == Z_OK;
+            }
+            if(err != Z_OK)
+            {
+                throw IOException("ZipStreamReaderStreambuf::nextEntry(): zlib initialization failed."); // LCOV_EXCL_LINE
+            }
+        }
+        m_format = data_format_t::DEFLATED;
+        m_remaining = descriptor ? std::numeric_limits<size_t>::max() : entry->getCompressedSize();
+        break;
+
+    default:
+        if(m_codec == nullptr
+        || m_codec->getMethod() != entry->getMethod())
+        {
+            m_codec = Codec::create(entry->getMethod());
+        }
+        m_codec->startDecompression(descriptor ? std::numeric_limits<size_t>::max() : entry->getSize());
+        m_format = data_format_t::CODEC;
+        m_remaining = descriptor ? std::numeric_limits<size_t>::max() : entry->getCompressedSize();
+        break;
+
+    }
+
+    m_entry = entry;
+    m_compressed_size = 0;
+    m_uncompressed_size = 0;
+    m_crc = 0;
+    m_end_of_entry = false;
+
+    // empty entries may have no compressed data at all
+    //
+    m_end_of_data = !descriptor && m_remaining == 0;
+
+    return m_entry;
+}
+
+
+/** \brief Read the next block of data of the current entry.
+ *
+ * This function reads or decompresses the next block of data of the
+ * current entry. Once the end of the data is reached, the trailing
+ * data descriptor is read, if any, and the CRC and sizes of the entry
+ * are verified.
+ *
+ * \exception IOException
+ * The archive is truncated, the data is invalid, or its CRC or sizes
+ * do not match the entry.
+ *
+ * \return The next character or EOF once the end of the data of the
+ *         entry was reached.
+ */
+ZipStreamReaderStreambuf::int_type ZipStreamReaderStreambuf::underflow()
+{
+    if(gptr() < egptr())
+    {
+        return traits_type::to_int_type(*gptr()); // LCOV_EXCL_LINE
+    }
+
+    if(m_end_of_entry)
+    {
+        return traits_type::eof();
+    }
+
+    if(m_end_of_data)
+    {
+        endEntry();
+        return traits_type::eof();
+    }
+
+    switch(m_format)
+    {
+    case data_format_t::STORED:
+        if(m_remaining == 0)
+        {
+            endEntry();
+            return traits_type::eof();
+        }
+        if(!fill(1))
+        {
+            throw IOException("ZipStreamReaderStreambuf::underflow(): the archive is truncated.");
+        }
+        {
+            size_t const size(std::min(available(), m_remaining));
+            output(m_invec.data() + m_in_position, size);
+            consume(size);
+            m_remaining -= size;
+            m_compressed_size += size;
+        }
+        break;
+
+    case data_format_t::STORED_SCAN:
+        {
+            bool found(false);
+            size_t const size(scanStored(found));
+            if(size == 0)
+            {
+                endEntry();
+                return traits_type::eof();
+            }
+            output(m_invec.data() + m_in_position, size);
+            consume(size);
+            m_compressed_size += size;
+            m_end_of_data = found;
+        }
+        break;
+
+    case data_format_t::DEFLATED:
+    case data_format_t::CODEC:
+        m_end_of_data = decompress();
+        if(gptr() == egptr())
+        {
+            endEntry();
+            return traits_type::eof();
+        }
+        break;
+
+    }
+
+    return traits_type::to_int_type(*gptr());
+}
+
+
+/** \brief Get the number of bytes available in the input buffer.
+ *
+ * \return The number of bytes read from the input stream buffer and
+ *         not yet consumed.
+ */
+size_t ZipStreamReaderStreambuf::available() const
+{
+    return m_in_end - m_in_position;
+}
+
+
+/** \brief Make sure the input buffer holds at least \p size bytes.
+ *
+ * The bytes not yet consumed are moved to the start of the input buffer
+ * and as much data as fits in the buffer gets read.
+ *
+ * This function must not be called while the get area points to the
+ * input buffer.
+ *
+ * \param[in] size  The number of bytes needed.
+ *
+ * \return true if at least \p size bytes are available, false if the
+ *         input ended first.
+ */
+bool ZipStreamReaderStreambuf::fill(size_t size)
+{
+    if(available() >= size)
+    {
+        return true;
+    }
+
+    if(m_in_position > 0)
+    {
+        memmove(m_invec.data(), m_invec.data() + m_in_position, available());
+        m_in_end -= m_in_position;
+        m_in_position = 0;
+    }
+    if(m_invec.size() < size)
+    {
+        m_invec.resize(size); // LCOV_EXCL_LINE
+    }
+
+    while(m_in_end < size)
+    {
+        std::streamsize const r(m_inbuf->sgetn(m_invec.data() + m_in_end, m_invec.size() - m_in_end));
+        if(r <= 0)
+        {
+            return false;
+        }
+        m_in_end += r;
+    }
+
+    return true;
+}
+
+
+/** \brief Mark bytes of the input buffer as used.
+ *
+ * \param[in] size  The number of bytes to skip.
+ */
+void ZipStreamReaderStreambuf::consume(size_t size)
+{
+    m_in_position += size;
+}
+
+
+/** \brief Make a block of uncompressed data available.
+ *
+ * This function updates the CRC and the size of the data of the entry
+ * and sets the get area to \p data.
+ *
+ * \param[in] data  The uncompressed data.
+ * \param[in] size  The number of bytes in \p data.
+ */
+void ZipStreamReaderStreambuf::output(char * data, size_t size)
+{
+    m_crc = updateCrc32(m_crc, data, size);
+    m_uncompressed_size += size;
+    setg(data, data, data + size);
+}
+
+
+/** \brief Decompress the next block of data.
+ *
+ * This function decompresses data in the output buffer until at least
+ * one byte is output or the end of the compressed data is reached.
+ *
+ * \exception IOException
+ * The compressed data is invalid or truncated.
+ *
+ * \return true once the end of the compressed data was reached.
+ */
+bool ZipStreamReaderStreambuf::decompress()
+{
+    for(;;)
+    {
+        size_t const in_size(std::min(available(), m_remaining));
+        char * const out(m_outvec.data());
+        bool end(false);
+        size_t consumed(0);
+        size_t produced(0);
+
+        if(m_format == data_format_t::DEFLATED)
+        {
+            z_stream & zs(m_state->m_zs);
+            uInt const avail_in(static_cast<uInt>(std::min(in_size, static_cast<size_t>(UINT_MAX))));
+            zs.next_in = reinterpret_cast<Bytef *>(m_invec.data() + m_in_position);
+            zs.avail_in = avail_in;
+            zs.next_out = reinterpret_cast<Bytef *>(out);
+            zs.avail_out = static_cast<uInt>(m_outvec.size());
+
+            int const err(inflate(&zs, Z_NO_FLUSH));
+            if(err == Z_STREAM_END)
+            {
+                end = true;
+            }
+            else if(err != Z_OK && err != Z_BUF_ERROR)
+            {
+                OutputStringStream msgs;
+                msgs << "ZipStreamReaderStreambuf::underflow(): inflate failed"
+                     << ": " << zError(err);
+                if(zs.msg != nullptr)
+                {
+                    msgs << " -- " << zs.msg;
+                }
+                throw IOException(msgs.str());
+            }
+            consumed = avail_in - zs.avail_in;
+            produced = m_outvec.size() - zs.avail_out;
+        }
+        else
+        {
+            char const * in(m_invec.data() + m_in_position);
+            size_t in_left(in_size);
+            char * o(out);
+            size_t out_left(m_outvec.size());
+            end = m_codec->decompress(in, in_left, o, out_left);
+            consumed = in_size - in_left;
+            produced = m_outvec.size() - out_left;
+        }
+
+        consume(consumed);
+        m_remaining -= consumed;
+        m_compressed_size += consumed;
+
+        if(produced > 0 || end)
+        {
+            output(out, produced);
+            return end;
+        }
+
+        if(consumed == 0)
+        {
+            if(m_remaining == 0)
+            {
+                throw IOException("ZipStreamReaderStreambuf::underflow(): the compressed data is invalid.");
+            }
+            if(!fill(available() + 1))
+            {
+                throw IOException("ZipStreamReaderStreambuf::underflow(): the archive is truncated.");
+            }
+        }
+    }
+}
+
+
+/** \brief Search the end of the data of a STORED entry.
+ *
+ * A STORED entry with a trailing data descriptor does not say where
+ * its data ends. This function searches the input buffer for the
+ * signature of a data descriptor followed by the CRC and sizes of
+ * the data found before it.
+ *
+ * When the descriptor is not found, the data which cannot be the start
+ * of a descriptor is returned and the search continues on the next call.
+ *
+ * \exception IOException
+ * The input ended before a data descriptor was found.
+ *
+ * \param[out] found  Set to true when the data descriptor was found.
+ *
+ * \return The number of bytes of data available at the start of the
+ *         input buffer.
+ */
+size_t ZipStreamReaderStreambuf::scanStored(bool & found)
+{
+    found = false;
+
+    // without the end of the input, only test positions where a whole
+    // Zip64 descriptor fits
+    //
+    bool const complete(fill(g_zip64_data_descriptor_size));
+    size_t const size(available());
+    size_t const end(complete
+                ? size - g_zip64_data_descriptor_size + 1
+                : (size >= g_data_descriptor_size ? size - g_data_descriptor_size + 1 : 0));
+
+    char const * data(m_invec.data() + m_in_position);
+    for(size_t position(0); position < end; ++position)
+    {
+        char const * s(static_cast<char const *>(memchr(data + position, 'P', end - position)));
+        if(s == nullptr)
+        {
+            break;
+        }
+        position = s - data;
+        if(matchDataDescriptor(s, size - position, position))
+        {
+            found = true;
+            return position;
+        }
+    }
+
+    if(!complete)
+    {
+        throw IOException("ZipStreamReaderStreambuf::underflow(): the archive is truncated.");
+    }
+
+    return end;
+}
+
+
+/** \brief Check whether a data descriptor ends the data of an entry.
+ *
+ * This function checks whether \p descriptor is a data descriptor with
+ * a signature and the CRC and sizes of the data of the entry read so
+ * far plus the \p data_size bytes found at the start of the input
+ * buffer.
+ *
+ * \param[in] descriptor  The possible data descriptor.
+ * \param[in] size  The number of bytes available in \p descriptor.
+ * \param[in] data_size  The number of bytes of data before \p descriptor.
+ *
+ * \return true if \p descriptor is the data descriptor of the entry.
+ */
+bool ZipStreamReaderStreambuf::matchDataDescriptor(char const * descriptor, size_t size, size_t data_size) const
+{
+    if(size < g_data_descriptor_size
+    || readUInt32(descriptor) != g_data_descriptor_signature)
+    {
+        return false;
+    }
+
+    uint64_t const total(m_uncompressed_size + data_size);
+    if((readUInt32(descriptor + 8) != total || readUInt32(descriptor + 12) != total)
+    && (size < g_zip64_data_descriptor_size || readUInt64(descriptor + 8) != total || readUInt64(descriptor + 16) != total))
+    {
+        return false;
+    }
+
+    return readUInt32(descriptor + 4) == updateCrc32(m_crc, m_invec.data() + m_in_position, data_size);
+}
+
+
+/** \brief Terminate the current entry.
+ *
+ * This function skips the compressed data left after the end of the
+ * compressed stream, reads the trailing data descriptor if any, and
+ * verifies the CRC and sizes of the entry.
+ *
+ * \exception IOException
+ * The archive is truncated or the CRC or sizes do not match the data.
+ */
+void ZipStreamReaderStreambuf::endEntry()
+{
+    // whatever happens, the next call to nextEntry() reads the next header
+    //
+    m_end_of_entry = true;
+
+    if(m_entry->hasTrailingDataDescriptor())
+    {
+        readDataDescriptor();
+    }
+    else
+    {
+        while(m_remaining > 0)
+        {
+            if(!fill(1))
+            {
+                throw IOException("ZipStreamReaderStreambuf::underflow(): the archive is truncated.");
+            }
+            size_t const size(std::min(available(), m_remaining));
+            consume(size);
+            m_remaining -= size;
+            m_compressed_size += size;
+        }
+    }
+
+    if(m_entry->getCompressedSize() != m_compressed_size
+    || m_entry->getSize() != m_uncompressed_size)
+    {
+        throw IOException("ZipStreamReaderStreambuf::underflow(): the sizes of the entry do not match its data.");
+    }
+    if(m_entry->getCrc() != m_crc)
+    {
+        throw IOException("ZipStreamReaderStreambuf::underflow(): CRC mismatch, the data of the entry is corrupted.");
+    }
+}
+
+
+/** \brief Read the data descriptor following the data of an entry.
+ *
+ * The data descriptor has an optional signature and its sizes are
+ * saved using 32 or 64 bits. The format is determined by comparing the
+ * sizes with the size of the data actually read. The CRC and sizes are
+ * then saved in the entry.
+ *
+ * \exception IOException
+ * The archive is truncated or the descriptor does not match the data.
+ */
+void ZipStreamReaderStreambuf::readDataDescriptor()
+{
+    fill(g_zip64_data_descriptor_size);
+
+    char const * descriptor(m_invec.data() + m_in_position);
+    size_t size(available());
+    size_t signature_size(0);
+    if(size >= 4
+    && readUInt32(descriptor) == g_data_descriptor_signature)
+    {
+        signature_size = 4;
+        descriptor += 4;
+        size -= 4;
+    }
+    if(size < 12)
+    {
+        throw IOException("ZipStreamReaderStreambuf::underflow(): the archive is truncated.");
+    }
+
+    bool const match32(readUInt32(descriptor + 4) == m_compressed_size
+                    && readUInt32(descriptor + 8) == m_uncompressed_size);
+    bool const match64(size >= 20
+                    && readUInt64(descriptor + 4) == m_compressed_size
+                    && readUInt64(descriptor + 12) == m_uncompressed_size);
+    if(!match32 && !match64)
+    {
+        throw IOException("ZipStreamReaderStreambuf::underflow(): the data descriptor does not match the data of the entry.");
+    }
+    bool const zip64(match32 && match64 ? m_entry->isZip64() : match64);
+
+    m_entry->setCrc(readUInt32(descriptor));
+    m_entry->setCompressedSize(m_compressed_size);
+    m_entry->setSize(m_uncompressed_size);
+    consume(signature_size + (zip64 ? 20 : 12));
+}
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
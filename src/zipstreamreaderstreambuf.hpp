@@ -0,0 +1,106 @@
+#pragma once
+#ifndef ZIPIOS_ZIPSTREAMREADERSTREAMBUF_HPP
+#define ZIPIOS_ZIPSTREAMREADERSTREAMBUF_HPP
+
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2019  Made to Order Software Corporation
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Define the zipios::ZipStreamReaderStreambuf class.
+ *
+ * The zipios::ZipStreamReaderStreambuf class reads the local headers
+ * and the data of the entries of a Zip archive one after the other
+ * without ever seeking.
+ */
+
+#include "codec.hpp"
+#include "inflatepool.hpp"
+#include "ziplocalentry.hpp"
+
+#include <streambuf>
+
+
+namespace zipios
+{
+
+
+class ZipStreamReaderStreambuf : public std::streambuf
+{
+public:
+                                ZipStreamReaderStreambuf(std::streambuf * inbuf);
+                                ZipStreamReaderStreambuf(ZipStreamReaderStreambuf const & src) = delete;
+    ZipStreamReaderStreambuf &  operator = (ZipStreamReaderStreambuf const & rhs) = delete;
+    virtual                     ~ZipStreamReaderStreambuf() override;
+
+    FileEntry::pointer_t        nextEntry();
+
+protected:
+    virtual int_type            underflow() override;
+
+private:
+    enum class data_format_t
+    {
+        STORED,
+        STORED_SCAN,
+        DEFLATED,
+        CODEC
+    };
+
+    size_t                      available() const;
+    bool                        fill(size_t size);
+    void                        consume(size_t size);
+    void                        output(char * data, size_t size);
+    bool                        decompress();
+    size_t                      scanStored(bool & found);
+    bool                        matchDataDescriptor(char const * descriptor, size_t size, size_t data_size) const;
+    void                        endEntry();
+    void                        readDataDescriptor();
+
+    std::streambuf *            m_inbuf = nullptr;
+    InflatePool::state_pointer_t m_state;
+    std::vector<char> &         m_invec;
+    std::vector<char> &         m_outvec;
+    size_t                      m_in_position = 0;
+    size_t                      m_in_end = 0;
+    bool                        m_first_header = true;
+    bool                        m_end_of_archive = false;
+    std::shared_ptr<ZipLocalEntry> m_entry;
+    data_format_t               m_format = data_format_t::STORED;
+    Codec::pointer_t            m_codec;
+    size_t                      m_remaining = 0;
+    size_t                      m_compressed_size = 0;
+    size_t                      m_uncompressed_size = 0;
+    uint32_t                    m_crc = 0;
+    bool                        m_end_of_data = false;
+    bool                        m_end_of_entry = true;
+};
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
+#endif
@@ -0,0 +1,170 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2019  Made to Order Software Corporation
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Implementation of the zipios::ZlibInflater class.
+ *
+ * This file implements the inflater based on the zlib library.
+ */
+
+#include "zlibinflater.hpp"
+
+#include "zipios/zipiosexceptions.hpp"
+
+#include <algorithm>
+#include <limits>
+
+
+namespace zipios
+{
+
+
+/** \class ZlibInflater
+ * \brief Decompress whole entries with zlib.
+ *
+ * This inflater calls the zlib inflate() function once per 4Gb of
+ * input or output. The zlib states are kept in a pool so decompressing
+ * many small entries does not allocate a new state each time.
+ */
+
+
+/** \brief Initialize a zlib inflater.
+ *
+ * The inflater starts with an empty pool of zlib states.
+ */
+ZlibInflater::ZlibInflater()
+    : m_pool(new InflatePool)
+{
+}
+
+
+/** \brief Clean up the zlib inflater.
+ *
+ * The pooled zlib states are released.
+ */
+ZlibInflater::~ZlibInflater()
+{
+}
+
+
+/** \brief Retrieve the name of this inflater.
+ *
+ * \return "zlib".
+ */
+std::string ZlibInflater::getName() const
+{
+    return "zlib";
+}
+
+
+/** \brief Decompress a raw DEFLATE stream with zlib.
+ *
+ * See Inflater::inflate() for details.
+ *
+ * \exception IOException
+ * The compressed data is invalid or does not decompress to exactly
+ * \p output_size bytes.
+ *
+ * \param[in] input  The compressed data.
+ * \param[in] input_size  The number of bytes in \p input.
+ * \param[out] output  The buffer receiving the uncompressed data.
+ * \param[in] output_size  The exact size of the uncompressed data.
+ */
+void ZlibInflater::inflate(char const * input, size_t input_size, char * output, size_t output_size)
+{
+    InflatePool::state_pointer_t state(InflatePool::getState(m_pool));
+    z_stream & zs(state->m_zs);
+    int err(Z_OK);
+    if(state->m_zs_initialized)
+    {
+        err = inflateReset(&zs);
+    }
+    else
+    {
+        zs.zalloc = Z_NULL;
+        zs.zfree  = Z_NULL;
+        zs.opaque = Z_NULL;
+        err = inflateInit2(&zs, -MAX_WBITS);
+        state->m_zs_initialized = err == Z_OK;
+    }
+    if(err != Z_OK)
+    {
+        throw IOException(std::string("ZlibInflater::inflate(): inflateInit2() failed: ") + zError(err)); // LCOV_EXCL_LINE
+    }
+
+    // zlib does not accept a null output pointer, even for an empty entry
+    //
+    char empty(0);
+    zs.next_out = reinterpret_cast<Bytef *>(output == nullptr ? &empty : output);
+    zs.avail_out = 0;
+    zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(input));
+    zs.avail_in = 0;
+
+    // zlib counts bytes with 32 bit numbers
+    //
+    size_t const max_chunk(std::numeric_limits<uInt>::max());
+    size_t in_remaining(input_size);
+    size_t out_remaining(output_size);
+    for(;;)
+    {
+        if(zs.avail_in == 0 && in_remaining > 0)
+        {
+            zs.avail_in = static_cast<uInt>(std::min(in_remaining, max_chunk));
+            in_remaining -= zs.avail_in;
+        }
+        if(zs.avail_out == 0 && out_remaining > 0)
+        {
+            zs.avail_out = static_cast<uInt>(std::min(out_remaining, max_chunk));
+            out_remaining -= zs.avail_out;
+        }
+
+        err = ::inflate(&zs, Z_NO_FLUSH);
+        if(err == Z_STREAM_END)
+        {
+            break;
+        }
+        if(err != Z_OK)
+        {
+            // Z_BUF_ERROR means the compressed data ended early or
+            // there was more data than expected
+            //
+            throw IOException(std::string("ZlibInflater::inflate(): inflate failed: ") + zError(err));
+        }
+    }
+
+    if(zs.avail_out != 0 || out_remaining != 0)
+    {
+        throw IOException("ZlibInflater::inflate(): the size of the inflated data does not match the size of the entry.");
+    }
+
+    InflatePool::releaseState(m_pool, state);
+}
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
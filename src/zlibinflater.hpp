@@ -0,0 +1,66 @@
+#pragma once
+#ifndef ZIPIOS_ZLIBINFLATER_HPP
+#define ZIPIOS_ZLIBINFLATER_HPP
+
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2019  Made to Order Software Corporation
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Declaration of the zipios::ZlibInflater class.
+ *
+ * The zipios::ZlibInflater class decompresses whole entries with zlib.
+ */
+
+#include "zipios/inflater.hpp"
+
+#include "inflatepool.hpp"
+
+
+namespace zipios
+{
+
+
+class ZlibInflater : public Inflater
+{
+public:
+                                ZlibInflater();
+                                ZlibInflater(ZlibInflater const & src) = delete;
+    ZlibInflater &              operator = (ZlibInflater const & rhs) = delete;
+    virtual                     ~ZlibInflater() override;
+
+    virtual std::string         getName() const override;
+    virtual void                inflate(char const * input, size_t input_size, char * output, size_t output_size) override;
+
+private:
+    InflatePool::pointer_t      m_pool;
+};
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
+#endif
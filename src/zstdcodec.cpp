@@ -0,0 +1,233 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2019  Made to Order Software Corporation
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Implementation of the zipios::ZstdCodec class.
+ *
+ * This file implements the Zstandard codec using libzstd.
+ */
+
+#include "zstdcodec.hpp"
+
+#include "zipios/zipiosexceptions.hpp"
+
+
+namespace zipios
+{
+
+
+/** \class ZstdCodec
+ * \brief Compress and decompress Zstandard entries.
+ *
+ * The data of a Zstandard entry (method 93) is one Zstandard frame.
+ * Zstandard decompresses several times faster than zlib inflates, with
+ * a better compression ratio.
+ *
+ * The compression levels are converted to the Zstandard levels 1 to 19.
+ * The levels above 19 use much more memory and are not used.
+ */
+
+
+/** \brief Initialize a Zstandard codec.
+ *
+ * The libzstd contexts get allocated the first time they are needed.
+ */
+ZstdCodec::ZstdCodec()
+    //: m_dctx(nullptr) -- auto-init
+    //, m_cctx(nullptr) -- auto-init
+{
+}
+
+
+/** \brief Release the libzstd contexts.
+ *
+ * The destructor releases the memory allocated by libzstd.
+ */
+ZstdCodec::~ZstdCodec()
+{
+    ZSTD_freeDCtx(m_dctx);
+    ZSTD_freeCCtx(m_cctx);
+}
+
+
+/** \brief Retrieve the compression method of this codec.
+ *
+ * \return StorageMethod::ZSTD.
+ */
+StorageMethod ZstdCodec::getMethod() const
+{
+    return StorageMethod::ZSTD;
+}
+
+
+/** \brief Compute the largest compressed size of some data.
+ *
+ * \param[in] size  The size of the uncompressed data.
+ *
+ * \return The largest possible size of the compressed data.
+ */
+size_t ZstdCodec::getCompressBound(size_t size) const
+{
+    return ZSTD_compressBound(size);
+}
+
+
+/** \brief Get ready to decompress the data of an entry.
+ *
+ * The Zstandard frame knows where it ends so the uncompressed size is
+ * not used.
+ *
+ * \exception IOException
+ * The decompression context cannot be allocated.
+ *
+ * \param[in] uncompressed_size  The size of the uncompressed data.
+ */
+void ZstdCodec::startDecompression(size_t uncompressed_size)
+{
+    static_cast<void>(uncompressed_size);
+
+    if(m_dctx == nullptr)
+    {
+        m_dctx = ZSTD_createDCtx();
+        if(m_dctx == nullptr)
+        {
+            throw IOException("ZstdCodec::startDecompression(): out of memory."); // LCOV_EXCL_LINE
+        }
+    }
+    else
+    {
+        ZSTD_DCtx_reset(m_dctx, ZSTD_reset_session_only);
+    }
+}
+
+
+/** \brief Decompress some Zstandard data.
+ *
+ * \exception IOException
+ * The data is invalid.
+ *
+ * \param[in,out] input  The compressed data.
+ * \param[in,out] input_size  The number of bytes in \p input.
+ * \param[in,out] output  The buffer receiving the uncompressed data.
+ * \param[in,out] output_size  The number of bytes available in \p output.
+ *
+ * \return true once the end of the frame was reached.
+ */
+bool ZstdCodec::decompress(char const * & input, size_t & input_size, char * & output, size_t & output_size)
+{
+    ZSTD_inBuffer in = { input, input_size, 0 };
+    ZSTD_outBuffer out = { output, output_size, 0 };
+
+    size_t const r(ZSTD_decompressStream(m_dctx, &out, &in));
+
+    input += in.pos;
+    input_size -= in.pos;
+    output += out.pos;
+    output_size -= out.pos;
+
+    if(ZSTD_isError(r))
+    {
+        throw IOException(std::string("ZstdCodec::decompress(): ") + ZSTD_getErrorName(r));
+    }
+
+    return r == 0;
+}
+
+
+/** \brief Get ready to compress the data of an entry.
+ *
+ * \exception IOException
+ * The compression context cannot be allocated.
+ *
+ * \param[in] level  The compression level.
+ * \param[in] size  The expected size of the uncompressed data.
+ */
+void ZstdCodec::startCompression(FileEntry::CompressionLevel level, size_t size)
+{
+    // the size is only a hint, pledging it would make the compression
+    // fail if the data ends up being larger
+    //
+    static_cast<void>(size);
+
+    if(m_cctx == nullptr)
+    {
+        m_cctx = ZSTD_createCCtx();
+        if(m_cctx == nullptr)
+        {
+            throw IOException("ZstdCodec::startCompression(): out of memory."); // LCOV_EXCL_LINE
+        }
+    }
+    else
+    {
+        ZSTD_CCtx_reset(m_cctx, ZSTD_reset_session_and_parameters);
+    }
+
+    size_t const r(ZSTD_CCtx_setParameter(m_cctx, ZSTD_c_compressionLevel, convertLevel(level, 1, ZSTD_CLEVEL_DEFAULT, 19)));
+    if(ZSTD_isError(r))
+    {
+        throw IOException(std::string("ZstdCodec::startCompression(): ") + ZSTD_getErrorName(r)); // LCOV_EXCL_LINE
+    }
+}
+
+
+/** \brief Compress some data with Zstandard.
+ *
+ * \exception IOException
+ * libzstd failed compressing the data.
+ *
+ * \param[in,out] input  The data to compress.
+ * \param[in,out] input_size  The number of bytes in \p input.
+ * \param[in,out] output  The buffer receiving the compressed data.
+ * \param[in,out] output_size  The number of bytes available in \p output.
+ * \param[in] finish  Whether all the data was given to the codec.
+ *
+ * \return true once the frame was completely output.
+ */
+bool ZstdCodec::compress(char const * & input, size_t & input_size, char * & output, size_t & output_size, bool finish)
+{
+    ZSTD_inBuffer in = { input, input_size, 0 };
+    ZSTD_outBuffer out = { output, output_size, 0 };
+
+    size_t const r(ZSTD_compressStream2(m_cctx, &out, &in, finish ? ZSTD_e_end : ZSTD_e_continue));
+
+    input += in.pos;
+    input_size -= in.pos;
+    output += out.pos;
+    output_size -= out.pos;
+
+    if(ZSTD_isError(r))
+    {
+        throw IOException(std::string("ZstdCodec::compress(): ") + ZSTD_getErrorName(r)); // LCOV_EXCL_LINE
+    }
+
+    return finish && r == 0;
+}
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
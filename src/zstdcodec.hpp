@@ -0,0 +1,75 @@
+#pragma once
+#ifndef ZIPIOS_ZSTDCODEC_HPP
+#define ZIPIOS_ZSTDCODEC_HPP
+
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2019  Made to Order Software Corporation
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Declaration of the zipios::ZstdCodec class.
+ *
+ * The zipios::ZstdCodec class compresses and decompresses Zstandard
+ * entries with libzstd. It is only compiled when libzstd was found at
+ * build time.
+ */
+
+#include "codec.hpp"
+
+#include <zstd.h>
+
+
+namespace zipios
+{
+
+
+class ZstdCodec : public Codec
+{
+public:
+                                ZstdCodec();
+                                ZstdCodec(ZstdCodec const & src) = delete;
+    ZstdCodec &                 operator = (ZstdCodec const & rhs) = delete;
+    virtual                     ~ZstdCodec() override;
+
+    virtual StorageMethod       getMethod() const override;
+    virtual size_t              getCompressBound(size_t size) const override;
+
+    virtual void                startDecompression(size_t uncompressed_size) override;
+    virtual bool                decompress(char const * & input, size_t & input_size, char * & output, size_t & output_size) override;
+
+    virtual void                startCompression(FileEntry::CompressionLevel level, size_t size) override;
+    virtual bool                compress(char const * & input, size_t & input_size, char * & output, size_t & output_size, bool finish) override;
+
+private:
+    ZSTD_DCtx *                 m_dctx = nullptr;
+    ZSTD_CCtx *                 m_cctx = nullptr;
+};
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
+#endif
@@ -27,12 +27,14 @@
 
 #include "tests.hpp"
 
+#include "src/crc32.hpp"
 #include "src/zipios_common.hpp"
 #include "zipios/zipiosexceptions.hpp"
 
 #include <fstream>
 
 #include <unistd.h>
+#include <zlib.h>
 
 
 SCENARIO("Vector append", "[zipios_common]")
@@ -975,6 +977,43 @@ SCENARIO("Write to file", "[zipios_common] [io]")
 }
 
 
+TEST_CASE("CRC-32 computation", "[zipios_common] [crc32]")
+{
+    std::string const implementation(zipios::getCrc32Implementation());
+    REQUIRE((implementation == "pclmul" || implementation == "zlib"));
+
+    std::vector<unsigned char> data(256 * 1024 + 100);
+    for(auto & c : data)
+    {
+        c = static_cast<unsigned char>(rand());
+    }
+
+    // all the small sizes and alignments
+    for(size_t size(0); size < 300; ++size)
+    {
+        for(size_t offset(0); offset < 16; ++offset)
+        {
+            uLong const expected(crc32(0, &data[offset], static_cast<uInt>(size)));
+            REQUIRE(zipios::updateCrc32(0, &data[offset], size) == expected);
+        }
+    }
+
+    // large buffers, computed at once or in pieces
+    for(int i(0); i < 20; ++i)
+    {
+        size_t const offset(rand() % 100);
+        size_t const size(rand() % (data.size() - offset));
+        uLong const expected(crc32(0, &data[offset], static_cast<uInt>(size)));
+        REQUIRE(zipios::updateCrc32(0, &data[offset], size) == expected);
+
+        size_t const split(rand() % (size + 1));
+        uint32_t crc(zipios::updateCrc32(0, &data[offset], split));
+        crc = zipios::updateCrc32(crc, &data[offset + split], size - split);
+        REQUIRE(crc == expected);
+    }
+}
+
+
 // Local Variables:
 // mode: cpp
 // indent-tabs-mode: nil
@@ -30,6 +30,7 @@
 #include "zipios/zipiosexceptions.hpp"
 #include "zipios/dosdatetime.hpp"
 
+#include <algorithm>
 #include <fstream>
 #include <memory>
 #include <vector>
@@ -984,6 +985,65 @@ TEST_CASE("DirectoryCollection with an empty directory", "[DirectoryCollection]
 }
 
 
+TEST_CASE("DirectoryCollection entries searched by name and basename", "[DirectoryCollection] [FileCollection]")
+{
+    REQUIRE(system("rm -rf tree") == 0); // clean up, just in case
+    REQUIRE(system("mkdir -p tree/a tree/b && touch tree/a/same.txt tree/b/same.txt tree/c.txt") == 0);
+
+    zipios::DirectoryCollection dc("tree", true);
+    zipios::FileEntry::vector_t v(dc.entries());
+    REQUIRE(v.size() == 6);
+
+    SECTION("each entry is found by its full name")
+    {
+        for(auto it(v.begin()); it != v.end(); ++it)
+        {
+            REQUIRE(dc.getEntry((*it)->getName()) == *it);
+        }
+    }
+
+    SECTION("the first entry with a given basename is returned")
+    {
+        for(auto it(v.begin()); it != v.end(); ++it)
+        {
+            // search the first entry with that basename linearly
+            auto const first(std::find_if(v.begin(), v.end(), [&](zipios::FileEntry::pointer_t e)
+                    {
+                        return e->getFileName() == (*it)->getFileName();
+                    }));
+            REQUIRE(dc.getEntry((*it)->getFileName(), zipios::FileCollection::MatchPath::IGNORE) == *first);
+        }
+        REQUIRE(dc.getEntry("same.txt", zipios::FileCollection::MatchPath::IGNORE) != nullptr);
+        REQUIRE_FALSE(dc.getEntry("same.txt", zipios::FileCollection::MatchPath::MATCH));
+        REQUIRE_FALSE(dc.getEntry("tree/same.txt", zipios::FileCollection::MatchPath::IGNORE));
+    }
+
+    SECTION("entries added later are found too")
+    {
+        REQUIRE(dc.getEntry("tree/c.txt") != nullptr);
+        REQUIRE_FALSE(dc.getEntry("tree/d.txt"));
+        REQUIRE_FALSE(dc.getEntry("d.txt", zipios::FileCollection::MatchPath::IGNORE));
+
+        REQUIRE(system("touch tree/d.txt") == 0);
+        dc.addEntry(zipios::DirectoryEntry(zipios::FilePath("tree/d.txt")));
+
+        REQUIRE(dc.getEntry("tree/d.txt") != nullptr);
+        REQUIRE(dc.getEntry("tree/d.txt")->getName() == "tree/d.txt");
+        REQUIRE(dc.getEntry("d.txt", zipios::FileCollection::MatchPath::IGNORE) == dc.getEntry("tree/d.txt"));
+    }
+
+    SECTION("a copy has its own index")
+    {
+        zipios::DirectoryCollection copy(dc);
+        REQUIRE(copy.getEntry("tree/c.txt") != nullptr);
+        REQUIRE(copy.getEntry("tree/c.txt") != dc.getEntry("tree/c.txt"));
+        REQUIRE(copy.getEntry("tree/c.txt")->getName() == "tree/c.txt");
+    }
+
+    REQUIRE(system("rm -rf tree") == 0);
+}
+
+
 // Local Variables:
 // mode: cpp
 // indent-tabs-mode: nil
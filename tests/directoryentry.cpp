@@ -30,6 +30,8 @@
 #include "zipios/zipiosexceptions.hpp"
 #include "zipios/dosdatetime.hpp"
 
+#include "src/codec.hpp"
+
 #include <fstream>
 
 #include <sys/stat.h>
@@ -438,6 +440,15 @@ SCENARIO("DirectoryEntry with invalid paths", "[DirectoryEntry] [FileEntry]")
                 case 8: // Deflated
                     break;
 
+                case 14: // LZMA
+                case 93: // Zstandard
+                    // only supported if the library was found at build time
+                    if(!zipios::Codec::isSupported(static_cast<zipios::StorageMethod>(i)))
+                    {
+                        REQUIRE_THROWS_AS(de.setMethod(static_cast<zipios::StorageMethod>(i)), zipios::InvalidStateException);
+                    }
+                    break;
+
                 default:
                     REQUIRE_THROWS_AS(de.setMethod(static_cast<zipios::StorageMethod>(i)), zipios::InvalidStateException);
                     break;
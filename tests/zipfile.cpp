@@ -27,15 +27,30 @@
 #include "tests.hpp"
 
 #include "zipios/zipfile.hpp"
+#include "zipios/collectioncollection.hpp"
 #include "zipios/directorycollection.hpp"
 #include "zipios/zipiosexceptions.hpp"
+#include "zipios/zipstreamreader.hpp"
 #include "zipios/dosdatetime.hpp"
 
+#include "src/codec.hpp"
+#include "src/paralleldeflater.hpp"
+#include "src/zipcentraldirectoryentry.hpp"
+#include "src/zipentrytable.hpp"
+#include "src/zipoutputstream.hpp"
+
 #include <algorithm>
+#include <atomic>
+#include <cstddef>
 #include <fstream>
+#include <map>
+#include <sstream>
+#include <thread>
 
+#include <sys/stat.h>
 #include <unistd.h>
 #include <string.h>
+#include <utime.h>
 #include <zlib.h>
 
 
@@ -47,7 +62,9 @@ namespace
 zipios::StorageMethod const g_supported_storage_methods[]
 {
     zipios::StorageMethod::STORED,
-    zipios::StorageMethod::DEFLATED
+    zipios::StorageMethod::DEFLATED,
+    zipios::StorageMethod::LZMA,
+    zipios::StorageMethod::ZSTD
 };
 
 
@@ -387,6 +404,269 @@ SCENARIO("ZipFile with a valid zip archive", "[ZipFile] [FileCollection]")
                 }
             }
         }
+
+        WHEN("we search entries before loading all of them")
+        {
+            zipios::ZipFile all("tree.zip");
+            zipios::FileEntry::vector_t v(all.entries());
+
+            THEN("the entries created on demand match the loaded entries")
+            {
+                zipios::ZipFile zf("tree.zip");
+                REQUIRE(zf.size() == v.size());
+
+                for(auto it(v.begin()); it != v.end(); ++it)
+                {
+                    zipios::FileEntry::pointer_t entry(zf.getEntry((*it)->getName()));
+                    REQUIRE(entry);
+                    REQUIRE(entry != *it);
+                    REQUIRE(entry->isEqual(**it));
+                    REQUIRE(entry->isDirectory() == (*it)->isDirectory());
+
+                    // the first entry with that basename is found
+                    //
+                    zipios::FileEntry::pointer_t base(zf.getEntry((*it)->getFileName(), zipios::FileCollection::MatchPath::IGNORE));
+                    REQUIRE(base);
+                    REQUIRE(base->getFileName() == (*it)->getFileName());
+                    REQUIRE(base->isEqual(*all.getEntry((*it)->getFileName(), zipios::FileCollection::MatchPath::IGNORE)));
+                }
+
+                // loading all the entries does not change the results
+                //
+                REQUIRE(zf.entries().size() == v.size());
+                REQUIRE(zf.size() == v.size());
+                REQUIRE(zf.getEntry(v.front()->getName()) == zf.entries().front());
+
+                // added entries are found too
+                //
+                zipios::DirectoryEntry other(zipios::FilePath("this/file/was/added.txt"));
+                zf.addEntry(other);
+                REQUIRE(zf.size() == v.size() + 1);
+                REQUIRE(zf.getEntry("this/file/was/added.txt"));
+                REQUIRE(zf.getEntry("added.txt", zipios::FileCollection::MatchPath::IGNORE));
+            }
+
+            THEN("a name always maps to the same entry object")
+            {
+                zipios::ZipFile zf("tree.zip");
+                auto const file(std::find_if(v.begin(), v.end(), [](zipios::FileEntry::pointer_t e) { return !e->isDirectory(); }));
+                REQUIRE(file != v.end());
+                std::string const name((*file)->getName());
+
+                zipios::FileEntry::pointer_t entry(zf.getEntry(name));
+                REQUIRE(entry);
+                REQUIRE(zf.getEntry(name) == entry);
+                zipios::FileEntry::pointer_t const base(zf.getEntry((*file)->getFileName(), zipios::FileCollection::MatchPath::IGNORE));
+                REQUIRE(zf.getEntry(base->getName()) == base);
+                zipios::FileEntry::vector_t const globbed(zf.glob(name));
+                REQUIRE(globbed.size() == 1);
+                REQUIRE(globbed.front() == entry);
+
+                // changes made before the entries get loaded are kept
+                //
+                zipios::StorageMethod const method(entry->getMethod() == zipios::StorageMethod::STORED
+                                                        ? zipios::StorageMethod::DEFLATED
+                                                        : zipios::StorageMethod::STORED);
+                entry->setMethod(method);
+
+                zipios::ZipFile copy(zf);
+                REQUIRE(copy.getEntry(name) != entry);
+                REQUIRE(copy.getEntry(name)->getMethod() == method);
+
+                zipios::FileEntry::vector_t const loaded(zf.entries());
+                REQUIRE(std::find(loaded.begin(), loaded.end(), entry) != loaded.end());
+                REQUIRE(zf.getEntry(name) == entry);
+
+                zipios_test::auto_unlink_t remove_identity("identity.zip");
+                {
+                    std::ofstream out("identity.zip", std::ios::out | std::ios::binary);
+                    zipios::ZipFile::saveCollectionToArchive(out, zf);
+                }
+                zipios::ZipFile saved("identity.zip");
+                REQUIRE(saved.getEntry(name)->getMethod() == method);
+            }
+        }
+    }
+}
+
+
+SCENARIO("ZipFile with a memory mapped zip archive", "[ZipFile] [FileCollection]")
+{
+    GIVEN("a tree directory")
+    {
+        REQUIRE(system("rm -rf tree") == 0); // clean up, just in case
+        size_t const start_count(rand() % 40 + 80);
+        zipios_test::file_t tree(zipios_test::file_t::type_t::DIRECTORY, start_count, "tree");
+        zipios_test::auto_unlink_t remove_zip("tree.zip");
+        REQUIRE(system("zip -r tree.zip tree >/dev/null") == 0);
+
+        WHEN("we load the zip file with a memory mapping")
+        {
+            zipios::ZipFile zf("tree.zip", 0, 0, zipios::ZipFile::AccessMode::MEMORY_MAP);
+
+            THEN("it is valid and the data matches the files in the tree")
+            {
+                REQUIRE(zf.isValid());
+                REQUIRE(zf.getAccessMode() == zipios::ZipFile::AccessMode::MEMORY_MAP);
+                REQUIRE(zf.size() == tree.size());
+                REQUIRE_FALSE(zf.getInputStream("inexistant", zipios::FileCollection::MatchPath::MATCH));
+
+                zipios::FileEntry::vector_t v(zf.entries());
+                for(auto it(v.begin()); it != v.end(); ++it)
+                {
+                    zipios::FileEntry::pointer_t entry(*it);
+
+                    zipios_test::file_t::type_t t(tree.find(entry->getName()));
+                    REQUIRE(t != zipios_test::file_t::type_t::UNKNOWN);
+                    if(t == zipios_test::file_t::type_t::DIRECTORY)
+                    {
+                        continue;
+                    }
+
+                    zipios::FileCollection::stream_pointer_t is(zf.getInputStream(entry->getName()));
+                    REQUIRE(is);
+                    std::ifstream in(entry->getName(), std::ios::in | std::ios::binary);
+
+                    while(in && *is)
+                    {
+                        char buf1[BUFSIZ], buf2[BUFSIZ];
+
+                        in.read(buf1, sizeof(buf1));
+                        std::streamsize sz1(in.gcount());
+
+                        is->read(buf2, sizeof(buf2));
+                        std::streamsize sz2(is->gcount());
+
+                        REQUIRE(sz1 == sz2);
+                        REQUIRE(memcmp(buf1, buf2, sz1) == 0);
+                    }
+
+                    REQUIRE(!in);
+                    REQUIRE(!*is);
+                }
+            }
+
+            THEN("input streams remain valid after the ZipFile is closed")
+            {
+                zipios::FileEntry::vector_t v(zf.entries());
+                std::vector<zipios::FileCollection::stream_pointer_t> streams;
+                std::vector<std::string> names;
+                for(auto it(v.begin()); it != v.end(); ++it)
+                {
+                    if(!(*it)->isDirectory())
+                    {
+                        streams.push_back(zf.getInputStream((*it)->getName()));
+                        names.push_back((*it)->getName());
+                    }
+                }
+
+                zf.close();
+                REQUIRE_FALSE(zf.isValid());
+
+                for(size_t idx(0); idx < streams.size(); ++idx)
+                {
+                    std::ifstream in(names[idx], std::ios::in | std::ios::binary);
+                    std::stringstream expected;
+                    expected << in.rdbuf();
+                    std::stringstream actual;
+                    actual << streams[idx]->rdbuf();
+                    REQUIRE(actual.str() == expected.str());
+                }
+            }
+        }
+        WHEN("we load the zip file with the default stream access")
+        {
+            zipios::ZipFile zf("tree.zip");
+
+            THEN("input streams read the shared file in turn and remain valid after the ZipFile is closed")
+            {
+                REQUIRE(zf.getAccessMode() == zipios::ZipFile::AccessMode::STREAM);
+
+                zipios::FileEntry::vector_t v(zf.entries());
+                std::vector<zipios::FileCollection::stream_pointer_t> streams;
+                std::vector<std::string> expected;
+                for(auto it(v.begin()); it != v.end(); ++it)
+                {
+                    if(!(*it)->isDirectory())
+                    {
+                        streams.push_back(zf.getInputStream((*it)->getName()));
+                        std::ifstream in((*it)->getName(), std::ios::in | std::ios::binary);
+                        std::stringstream data;
+                        data << in.rdbuf();
+                        expected.push_back(data.str());
+                    }
+                }
+
+                zf.close();
+                REQUIRE_FALSE(zf.isValid());
+
+                // read a few bytes of each stream in turn so the reads
+                // of all the streams are interleaved
+                //
+                std::vector<std::string> actual(streams.size());
+                for(bool more(true); more;)
+                {
+                    more = false;
+                    for(size_t idx(0); idx < streams.size(); ++idx)
+                    {
+                        char buf[37];
+                        streams[idx]->read(buf, sizeof(buf));
+                        actual[idx].append(buf, streams[idx]->gcount());
+                        if(*streams[idx])
+                        {
+                            more = true;
+                        }
+                    }
+                }
+                REQUIRE(actual == expected);
+            }
+        }
+        WHEN("we load the zip file with lazy validation")
+        {
+            zipios::ZipFile zf("tree.zip", 0, 0, zipios::ZipFile::AccessMode::MEMORY_MAP, zipios::ZipFile::ValidationLevel::LAZY);
+
+            THEN("each entry can be read, twice")
+            {
+                REQUIRE(zf.isValid());
+                REQUIRE(zf.size() == tree.size());
+
+                zipios::FileEntry::vector_t v(zf.entries());
+                for(int repeat(0); repeat < 2; ++repeat)
+                {
+                    for(auto it(v.begin()); it != v.end(); ++it)
+                    {
+                        if((*it)->isDirectory())
+                        {
+                            continue;
+                        }
+                        zipios::FileCollection::stream_pointer_t is(zf.getInputStream((*it)->getName()));
+                        REQUIRE(is);
+
+                        std::ifstream in((*it)->getName(), std::ios::in | std::ios::binary);
+                        std::stringstream expected;
+                        expected << in.rdbuf();
+                        std::stringstream actual;
+                        actual << is->rdbuf();
+                        REQUIRE(actual.str() == expected.str());
+                    }
+                }
+            }
+        }
+    }
+
+    GIVEN("a file which does not exist")
+    {
+        REQUIRE(system("rm -f inexistant.zip") == 0);
+        REQUIRE_THROWS_AS(zipios::ZipFile("inexistant.zip", 0, 0, zipios::ZipFile::AccessMode::MEMORY_MAP), zipios::IOException);
+    }
+
+    GIVEN("an empty file")
+    {
+        zipios_test::auto_unlink_t remove_zip("empty.zip");
+        {
+            std::ofstream os("empty.zip", std::ios::out | std::ios::binary);
+        }
+        REQUIRE_THROWS_AS(zipios::ZipFile("empty.zip", 0, 0, zipios::ZipFile::AccessMode::MEMORY_MAP), zipios::FileCollectionException);
     }
 }
 
@@ -840,19 +1120,34 @@ SCENARIO("use Zipios to create zip archives with 1 or 3 files each", "[ZipFile]
             zipios::DirectoryCollection dc("file.bin");
 
             // add another 64Kb file entries! (all the same name, ouch!)
-            for(int i(0); i < 64 * 1024 + rand() % 100; ++i)
+            int const count(64 * 1024 + rand() % 100);
+            for(int i(0); i < count; ++i)
             {
                 zipios::DirectoryEntry other_entry(zipios::FilePath("file.bin"));
                 dc.addEntry(other_entry);
             }
 
-            THEN("the creating of the zip archive fails: too many file entries")
+            THEN("the creating of the zip archive uses Zip64")
             {
                 zipios_test::auto_unlink_t remove_zip("file.zip");
                 {
                     std::ofstream out("file.zip", std::ios::out | std::ios::binary);
-                    REQUIRE_THROWS_AS(zipios::ZipFile::saveCollectionToArchive(out, dc), zipios::InvalidStateException);
+                    zipios::ZipFile::saveCollectionToArchive(out, dc);
+                }
+
+                zipios::ZipFile zf("file.zip");
+                REQUIRE(zf.size() == static_cast<size_t>(count + 1));
+
+                zipios::FileEntry::vector_t v(zf.entries());
+                REQUIRE(v.size() == static_cast<size_t>(count + 1));
+                for(auto it(v.begin()); it != v.end(); ++it)
+                {
+                    REQUIRE((*it)->getName() == "file.bin");
+                    REQUIRE((*it)->getSize() == 1);
                 }
+
+                // check with the unzip tool, which has to see all the entries
+                REQUIRE(system("unzip -tqq file.zip >/dev/null") == 0);
             }
         }
     }
@@ -1234,6 +1529,95 @@ struct end_of_central_directory_t
 };
 
 
+struct zip64_end_of_central_directory_t
+{
+    uint32_t            m_signature;        // "PK 6.6"
+    uint64_t            m_record_size;      // size of the record after this field
+    uint16_t            m_version;
+    uint16_t            m_extract_version;
+    uint32_t            m_disk_number;
+    uint32_t            m_disk_start;
+    uint64_t            m_file_count;       // number of files in this archive
+    uint64_t            m_total_count;      // total number across all split files
+    uint64_t            m_central_directory_size;
+    uint64_t            m_central_directory_offset;
+    uint32_t            m_locator_signature;    // "PK 6.7"
+    uint32_t            m_locator_disk_number;
+    uint64_t            m_record_offset;        // where this record starts
+    uint32_t            m_total_disks;
+
+    zip64_end_of_central_directory_t()
+        : m_signature(0x06064B50)
+        , m_record_size(44)
+        , m_version(45)
+        , m_extract_version(45)
+        , m_disk_number(0)
+        , m_disk_start(0)
+        , m_file_count(0)
+        , m_total_count(0)
+        , m_central_directory_size(0)
+        , m_central_directory_offset(0)
+        , m_locator_signature(0x07064B50)
+        , m_locator_disk_number(0)
+        , m_record_offset(0)
+        , m_total_disks(1)
+    {
+    }
+
+    static void write_value(std::ostream& os, uint64_t value, int size)
+    {
+        for(int i(0); i < size; ++i)
+        {
+            os << static_cast<unsigned char>(value >> (i * 8));
+        }
+    }
+
+    void write(std::ostream& os)
+    {
+        // IMPORTANT NOTE:
+        // We do not verify any of the values on purpose, we want to be
+        // able to use this class to create anything (i.e. including invalid
+        // headers.)
+
+        // the record
+        write_value(os, m_signature, 4);
+        write_value(os, m_record_size, 8);
+        write_value(os, m_version, 2);
+        write_value(os, m_extract_version, 2);
+        write_value(os, m_disk_number, 4);
+        write_value(os, m_disk_start, 4);
+        write_value(os, m_file_count, 8);
+        write_value(os, m_total_count, 8);
+        write_value(os, m_central_directory_size, 8);
+        write_value(os, m_central_directory_offset, 8);
+
+        // the locator
+        write_value(os, m_locator_signature, 4);
+        write_value(os, m_locator_disk_number, 4);
+        write_value(os, m_record_offset, 8);
+        write_value(os, m_total_disks, 4);
+    }
+
+    // create a Zip64 extended information extra field
+    static std::vector<unsigned char> extra_field(std::vector<uint64_t> const & values)
+    {
+        std::vector<unsigned char> result;
+        result.push_back(0x01);
+        result.push_back(0x00);
+        result.push_back(static_cast<unsigned char>(values.size() * 8));
+        result.push_back(0x00);
+        for(auto v : values)
+        {
+            for(int i(0); i < 8; ++i)
+            {
+                result.push_back(static_cast<unsigned char>(v >> (i * 8)));
+            }
+        }
+        return result;
+    }
+};
+
+
 TEST_CASE("Valid and Invalid ZipFile Archives", "[ZipFile] [FileCollection]")
 {
     SECTION("create files with End of Central Directory that are tool small")
@@ -1287,6 +1671,154 @@ TEST_CASE("Valid and Invalid ZipFile Archives", "[ZipFile] [FileCollection]")
         }
     }
 
+    SECTION("create files with End of Central Directory followed by comments of many sizes")
+    {
+        // include sizes that make the structure straddle 1Kb boundaries
+        // and the largest possible comment
+        size_t const sizes[] = { 0, 1, 1000, 1010, 1024, 4090, 32768, 65535 };
+        for(auto const comment_len : sizes)
+        {
+            zipios_test::auto_unlink_t auto_unlink("file.zip");
+            {
+                std::ofstream os("file.zip", std::ios::out | std::ios::binary);
+
+                // some random data before the structure, which the
+                // search must not mistake for the signature
+                //
+                size_t const prefix_len(rand() % 2048 + 1);
+                for(size_t j(0); j < prefix_len; ++j)
+                {
+                    os << static_cast<char>('A' + rand() % 26);
+                }
+
+                end_of_central_directory_t eocd;
+                eocd.m_central_directory_offset = prefix_len;
+                for(size_t j(0); j < comment_len; ++j)
+                {
+                    eocd.m_comment += static_cast<char>('A' + rand() % 26);
+                }
+                eocd.write(os);
+            }
+
+            zipios::ZipFile zf("file.zip");
+            REQUIRE(zf.isValid());
+            REQUIRE(zf.size() == 0);
+        }
+    }
+
+    SECTION("create files with a Central Directory offset past the End of Central Directory")
+    {
+        for(int i(0); i < 10; ++i)
+        {
+            zipios_test::auto_unlink_t auto_unlink("file.zip");
+            {
+                std::ofstream os("file.zip", std::ios::out | std::ios::binary);
+
+                size_t const prefix_len(rand() % 2048 + 1);
+                for(size_t j(0); j < prefix_len; ++j)
+                {
+                    os << static_cast<char>('A' + rand() % 26);
+                }
+
+                end_of_central_directory_t eocd;
+                eocd.m_central_directory_offset = prefix_len + rand() % 1000 + 1;
+                eocd.write(os);
+            }
+
+            REQUIRE_THROWS_AS([&](){
+                            zipios::ZipFile zf("file.zip");
+                        }(), zipios::FileCollectionException);
+        }
+    }
+
+    SECTION("read Central Directory entries with an extra field and a comment from a stream")
+    {
+        // the stream version reads the fixed part of each entry and then
+        // its variable part, which has to end exactly on the next entry
+        //
+        std::stringstream ss;
+        std::vector<central_directory_header_t> headers(3);
+        for(size_t idx(0); idx < headers.size(); ++idx)
+        {
+            central_directory_header_t & cdh(headers[idx]);
+            cdh.m_filename = "entry" + std::to_string(idx) + ".txt";
+            cdh.m_compressed_size = static_cast<uint32_t>(idx * 100);
+            cdh.m_uncompressed_size = static_cast<uint32_t>(idx * 100);
+            cdh.m_relative_offset_to_local_header = static_cast<uint32_t>(idx * 1000);
+
+            // an unknown extra field: header ID, size, and data
+            //
+            size_t const data_len(rand() % 50 + idx);
+            cdh.m_extra_field.push_back(0x34);
+            cdh.m_extra_field.push_back(0x12);
+            cdh.m_extra_field.push_back(static_cast<unsigned char>(data_len));
+            cdh.m_extra_field.push_back(0);
+            for(size_t j(0); j < data_len; ++j)
+            {
+                cdh.m_extra_field.push_back(static_cast<unsigned char>(rand()));
+            }
+
+            size_t const comment_len(rand() % 100 + idx);
+            for(size_t j(0); j < comment_len; ++j)
+            {
+                cdh.m_file_comment += static_cast<char>('A' + rand() % 26);
+            }
+            cdh.write(ss);
+        }
+        std::string const data(ss.str());
+
+        std::istringstream is(data);
+        for(size_t idx(0); idx < headers.size(); ++idx)
+        {
+            zipios::ZipCentralDirectoryEntry entry;
+            entry.read(is);
+            REQUIRE(is);
+            REQUIRE(entry.isValid());
+            REQUIRE(entry.getName() == headers[idx].m_filename);
+            REQUIRE(entry.getSize() == idx * 100);
+            REQUIRE(entry.getEntryOffset() == static_cast<std::streampos>(idx * 1000));
+            REQUIRE(entry.getExtra() == headers[idx].m_extra_field);
+            REQUIRE(entry.getComment() == headers[idx].m_file_comment);
+        }
+        REQUIRE(is.tellg() == static_cast<std::streampos>(data.length()));
+
+        // a truncated variable part fails
+        //
+        std::istringstream truncated(data.substr(0, data.length() - 1));
+        truncated.exceptions(std::ios::eofbit | std::ios::failbit | std::ios::badbit);
+        for(size_t idx(0); idx < headers.size() - 1; ++idx)
+        {
+            zipios::ZipCentralDirectoryEntry entry;
+            entry.read(truncated);
+        }
+        zipios::ZipCentralDirectoryEntry entry;
+        REQUIRE_THROWS(entry.read(truncated));
+        REQUIRE_FALSE(entry.isValid());
+    }
+
+    SECTION("create files with End of Central Directory too far from the end")
+    {
+        // the comment cannot be more than 65535 bytes so an End of
+        // Central Directory further away cannot be the right one
+        //
+        zipios_test::auto_unlink_t auto_unlink("file.zip");
+        {
+            std::ofstream os("file.zip", std::ios::out | std::ios::binary);
+
+            end_of_central_directory_t eocd;
+            eocd.write(os);
+
+            for(size_t j(0); j < 65536; ++j)
+            {
+                os << static_cast<char>('A' + rand() % 26);
+            }
+        }
+
+        REQUIRE_THROWS_AS([&](){
+                        zipios::ZipFile zf("file.zip");
+                    }(), zipios::FileCollectionException);
+    }
+
     SECTION("create files with End of Central Directory using counts that differ")
     {
         for(int i(0); i < 10; ++i)
@@ -1445,15 +1977,15 @@ TEST_CASE("Valid and Invalid ZipFile Archives", "[ZipFile] [FileCollection]")
                 end_of_central_directory_t eocd;
 
                 // use a valid compression method
-                lh.m_flags |= 1 << 3;  // <-- testing that trailing data is not supported!
-                lh.m_compression_method = static_cast<uint16_t>(g_supported_storage_methods[rand() % (sizeof(g_supported_storage_methods) / sizeof(g_supported_storage_methods[0]))]);
+                lh.m_flags |= 1 << 3;  // <-- the CRC and sizes come from the Central Directory
+                lh.m_compression_method = static_cast<uint16_t>(zipios::StorageMethod::STORED);
                 lh.m_filename = "invalid";
                 lh.write(os);
 
                 eocd.m_central_directory_offset = os.tellp();
 
                 cdh.m_compression_method = lh.m_compression_method;
-                cdh.m_flags = lh.m_flags;
+                cdh.m_flags = (i & 1) == 0 ? lh.m_flags : 0;
                 cdh.m_filename = "invalid";
                 cdh.write(os);
 
@@ -1463,8 +1995,20 @@ TEST_CASE("Valid and Invalid ZipFile Archives", "[ZipFile] [FileCollection]")
                 eocd.write(os);
             }
 
-            zipios::ZipFile zf("file.zip");
-            REQUIRE_THROWS_AS(zf.getInputStream("invalid"), zipios::FileCollectionException);
+            if((i & 1) == 0)
+            {
+                zipios::ZipFile zf("file.zip");
+                zipios::FileCollection::stream_pointer_t is(zf.getInputStream("invalid"));
+                REQUIRE(is != nullptr);
+                REQUIRE(is->get() == std::char_traits<char>::eof());
+            }
+            else
+            {
+                // the flags of the local header and Central Directory differ
+                REQUIRE_THROWS_AS([&](){
+                            zipios::ZipFile zf("file.zip");
+                        }(), zipios::FileCollectionException);
+            }
         }
     }
 
@@ -1556,7 +2100,144 @@ TEST_CASE("Valid and Invalid ZipFile Archives", "[ZipFile] [FileCollection]")
         }
     }
 
-/** \todo
+    SECTION("open files with a mismatched compression method at each validation level")
+    {
+        zipios_test::auto_unlink_t auto_unlink("file.zip");
+        {
+            std::ofstream os("file.zip", std::ios::out | std::ios::binary);
+
+            local_header_t lh;
+            central_directory_header_t cdh;
+            end_of_central_directory_t eocd;
+
+            lh.m_compression_method = static_cast<uint16_t>(zipios::StorageMethod::STORED);
+            lh.m_filename = "invalid";
+            lh.write(os);
+
+            eocd.m_central_directory_offset = os.tellp();
+
+            cdh.m_compression_method = static_cast<uint16_t>(zipios::StorageMethod::DEFLATED);
+            cdh.m_flags = lh.m_flags;
+            cdh.m_filename = "invalid";
+            cdh.write(os);
+
+            eocd.m_file_count = 1;
+            eocd.m_total_count = 1;
+            eocd.m_central_directory_size = 46 + 7; // structure + filename
+            eocd.write(os);
+        }
+
+        {
+            zipios::ZipFile zf("file.zip", 0, 0, zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::ValidationLevel::NONE);
+            REQUIRE(zf.getValidationLevel() == zipios::ZipFile::ValidationLevel::NONE);
+            REQUIRE(zf.size() == 1);
+            REQUIRE(zf.getInputStream("invalid") != nullptr);
+        }
+
+        {
+            zipios::ZipFile zf("file.zip", 0, 0, zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::ValidationLevel::CENTRAL_DIRECTORY);
+            REQUIRE(zf.getValidationLevel() == zipios::ZipFile::ValidationLevel::CENTRAL_DIRECTORY);
+            REQUIRE(zf.getInputStream("invalid") != nullptr);
+        }
+
+        for(int mode(0); mode < 2; ++mode)
+        {
+            zipios::ZipFile zf("file.zip", 0, 0, mode == 0 ? zipios::ZipFile::AccessMode::STREAM : zipios::ZipFile::AccessMode::MEMORY_MAP, zipios::ZipFile::ValidationLevel::LAZY);
+            REQUIRE(zf.getValidationLevel() == zipios::ZipFile::ValidationLevel::LAZY);
+            REQUIRE(zf.size() == 1);
+            REQUIRE_THROWS_AS(zf.getInputStream("invalid"), zipios::FileCollectionException);
+
+            // the entry was not marked as verified so it fails again
+            REQUIRE_THROWS_AS(zf.getInputStream("invalid"), zipios::FileCollectionException);
+        }
+
+        REQUIRE_THROWS_AS([&](){
+                    zipios::ZipFile zf("file.zip", 0, 0, zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::ValidationLevel::FULL);
+                }(), zipios::FileCollectionException);
+    }
+
+    SECTION("open files with an erroneous central directory size at each validation level")
+    {
+        zipios_test::auto_unlink_t auto_unlink("file.zip");
+        {
+            std::ofstream os("file.zip", std::ios::out | std::ios::binary);
+
+            local_header_t lh;
+            central_directory_header_t cdh;
+            end_of_central_directory_t eocd;
+
+            lh.m_compression_method = static_cast<uint16_t>(zipios::StorageMethod::STORED);
+            lh.m_filename = "valid";
+            lh.write(os);
+
+            eocd.m_central_directory_offset = os.tellp();
+
+            cdh.m_compression_method = lh.m_compression_method;
+            cdh.m_flags = lh.m_flags;
+            cdh.m_filename = "valid";
+            cdh.write(os);
+
+            eocd.m_file_count = 1;
+            eocd.m_total_count = 1;
+            eocd.m_central_directory_size = 46 + 5 + 3; // structure + filename + erroneous size
+            eocd.write(os);
+        }
+
+        {
+            zipios::ZipFile zf("file.zip", 0, 0, zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::ValidationLevel::NONE);
+            REQUIRE(zf.size() == 1);
+            zipios::ZipFile::stream_pointer_t is(zf.getInputStream("valid"));
+            REQUIRE(is != nullptr);
+            char buf[16];
+            is->read(buf, sizeof(buf));
+            REQUIRE(is->gcount() == 0);
+        }
+
+        REQUIRE_THROWS_AS([&](){
+                    zipios::ZipFile zf("file.zip", 0, 0, zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::ValidationLevel::CENTRAL_DIRECTORY);
+                }(), zipios::FileCollectionException);
+        REQUIRE_THROWS_AS([&](){
+                    zipios::ZipFile zf("file.zip", 0, 0, zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::ValidationLevel::LAZY);
+                }(), zipios::FileCollectionException);
+    }
+
+    SECTION("truncate a file after it was opened with the lazy validation")
+    {
+        zipios_test::auto_unlink_t auto_unlink("file.zip");
+        {
+            std::ofstream os("file.zip", std::ios::out | std::ios::binary);
+
+            local_header_t lh;
+            central_directory_header_t cdh;
+            end_of_central_directory_t eocd;
+
+            lh.m_compression_method = static_cast<uint16_t>(zipios::StorageMethod::STORED);
+            lh.m_filename = "valid";
+            lh.write(os);
+
+            eocd.m_central_directory_offset = os.tellp();
+
+            cdh.m_compression_method = lh.m_compression_method;
+            cdh.m_flags = lh.m_flags;
+            cdh.m_filename = "valid";
+            cdh.write(os);
+
+            eocd.m_file_count = 1;
+            eocd.m_total_count = 1;
+            eocd.m_central_directory_size = 46 + 5; // structure + filename
+            eocd.write(os);
+        }
+
+        zipios::ZipFile zf("file.zip", 0, 0, zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::ValidationLevel::LAZY);
+        REQUIRE(zf.size() == 1);
+
+        // the local header is found but its filename cannot be read
+        //
+        REQUIRE(truncate("file.zip", 30 + 2) == 0);
+        REQUIRE_THROWS_WITH(zf.getRawInputStream("valid"), Catch::Contains("Local header of an entry not found"));
+    }
+
+/** \todo
  * Once clang is fixed, remove those tests. clang does not clear the
  * std::unchecked_exception() flag when we have a re-throw in a catch.
  * In this case we have a problem with the exception raised in
@@ -1644,12 +2325,2449 @@ TEST_CASE("Valid and Invalid ZipFile Archives", "[ZipFile] [FileCollection]")
             REQUIRE(in->bad());
             REQUIRE(in->fail());
             REQUIRE(amount_read != uncompressed_size);
+
+            // reading the whole entry at once fails too
+            REQUIRE_THROWS_AS(zf.readEntry("invalid"), zipios::IOException);
         }
     }
 #endif
 }
 
 
+TEST_CASE("Zip64 ZipFile Archives", "[ZipFile] [FileCollection] [Zip64]")
+{
+    SECTION("open an archive with more than 65535 entries")
+    {
+        zipios_test::auto_unlink_t auto_unlink("file.zip");
+        size_t const count(70000);
+        {
+            std::ofstream os("file.zip", std::ios::out | std::ios::binary);
+
+            std::vector<uint32_t> offsets;
+            std::vector<uint32_t> times;
+            for(size_t i(0); i < count; ++i)
+            {
+                offsets.push_back(os.tellp());
+                local_header_t lh;
+                lh.m_filename = "dir/file" + std::to_string(i) + ".txt";
+                lh.write(os);
+                times.push_back(lh.m_time_and_date);
+            }
+
+            uint64_t const cd_offset(os.tellp());
+            for(size_t i(0); i < count; ++i)
+            {
+                central_directory_header_t cdh;
+                cdh.m_filename = "dir/file" + std::to_string(i) + ".txt";
+                cdh.m_time_and_date = times[i];
+                cdh.m_relative_offset_to_local_header = offsets[i];
+                cdh.write(os);
+            }
+
+            zip64_end_of_central_directory_t zip64;
+            zip64.m_file_count = count;
+            zip64.m_total_count = count;
+            zip64.m_central_directory_offset = cd_offset;
+            zip64.m_central_directory_size = static_cast<uint64_t>(os.tellp()) - cd_offset;
+            zip64.m_record_offset = os.tellp();
+            zip64.write(os);
+
+            end_of_central_directory_t eocd;
+            eocd.m_file_count = 0xFFFF;
+            eocd.m_total_count = 0xFFFF;
+            eocd.m_central_directory_size = 0xFFFFFFFF;
+            eocd.m_central_directory_offset = 0xFFFFFFFF;
+            eocd.write(os);
+        }
+
+        for(auto mode : { zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::AccessMode::MEMORY_MAP })
+        {
+            zipios::ZipFile zf("file.zip", 0, 0, mode);
+            REQUIRE(zf.size() == count);
+            REQUIRE(zf.getEntry("dir/file0.txt"));
+            REQUIRE(zf.getEntry("file65536.txt", zipios::FileCollection::MatchPath::IGNORE));
+            zipios::FileEntry::pointer_t last(zf.getEntry("dir/file69999.txt"));
+            REQUIRE(last);
+            REQUIRE(last->getSize() == 0);
+            zipios::FileCollection::stream_pointer_t is(zf.getInputStream("dir/file69999.txt"));
+            REQUIRE(is);
+            REQUIRE(is->get() == EOF);
+            REQUIRE(zf.entries().size() == count);
+        }
+    }
+
+    SECTION("open an archive with a Zip64 locator pointing to an invalid record")
+    {
+        zipios_test::auto_unlink_t auto_unlink("file.zip");
+        {
+            std::ofstream os("file.zip", std::ios::out | std::ios::binary);
+
+            zip64_end_of_central_directory_t zip64;
+            zip64.m_signature = 0x06064B51;
+            zip64.write(os);
+
+            end_of_central_directory_t eocd;
+            eocd.write(os);
+        }
+
+        REQUIRE_THROWS_AS([&](){
+                        zipios::ZipFile zf("file.zip");
+                    }(), zipios::FileCollectionException);
+    }
+
+    SECTION("open an archive with an entry starting after 4Gb")
+    {
+        // this creates a sparse file of a little over 4Gb
+        zipios_test::auto_unlink_t auto_unlink("file.zip");
+        uint64_t const far_offset(0x100000000ULL + 1000);
+        {
+            std::ofstream os("file.zip", std::ios::out | std::ios::binary);
+
+            std::string const small_data("small");
+            local_header_t lh1;
+            lh1.m_filename = "small.txt";
+            lh1.m_crc32 = crc32(0L, reinterpret_cast<Bytef const *>(small_data.c_str()), small_data.length());
+            lh1.m_compressed_size = small_data.length();
+            lh1.m_uncompressed_size = small_data.length();
+            lh1.write(os);
+            os << small_data;
+
+            os.seekp(far_offset);
+            std::string const far_data("far away");
+            local_header_t lh2;
+            lh2.m_filename = "far.txt";
+            lh2.m_crc32 = crc32(0L, reinterpret_cast<Bytef const *>(far_data.c_str()), far_data.length());
+            lh2.m_compressed_size = far_data.length();
+            lh2.m_uncompressed_size = far_data.length();
+            lh2.write(os);
+            os << far_data;
+
+            uint64_t const cd_offset(os.tellp());
+            central_directory_header_t cdh1;
+            cdh1.m_filename = lh1.m_filename;
+            cdh1.m_time_and_date = lh1.m_time_and_date;
+            cdh1.m_crc32 = lh1.m_crc32;
+            cdh1.m_compressed_size = lh1.m_compressed_size;
+            cdh1.m_uncompressed_size = lh1.m_uncompressed_size;
+            cdh1.write(os);
+
+            central_directory_header_t cdh2;
+            cdh2.m_filename = lh2.m_filename;
+            cdh2.m_time_and_date = lh2.m_time_and_date;
+            cdh2.m_crc32 = lh2.m_crc32;
+            cdh2.m_compressed_size = lh2.m_compressed_size;
+            cdh2.m_uncompressed_size = lh2.m_uncompressed_size;
+            cdh2.m_relative_offset_to_local_header = 0xFFFFFFFF;
+            cdh2.m_extra_field = zip64_end_of_central_directory_t::extra_field({ far_offset });
+            cdh2.write(os);
+
+            zip64_end_of_central_directory_t zip64;
+            zip64.m_file_count = 2;
+            zip64.m_total_count = 2;
+            zip64.m_central_directory_offset = cd_offset;
+            zip64.m_central_directory_size = static_cast<uint64_t>(os.tellp()) - cd_offset;
+            zip64.m_record_offset = os.tellp();
+            zip64.write(os);
+
+            end_of_central_directory_t eocd;
+            eocd.m_file_count = 2;
+            eocd.m_total_count = 2;
+            eocd.m_central_directory_size = zip64.m_central_directory_size;
+            eocd.m_central_directory_offset = 0xFFFFFFFF;
+            eocd.write(os);
+        }
+
+        for(auto mode : { zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::AccessMode::MEMORY_MAP })
+        {
+            zipios::ZipFile zf("file.zip", 0, 0, mode);
+            REQUIRE(zf.size() == 2);
+
+            zipios::FileEntry::pointer_t far(zf.getEntry("far.txt"));
+            REQUIRE(far);
+            REQUIRE(static_cast<uint64_t>(far->getEntryOffset()) == far_offset);
+
+            zipios::FileCollection::stream_pointer_t is(zf.getInputStream("far.txt"));
+            REQUIRE(is);
+            std::string content;
+            std::getline(*is, content);
+            REQUIRE(content == "far away");
+
+            is = zf.getInputStream("small.txt");
+            REQUIRE(is);
+            std::getline(*is, content);
+            REQUIRE(content == "small");
+        }
+    }
+
+    SECTION("open an archive with an entry larger than 4Gb")
+    {
+        // this creates a sparse file of a little over 4Gb
+        zipios_test::auto_unlink_t auto_unlink("file.zip");
+        std::string const end_marker("END!");
+        uint64_t const size(0x100000000ULL + end_marker.length());
+        {
+            std::ofstream os("file.zip", std::ios::out | std::ios::binary);
+
+            // the data is 4Gb of zeroes followed by the end marker
+            // (compute the CRC of the zeroes by doubling 1Mb of zeroes)
+            std::vector<Bytef> const zeroes(1024 * 1024, 0);
+            uLong crc(crc32(0L, zeroes.data(), zeroes.size()));
+            for(uint64_t length(zeroes.size()); length < 0x100000000ULL; length *= 2)
+            {
+                crc = crc32_combine(crc, crc, length);
+            }
+            crc = crc32_combine(crc, crc32(0L, reinterpret_cast<Bytef const *>(end_marker.c_str()), end_marker.length()), end_marker.length());
+
+            local_header_t lh;
+            lh.m_filename = "big.bin";
+            lh.m_version = 45;
+            lh.m_crc32 = crc;
+            lh.m_compressed_size = 0xFFFFFFFF;
+            lh.m_uncompressed_size = 0xFFFFFFFF;
+            lh.m_extra_field = zip64_end_of_central_directory_t::extra_field({ size, size });
+            lh.write(os);
+
+            uint64_t const data_offset(os.tellp());
+            os.seekp(data_offset + size - end_marker.length());
+            os << end_marker;
+
+            uint64_t const cd_offset(os.tellp());
+            central_directory_header_t cdh;
+            cdh.m_filename = lh.m_filename;
+            cdh.m_extract_version = 45;
+            cdh.m_time_and_date = lh.m_time_and_date;
+            cdh.m_crc32 = lh.m_crc32;
+            cdh.m_compressed_size = 0xFFFFFFFF;
+            cdh.m_uncompressed_size = 0xFFFFFFFF;
+            cdh.m_extra_field = zip64_end_of_central_directory_t::extra_field({ size, size });
+            cdh.write(os);
+
+            zip64_end_of_central_directory_t zip64;
+            zip64.m_file_count = 1;
+            zip64.m_total_count = 1;
+            zip64.m_central_directory_offset = cd_offset;
+            zip64.m_central_directory_size = static_cast<uint64_t>(os.tellp()) - cd_offset;
+            zip64.m_record_offset = os.tellp();
+            zip64.write(os);
+
+            end_of_central_directory_t eocd;
+            eocd.m_file_count = 1;
+            eocd.m_total_count = 1;
+            eocd.m_central_directory_size = zip64.m_central_directory_size;
+            eocd.m_central_directory_offset = 0xFFFFFFFF;
+            eocd.write(os);
+        }
+
+        {
+            zipios::ZipFile zf("file.zip");
+            REQUIRE(zf.size() == 1);
+            zipios::FileEntry::pointer_t big(zf.getEntry("big.bin"));
+            REQUIRE(big);
+            REQUIRE(big->getSize() == size);
+            REQUIRE(big->getCompressedSize() == size);
+        }
+
+        {
+            // read the whole entry from memory, it is much faster
+            zipios::ZipFile zf("file.zip", 0, 0, zipios::ZipFile::AccessMode::MEMORY_MAP);
+            zipios::FileCollection::stream_pointer_t is(zf.getInputStream("big.bin"));
+            REQUIRE(is);
+            std::vector<char> buf(1024 * 1024);
+            uint64_t total(0);
+            std::string last;
+            while(*is)
+            {
+                is->read(buf.data(), buf.size());
+                std::streamsize const r(is->gcount());
+                if(r >= static_cast<std::streamsize>(end_marker.length()))
+                {
+                    last = std::string(buf.data() + r - end_marker.length(), end_marker.length());
+                }
+                total += r;
+            }
+            REQUIRE(total == size);
+            REQUIRE(last == end_marker);
+        }
+    }
+
+    SECTION("open an embedded archive starting after 4Gb")
+    {
+        // this creates a sparse file of a little over 4Gb
+        zipios_test::auto_unlink_t auto_unlink("file.bin");
+        uint64_t const zip_start(0x100000000ULL + 123);
+        {
+            std::ofstream os("file.bin", std::ios::out | std::ios::binary);
+            os << "some executable";
+            os.seekp(zip_start);
+
+            std::string const data("embedded");
+            local_header_t lh;
+            lh.m_filename = "embedded.txt";
+            lh.m_crc32 = crc32(0L, reinterpret_cast<Bytef const *>(data.c_str()), data.length());
+            lh.m_compressed_size = data.length();
+            lh.m_uncompressed_size = data.length();
+            lh.write(os);
+            os << data;
+
+            uint64_t const cd_offset(static_cast<uint64_t>(os.tellp()) - zip_start);
+            central_directory_header_t cdh;
+            cdh.m_filename = lh.m_filename;
+            cdh.m_time_and_date = lh.m_time_and_date;
+            cdh.m_crc32 = lh.m_crc32;
+            cdh.m_compressed_size = lh.m_compressed_size;
+            cdh.m_uncompressed_size = lh.m_uncompressed_size;
+            cdh.write(os);
+
+            end_of_central_directory_t eocd;
+            eocd.m_file_count = 1;
+            eocd.m_total_count = 1;
+            eocd.m_central_directory_size = static_cast<uint64_t>(os.tellp()) - zip_start - cd_offset;
+            eocd.m_central_directory_offset = cd_offset;
+            eocd.write(os);
+
+            // 64 bit start offset followed by 0xFFFFFFFF
+            zip64_end_of_central_directory_t::write_value(os, zip_start, 8);
+            zip64_end_of_central_directory_t::write_value(os, 0xFFFFFFFF, 4);
+        }
+
+        zipios::ZipFile::pointer_t zf(zipios::ZipFile::openEmbeddedZipFile("file.bin"));
+        REQUIRE(zf->size() == 1);
+        zipios::FileCollection::stream_pointer_t is(zf->getInputStream("embedded.txt"));
+        REQUIRE(is);
+        std::string content;
+        std::getline(*is, content);
+        REQUIRE(content == "embedded");
+    }
+
+    SECTION("save an archive with an entry larger than 4Gb")
+    {
+        // the input is a sparse file of a little over 4Gb, the output
+        // is not sparse, it takes a few seconds to write it
+        zipios_test::auto_unlink_t remove_big("big.bin");
+        zipios_test::auto_unlink_t remove_small("small.txt");
+        zipios_test::auto_unlink_t remove_zip("file.zip");
+        std::string const end_marker("END!");
+        uint64_t const size(0x100000000ULL + end_marker.length());
+        {
+            std::ofstream os("big.bin", std::ios::out | std::ios::binary);
+            os.seekp(size - end_marker.length());
+            os << end_marker;
+        }
+        {
+            std::ofstream os("small.txt", std::ios::out | std::ios::binary);
+            os << "small" << std::endl;
+        }
+
+        {
+            zipios::DirectoryCollection dc("big.bin");
+            zipios::FileEntry::vector_t v(dc.entries());
+            (*v.begin())->setLevel(zipios::FileEntry::COMPRESSION_LEVEL_NONE);
+            dc.addEntry(zipios::DirectoryEntry(zipios::FilePath("small.txt")));
+
+            std::ofstream out("file.zip", std::ios::out | std::ios::binary | std::ios::trunc);
+            zipios::ZipFile::saveCollectionToArchive(out, dc);
+        }
+
+        // the full validation compares all the local headers
+        zipios::ZipFile zf("file.zip");
+        REQUIRE(zf.size() == 2);
+
+        zipios::FileEntry::pointer_t big(zf.getEntry("big.bin"));
+        REQUIRE(big);
+        REQUIRE(big->getSize() == size);
+        REQUIRE(big->getCompressedSize() == size);
+        REQUIRE(big->getEntryOffset() == 0);
+
+        zipios::FileEntry::pointer_t small(zf.getEntry("small.txt"));
+        REQUIRE(small);
+        REQUIRE(static_cast<uint64_t>(small->getEntryOffset()) > size);
+
+        zipios::FileCollection::stream_pointer_t is(zf.getInputStream("small.txt"));
+        REQUIRE(is);
+        std::string content;
+        std::getline(*is, content);
+        REQUIRE(content == "small");
+
+        // the unzip tool also has to understand our Zip64 structures
+        REQUIRE(system("unzip -tqq file.zip >/dev/null") == 0);
+    }
+}
+
+
+TEST_CASE("ZipFile with an Index", "[ZipFile] [FileCollection] [Index]")
+{
+    REQUIRE(system("rm -f file.zip file.zip.index alpha.txt beta.txt gamma.txt") == 0); // clean up, just in case
+    zipios_test::auto_unlink_t remove_zip("file.zip");
+    zipios_test::auto_unlink_t remove_index("file.zip.index");
+    {
+        zipios_test::auto_unlink_t remove_alpha("alpha.txt");
+        zipios_test::auto_unlink_t remove_beta("beta.txt");
+        zipios_test::auto_unlink_t remove_gamma("gamma.txt");
+        char const * names[] = { "alpha.txt", "beta.txt", "gamma.txt" };
+        for(auto n : names)
+        {
+            std::ofstream os(n, std::ios::out | std::ios::binary);
+            os << "content of " << n << std::endl;
+        }
+        REQUIRE(system("zip -q file.zip alpha.txt beta.txt gamma.txt") == 0);
+    }
+
+    SECTION("create an index and then use it")
+    {
+        {
+            zipios::ZipFile zf("file.zip", 0, 0, zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::ValidationLevel::FULL, "file.zip.index");
+            REQUIRE(zf.size() == 3);
+        }
+        REQUIRE(access("file.zip.index", R_OK) == 0);
+
+        zipios::ZipFile reference("file.zip");
+        zipios::FileEntry::vector_t const expected(reference.entries());
+
+        for(auto mode : { zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::AccessMode::MEMORY_MAP })
+        {
+            for(auto level : { zipios::ZipFile::ValidationLevel::NONE
+                             , zipios::ZipFile::ValidationLevel::CENTRAL_DIRECTORY
+                             , zipios::ZipFile::ValidationLevel::LAZY
+                             , zipios::ZipFile::ValidationLevel::FULL })
+            {
+                zipios::ZipFile zf("file.zip", 0, 0, mode, level, "file.zip.index");
+                REQUIRE(zf.size() == 3);
+
+                zipios::FileEntry::vector_t const v(zf.entries());
+                REQUIRE(v.size() == expected.size());
+                for(size_t idx(0); idx < v.size(); ++idx)
+                {
+                    REQUIRE(v[idx]->isEqual(*expected[idx]));
+                    REQUIRE(v[idx]->getEntryOffset() == expected[idx]->getEntryOffset());
+                }
+
+                REQUIRE_FALSE(zf.getEntry("delta.txt"));
+                zipios::FileCollection::stream_pointer_t is(zf.getInputStream("beta.txt"));
+                REQUIRE(is);
+                std::string content;
+                std::getline(*is, content);
+                REQUIRE(content == "content of beta.txt");
+            }
+        }
+    }
+
+    SECTION("a damaged index is ignored or detected")
+    {
+        {
+            zipios::ZipFile zf("file.zip", 0, 0, zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::ValidationLevel::FULL, "file.zip.index");
+            REQUIRE(zf.size() == 3);
+        }
+
+        std::string data;
+        {
+            std::ifstream is("file.zip.index", std::ios::in | std::ios::binary);
+            data.assign(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+        }
+        auto save_index = [](std::string const & index)
+            {
+                std::ofstream os("file.zip.index", std::ios::out | std::ios::binary | std::ios::trunc);
+                os << index;
+            };
+
+        // a truncated index or a damaged header are not used and get
+        // replaced; the checksum of the Central Directory is at offset
+        // 20 in the header
+        //
+        {
+            std::string damaged(data);
+            damaged[20] ^= 0x55;
+            for(std::string const & index : { data.substr(0, data.length() - 8), damaged })
+            {
+                save_index(index);
+
+                zipios::ZipFile zf("file.zip", 0, 0, zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::ValidationLevel::CENTRAL_DIRECTORY, "file.zip.index");
+                REQUIRE(zf.size() == 3);
+                REQUIRE(zf.getEntry("alpha.txt"));
+                REQUIRE(zf.getEntry("gamma.txt", zipios::FileCollection::MatchPath::IGNORE));
+                REQUIRE_FALSE(zf.getEntry("delta.txt"));
+
+                std::ifstream is("file.zip.index", std::ios::in | std::ios::binary);
+                REQUIRE(std::string(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>()) == data);
+            }
+        }
+
+        // the records and hash tables are not verified when loading the
+        // index, only once used; with 3 entries, each hash table has 8
+        // slots and the records come just before them
+        //
+        size_t const hash_tables_size(2 * 8 * sizeof(uint32_t));
+        {
+            std::string damaged(data);
+            for(size_t idx(1); idx <= hash_tables_size; ++idx)
+            {
+                damaged[damaged.length() - idx] = static_cast<char>(0xFF);
+            }
+            save_index(damaged);
+
+            zipios::ZipFile zf("file.zip", 0, 0, zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::ValidationLevel::CENTRAL_DIRECTORY, "file.zip.index");
+            REQUIRE(zf.size() == 3);
+            REQUIRE_THROWS_AS(zf.getEntry("alpha.txt"), zipios::FileCollectionException);
+            REQUIRE_THROWS_AS(zf.getEntry("gamma.txt", zipios::FileCollection::MatchPath::IGNORE), zipios::FileCollectionException);
+        }
+        {
+            std::string damaged(data);
+            size_t const records_offset(damaged.length() - hash_tables_size - 3 * sizeof(zipios::ZipEntryTable::record_t));
+            for(size_t idx(0); idx < 3; ++idx)
+            {
+                size_t const pos(records_offset + idx * sizeof(zipios::ZipEntryTable::record_t) + offsetof(zipios::ZipEntryTable::record_t, m_header_offset));
+                damaged.replace(pos, 4, 4, static_cast<char>(0xFF));
+            }
+            save_index(damaged);
+
+            zipios::ZipFile zf("file.zip", 0, 0, zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::ValidationLevel::CENTRAL_DIRECTORY, "file.zip.index");
+            REQUIRE(zf.size() == 3);
+            REQUIRE_THROWS_AS(zf.getEntry("alpha.txt"), zipios::FileCollectionException);
+            REQUIRE_THROWS_AS(zf.entries(), zipios::FileCollectionException);
+        }
+    }
+
+    SECTION("an index which does not match the archive is replaced")
+    {
+        {
+            zipios::ZipFile zf("file.zip", 0, 0, zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::ValidationLevel::FULL, "file.zip.index");
+            REQUIRE(zf.getEntry("alpha.txt"));
+        }
+
+        // rename "alpha.txt" in the local header and the Central Directory
+        // without changing the size or modification time of the archive
+        //
+        struct stat st;
+        REQUIRE(stat("file.zip", &st) == 0);
+        {
+            std::string data;
+            {
+                std::ifstream is("file.zip", std::ios::in | std::ios::binary);
+                data.assign(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+            }
+            for(size_t pos(data.find("alpha.txt")); pos != std::string::npos; pos = data.find("alpha.txt", pos))
+            {
+                data[pos] = 'A';
+            }
+            std::ofstream os("file.zip", std::ios::out | std::ios::binary | std::ios::trunc);
+            os << data;
+        }
+        struct utimbuf times;
+        times.actime = st.st_atime;
+        times.modtime = st.st_mtime;
+        REQUIRE(utime("file.zip", &times) == 0);
+
+        // without the full validation, the index is trusted as is
+        {
+            zipios::ZipFile zf("file.zip", 0, 0, zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::ValidationLevel::CENTRAL_DIRECTORY, "file.zip.index");
+            REQUIRE(zf.getEntry("alpha.txt"));
+            REQUIRE_FALSE(zf.getEntry("Alpha.txt"));
+        }
+
+        // the full validation detects that the Central Directory changed
+        // and replaces the index
+        {
+            zipios::ZipFile zf("file.zip", 0, 0, zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::ValidationLevel::FULL, "file.zip.index");
+            REQUIRE_FALSE(zf.getEntry("alpha.txt"));
+            REQUIRE(zf.getEntry("Alpha.txt"));
+        }
+        {
+            zipios::ZipFile zf("file.zip", 0, 0, zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::ValidationLevel::CENTRAL_DIRECTORY, "file.zip.index");
+            REQUIRE_FALSE(zf.getEntry("alpha.txt"));
+            REQUIRE(zf.getEntry("Alpha.txt"));
+        }
+
+        // a different modification time invalidates the index
+        {
+            std::string data;
+            {
+                std::ifstream is("file.zip", std::ios::in | std::ios::binary);
+                data.assign(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+            }
+            for(size_t pos(data.find("Alpha.txt")); pos != std::string::npos; pos = data.find("Alpha.txt", pos))
+            {
+                data[pos] = 'a';
+            }
+            std::ofstream os("file.zip", std::ios::out | std::ios::binary | std::ios::trunc);
+            os << data;
+        }
+        times.modtime = st.st_mtime - 100;
+        REQUIRE(utime("file.zip", &times) == 0);
+        {
+            zipios::ZipFile zf("file.zip", 0, 0, zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::ValidationLevel::CENTRAL_DIRECTORY, "file.zip.index");
+            REQUIRE(zf.getEntry("alpha.txt"));
+            REQUIRE_FALSE(zf.getEntry("Alpha.txt"));
+        }
+
+        // an invalid index file is replaced
+        {
+            std::ofstream os("file.zip.index", std::ios::out | std::ios::binary | std::ios::trunc);
+            os << "garbage";
+        }
+        {
+            zipios::ZipFile zf("file.zip", 0, 0, zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::ValidationLevel::CENTRAL_DIRECTORY, "file.zip.index");
+            REQUIRE(zf.size() == 3);
+            REQUIRE(zf.getEntry("beta.txt"));
+        }
+        REQUIRE(zipios::FilePath("file.zip.index").fileSize() > 100);
+
+        // failing to save the index is not an error
+        {
+            zipios::ZipFile zf("file.zip", 0, 0, zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::ValidationLevel::CENTRAL_DIRECTORY, "no-such-directory/file.zip.index");
+            REQUIRE(zf.size() == 3);
+        }
+    }
+}
+
+
+
+TEST_CASE("ZipFile directory listing", "[ZipFile] [FileCollection] [CollectionCollection]")
+{
+    REQUIRE(system("rm -rf textures listing.zip") == 0); // clean up, just in case
+    zipios_test::auto_unlink_t remove_zip("listing.zip");
+    REQUIRE(system("mkdir -p textures/level2 textures/level3/sub textures/level30") == 0);
+    char const * files[] = {
+        "readme.txt",
+        "textures/level2/e.png",
+        "textures/level3/a.png",
+        "textures/level3/b.jpg",
+        "textures/level3/sub/c.png",
+        "textures/level30/d.png",
+    };
+    for(auto f : files)
+    {
+        std::ofstream os(f, std::ios::out | std::ios::binary);
+        os << "content of " << f << std::endl;
+    }
+    REQUIRE(system("zip -qr listing.zip readme.txt textures") == 0);
+    REQUIRE(system("rm -rf textures readme.txt") == 0);
+
+    auto names = [](zipios::FileEntry::vector_t const & v)
+        {
+            std::vector<std::string> result;
+            for(auto const & e : v)
+            {
+                result.push_back(e->getName());
+            }
+            return result;
+        };
+
+    auto check = [&names](zipios::FileCollection const & fc)
+        {
+            REQUIRE(names(fc.listDirectory("")) == std::vector<std::string>({ "readme.txt", "textures" }));
+            REQUIRE(names(fc.listDirectory("textures/level3")) == std::vector<std::string>({ "textures/level3/a.png", "textures/level3/b.jpg", "textures/level3/sub" }));
+            REQUIRE(names(fc.listDirectory("textures/level3/", true)) == std::vector<std::string>({ "textures/level3/a.png", "textures/level3/b.jpg", "textures/level3/sub", "textures/level3/sub/c.png" }));
+            REQUIRE(names(fc.listDirectory("textures", false)) == std::vector<std::string>({ "textures/level2", "textures/level3", "textures/level30" }));
+            REQUIRE(fc.listDirectory("textures/level4").empty());
+            REQUIRE(fc.listDirectory("readme.txt").empty());
+
+            REQUIRE(names(fc.glob("textures/level3*/*.png")) == std::vector<std::string>({ "textures/level3/a.png", "textures/level30/d.png" }));
+            REQUIRE(names(fc.glob("**.png")) == std::vector<std::string>({ "textures/level2/e.png", "textures/level3/a.png", "textures/level3/sub/c.png", "textures/level30/d.png" }));
+            REQUIRE(names(fc.glob("textures/level[!0-2]/?.*")) == std::vector<std::string>({ "textures/level3/a.png", "textures/level3/b.jpg" }));
+            REQUIRE(names(fc.glob("*")) == std::vector<std::string>({ "readme.txt", "textures" }));
+            REQUIRE(names(fc.glob("readme.txt")) == std::vector<std::string>({ "readme.txt" }));
+            REQUIRE(names(fc.glob("readme\\.txt")) == std::vector<std::string>({ "readme.txt" }));
+            REQUIRE(fc.glob("*.png").empty());
+        };
+
+    SECTION("search the compact table")
+    {
+        zipios::ZipFile zf("listing.zip");
+        check(zf);
+    }
+
+    SECTION("search the loaded entries")
+    {
+        zipios::ZipFile zf("listing.zip");
+        REQUIRE(zf.entries().size() == 11);
+        check(zf);
+
+        zipios::FileCollection::pointer_t copy(zf.clone());
+        check(*copy);
+    }
+
+    SECTION("search a collection of collections")
+    {
+        zipios::CollectionCollection cc;
+        cc.addCollection(zipios::FileCollection::pointer_t(new zipios::ZipFile("listing.zip")));
+        check(cc);
+
+        cc.addCollection(zipios::FileCollection::pointer_t(new zipios::ZipFile("listing.zip")));
+        REQUIRE(names(cc.listDirectory("textures/level3")) == std::vector<std::string>({ "textures/level3/a.png", "textures/level3/a.png", "textures/level3/b.jpg", "textures/level3/b.jpg", "textures/level3/sub", "textures/level3/sub" }));
+        REQUIRE(cc.glob("**.png").size() == 8);
+    }
+}
+
+
+TEST_CASE("ZipFile concurrent reads", "[ZipFile] [FileCollection] [Threads]")
+{
+    REQUIRE(system("rm -rf tree") == 0); // clean up, just in case
+    zipios_test::file_t tree(zipios_test::file_t::type_t::DIRECTORY, rand() % 40 + 80, "tree");
+    zipios_test::auto_unlink_t remove_zip("tree.zip");
+    REQUIRE(system("zip -r tree.zip tree >/dev/null") == 0);
+
+    for(auto mode : { zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::AccessMode::MEMORY_MAP })
+    {
+        zipios::ZipFile zf("tree.zip", 0, 0, mode, zipios::ZipFile::ValidationLevel::LAZY);
+
+        // gather the expected data before starting the threads
+        //
+        std::vector<std::string> names;
+        std::vector<std::string> expected;
+        {
+            zipios::ZipFile reference("tree.zip");
+            zipios::FileEntry::vector_t const v(reference.entries());
+            for(auto it(v.begin()); it != v.end(); ++it)
+            {
+                if(!(*it)->isDirectory())
+                {
+                    names.push_back((*it)->getName());
+                    std::ifstream in((*it)->getName(), std::ios::in | std::ios::binary);
+                    std::stringstream data;
+                    data << in.rdbuf();
+                    expected.push_back(data.str());
+                }
+            }
+        }
+        size_t const total_entries(zf.size());
+        size_t const total_tree(zf.listDirectory("tree", true).size());
+
+        // Catch is not thread safe, the threads only count errors
+        //
+        std::atomic<size_t> errors(0);
+        std::atomic<size_t> reads(0);
+        std::vector<std::thread> threads;
+        size_t const thread_count(8);
+        for(size_t t(0); t < thread_count; ++t)
+        {
+            threads.push_back(std::thread([&, t]()
+                {
+                    for(int repeat(0); repeat < 3; ++repeat)
+                    {
+                        for(size_t n(0); n < names.size(); ++n)
+                        {
+                            // each thread starts at a different entry
+                            size_t const idx((n + t * 7) % names.size());
+                            zipios::FileEntry::pointer_t entry(zf.getEntry(names[idx]));
+                            if(entry == nullptr
+                            || entry->getSize() != expected[idx].length())
+                            {
+                                ++errors;
+                            }
+                            zipios::FileCollection::stream_pointer_t is(zf.getInputStream(names[idx]));
+                            if(is == nullptr)
+                            {
+                                ++errors;
+                                continue;
+                            }
+                            std::stringstream data;
+                            data << is->rdbuf();
+                            if(data.str() != expected[idx])
+                            {
+                                ++errors;
+                            }
+                            ++reads;
+                        }
+
+                        // in the middle of the reads, some threads
+                        // load all the entries and others search them
+                        //
+                        if(t % 2 == 0)
+                        {
+                            if(zf.entries().size() != total_entries)
+                            {
+                                ++errors;
+                            }
+                        }
+                        if(zf.listDirectory("tree", true).size() != total_tree
+                        || zf.size() != total_entries)
+                        {
+                            ++errors;
+                        }
+                    }
+                }));
+        }
+        for(auto & th : threads)
+        {
+            th.join();
+        }
+
+        REQUIRE(errors == 0);
+        REQUIRE(reads == thread_count * 3 * names.size());
+    }
+}
+
+
+TEST_CASE("ZipFile pooled inflate states", "[ZipFile] [FileCollection] [Threads]")
+{
+    REQUIRE(system("rm -rf pool") == 0); // clean up, just in case
+    REQUIRE(mkdir("pool", 0777) == 0);
+    zipios_test::auto_unlink_t remove_zip("pool.zip");
+
+    // more entries than the pool keeps states and large enough to
+    // need several buffers each
+    //
+    std::vector<std::string> names;
+    std::vector<std::string> expected;
+    for(int i(0); i < 40; ++i)
+    {
+        std::string data;
+        size_t const size(rand() % 100000 + 1);
+        while(data.length() < size)
+        {
+            data += std::string(rand() % 30 + 1, static_cast<char>('a' + rand() % 26));
+        }
+        data.resize(size);
+        names.push_back("pool/file" + std::to_string(i) + ".txt");
+        expected.push_back(data);
+        std::ofstream os(names.back(), std::ios::out | std::ios::binary);
+        os << data;
+    }
+    {
+        zipios::DirectoryCollection dc("pool");
+        dc.setMethod([](zipios::FileEntry const &)
+            {
+                return zipios::StorageMethod::DEFLATED;
+            });
+        std::ofstream out("pool.zip", std::ios::out | std::ios::binary);
+        zipios::ZipFile::saveCollectionToArchive(out, dc);
+    }
+
+    auto read_stream = [](zipios::FileCollection::stream_pointer_t is)
+        {
+            std::stringstream ss;
+            ss << is->rdbuf();
+            return ss.str();
+        };
+
+    SECTION("streams opened and destroyed in sequence")
+    {
+        for(auto mode : { zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::AccessMode::MEMORY_MAP })
+        {
+            zipios::ZipFile zf("pool.zip", 0, 0, mode);
+            zf.setCrcVerification(true);
+            for(int repeat(0); repeat < 3; ++repeat)
+            {
+                for(size_t idx(0); idx < names.size(); ++idx)
+                {
+                    zipios::FileEntry::pointer_t entry(zf.getEntry(names[idx]));
+                    REQUIRE(entry != nullptr);
+                    REQUIRE(entry->getMethod() == zipios::StorageMethod::DEFLATED);
+                    REQUIRE(read_stream(zf.getInputStream(names[idx])) == expected[idx]);
+
+                    // a stream destroyed in the middle of the data
+                    // gives back a state which has to be reset
+                    //
+                    zipios::FileCollection::stream_pointer_t is(zf.getInputStream(names[(idx + 1) % names.size()]));
+                    char buf[100];
+                    is->read(buf, sizeof(buf));
+                }
+
+                // more streams alive at once than the pool keeps
+                //
+                std::vector<zipios::FileCollection::stream_pointer_t> streams;
+                for(size_t idx(0); idx < names.size(); ++idx)
+                {
+                    streams.push_back(zf.getInputStream(names[idx]));
+                }
+                for(size_t idx(streams.size()); idx > 0; --idx)
+                {
+                    REQUIRE(read_stream(streams[idx - 1]) == expected[idx - 1]);
+                }
+            }
+        }
+    }
+
+    SECTION("streams opened and destroyed by several threads")
+    {
+        for(auto mode : { zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::AccessMode::MEMORY_MAP })
+        {
+            zipios::ZipFile zf("pool.zip", 0, 0, mode);
+
+            // Catch is not thread safe, the threads only count errors
+            //
+            std::atomic<size_t> errors(0);
+            std::atomic<size_t> reads(0);
+            std::vector<std::thread> threads;
+            size_t const thread_count(8);
+            for(size_t t(0); t < thread_count; ++t)
+            {
+                threads.push_back(std::thread([&, t]()
+                    {
+                        for(int repeat(0); repeat < 3; ++repeat)
+                        {
+                            for(size_t n(0); n < names.size(); ++n)
+                            {
+                                size_t const idx((n + t * 5) % names.size());
+                                zipios::FileCollection::stream_pointer_t is(zf.getInputStream(names[idx]));
+                                if(is == nullptr)
+                                {
+                                    ++errors;
+                                    continue;
+                                }
+                                if((n + t) % 3 == 0)
+                                {
+                                    // destroyed before the end
+                                    char buf[1000];
+                                    is->read(buf, sizeof(buf));
+                                    continue;
+                                }
+                                std::stringstream data;
+                                data << is->rdbuf();
+                                if(data.str() != expected[idx])
+                                {
+                                    ++errors;
+                                }
+                                ++reads;
+                            }
+                        }
+                    }));
+            }
+            for(auto & th : threads)
+            {
+                th.join();
+            }
+
+            REQUIRE(errors == 0);
+            REQUIRE(reads > 0);
+
+            // the states given back by the threads are still fine
+            //
+            for(size_t idx(0); idx < names.size(); ++idx)
+            {
+                REQUIRE(read_stream(zf.getInputStream(names[idx])) == expected[idx]);
+            }
+        }
+    }
+
+    SECTION("a stream outliving its ZipFile")
+    {
+        for(auto mode : { zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::AccessMode::MEMORY_MAP })
+        {
+            zipios::FileCollection::stream_pointer_t is;
+            std::string start;
+            {
+                zipios::ZipFile zf("pool.zip", 0, 0, mode);
+                is = zf.getInputStream(names[0]);
+                REQUIRE(is != nullptr);
+                char buf[100];
+                REQUIRE(is->read(buf, sizeof(buf)));
+                start = std::string(buf, sizeof(buf));
+            }
+            REQUIRE(start + read_stream(is) == expected[0]);
+            REQUIRE_FALSE(is->bad());
+
+            // the state goes back to the pool kept alive by the stream
+            //
+            is.reset();
+        }
+    }
+
+    REQUIRE(system("rm -rf pool") == 0);
+}
+
+
+TEST_CASE("ZipFile whole entry read", "[ZipFile] [FileCollection]")
+{
+    REQUIRE(system("rm -rf tree") == 0); // clean up, just in case
+    zipios_test::file_t tree(zipios_test::file_t::type_t::DIRECTORY, rand() % 40 + 40, "tree");
+    zipios_test::auto_unlink_t remove_deflated("tree.zip");
+    zipios_test::auto_unlink_t remove_stored("tree-stored.zip");
+    REQUIRE(system("zip -r tree.zip tree >/dev/null") == 0);
+    REQUIRE(system("zip -0 -r tree-stored.zip tree >/dev/null") == 0);
+
+    for(auto filename : { "tree.zip", "tree-stored.zip" })
+    {
+        for(auto mode : { zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::AccessMode::MEMORY_MAP })
+        {
+            for(auto level : { zipios::ZipFile::ValidationLevel::LAZY, zipios::ZipFile::ValidationLevel::FULL })
+            {
+                zipios::ZipFile zf(filename, 0, 0, mode, level);
+
+                zipios::FileEntry::vector_t const v(zf.entries());
+                for(auto it(v.begin()); it != v.end(); ++it)
+                {
+                    if((*it)->isDirectory())
+                    {
+                        continue;
+                    }
+                    std::string const name((*it)->getName());
+                    std::ifstream in(name, std::ios::in | std::ios::binary);
+                    std::stringstream expected;
+                    expected << in.rdbuf();
+                    std::string const data(expected.str());
+
+                    std::vector<char> const whole(zf.readEntry(name));
+                    REQUIRE(std::string(whole.begin(), whole.end()) == data);
+
+                    // a larger buffer is fine, only the data gets written
+                    //
+                    std::vector<char> buffer(data.length() + 10, '*');
+                    REQUIRE(zf.readEntry(name, &buffer[0], buffer.size()) == data.length());
+                    REQUIRE(std::string(buffer.begin(), buffer.begin() + data.length()) == data);
+                    REQUIRE(std::string(buffer.begin() + data.length(), buffer.end()) == "**********");
+
+                    if(!data.empty())
+                    {
+                        REQUIRE_THROWS_AS(zf.readEntry(name, &buffer[0], data.length() - 1), zipios::FileCollectionException);
+                    }
+
+                    // the stream returns the same data
+                    //
+                    zipios::FileCollection::stream_pointer_t is(zf.getInputStream(name));
+                    REQUIRE(is);
+                    std::stringstream streamed;
+                    streamed << is->rdbuf();
+                    REQUIRE(streamed.str() == data);
+                }
+
+                REQUIRE_THROWS_AS(zf.readEntry("this/entry/does/not/exist"), zipios::FileCollectionException);
+            }
+        }
+    }
+}
+
+TEST_CASE("ZipFile seeking in deflated entries", "[ZipFile] [FileCollection] [Checkpoints]")
+{
+    // create a large file which compresses in many deflate blocks
+    //
+    zipios_test::auto_unlink_t remove_log("large.log");
+    zipios_test::auto_unlink_t remove_zip("large.zip");
+    std::string data;
+    {
+        char const * words[] = { "zip", "file", "entry", "seek", "data", "checkpoint", "window", "inflate", "\n" };
+        size_t const size(rand() % (512 * 1024) + 3 * 1024 * 1024);
+        while(data.length() < size)
+        {
+            data += words[rand() % (sizeof(words) / sizeof(words[0]))];
+            data += std::to_string(rand() % 1000) + ' ';
+        }
+        std::ofstream os("large.log", std::ios::out | std::ios::binary);
+        os << data;
+    }
+    REQUIRE(system("zip large.zip large.log >/dev/null") == 0);
+
+    auto check_seeks = [&data](zipios::ZipFile & zf)
+        {
+            zipios::FileCollection::stream_pointer_t is(zf.getInputStream("large.log"));
+            REQUIRE(is);
+
+            // seek from the end
+            is->seekg(0, std::ios::end);
+            REQUIRE(static_cast<size_t>(is->tellg()) == data.length());
+
+            // random seeks, forward and backward
+            for(int i(0); i < 50; ++i)
+            {
+                size_t const pos(rand() % (data.length() - 100));
+                is->seekg(pos);
+                REQUIRE(is->good());
+                REQUIRE(static_cast<size_t>(is->tellg()) == pos);
+                char buf[100];
+                is->read(buf, sizeof(buf));
+                REQUIRE(is->gcount() == 100);
+                REQUIRE(std::string(buf, sizeof(buf)) == data.substr(pos, sizeof(buf)));
+
+                // a small relative seek stays within the buffer
+                is->seekg(-50, std::ios::cur);
+                REQUIRE(static_cast<size_t>(is->tellg()) == pos + 50);
+                REQUIRE(is->get() == data[pos + 50]);
+            }
+
+            // seeking past the end fails
+            is->seekg(data.length() + 1);
+            REQUIRE(is->fail());
+        };
+
+    for(auto mode : { zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::AccessMode::MEMORY_MAP })
+    {
+        SECTION(std::string("seek without checkpoints, ") + (mode == zipios::ZipFile::AccessMode::STREAM ? "stream" : "memory map"))
+        {
+            zipios::ZipFile zf("large.zip", 0, 0, mode);
+            REQUIRE(zf.getCheckpointInterval() == 0);
+            check_seeks(zf);
+
+            std::stringstream saved;
+            REQUIRE_THROWS_AS(zf.saveCheckpoints("large.log", saved), zipios::FileCollectionException);
+        }
+
+        SECTION(std::string("seek with checkpoints, save and reload them, ") + (mode == zipios::ZipFile::AccessMode::STREAM ? "stream" : "memory map"))
+        {
+            std::stringstream saved;
+            {
+                zipios::ZipFile zf("large.zip", 0, 0, mode);
+                zf.setCheckpointInterval(256 * 1024);
+                REQUIRE(zf.getCheckpointInterval() == 256 * 1024);
+                check_seeks(zf);
+                zf.saveCheckpoints("large.log", saved);
+
+                // each checkpoint saves a window of 32Kb
+                REQUIRE(saved.str().length() > 32768 * (data.length() / (512 * 1024)));
+
+                REQUIRE_THROWS_AS(zf.saveCheckpoints("not-an-entry", saved), zipios::FileCollectionException);
+            }
+
+            zipios::ZipFile zf("large.zip", 0, 0, mode);
+            saved.seekg(0);
+            REQUIRE(zf.loadCheckpoints("large.log", saved));
+            check_seeks(zf);
+
+            // invalid checkpoints are ignored
+            std::string const valid(saved.str());
+            std::stringstream truncated(valid.substr(0, valid.length() / 2));
+            REQUIRE_FALSE(zf.loadCheckpoints("large.log", truncated));
+            std::string modified(valid);
+            modified[12] ^= 1; // the CRC does not match
+            std::stringstream mismatch(modified);
+            REQUIRE_FALSE(zf.loadCheckpoints("large.log", mismatch));
+            check_seeks(zf);
+        }
+    }
+}
+
+TEST_CASE("ZipFile seeking in stored entries", "[ZipFile] [FileCollection]")
+{
+    zipios_test::auto_unlink_t remove_blob("blob.bin");
+    zipios_test::auto_unlink_t remove_small("small.bin");
+    zipios_test::auto_unlink_t remove_zip("blobs.zip");
+    std::string data;
+    {
+        size_t const size(rand() % (256 * 1024) + 64 * 1024);
+        for(size_t pos(0); pos < size; ++pos)
+        {
+            data += static_cast<char>(rand());
+        }
+        std::ofstream os("blob.bin", std::ios::out | std::ios::binary);
+        os << data;
+        std::ofstream small("small.bin", std::ios::out | std::ios::binary);
+        small << "the next entry";
+    }
+    REQUIRE(system("zip -0 blobs.zip blob.bin small.bin >/dev/null") == 0);
+
+    for(auto mode : { zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::AccessMode::MEMORY_MAP })
+    {
+        zipios::ZipFile zf("blobs.zip", 0, 0, mode);
+        zipios::FileCollection::stream_pointer_t is(zf.getInputStream("blob.bin"));
+        REQUIRE(is);
+
+        // the size is known without reading
+        REQUIRE(is->rdbuf()->in_avail() == static_cast<std::streamsize>(data.length()));
+        is->seekg(0, std::ios::end);
+        REQUIRE(static_cast<size_t>(is->tellg()) == data.length());
+        REQUIRE(is->rdbuf()->in_avail() == -1);
+
+        for(int i(0); i < 100; ++i)
+        {
+            // byte ranges of any size, including larger than the buffer
+            size_t const pos(rand() % data.length());
+            size_t const size(std::min(data.length() - pos, static_cast<size_t>(rand() % (zipios::getBufferSize() * 3))));
+            is->seekg(pos);
+            REQUIRE(is->good());
+            REQUIRE(static_cast<size_t>(is->tellg()) == pos);
+            std::streamsize const avail(is->rdbuf()->in_avail());
+            REQUIRE(avail > 0);
+            REQUIRE(static_cast<size_t>(avail) <= data.length() - pos);
+            std::vector<char> buf(size + 1);
+            is->read(&buf[0], size);
+            REQUIRE(static_cast<size_t>(is->gcount()) == size);
+            REQUIRE(std::string(buf.begin(), buf.begin() + size) == data.substr(pos, size));
+            REQUIRE(static_cast<size_t>(is->tellg()) == pos + size);
+
+            // relative seek backward
+            is->seekg(-static_cast<std::streamoff>(size), std::ios::cur);
+            REQUIRE(static_cast<size_t>(is->tellg()) == pos);
+        }
+
+        // the data of the next entry is not accessible
+        is->seekg(-10, std::ios::end);
+        char buf[100];
+        is->read(buf, sizeof(buf));
+        REQUIRE(is->gcount() == 10);
+        REQUIRE(std::string(buf, 10) == data.substr(data.length() - 10));
+        is->clear();
+        is->seekg(data.length() + 1);
+        REQUIRE(is->fail());
+        is->clear();
+        is->seekg(-1, std::ios::beg);
+        REQUIRE(is->fail());
+    }
+}
+
+TEST_CASE("ZipFile entry cache", "[ZipFile] [FileCollection] [CollectionCollection] [Cache]")
+{
+    REQUIRE(system("rm -rf cache") == 0); // clean up, just in case
+    REQUIRE(mkdir("cache", 0755) == 0);
+    zipios_test::auto_unlink_t remove_zip("cache.zip");
+    std::map<std::string, std::string> files;
+    for(auto name : { "cache/a.txt", "cache/b.txt", "cache/c.txt", "cache/large.txt" })
+    {
+        size_t const size(strcmp(name, "cache/large.txt") == 0 ? 4000 : 1000);
+        std::string data;
+        for(size_t pos(0); pos < size; ++pos)
+        {
+            data += static_cast<char>('a' + rand() % 4);
+        }
+        std::ofstream os(name, std::ios::out | std::ios::binary);
+        os << data;
+        files[name] = data;
+    }
+    REQUIRE(system("zip -r cache.zip cache >/dev/null") == 0);
+
+    auto read_entry = [&files](zipios::FileCollection & collection, std::string const & name, zipios::FileCollection::MatchPath matchpath)
+        {
+            zipios::FileCollection::stream_pointer_t is(collection.getInputStream(name, matchpath));
+            REQUIRE(is);
+            std::stringstream ss;
+            ss << is->rdbuf();
+            std::string const full_name(matchpath == zipios::FileCollection::MatchPath::MATCH ? name : "cache/" + name);
+            REQUIRE(ss.str() == files[full_name]);
+        };
+
+    for(auto mode : { zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::AccessMode::MEMORY_MAP })
+    {
+        zipios::ZipFile zf("cache.zip", 0, 0, mode);
+        REQUIRE(zf.getCacheStatistics().m_budget == 0);
+
+        zf.setCacheBudget(2500);
+        zipios::EntryCache::statistics_t stats(zf.getCacheStatistics());
+        REQUIRE(stats.m_budget == 2500);
+        REQUIRE(stats.m_count == 0);
+
+        // first read is a miss, second read is a hit whatever the matchpath
+        read_entry(zf, "cache/a.txt", zipios::FileCollection::MatchPath::MATCH);
+        read_entry(zf, "a.txt", zipios::FileCollection::MatchPath::IGNORE);
+        stats = zf.getCacheStatistics();
+        REQUIRE(stats.m_misses == 1);
+        REQUIRE(stats.m_hits == 1);
+        REQUIRE(stats.m_count == 1);
+        REQUIRE(stats.m_size == 1000);
+
+        // "a.txt" was read twice so it gets protected, "b.txt" is the
+        // one evicted to make space for "c.txt"
+        read_entry(zf, "cache/b.txt", zipios::FileCollection::MatchPath::MATCH);
+        read_entry(zf, "cache/c.txt", zipios::FileCollection::MatchPath::MATCH);
+        stats = zf.getCacheStatistics();
+        REQUIRE(stats.m_misses == 3);
+        REQUIRE(stats.m_evictions == 1);
+        REQUIRE(stats.m_count == 2);
+        REQUIRE(stats.m_size == 2000);
+
+        read_entry(zf, "cache/a.txt", zipios::FileCollection::MatchPath::MATCH);
+        REQUIRE(zf.getCacheStatistics().m_hits == 2);
+        read_entry(zf, "cache/b.txt", zipios::FileCollection::MatchPath::MATCH);
+        REQUIRE(zf.getCacheStatistics().m_misses == 4);
+
+        // entries larger than the budget are read but not cached
+        read_entry(zf, "cache/large.txt", zipios::FileCollection::MatchPath::MATCH);
+        stats = zf.getCacheStatistics();
+        REQUIRE(stats.m_misses == 5);
+        REQUIRE(stats.m_count == 2);
+        REQUIRE(stats.m_size <= 2500);
+
+        // cached streams can seek and outlive the ZipFile
+        zipios::FileCollection::stream_pointer_t is(zf.getInputStream("cache/a.txt"));
+        REQUIRE(is);
+        is->seekg(500);
+        char buf[10];
+        is->read(buf, sizeof(buf));
+        REQUIRE(std::string(buf, sizeof(buf)) == files["cache/a.txt"].substr(500, 10));
+
+        // copies share the cache
+        zipios::ZipFile copy(zf);
+        read_entry(copy, "cache/a.txt", zipios::FileCollection::MatchPath::MATCH);
+        REQUIRE(zf.getCacheStatistics().m_hits == stats.m_hits + 2);
+
+        // a smaller budget evicts entries immediately
+        zf.setCacheBudget(1000);
+        stats = zf.getCacheStatistics();
+        REQUIRE(stats.m_budget == 1000);
+        REQUIRE(stats.m_count == 1);
+        REQUIRE(stats.m_size == 1000);
+
+        zf.setCacheBudget(0);
+        REQUIRE(zf.getCacheStatistics().m_budget == 0);
+        REQUIRE(zf.getCacheStatistics().m_hits == 0);
+        read_entry(zf, "cache/a.txt", zipios::FileCollection::MatchPath::MATCH);
+
+        zf.close();
+        is->seekg(0);
+        is->read(buf, sizeof(buf));
+        REQUIRE(std::string(buf, sizeof(buf)) == files["cache/a.txt"].substr(0, 10));
+    }
+
+    // the cache of a CollectionCollection works with any child collection
+    for(int use_zip(0); use_zip < 2; ++use_zip)
+    {
+        zipios::CollectionCollection cc;
+        if(use_zip == 0)
+        {
+            cc.addCollection(zipios::DirectoryCollection("cache", true));
+        }
+        else
+        {
+            cc.addCollection(zipios::ZipFile("cache.zip"));
+        }
+        REQUIRE(cc.getCacheStatistics().m_budget == 0);
+        cc.setCacheBudget(2500);
+
+        read_entry(cc, "cache/a.txt", zipios::FileCollection::MatchPath::MATCH);
+        read_entry(cc, "a.txt", zipios::FileCollection::MatchPath::IGNORE);
+        read_entry(cc, "cache/b.txt", zipios::FileCollection::MatchPath::MATCH);
+        read_entry(cc, "cache/c.txt", zipios::FileCollection::MatchPath::MATCH);
+        read_entry(cc, "cache/large.txt", zipios::FileCollection::MatchPath::MATCH);
+        zipios::EntryCache::statistics_t const stats(cc.getCacheStatistics());
+        REQUIRE(stats.m_hits == 1);
+        REQUIRE(stats.m_misses == 4);
+        REQUIRE(stats.m_evictions == 1);
+        REQUIRE(stats.m_count == 2);
+        REQUIRE(stats.m_size == 2000);
+
+        REQUIRE_FALSE(cc.getInputStream("cache/unknown.txt"));
+
+        // copies get their own empty cache
+        zipios::CollectionCollection copy(cc);
+        REQUIRE(copy.getCacheStatistics().m_budget == 2500);
+        REQUIRE(copy.getCacheStatistics().m_count == 0);
+    }
+
+    REQUIRE(system("rm -rf cache") == 0);
+}
+
+TEST_CASE("ZipFile inflaters", "[ZipFile] [FileCollection] [Inflater]")
+{
+    std::vector<std::string> const names(zipios::Inflater::getNames());
+    REQUIRE(std::find(names.begin(), names.end(), "zlib") != names.end());
+    REQUIRE(zipios::Inflater::create()->getName() == names.front());
+    REQUIRE_THROWS_AS(zipios::Inflater::create("unknown"), zipios::InvalidException);
+
+    REQUIRE(system("rm -rf tree") == 0); // clean up, just in case
+    zipios_test::file_t tree(zipios_test::file_t::type_t::DIRECTORY, rand() % 40 + 40, "tree");
+    zipios_test::auto_unlink_t remove_zip("tree.zip");
+    zipios_test::auto_unlink_t remove_empty("empty.txt");
+    {
+        std::ofstream empty("empty.txt");
+    }
+    REQUIRE(system("zip -r tree.zip tree empty.txt >/dev/null") == 0);
+
+    // compress some data to check the inflaters directly
+    std::string data;
+    for(int i(0); i < 10000; ++i)
+    {
+        data += static_cast<char>('a' + rand() % 4);
+    }
+    std::vector<char> compressed(compressBound(data.length()) + 10);
+    {
+        z_stream zs = z_stream();
+        REQUIRE(deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+        zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.c_str()));
+        zs.avail_in = static_cast<uInt>(data.length());
+        zs.next_out = reinterpret_cast<Bytef *>(&compressed[0]);
+        zs.avail_out = static_cast<uInt>(compressed.size());
+        REQUIRE(deflate(&zs, Z_FINISH) == Z_STREAM_END);
+        compressed.resize(zs.total_out);
+        deflateEnd(&zs);
+    }
+
+    for(auto const & name : names)
+    {
+        zipios::Inflater::pointer_t inflater(zipios::Inflater::create(name));
+        REQUIRE(inflater->getName() == name);
+
+        std::vector<char> out(data.length());
+        inflater->inflate(&compressed[0], compressed.size(), &out[0], out.size());
+        REQUIRE(std::string(out.begin(), out.end()) == data);
+
+        // the size must match exactly
+        REQUIRE_THROWS_AS(inflater->inflate(&compressed[0], compressed.size(), &out[0], out.size() - 1), zipios::IOException);
+        std::vector<char> larger(data.length() + 1);
+        REQUIRE_THROWS_AS(inflater->inflate(&compressed[0], compressed.size(), &larger[0], larger.size()), zipios::IOException);
+
+        // truncated and invalid data
+        REQUIRE_THROWS_AS(inflater->inflate(&compressed[0], compressed.size() / 2, &out[0], out.size()), zipios::IOException);
+        std::vector<char> const garbage(100, static_cast<char>(0xFF));
+        REQUIRE_THROWS_AS(inflater->inflate(&garbage[0], garbage.size(), &out[0], out.size()), zipios::IOException);
+
+        for(auto mode : { zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::AccessMode::MEMORY_MAP })
+        {
+            zipios::ZipFile zf("tree.zip", 0, 0, mode);
+            zf.setInflater(inflater);
+            REQUIRE(zf.getInflater() == inflater);
+
+            REQUIRE(zf.readEntry("empty.txt").empty());
+
+            zipios::FileEntry::vector_t const v(zf.entries());
+            for(auto it(v.begin()); it != v.end(); ++it)
+            {
+                if((*it)->isDirectory())
+                {
+                    continue;
+                }
+                std::ifstream in((*it)->getName(), std::ios::in | std::ios::binary);
+                std::stringstream expected;
+                expected << in.rdbuf();
+                std::vector<char> const whole(zf.readEntry((*it)->getName()));
+                REQUIRE(std::string(whole.begin(), whole.end()) == expected.str());
+            }
+
+            // back to the default
+            zf.setInflater(nullptr);
+            REQUIRE(zf.getInflater()->getName() == names.front());
+        }
+    }
+
+    // a user defined inflater
+    class counting_inflater_t
+        : public zipios::Inflater
+    {
+    public:
+        virtual std::string getName() const override
+        {
+            return "counting";
+        }
+
+        virtual void inflate(char const * input, size_t input_size, char * output, size_t output_size) override
+        {
+            ++m_count;
+            m_zlib->inflate(input, input_size, output, output_size);
+        }
+
+        int                         m_count = 0;
+        zipios::Inflater::pointer_t m_zlib = zipios::Inflater::create("zlib");
+    };
+    std::shared_ptr<counting_inflater_t> counting(new counting_inflater_t);
+
+    zipios::ZipFile zf("tree.zip");
+    zf.setInflater(counting);
+    int deflated(0);
+    zipios::FileEntry::vector_t const v(zf.entries());
+    for(auto it(v.begin()); it != v.end(); ++it)
+    {
+        if(!(*it)->isDirectory())
+        {
+            zf.readEntry((*it)->getName());
+            if((*it)->getMethod() == zipios::StorageMethod::DEFLATED)
+            {
+                ++deflated;
+            }
+        }
+    }
+    REQUIRE(counting->m_count == deflated);
+}
+
+TEST_CASE("ZipFile CRC verification", "[ZipFile] [FileCollection] [crc32]")
+{
+    zipios_test::auto_unlink_t remove_stored("crc-stored.bin");
+    zipios_test::auto_unlink_t remove_deflated("crc-deflated.txt");
+    zipios_test::auto_unlink_t remove_zip("crc.zip");
+    zipios_test::auto_unlink_t remove_bad_zip("crc-bad.zip");
+    std::string stored;
+    std::string deflated;
+    {
+        size_t const size(rand() % (64 * 1024) + 20 * 1024);
+        for(size_t pos(0); pos < size; ++pos)
+        {
+            stored += static_cast<char>(rand());
+            deflated += static_cast<char>('a' + rand() % 4);
+        }
+        std::ofstream os("crc-stored.bin", std::ios::out | std::ios::binary);
+        os << stored;
+        std::ofstream ds("crc-deflated.txt", std::ios::out | std::ios::binary);
+        ds << deflated;
+    }
+    REQUIRE(system("zip -0 crc.zip crc-stored.bin >/dev/null") == 0);
+    REQUIRE(system("zip crc.zip crc-deflated.txt >/dev/null") == 0);
+
+    // create a copy of the archive with wrong CRCs in the Central Directory
+    {
+        std::ifstream in("crc.zip", std::ios::in | std::ios::binary);
+        std::stringstream ss;
+        ss << in.rdbuf();
+        std::string archive(ss.str());
+        int count(0);
+        for(size_t pos(archive.find("PK\x01\x02")); pos != std::string::npos; pos = archive.find("PK\x01\x02", pos + 4))
+        {
+            archive[pos + 16] ^= 0x55;
+            ++count;
+        }
+        REQUIRE(count == 2);
+        std::ofstream out("crc-bad.zip", std::ios::out | std::ios::binary);
+        out << archive;
+    }
+
+    auto read_stream = [](zipios::FileCollection::stream_pointer_t is, std::string & data)
+        {
+            char buf[1000];
+            data.clear();
+            while(is->read(buf, sizeof(buf)) || is->gcount() > 0)
+            {
+                data += std::string(buf, is->gcount());
+            }
+            return !is->bad();
+        };
+
+    for(auto mode : { zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::AccessMode::MEMORY_MAP })
+    {
+        // valid CRCs
+        {
+            zipios::ZipFile zf("crc.zip", 0, 0, mode);
+            REQUIRE_FALSE(zf.getCrcVerification());
+            zf.setCrcVerification(true);
+            REQUIRE(zf.getCrcVerification());
+
+            std::vector<char> const s(zf.readEntry("crc-stored.bin"));
+            REQUIRE(std::string(s.begin(), s.end()) == stored);
+            std::vector<char> const d(zf.readEntry("crc-deflated.txt"));
+            REQUIRE(std::string(d.begin(), d.end()) == deflated);
+
+            std::string data;
+            REQUIRE(read_stream(zf.getInputStream("crc-stored.bin"), data));
+            REQUIRE(data == stored);
+            REQUIRE(read_stream(zf.getInputStream("crc-deflated.txt"), data));
+            REQUIRE(data == deflated);
+
+            // seeking backward keeps the verification going
+            zipios::FileCollection::stream_pointer_t is(zf.getInputStream("crc-deflated.txt"));
+            is->seekg(deflated.length() / 2);
+            is->seekg(100);
+            REQUIRE(read_stream(is, data));
+            REQUIRE(data == deflated.substr(100));
+        }
+
+        // wrong CRCs, no verification
+        {
+            zipios::ZipFile zf("crc-bad.zip", 0, 0, mode, zipios::ZipFile::ValidationLevel::CENTRAL_DIRECTORY);
+
+            std::vector<char> const s(zf.readEntry("crc-stored.bin"));
+            REQUIRE(std::string(s.begin(), s.end()) == stored);
+            std::string data;
+            REQUIRE(read_stream(zf.getInputStream("crc-deflated.txt"), data));
+            REQUIRE(data == deflated);
+        }
+
+        // wrong CRCs, with verification
+        {
+            zipios::ZipFile zf("crc-bad.zip", 0, 0, mode, zipios::ZipFile::ValidationLevel::CENTRAL_DIRECTORY);
+            zf.setCrcVerification(true);
+
+            REQUIRE_THROWS_AS(zf.readEntry("crc-stored.bin"), zipios::IOException);
+            REQUIRE_THROWS_AS(zf.readEntry("crc-deflated.txt"), zipios::IOException);
+
+            std::string data;
+            REQUIRE_FALSE(read_stream(zf.getInputStream("crc-deflated.txt"), data));
+            if(mode == zipios::ZipFile::AccessMode::MEMORY_MAP)
+            {
+                // the stored data is in memory, it gets verified immediately
+                REQUIRE_THROWS_AS(zf.getInputStream("crc-stored.bin"), zipios::IOException);
+            }
+            else
+            {
+                REQUIRE_FALSE(read_stream(zf.getInputStream("crc-stored.bin"), data));
+            }
+
+            // the cache does not keep entries with a wrong CRC
+            zf.setCacheBudget(1024 * 1024);
+            REQUIRE_THROWS_AS(zf.getInputStream("crc-deflated.txt"), zipios::IOException);
+            REQUIRE(zf.getCacheStatistics().m_count == 0);
+
+            // seeking forward in a DEFLATED entry still inflates all
+            // the data so the CRC is still verified
+            zf.setCacheBudget(0);
+            zipios::FileCollection::stream_pointer_t is(zf.getInputStream("crc-deflated.txt"));
+            is->seekg(100);
+            REQUIRE_FALSE(read_stream(is, data));
+
+            // skipping data of a STORED entry disables the verification
+            if(mode == zipios::ZipFile::AccessMode::STREAM)
+            {
+                is = zf.getInputStream("crc-stored.bin");
+                is->seekg(10000);
+                REQUIRE(read_stream(is, data));
+                REQUIRE(data == stored.substr(10000));
+            }
+        }
+    }
+}
+
+TEST_CASE("ZipFile LZMA and Zstandard entries", "[ZipFile] [FileCollection] [Codec]")
+{
+    REQUIRE(system("rm -rf codec") == 0); // clean up, just in case
+    REQUIRE(mkdir("codec", 0777) == 0);
+    zipios_test::auto_unlink_t remove_zip("codec.zip");
+
+    std::map<std::string, std::string> files;
+    for(int i(0); i < 200000; ++i)
+    {
+        files["codec/text.txt"] += static_cast<char>('a' + rand() % 4);
+    }
+    for(int i(0); i < 50000; ++i)
+    {
+        files["codec/random.bin"] += static_cast<char>(rand());
+    }
+    files["codec/small.txt"] = "a small file";
+    files["codec/empty.txt"] = "";
+    for(auto const & f : files)
+    {
+        std::ofstream os(f.first, std::ios::out | std::ios::binary);
+        os << f.second;
+    }
+
+    auto read_stream = [](zipios::FileCollection::stream_pointer_t is)
+        {
+            std::string data;
+            char buf[1000];
+            while(is->read(buf, sizeof(buf)) || is->gcount() > 0)
+            {
+                data += std::string(buf, is->gcount());
+            }
+            REQUIRE_FALSE(is->bad());
+            return data;
+        };
+
+    for(auto method : { zipios::StorageMethod::LZMA, zipios::StorageMethod::ZSTD })
+    {
+        if(!zipios::Codec::isSupported(method))
+        {
+            // the library was not found at build time
+            zipios::DirectoryCollection dc("codec");
+            REQUIRE_THROWS_AS(dc.setMethod(0, method, method), zipios::InvalidStateException);
+            REQUIRE_THROWS_AS(zipios::Codec::create(method), zipios::FileCollectionException);
+            continue;
+        }
+
+        // the codec directly
+        {
+            std::string const & text(files["codec/text.txt"]);
+            zipios::Codec::pointer_t codec(zipios::Codec::create(method));
+            REQUIRE(codec->getMethod() == method);
+            REQUIRE(codec->getExtractVersion() == 63);
+
+            std::vector<char> compressed(codec->getCompressBound(text.length()));
+            char const * input(text.c_str());
+            size_t input_size(text.length());
+            char * output(&compressed[0]);
+            size_t output_size(compressed.size());
+            codec->startCompression(zipios::FileEntry::COMPRESSION_LEVEL_DEFAULT, text.length());
+            REQUIRE_FALSE(codec->compress(input, input_size, output, output_size, false));
+            REQUIRE(input_size == 0);
+            while(!codec->compress(input, input_size, output, output_size, true))
+            {
+                REQUIRE(output_size > 0);
+            }
+            compressed.resize(output - &compressed[0]);
+            REQUIRE(compressed.size() < text.length() / 3);
+
+            std::vector<char> out(text.length());
+            codec->decompressAll(&compressed[0], compressed.size(), &out[0], out.size());
+            REQUIRE(std::string(out.begin(), out.end()) == text);
+
+            // trailing data is ignored
+            std::vector<char> with_trailer(compressed);
+            with_trailer.insert(with_trailer.end(), 100, 'x');
+            codec->decompressAll(&with_trailer[0], with_trailer.size(), &out[0], out.size());
+            REQUIRE(std::string(out.begin(), out.end()) == text);
+
+            // the size must match, the data must be complete and valid
+            std::vector<char> larger(text.length() + 1);
+            REQUIRE_THROWS_AS(codec->decompressAll(&compressed[0], compressed.size(), &larger[0], larger.size()), zipios::IOException);
+            REQUIRE_THROWS_AS(codec->decompressAll(&compressed[0], compressed.size() / 2, &out[0], out.size()), zipios::IOException);
+            std::vector<char> const garbage(100, static_cast<char>(0xFF));
+            REQUIRE_THROWS_AS(codec->decompressAll(&garbage[0], garbage.size(), &out[0], out.size()), zipios::IOException);
+        }
+
+        for(auto level : { zipios::FileEntry::COMPRESSION_LEVEL_DEFAULT
+                         , zipios::FileEntry::COMPRESSION_LEVEL_FASTEST
+                         , zipios::FileEntry::COMPRESSION_LEVEL_SMALLEST
+                         , zipios::FileEntry::COMPRESSION_LEVEL_MAXIMUM })
+        {
+            // compress everything but the random data
+            {
+                zipios::DirectoryCollection dc("codec");
+                dc.setMethod([method](zipios::FileEntry const & entry)
+                    {
+                        return entry.getName() == "codec/random.bin" ? zipios::StorageMethod::STORED : method;
+                    });
+                dc.setLevel(0, zipios::FileEntry::COMPRESSION_LEVEL_DEFAULT, level);
+                std::ofstream out("codec.zip", std::ios::out | std::ios::binary);
+                zipios::ZipFile::saveCollectionToArchive(out, dc);
+            }
+
+            for(auto mode : { zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::AccessMode::MEMORY_MAP })
+            {
+                zipios::ZipFile zf("codec.zip", 0, 0, mode, zipios::ZipFile::ValidationLevel::FULL);
+                zf.setCrcVerification(true);
+
+                for(auto const & f : files)
+                {
+                    zipios::FileEntry::pointer_t entry(zf.getEntry(f.first));
+                    REQUIRE(entry != nullptr);
+                    REQUIRE(entry->getMethod() == (f.first == "codec/random.bin" ? zipios::StorageMethod::STORED : method));
+                    REQUIRE(entry->getSize() == f.second.length());
+
+                    std::vector<char> const whole(zf.readEntry(f.first));
+                    REQUIRE(std::string(whole.begin(), whole.end()) == f.second);
+                    REQUIRE(read_stream(zf.getInputStream(f.first)) == f.second);
+                }
+                REQUIRE(zf.getEntry("codec/text.txt")->getCompressedSize() < files["codec/text.txt"].length() / 3);
+
+                // seek forward, then backward
+                std::string const & text(files["codec/text.txt"]);
+                zipios::FileCollection::stream_pointer_t is(zf.getInputStream("codec/text.txt"));
+                is->seekg(150000);
+                char buf[100];
+                REQUIRE(is->read(buf, sizeof(buf)));
+                REQUIRE(std::string(buf, sizeof(buf)) == text.substr(150000, sizeof(buf)));
+                is->seekg(-1000, std::ios::end);
+                REQUIRE(read_stream(is) == text.substr(text.length() - 1000));
+                is->clear();
+                is->seekg(123);
+                REQUIRE(read_stream(is) == text.substr(123));
+            }
+        }
+
+        // a corrupted entry fails cleanly
+        {
+            std::ifstream in("codec.zip", std::ios::in | std::ios::binary);
+            std::stringstream ss;
+            ss << in.rdbuf();
+            std::string archive(ss.str());
+            zipios::ZipFile zf("codec.zip");
+            zipios::FileEntry::pointer_t entry(zf.getEntry("codec/text.txt"));
+            size_t const offset(static_cast<size_t>(entry->getEntryOffset()));
+            size_t const header_size(30
+                        + static_cast<unsigned char>(archive[offset + 26]) + static_cast<unsigned char>(archive[offset + 27]) * 256
+                        + static_cast<unsigned char>(archive[offset + 28]) + static_cast<unsigned char>(archive[offset + 29]) * 256);
+            size_t const middle(offset + header_size + entry->getCompressedSize() / 2);
+            for(size_t pos(middle); pos < middle + 64; ++pos)
+            {
+                archive[pos] ^= 0x5A;
+            }
+            std::ofstream out("codec.zip", std::ios::out | std::ios::binary);
+            out << archive;
+        }
+        {
+            // Zstandard may not detect the corruption, the CRC does
+            zipios::ZipFile zf("codec.zip");
+            zf.setCrcVerification(true);
+            REQUIRE_THROWS_AS(zf.readEntry("codec/text.txt"), zipios::IOException);
+            zipios::FileCollection::stream_pointer_t is(zf.getInputStream("codec/text.txt"));
+            char buf[1000];
+            while(is->read(buf, sizeof(buf)))
+            {
+            }
+            REQUIRE(is->bad());
+        }
+    }
+
+    REQUIRE(system("rm -rf codec") == 0);
+}
+
+
+TEST_CASE("ZipFile saved without seeking", "[ZipFile] [FileCollection] [Streaming]")
+{
+    // a stream buffer which, like a pipe, cannot seek nor tell its position
+    class no_seek_stringbuf
+        : public std::stringbuf
+    {
+    protected:
+        virtual pos_type seekoff(off_type, std::ios_base::seekdir, std::ios_base::openmode) override
+        {
+            return pos_type(off_type(-1));
+        }
+
+        virtual pos_type seekpos(pos_type, std::ios_base::openmode) override
+        {
+            return pos_type(off_type(-1));
+        }
+    };
+
+    REQUIRE(system("rm -rf streaming") == 0); // clean up, just in case
+    REQUIRE(mkdir("streaming", 0777) == 0);
+    REQUIRE(mkdir("streaming/sub", 0777) == 0);
+    zipios_test::auto_unlink_t remove_zip("streaming.zip");
+
+    std::map<std::string, std::string> files;
+    for(int i(0); i < 100000; ++i)
+    {
+        files["streaming/text.txt"] += static_cast<char>('a' + rand() % 4);
+    }
+    for(int i(0); i < 30000; ++i)
+    {
+        files["streaming/sub/random.bin"] += static_cast<char>(rand());
+    }
+    files["streaming/small.txt"] = "a small file";
+    files["streaming/empty.txt"] = "";
+    for(auto const & f : files)
+    {
+        std::ofstream os(f.first, std::ios::out | std::ios::binary);
+        os << f.second;
+    }
+
+    auto read_stream = [](std::shared_ptr<std::istream> is)
+        {
+            std::string data;
+            char buf[1000];
+            while(is->read(buf, sizeof(buf)) || is->gcount() > 0)
+            {
+                data += std::string(buf, is->gcount());
+            }
+            REQUIRE_FALSE(is->bad());
+            return data;
+        };
+
+    // bit 3 of the flags of the first local header
+    auto has_data_descriptor = [](std::string const & archive)
+        {
+            REQUIRE(archive.length() > 30);
+            REQUIRE(archive.substr(0, 4) == std::string("PK\3\4"));
+            return (archive[6] & (1 << 3)) != 0;
+        };
+
+    std::vector<zipios::StorageMethod> methods{ zipios::StorageMethod::STORED, zipios::StorageMethod::DEFLATED };
+    for(auto method : { zipios::StorageMethod::LZMA, zipios::StorageMethod::ZSTD })
+    {
+        if(zipios::Codec::isSupported(method))
+        {
+            methods.push_back(method);
+        }
+    }
+
+    for(auto method : methods)
+    {
+        zipios::DirectoryCollection dc("streaming");
+        dc.setMethod(0, method, method);
+
+        // AUTO on a stream which cannot seek uses data descriptors
+        std::string archive;
+        {
+            no_seek_stringbuf buf;
+            std::ostream os(&buf);
+            zipios::ZipFile::saveCollectionToArchive(os, dc, "streamed");
+            REQUIRE(os);
+            archive = buf.str();
+        }
+        REQUIRE(has_data_descriptor(archive));
+
+        // DATA_DESCRIPTOR on a file gives the exact same archive
+        {
+            std::ofstream os("streaming.zip", std::ios::out | std::ios::binary);
+            zipios::ZipFile::saveCollectionToArchive(os, dc, "streamed", zipios::ZipFile::WriteMode::DATA_DESCRIPTOR);
+        }
+        {
+            std::ifstream in("streaming.zip", std::ios::in | std::ios::binary);
+            std::stringstream ss;
+            ss << in.rdbuf();
+            REQUIRE(ss.str() == archive);
+        }
+
+        // the standard unzip tool verifies all the CRCs (it does not
+        // support the other methods)
+        if(method == zipios::StorageMethod::STORED
+        || method == zipios::StorageMethod::DEFLATED)
+        {
+            REQUIRE(system("unzip -tqq streaming.zip >/dev/null") == 0);
+        }
+
+        // read it back as a file
+        for(auto mode : { zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::AccessMode::MEMORY_MAP })
+        {
+            for(auto level : { zipios::ZipFile::ValidationLevel::FULL, zipios::ZipFile::ValidationLevel::LAZY })
+            {
+                zipios::ZipFile zf("streaming.zip", 0, 0, mode, level);
+                zf.setCrcVerification(true);
+                REQUIRE(zf.size() == files.size() + 2); // + "streaming" and "streaming/sub"
+                for(auto const & f : files)
+                {
+                    zipios::FileEntry::pointer_t entry(zf.getEntry(f.first));
+                    REQUIRE(entry != nullptr);
+                    REQUIRE(entry->getMethod() == method);
+                    REQUIRE(entry->getSize() == f.second.length());
+                    REQUIRE(read_stream(zf.getInputStream(f.first)) == f.second);
+                    std::vector<char> const whole(zf.readEntry(f.first));
+                    REQUIRE(std::string(whole.begin(), whole.end()) == f.second);
+                }
+            }
+        }
+
+        // read it back from the stream
+        {
+            std::istringstream in(archive);
+            zipios::ZipStreamReader reader(in);
+            size_t count(0);
+            for(;;)
+            {
+                zipios::FileEntry::pointer_t entry(reader.getNextEntry());
+                if(entry == nullptr)
+                {
+                    break;
+                }
+                ++count;
+                std::string const data(read_stream(reader.getInputStream()));
+                if(entry->isDirectory())
+                {
+                    REQUIRE(data.empty());
+                    continue;
+                }
+                REQUIRE(data == files[entry->getName()]);
+                REQUIRE(entry->getSize() == data.length());
+            }
+            REQUIRE(count == files.size() + 2);
+        }
+    }
+
+    // AUTO on a file seeks back and does not use data descriptors
+    {
+        zipios::DirectoryCollection dc("streaming");
+        {
+            std::ofstream os("streaming.zip", std::ios::out | std::ios::binary);
+            zipios::ZipFile::saveCollectionToArchive(os, dc);
+        }
+        std::ifstream in("streaming.zip", std::ios::in | std::ios::binary);
+        std::stringstream ss;
+        ss << in.rdbuf();
+        REQUIRE_FALSE(has_data_descriptor(ss.str()));
+        REQUIRE(system("unzip -tqq streaming.zip >/dev/null") == 0);
+    }
+
+    REQUIRE(system("rm -rf streaming") == 0);
+}
+
+
+TEST_CASE("ZipFile copied without recompression", "[ZipFile] [FileCollection] [Raw]")
+{
+    REQUIRE(system("rm -rf raw") == 0); // clean up, just in case
+    REQUIRE(mkdir("raw", 0777) == 0);
+    zipios_test::auto_unlink_t remove_source("raw-source.zip");
+    zipios_test::auto_unlink_t remove_copy("raw-copy.zip");
+
+    std::map<std::string, std::string> files;
+    for(int i(0); i < 100000; ++i)
+    {
+        files["raw/text.txt"] += static_cast<char>('a' + rand() % 4);
+    }
+    for(int i(0); i < 20000; ++i)
+    {
+        files["raw/random.bin"] += static_cast<char>(rand());
+    }
+    files["raw/small.txt"] = "a small file";
+    files["raw/empty.txt"] = "";
+    for(auto const & f : files)
+    {
+        std::ofstream os(f.first, std::ios::out | std::ios::binary);
+        os << f.second;
+    }
+
+    auto read_stream = [](zipios::FileCollection::stream_pointer_t is)
+        {
+            std::string data;
+            char buf[1000];
+            while(is->read(buf, sizeof(buf)) || is->gcount() > 0)
+            {
+                data += std::string(buf, is->gcount());
+            }
+            REQUIRE_FALSE(is->bad());
+            return data;
+        };
+
+    auto raw_inflate = [](std::string const & compressed, size_t size)
+        {
+            std::string data(size, '\0');
+            z_stream zs;
+            memset(&zs, 0, sizeof(zs));
+            REQUIRE(inflateInit2(&zs, -MAX_WBITS) == Z_OK);
+            zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(compressed.c_str()));
+            zs.avail_in = compressed.length();
+            zs.next_out = reinterpret_cast<Bytef *>(&data[0]);
+            zs.avail_out = size;
+            int const r(inflate(&zs, Z_FINISH));
+            inflateEnd(&zs);
+            REQUIRE(r == Z_STREAM_END);
+            REQUIRE(zs.avail_in == 0);
+            return data;
+        };
+
+    // the random data is STORED, the other files are DEFLATED
+    {
+        zipios::DirectoryCollection dc("raw");
+        dc.setMethod([](zipios::FileEntry const & entry)
+            {
+                return entry.getName() == "raw/random.bin" ? zipios::StorageMethod::STORED : zipios::StorageMethod::DEFLATED;
+            });
+        std::ofstream out("raw-source.zip", std::ios::out | std::ios::binary);
+        zipios::ZipFile::saveCollectionToArchive(out, dc);
+    }
+
+    SECTION("read the raw data")
+    {
+        for(auto mode : { zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::AccessMode::MEMORY_MAP })
+        {
+            zipios::ZipFile zf("raw-source.zip", 0, 0, mode);
+            REQUIRE(zf.getRawInputStream("raw/unknown.txt") == nullptr);
+            for(auto const & f : files)
+            {
+                zipios::FileEntry::pointer_t entry(zf.getEntry(f.first));
+                REQUIRE(entry != nullptr);
+                std::string const raw(read_stream(zf.getRawInputStream(f.first)));
+                REQUIRE(raw.length() == entry->getCompressedSize());
+                if(entry->getMethod() == zipios::StorageMethod::STORED)
+                {
+                    REQUIRE(raw == f.second);
+                }
+                else if(f.second.empty())
+                {
+                    // saved with seek back, an empty entry has no
+                    // deflate data at all
+                    //
+                    REQUIRE(raw.empty());
+                }
+                else
+                {
+                    REQUIRE(raw_inflate(raw, entry->getSize()) == f.second);
+                }
+            }
+        }
+    }
+
+    SECTION("copy the raw data")
+    {
+        for(auto write_mode : { zipios::ZipFile::WriteMode::SEEK_BACK, zipios::ZipFile::WriteMode::DATA_DESCRIPTOR })
+        {
+            {
+                zipios::ZipFile zf("raw-source.zip");
+                std::ofstream out("raw-copy.zip", std::ios::out | std::ios::binary);
+                zipios::ZipFile::saveCollectionToArchive(out, zf, "copy", write_mode);
+            }
+            // unzip rejects DEFLATED entries without any data
+            //
+            REQUIRE(system("unzip -tqq raw-copy.zip -x raw/empty.txt >/dev/null") == 0);
+
+            zipios::ZipFile source("raw-source.zip");
+            zipios::ZipFile copy("raw-copy.zip");
+            copy.setCrcVerification(true);
+            REQUIRE(copy.size() == source.size());
+            for(auto const & f : files)
+            {
+                zipios::FileEntry::pointer_t entry(copy.getEntry(f.first));
+                REQUIRE(entry != nullptr);
+                REQUIRE(entry->getMethod() == source.getEntry(f.first)->getMethod());
+                REQUIRE(entry->getCrc() == source.getEntry(f.first)->getCrc());
+
+                // the exact same compressed data
+                REQUIRE(read_stream(copy.getRawInputStream(f.first)) == read_stream(source.getRawInputStream(f.first)));
+                REQUIRE(read_stream(copy.getInputStream(f.first)) == f.second);
+            }
+        }
+    }
+
+    SECTION("a different method or level compresses the data again")
+    {
+        {
+            zipios::ZipFile zf("raw-source.zip");
+            zf.setLevel(0, zipios::FileEntry::COMPRESSION_LEVEL_NONE, zipios::FileEntry::COMPRESSION_LEVEL_NONE);
+            std::ofstream out("raw-copy.zip", std::ios::out | std::ios::binary);
+            zipios::ZipFile::saveCollectionToArchive(out, zf);
+        }
+        {
+            zipios::ZipFile copy("raw-copy.zip");
+            for(auto const & f : files)
+            {
+                zipios::FileEntry::pointer_t entry(copy.getEntry(f.first));
+                REQUIRE(entry->getMethod() == zipios::StorageMethod::STORED);
+                REQUIRE(read_stream(copy.getRawInputStream(f.first)) == f.second);
+            }
+        }
+
+        {
+            zipios::ZipFile zf("raw-source.zip");
+            zf.setMethod(0, zipios::StorageMethod::DEFLATED, zipios::StorageMethod::DEFLATED);
+            std::ofstream out("raw-copy.zip", std::ios::out | std::ios::binary);
+            zipios::ZipFile::saveCollectionToArchive(out, zf);
+        }
+        {
+            zipios::ZipFile copy("raw-copy.zip");
+            copy.setCrcVerification(true);
+            for(auto const & f : files)
+            {
+                zipios::FileEntry::pointer_t entry(copy.getEntry(f.first));
+                REQUIRE(entry->getMethod() == zipios::StorageMethod::DEFLATED);
+                REQUIRE(read_stream(copy.getInputStream(f.first)) == f.second);
+            }
+        }
+    }
+
+    SECTION("raw data shorter than the compressed size")
+    {
+        zipios::ZipFile zf("raw-source.zip");
+        zipios::FileEntry::pointer_t entry(zf.getEntry("raw/text.txt"));
+        std::string const raw(read_stream(zf.getRawInputStream("raw/text.txt")));
+        std::istringstream is(raw.substr(0, raw.length() / 2));
+
+        std::stringstream out;
+        zipios::ZipOutputStream os(out);
+        REQUIRE_THROWS_AS(os.putRawEntry(entry, is), zipios::IOException);
+    }
+
+    REQUIRE(system("rm -rf raw") == 0);
+}
+
+
+TEST_CASE("ZipFile saved with several threads", "[ZipFile] [FileCollection] [Threads]")
+{
+    REQUIRE(system("rm -rf threads") == 0); // clean up, just in case
+    REQUIRE(mkdir("threads", 0777) == 0);
+    zipios_test::auto_unlink_t remove_serial("threads-serial.zip");
+    zipios_test::auto_unlink_t remove_parallel("threads-parallel.zip");
+
+    // a mix of small, large, compressible, and random files
+    std::map<std::string, std::string> files;
+    for(int idx(0); idx < 200; ++idx)
+    {
+        std::string const name("threads/file" + std::to_string(idx) + ".txt");
+        std::string & data(files[name]);
+        size_t const size(idx % 50 == 0 ? 200000 + rand() % 100000 : rand() % 5000);
+        for(size_t j(0); j < size; ++j)
+        {
+            data += static_cast<char>(idx % 3 == 0 ? rand() : 'a' + rand() % 4);
+        }
+        std::ofstream os(name, std::ios::out | std::ios::binary);
+        os << data;
+    }
+
+    auto read_file = [](std::string const & filename)
+        {
+            std::ifstream is(filename, std::ios::in | std::ios::binary);
+            std::stringstream ss;
+            ss << is.rdbuf();
+            return ss.str();
+        };
+
+    auto save = [](zipios::FileCollection & collection, std::string const & filename, zipios::ZipFile::WriteMode write_mode, size_t thread_count, size_t memory_budget)
+        {
+            std::ofstream out(filename, std::ios::out | std::ios::binary);
+            zipios::ZipFile::saveCollectionToArchive(out, collection, "threads", write_mode, thread_count, memory_budget);
+        };
+
+    auto set_method = [](zipios::FileEntry const & entry)
+        {
+            return entry.getName().find('5') != std::string::npos ? zipios::StorageMethod::STORED : zipios::StorageMethod::DEFLATED;
+        };
+
+    for(auto write_mode : { zipios::ZipFile::WriteMode::SEEK_BACK, zipios::ZipFile::WriteMode::DATA_DESCRIPTOR })
+    {
+        {
+            zipios::DirectoryCollection dc("threads");
+            dc.setMethod(set_method);
+            save(dc, "threads-serial.zip", write_mode, 1, zipios::ZipFile::SAVE_MEMORY_BUDGET_DEFAULT);
+        }
+        REQUIRE(system("unzip -tqq threads-serial.zip >/dev/null") == 0);
+        std::string const serial(read_file("threads-serial.zip"));
+
+        // the budget of 128Kb forces the large files to be compressed
+        // by the calling thread and the others to wait on each other;
+        // with a budget of 1 no entry is given to the threads
+        //
+        std::vector<std::pair<size_t, size_t>> const settings{
+            { 4, 128 * 1024 },
+            { 0, zipios::ZipFile::SAVE_MEMORY_BUDGET_DEFAULT },
+            { 8, 1 },
+        };
+        for(auto const & s : settings)
+        {
+            zipios::DirectoryCollection dc("threads");
+            dc.setMethod(set_method);
+            save(dc, "threads-parallel.zip", write_mode, s.first, s.second);
+            REQUIRE(read_file("threads-parallel.zip") == serial);
+        }
+
+        zipios::ZipFile zf("threads-parallel.zip");
+        zf.setCrcVerification(true);
+        REQUIRE(zf.size() == files.size() + 1);
+        for(auto const & f : files)
+        {
+            zipios::FileEntry::pointer_t entry(zf.getEntry(f.first));
+            REQUIRE(entry != nullptr);
+            REQUIRE(entry->getMethod() == set_method(*entry));
+            zipios::FileCollection::stream_pointer_t is(zf.getInputStream(f.first));
+            std::stringstream ss;
+            ss << is->rdbuf();
+            REQUIRE(ss.str() == f.second);
+        }
+    }
+
+    // copying a ZipFile mixes raw copies and compressed entries
+    //
+    auto set_level = [](zipios::ZipFile & zf)
+        {
+            for(auto const & entry : zf.entries())
+            {
+                if(entry->getMethod() == zipios::StorageMethod::DEFLATED)
+                {
+                    entry->setLevel(3);
+                }
+            }
+        };
+    {
+        zipios::ZipFile zf("threads-parallel.zip");
+        set_level(zf);
+        save(zf, "threads-serial.zip", zipios::ZipFile::WriteMode::SEEK_BACK, 1, zipios::ZipFile::SAVE_MEMORY_BUDGET_DEFAULT);
+    }
+    {
+        zipios::ZipFile zf("threads-parallel.zip");
+        set_level(zf);
+        save(zf, "threads-parallel.zip.tmp", zipios::ZipFile::WriteMode::SEEK_BACK, 4, 256 * 1024);
+    }
+    REQUIRE(rename("threads-parallel.zip.tmp", "threads-parallel.zip") == 0);
+    REQUIRE(read_file("threads-parallel.zip") == read_file("threads-serial.zip"));
+    REQUIRE(system("unzip -tqq threads-parallel.zip >/dev/null") == 0);
+
+    REQUIRE(system("rm -rf threads") == 0);
+}
+
+
+TEST_CASE("ZipOutputStream deflating with several threads", "[ZipFile] [Threads]")
+{
+    REQUIRE(system("rm -rf deflate") == 0); // clean up, just in case
+    REQUIRE(mkdir("deflate", 0777) == 0);
+    zipios_test::auto_unlink_t remove_zip("deflate.zip");
+
+    // compressible data with repeated runs crossing the blocks, which
+    // make use of the dictionaries, and some random data
+    //
+    size_t const block_size(zipios::ParallelDeflater::BLOCK_SIZE);
+    std::map<std::string, std::string> files;
+    files["deflate/empty.txt"] = "";
+    files["deflate/small.txt"] = "a small file";
+    for(size_t size : { block_size, block_size * 3, block_size * 5 + 12345 })
+    {
+        std::string & data(files["deflate/file" + std::to_string(size) + ".txt"]);
+        while(data.length() < size)
+        {
+            switch(rand() % 3)
+            {
+            case 0:
+                data += std::string(rand() % 100, static_cast<char>('a' + rand() % 26));
+                break;
+
+            case 1:
+                data += data.substr(data.length() - std::min(data.length(), static_cast<size_t>(rand() % 20000)), rand() % 200);
+                break;
+
+            default:
+                data += static_cast<char>(rand());
+                break;
+
+            }
+        }
+        data.resize(size);
+    }
+    for(auto const & f : files)
+    {
+        std::ofstream os(f.first, std::ios::out | std::ios::binary);
+        os << f.second;
+    }
+
+    auto read_stream = [](zipios::FileCollection::stream_pointer_t is)
+        {
+            std::stringstream ss;
+            ss << is->rdbuf();
+            return ss.str();
+        };
+
+    std::map<std::string, std::string> serial;
+    std::map<std::string, std::string> reference;
+    for(size_t count : { 1, 2, 8 })
+    {
+        {
+            std::ofstream out("deflate.zip", std::ios::out | std::ios::binary);
+            zipios::ZipOutputStream os(out);
+            os.setThreadCount(count);
+            for(auto const & f : files)
+            {
+                zipios::FileEntry::pointer_t entry(new zipios::DirectoryEntry(zipios::FilePath(f.first)));
+                entry->setMethod(zipios::StorageMethod::DEFLATED);
+                std::ifstream is(f.first, std::ios::in | std::ios::binary);
+                os.putEntry(entry, &is);
+            }
+            os.finish();
+        }
+        // unzip rejects DEFLATED entries without any data
+        //
+        REQUIRE(system("unzip -tqq deflate.zip -x deflate/empty.txt >/dev/null") == 0);
+
+        zipios::ZipFile zf("deflate.zip");
+        zf.setCrcVerification(true);
+        for(auto const & f : files)
+        {
+            zipios::FileEntry::pointer_t entry(zf.getEntry(f.first));
+            REQUIRE(entry != nullptr);
+            REQUIRE(entry->getMethod() == zipios::StorageMethod::DEFLATED);
+            REQUIRE(entry->getSize() == f.second.length());
+            REQUIRE(read_stream(zf.getInputStream(f.first)) == f.second);
+
+            std::string const raw(read_stream(zf.getRawInputStream(f.first)));
+            if(count == 1)
+            {
+                serial[f.first] = raw;
+            }
+            else if(reference.find(f.first) == reference.end())
+            {
+                // the blocks cost a few bytes but the dictionaries
+                // keep the compression about the same
+                //
+                reference[f.first] = raw;
+                if(f.second.length() <= block_size)
+                {
+                    REQUIRE(raw == serial[f.first]);
+                }
+                else
+                {
+                    REQUIRE(raw.length() < serial[f.first].length() * 102 / 100 + 64);
+                }
+            }
+            else
+            {
+                REQUIRE(raw == reference[f.first]);
+            }
+        }
+    }
+
+    REQUIRE(system("rm -rf deflate") == 0);
+}
+
+
+TEST_CASE("ZipFile saved with several threads per entry", "[ZipFile] [Threads]")
+{
+    REQUIRE(system("rm -rf blocks") == 0); // clean up, just in case
+    REQUIRE(mkdir("blocks", 0777) == 0);
+    zipios_test::auto_unlink_t remove_serial("blocks-serial.zip");
+    zipios_test::auto_unlink_t remove_parallel("blocks-parallel.zip");
+
+    size_t const block_size(zipios::ParallelDeflater::BLOCK_SIZE);
+    std::map<std::string, std::string> files;
+    files["blocks/empty.txt"] = "";
+    files["blocks/small.txt"] = "a small file";
+    for(size_t size : { block_size * 2, block_size * 4 + 321 })
+    {
+        std::string & data(files["blocks/file" + std::to_string(size) + ".txt"]);
+        while(data.length() < size)
+        {
+            data += std::string(rand() % 50, static_cast<char>('a' + rand() % 26));
+            data += static_cast<char>(rand());
+        }
+        data.resize(size);
+    }
+    for(auto const & f : files)
+    {
+        std::ofstream os(f.first, std::ios::out | std::ios::binary);
+        os << f.second;
+    }
+
+    auto read_file = [](std::string const & filename)
+        {
+            std::ifstream is(filename, std::ios::in | std::ios::binary);
+            std::stringstream ss;
+            ss << is.rdbuf();
+            return ss.str();
+        };
+
+    auto read_stream = [](zipios::FileCollection::stream_pointer_t is)
+        {
+            std::stringstream ss;
+            ss << is->rdbuf();
+            return ss.str();
+        };
+
+    auto set_method = [](zipios::FileEntry const &)
+        {
+            return zipios::StorageMethod::DEFLATED;
+        };
+
+    for(auto write_mode : { zipios::ZipFile::WriteMode::SEEK_BACK, zipios::ZipFile::WriteMode::DATA_DESCRIPTOR })
+    {
+        // by default, the entries are compressed by a single thread each
+        //
+        {
+            zipios::DirectoryCollection dc("blocks");
+            dc.setMethod(set_method);
+            std::ofstream out("blocks-serial.zip", std::ios::out | std::ios::binary);
+            zipios::ZipFile::saveCollectionToArchive(out, dc, "blocks", write_mode);
+        }
+        std::string const serial(read_file("blocks-serial.zip"));
+        {
+            zipios::DirectoryCollection dc("blocks");
+            dc.setMethod(set_method);
+            std::ofstream out("blocks-parallel.zip", std::ios::out | std::ios::binary);
+            zipios::ZipFile::saveCollectionToArchive(out, dc, "blocks", write_mode, 1, zipios::ZipFile::SAVE_MEMORY_BUDGET_DEFAULT, 1);
+        }
+        REQUIRE(read_file("blocks-parallel.zip") == serial);
+
+        // the blocks do not depend on the number of threads nor on
+        // whether the entry is compressed by the calling thread
+        //
+        struct setting_t
+        {
+            size_t      m_thread_count;
+            size_t      m_memory_budget;
+            size_t      m_deflate_thread_count;
+        };
+        std::string reference;
+        std::vector<setting_t> const settings{
+            { 1, zipios::ZipFile::SAVE_MEMORY_BUDGET_DEFAULT, 2 },
+            { 1, zipios::ZipFile::SAVE_MEMORY_BUDGET_DEFAULT, 8 },
+            { 4, zipios::ZipFile::SAVE_MEMORY_BUDGET_DEFAULT, 2 },
+            { 0, 1, 4 },
+        };
+        for(auto const & s : settings)
+        {
+            {
+                zipios::DirectoryCollection dc("blocks");
+                dc.setMethod(set_method);
+                std::ofstream out("blocks-parallel.zip", std::ios::out | std::ios::binary);
+                zipios::ZipFile::saveCollectionToArchive(out, dc, "blocks", write_mode, s.m_thread_count, s.m_memory_budget, s.m_deflate_thread_count);
+            }
+            std::string const parallel(read_file("blocks-parallel.zip"));
+            if(reference.empty())
+            {
+                reference = parallel;
+                REQUIRE(reference != serial);
+            }
+            else
+            {
+                REQUIRE(parallel == reference);
+            }
+        }
+
+        // unzip rejects DEFLATED entries without any data
+        //
+        if(write_mode == zipios::ZipFile::WriteMode::SEEK_BACK)
+        {
+            REQUIRE(system("unzip -tqq blocks-parallel.zip -x blocks/empty.txt >/dev/null") == 0);
+        }
+        else
+        {
+            REQUIRE(system("unzip -tqq blocks-parallel.zip >/dev/null") == 0);
+        }
+
+        zipios::ZipFile serial_zf("blocks-serial.zip");
+        zipios::ZipFile zf("blocks-parallel.zip");
+        zf.setCrcVerification(true);
+        for(auto const & f : files)
+        {
+            zipios::FileEntry::pointer_t entry(zf.getEntry(f.first));
+            REQUIRE(entry != nullptr);
+            REQUIRE(entry->getMethod() == zipios::StorageMethod::DEFLATED);
+            REQUIRE(read_stream(zf.getInputStream(f.first)) == f.second);
+
+            // the data fitting in one block is compressed as usual
+            //
+            if(f.second.length() <= block_size)
+            {
+                REQUIRE(read_stream(zf.getRawInputStream(f.first)) == read_stream(serial_zf.getRawInputStream(f.first)));
+            }
+        }
+    }
+
+    REQUIRE(system("rm -rf blocks") == 0);
+}
+
 // Local Variables:
 // mode: cpp
 // indent-tabs-mode: nil
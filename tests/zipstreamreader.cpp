@@ -0,0 +1,511 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2019  Made to Order Software Corporation
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ *
+ * Zipios unit tests used to verify the ZipStreamReader class.
+ */
+
+#include "tests.hpp"
+
+#include "zipios/zipstreamreader.hpp"
+#include "zipios/directorycollection.hpp"
+#include "zipios/zipfile.hpp"
+#include "zipios/zipiosexceptions.hpp"
+
+#include "src/codec.hpp"
+
+#include <fstream>
+#include <map>
+#include <sstream>
+
+#include <sys/stat.h>
+#include <zlib.h>
+
+
+namespace
+{
+
+
+/** \brief A stream buffer which behaves like a pipe.
+ *
+ * The data is returned in small blocks of random sizes and the
+ * stream buffer cannot seek.
+ */
+class pipe_streambuf
+    : public std::streambuf
+{
+public:
+    pipe_streambuf(std::string const & data)
+        : m_data(data)
+    {
+    }
+
+protected:
+    virtual int_type underflow() override
+    {
+        if(m_position >= m_data.length())
+        {
+            return traits_type::eof();
+        }
+        size_t const size(std::min(static_cast<size_t>(rand() % 100 + 1), m_data.length() - m_position));
+        m_block = m_data.substr(m_position, size);
+        m_position += size;
+        setg(&m_block[0], &m_block[0], &m_block[0] + size);
+        return traits_type::to_int_type(m_block[0]);
+    }
+
+private:
+    std::string         m_data;
+    std::string         m_block;
+    size_t              m_position = 0;
+};
+
+
+std::string read_stream(zipios::ZipStreamReader::stream_pointer_t is)
+{
+    std::string data;
+    char buf[1000];
+    while(is->read(buf, sizeof(buf)) || is->gcount() > 0)
+    {
+        data += std::string(buf, is->gcount());
+    }
+    return data;
+}
+
+
+void write16(std::string & out, uint16_t value)
+{
+    out += static_cast<char>(value);
+    out += static_cast<char>(value >> 8);
+}
+
+
+void write32(std::string & out, uint32_t value)
+{
+    write16(out, static_cast<uint16_t>(value));
+    write16(out, static_cast<uint16_t>(value >> 16));
+}
+
+
+void write64(std::string & out, uint64_t value)
+{
+    write32(out, static_cast<uint32_t>(value));
+    write32(out, static_cast<uint32_t>(value >> 32));
+}
+
+
+enum class descriptor_t
+{
+    DESCRIPTOR_NONE,
+    DESCRIPTOR_SIGNATURE,
+    DESCRIPTOR_NO_SIGNATURE,
+    DESCRIPTOR_ZIP64
+};
+
+
+/** \brief Append an entry to an archive.
+ *
+ * The entry is written the way a tool which cannot seek writes it:
+ * the CRC and sizes are saved in a data descriptor after the data.
+ */
+void append_entry(std::string & archive, std::string const & name, std::string const & data, bool deflated, descriptor_t descriptor)
+{
+    std::string compressed(data);
+    if(deflated)
+    {
+        z_stream zs = z_stream();
+        REQUIRE(deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+        compressed.resize(deflateBound(&zs, data.length()));
+        zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.c_str()));
+        zs.avail_in = data.length();
+        zs.next_out = reinterpret_cast<Bytef *>(&compressed[0]);
+        zs.avail_out = compressed.length();
+        REQUIRE(deflate(&zs, Z_FINISH) == Z_STREAM_END);
+        compressed.resize(zs.total_out);
+        deflateEnd(&zs);
+    }
+    uint32_t const crc(crc32(0, reinterpret_cast<Bytef const *>(data.c_str()), data.length()));
+    bool const has_descriptor(descriptor != descriptor_t::DESCRIPTOR_NONE);
+
+    write32(archive, 0x04034b50);
+    write16(archive, 20);
+    write16(archive, has_descriptor ? 1 << 3 : 0);
+    write16(archive, deflated ? 8 : 0);
+    write32(archive, 0x21000000);
+    write32(archive, has_descriptor ? 0 : crc);
+    write32(archive, has_descriptor ? 0 : compressed.length());
+    write32(archive, has_descriptor ? 0 : data.length());
+    write16(archive, name.length());
+    write16(archive, 0);
+    archive += name;
+    archive += compressed;
+
+    switch(descriptor)
+    {
+    case descriptor_t::DESCRIPTOR_NONE:
+        break;
+
+    case descriptor_t::DESCRIPTOR_SIGNATURE:
+        write32(archive, 0x08074b50);
+        write32(archive, crc);
+        write32(archive, compressed.length());
+        write32(archive, data.length());
+        break;
+
+    case descriptor_t::DESCRIPTOR_NO_SIGNATURE:
+        write32(archive, crc);
+        write32(archive, compressed.length());
+        write32(archive, data.length());
+        break;
+
+    case descriptor_t::DESCRIPTOR_ZIP64:
+        write32(archive, 0x08074b50);
+        write32(archive, crc);
+        write64(archive, compressed.length());
+        write64(archive, data.length());
+        break;
+
+    }
+}
+
+
+/** \brief Append the start of a central directory.
+ *
+ * The reader stops at the first central directory header so the rest
+ * of it does not matter.
+ */
+void append_central_directory(std::string & archive)
+{
+    write32(archive, 0x02014b50);
+    archive += std::string(42, '\0');
+}
+
+
+} // no name namespace
+
+
+TEST_CASE("ZipStreamReader archives saved by ZipFile", "[ZipStreamReader] [ZipFile]")
+{
+    REQUIRE(system("rm -rf streamreader") == 0); // clean up, just in case
+    REQUIRE(mkdir("streamreader", 0777) == 0);
+
+    std::map<std::string, std::string> files;
+    for(int i(0); i < 100000; ++i)
+    {
+        files["streamreader/text.txt"] += static_cast<char>('a' + rand() % 4);
+    }
+    for(int i(0); i < 30000; ++i)
+    {
+        files["streamreader/random.bin"] += static_cast<char>(rand());
+    }
+    files["streamreader/small.txt"] = "a small file";
+    files["streamreader/empty.txt"] = "";
+    for(auto const & f : files)
+    {
+        std::ofstream os(f.first, std::ios::out | std::ios::binary);
+        os << f.second;
+    }
+
+    for(auto method : { zipios::StorageMethod::STORED
+                      , zipios::StorageMethod::DEFLATED
+                      , zipios::StorageMethod::LZMA
+                      , zipios::StorageMethod::ZSTD })
+    {
+        if(method != zipios::StorageMethod::STORED
+        && method != zipios::StorageMethod::DEFLATED
+        && !zipios::Codec::isSupported(method))
+        {
+            continue;
+        }
+
+        std::ostringstream out;
+        {
+            zipios::DirectoryCollection dc("streamreader");
+            dc.setMethod(0, method, method);
+            zipios::ZipFile::saveCollectionToArchive(out, dc);
+        }
+        std::string const archive(out.str());
+
+        // read all the data of all the entries
+        {
+            pipe_streambuf pipe(archive);
+            zipios::ZipStreamReader reader(&pipe);
+            REQUIRE_THROWS_AS(reader.getInputStream(), zipios::InvalidStateException);
+
+            std::map<std::string, std::string> found;
+            for(;;)
+            {
+                zipios::FileEntry::pointer_t entry(reader.getNextEntry());
+                if(entry == nullptr)
+                {
+                    break;
+                }
+                zipios::ZipStreamReader::stream_pointer_t is(reader.getInputStream());
+                std::string const data(read_stream(is));
+                INFO("method " << static_cast<int>(method) << " entry " << entry->getName());
+                REQUIRE_FALSE(is->bad());
+                if(entry->isDirectory())
+                {
+                    REQUIRE(data.empty());
+                    continue;
+                }
+                REQUIRE(entry->getSize() == data.length());
+                found[entry->getName()] = data;
+            }
+            REQUIRE(found == files);
+
+            // the end stays the end
+            REQUIRE(reader.getNextEntry() == nullptr);
+        }
+
+        // skip the data of some of the entries
+        {
+            std::istringstream is(archive);
+            zipios::ZipStreamReader reader(is);
+            size_t count(0);
+            for(;;)
+            {
+                zipios::FileEntry::pointer_t entry(reader.getNextEntry());
+                if(entry == nullptr)
+                {
+                    break;
+                }
+                if(entry->getName() == "streamreader/small.txt")
+                {
+                    REQUIRE(read_stream(reader.getInputStream()) == "a small file");
+                }
+                else if(entry->getName() == "streamreader/text.txt")
+                {
+                    // read only the start of the data
+                    zipios::ZipStreamReader::stream_pointer_t data(reader.getInputStream());
+                    char buf[100];
+                    REQUIRE(data->read(buf, sizeof(buf)));
+                    REQUIRE(std::string(buf, sizeof(buf)) == files["streamreader/text.txt"].substr(0, sizeof(buf)));
+                }
+                ++count;
+            }
+            REQUIRE(count == files.size() + 1);
+        }
+
+        // a corrupted entry is detected, read or skipped
+        if(method != zipios::StorageMethod::STORED)
+        {
+            continue;
+        }
+        std::string corrupted(archive);
+        size_t const pos(corrupted.find("a small file"));
+        REQUIRE(pos != std::string::npos);
+        corrupted[pos] = 'A';
+        for(int skip(0); skip < 2; ++skip)
+        {
+            std::istringstream is(corrupted);
+            zipios::ZipStreamReader reader(is);
+            bool failed(false);
+            for(;;)
+            {
+                zipios::FileEntry::pointer_t entry;
+                try
+                {
+                    entry = reader.getNextEntry();
+                }
+                catch(zipios::IOException const &)
+                {
+                    REQUIRE(skip == 1);
+                    failed = true;
+                    continue;
+                }
+                if(entry == nullptr)
+                {
+                    break;
+                }
+                if(skip == 0
+                && entry->getName() == "streamreader/small.txt")
+                {
+                    zipios::ZipStreamReader::stream_pointer_t data(reader.getInputStream());
+                    read_stream(data);
+                    REQUIRE(data->bad());
+                    failed = true;
+                }
+            }
+            REQUIRE(failed);
+        }
+    }
+
+    REQUIRE(system("rm -rf streamreader") == 0);
+}
+
+
+TEST_CASE("ZipStreamReader trailing data descriptors", "[ZipStreamReader]")
+{
+    std::string text;
+    for(int i(0); i < 50000; ++i)
+    {
+        text += static_cast<char>('a' + rand() % 4);
+    }
+
+    // STORED data which includes what looks like a data descriptor
+    std::string tricky("before PK\x07\x08 after");
+    write32(tricky, 0);
+    write32(tricky, 7);
+    write32(tricky, 7);
+    tricky += " and more PK\x07\x08";
+
+    std::string archive;
+    write32(archive, 0x08074b50); // split archive marker
+    append_entry(archive, "text.txt", text, true, descriptor_t::DESCRIPTOR_SIGNATURE);
+    append_entry(archive, "no-signature.txt", text, true, descriptor_t::DESCRIPTOR_NO_SIGNATURE);
+    append_entry(archive, "zip64.txt", text, true, descriptor_t::DESCRIPTOR_ZIP64);
+    append_entry(archive, "stored.txt", text, false, descriptor_t::DESCRIPTOR_SIGNATURE);
+    append_entry(archive, "stored64.txt", text, false, descriptor_t::DESCRIPTOR_ZIP64);
+    append_entry(archive, "tricky.bin", tricky, false, descriptor_t::DESCRIPTOR_SIGNATURE);
+    append_entry(archive, "empty.txt", "", false, descriptor_t::DESCRIPTOR_SIGNATURE);
+    append_entry(archive, "empty-deflated.txt", "", true, descriptor_t::DESCRIPTOR_NO_SIGNATURE);
+    append_entry(archive, "plain.txt", text, true, descriptor_t::DESCRIPTOR_NONE);
+    std::string const entries(archive);
+    append_central_directory(archive);
+
+    std::map<std::string, std::string> const expected{
+            { "text.txt", text },
+            { "no-signature.txt", text },
+            { "zip64.txt", text },
+            { "stored.txt", text },
+            { "stored64.txt", text },
+            { "tricky.bin", tricky },
+            { "empty.txt", "" },
+            { "empty-deflated.txt", "" },
+            { "plain.txt", text },
+        };
+
+    SECTION("read all the entries")
+    {
+        pipe_streambuf pipe(archive);
+        zipios::ZipStreamReader reader(&pipe);
+        std::map<std::string, std::string> found;
+        for(;;)
+        {
+            zipios::FileEntry::pointer_t entry(reader.getNextEntry());
+            if(entry == nullptr)
+            {
+                break;
+            }
+            std::string const data(read_stream(reader.getInputStream()));
+
+            // the descriptor was applied to the entry
+            REQUIRE(entry->getSize() == data.length());
+            REQUIRE(entry->getCrc() == crc32(0, reinterpret_cast<Bytef const *>(data.c_str()), data.length()));
+            found[entry->getName()] = data;
+        }
+        REQUIRE(found == expected);
+    }
+
+    SECTION("skip all the entries")
+    {
+        std::istringstream is(archive);
+        zipios::ZipStreamReader reader(is);
+        size_t count(0);
+        while(reader.getNextEntry() != nullptr)
+        {
+            ++count;
+        }
+        REQUIRE(count == expected.size());
+    }
+
+    SECTION("the archive can end without a central directory")
+    {
+        std::istringstream is(entries);
+        zipios::ZipStreamReader reader(is);
+        size_t count(0);
+        while(reader.getNextEntry() != nullptr)
+        {
+            ++count;
+        }
+        REQUIRE(count == expected.size());
+    }
+
+    SECTION("a wrong CRC in a descriptor is detected")
+    {
+        std::string bad;
+        append_entry(bad, "text.txt", text, true, descriptor_t::DESCRIPTOR_SIGNATURE);
+        bad[bad.length() - 12] ^= 1;
+        append_central_directory(bad);
+
+        std::istringstream is(bad);
+        zipios::ZipStreamReader reader(is);
+        REQUIRE(reader.getNextEntry() != nullptr);
+        zipios::ZipStreamReader::stream_pointer_t data(reader.getInputStream());
+        read_stream(data);
+        REQUIRE(data->bad());
+        REQUIRE(reader.getNextEntry() == nullptr);
+    }
+
+    SECTION("a STORED entry without its descriptor is truncated")
+    {
+        std::string bad;
+        append_entry(bad, "stored.txt", text, false, descriptor_t::DESCRIPTOR_SIGNATURE);
+        bad.resize(bad.length() - 16);
+
+        std::istringstream is(bad);
+        zipios::ZipStreamReader reader(is);
+        REQUIRE(reader.getNextEntry() != nullptr);
+        REQUIRE_THROWS_AS(reader.getNextEntry(), zipios::IOException);
+    }
+
+    SECTION("truncated archives")
+    {
+        for(size_t size : { static_cast<size_t>(2), static_cast<size_t>(20), static_cast<size_t>(40), entries.find("no-signature.txt") - 20 })
+        {
+            std::istringstream is(entries.substr(0, size));
+            zipios::ZipStreamReader reader(is);
+            auto read_all = [&reader]()
+                {
+                    while(reader.getNextEntry() != nullptr)
+                    {
+                    }
+                };
+            REQUIRE_THROWS_AS(read_all(), zipios::IOException);
+        }
+    }
+
+    SECTION("invalid input")
+    {
+        {
+            std::istringstream is("");
+            zipios::ZipStreamReader reader(is);
+            REQUIRE(reader.getNextEntry() == nullptr);
+        }
+        {
+            std::istringstream is("this is not a zip archive");
+            zipios::ZipStreamReader reader(is);
+            REQUIRE_THROWS_AS(reader.getNextEntry(), zipios::FileCollectionException);
+        }
+        REQUIRE_THROWS_AS(zipios::ZipStreamReader(static_cast<std::streambuf *>(nullptr)), zipios::InvalidException);
+    }
+}
+
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
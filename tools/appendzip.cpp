@@ -88,17 +88,28 @@ int main(int argc, char *argv[])
     }
 
     // get eof pos (to become zip file starting position).
-    uint32_t const zip_start = exef.tellp();
+    uint64_t const zip_start = exef.tellp();
     std::cout << "zip start will be at " << zip_start << std::endl;
 
     // Append zip file to exe file
     exef << zipf.rdbuf();
 
     // write zipfile start offset to file
-    exef << static_cast<unsigned char>(zip_start);
-    exef << static_cast<unsigned char>(zip_start >> 8);
-    exef << static_cast<unsigned char>(zip_start >> 16);
-    exef << static_cast<unsigned char>(zip_start >> 24);
+    // (if it does not fit in 32 bits, write the 64 bit offset followed
+    // by 0xFFFFFFFF instead)
+    uint64_t offset(zip_start);
+    if(zip_start >= 0xFFFFFFFF)
+    {
+        for(int i(0); i < 8; ++i)
+        {
+            exef << static_cast<unsigned char>(zip_start >> (i * 8));
+        }
+        offset = 0xFFFFFFFF;
+    }
+    exef << static_cast<unsigned char>(offset);
+    exef << static_cast<unsigned char>(offset >> 8);
+    exef << static_cast<unsigned char>(offset >> 16);
+    exef << static_cast<unsigned char>(offset >> 24);
     //zipios::writeUint32(zip_start, exef); -- TODO: delete once verified
 
     return 0;
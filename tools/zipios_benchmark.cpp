@@ -0,0 +1,539 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2019  Made to Order Software Corporation
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief A tool to measure the time zipios takes to do various things.
+ *
+ * This tool is used to benchmark the library against real archives.
+ * Each function is repeated a number of times and the tool prints
+ * the minimum and average time it took for each file.
+ *
+ * For example, to measure how long it takes to open an archive
+ * (find the End of Central Directory and read the Central Directory)
+ * or to reject a file which is not a Zip archive:
+ *
+ * \code
+ *      zipios_benchmark --open --repeat 100 archive.zip not-a-zip.bin
+ * \endcode
+ *
+ * To measure how reading all the entries of one ZipFile scales with
+ * the number of threads sharing it (1, 2, 4, and 8 threads):
+ *
+ * \code
+ *      zipios_benchmark --read --threads 8 archive.zip
+ * \endcode
+ *
+ * To compare the inflaters available to decompress whole entries
+ * (zlib and, when Zipios was built with it, libdeflate):
+ *
+ * \code
+ *      zipios_benchmark --read --whole --inflater all archive.zip
+ * \endcode
+ *
+ * To compare saving the entries of an archive to a new archive in
+ * memory by seeking back to the local headers and with trailing data
+ * descriptors, as done when the output cannot seek:
+ *
+ * \code
+ *      zipios_benchmark --write archive.zip
+ * \endcode
+ *
+ * The entries are copied without being compressed again. Add the
+ * --recompress option to measure the compression instead, and the
+ * --threads option to compare compressing with several threads:
+ *
+ * \code
+ *      zipios_benchmark --write --recompress --threads 8 archive.zip
+ * \endcode
+ *
+ * This tool is not installed.
+ */
+
+#include "zipios/zipfile.hpp"
+#include "zipios/zipiosexceptions.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#include <stdlib.h>
+
+
+/** \brief A few static variables and functions.
+ *
+ * This namespace includes various declarations, variables, and functions
+ * that are specific to the zipios_benchmark tool.
+ */
+namespace
+{
+
+/** \brief Name of the program.
+ *
+ * This variable holds the name of the program. As soon as the main()
+ * function is entered, this variable gets defined.
+ */
+char *g_progname;
+
+
+/** \brief Usage of the zipios_benchmark tool.
+ *
+ * This function prints out the zipios_benchmark tool usage and then
+ * exits with error code 1.
+ */
+void usage()
+{
+    std::cout << "Usage:  " << g_progname << " [-opt] [file ...]" << std::endl;
+    std::cout << "Where -opt is one or more of:" << std::endl;
+    std::cout << "  --help                  show this help screen" << std::endl;
+    std::cout << "  --index                 use an index file named <file>.index (created if necessary)" << std::endl;
+    std::cout << "  --inflater <name>       with --whole, use the named inflater or \"all\" to compare all the available inflaters" << std::endl;
+    std::cout << "  --mmap                  map the archives in memory instead of using streams" << std::endl;
+    std::cout << "  --open                  time opening the archives (or rejecting non-archives)" << std::endl;
+    std::cout << "  --read                  time reading all the entries of the archives" << std::endl;
+    std::cout << "  --recompress            with --write, compress the entries again instead of copying the compressed data" << std::endl;
+    std::cout << "  --repeat <count>        repeat each measurement <count> times (default 10)" << std::endl;
+    std::cout << "  --threads <count>       with --read, share the ZipFile between 1, 2, 4, ... up to <count> threads;" << std::endl;
+    std::cout << "                          with --write, compress the entries with 1, 2, 4, ... up to <count> threads" << std::endl;
+    std::cout << "  --validation <level>    one of: none, central-directory, lazy, full (default)" << std::endl;
+    std::cout << "  --whole                 with --read, read each entry at once with ZipFile::readEntry()" << std::endl;
+    std::cout << "  --write                 time saving the archives to memory by seeking back and with data descriptors" << std::endl;
+    exit(1);
+}
+
+
+/** \brief The function to benchmark.
+ *
+ * This enumeration lists all the functions the zipios_benchmark tool
+ * can measure.
+ */
+enum class func_t
+{
+    /** \brief Still undefined.
+     *
+     * This is used to know whether the user had a function on the command
+     * line that would be run by zipios_benchmark.
+     */
+    UNDEFINED,
+
+    /** \brief Time the opening of a Zip archive.
+     *
+     * This function is used when the user specify --open. It measures
+     * the time the ZipFile constructor takes. A file which is not a Zip
+     * archive gets rejected and the time it took to reject it is shown.
+     */
+    OPEN,
+
+    /** \brief Time reading all the entries of a Zip archive.
+     *
+     * This function is used when the user specify --read. It measures
+     * the time it takes to read the data of all the entries of an
+     * opened ZipFile. With --threads, the entries are split between
+     * threads which all share the same ZipFile object.
+     */
+    READ,
+
+    /** \brief Time saving the entries of a Zip archive.
+     *
+     * This function is used when the user specify --write. It measures
+     * the time ZipFile::saveCollectionToArchive() takes to save all the
+     * entries of an opened ZipFile to memory with each of the
+     * ZipFile::WriteMode. With --recompress, the level of the entries
+     * is changed to COMPRESSION_LEVEL_FASTEST so they get compressed
+     * again instead of being copied as is. With --threads, the entries
+     * get compressed by 1, 2, 4, ... threads.
+     */
+    WRITE
+};
+
+
+/** \brief The clock used to measure the time spent.
+ *
+ * We use a steady clock so changes to the system time do not
+ * affect the results.
+ */
+typedef std::chrono::steady_clock       benchmark_clock_t;
+
+
+/** \brief Print the result of a measurement.
+ *
+ * This function prints the name of the file, the name of the function,
+ * and the minimum and average durations in milliseconds.
+ *
+ * \param[in] filename  The name of the file the measurement was done on.
+ * \param[in] what  The name of the function that was measured.
+ * \param[in] min  The fastest run.
+ * \param[in] total  The sum of all the runs.
+ * \param[in] repeat  The number of runs.
+ */
+void print_result(std::string const & filename, char const * what, benchmark_clock_t::duration min, benchmark_clock_t::duration total, int repeat)
+{
+    typedef std::chrono::duration<double, std::milli> ms_t;
+
+    std::cout << filename << ": " << what
+              << std::fixed << std::setprecision(3)
+              << ": min " << std::chrono::duration_cast<ms_t>(min).count()
+              << " ms, avg " << std::chrono::duration_cast<ms_t>(total).count() / repeat
+              << " ms (" << repeat << " runs)" << std::endl;
+}
+
+
+/** \brief Read the data of some of the entries of a ZipFile.
+ *
+ * This function reads the data of the entries found at \p start,
+ * \p start + \p step, \p start + 2 * \p step, etc. It is used by
+ * each thread of the --read benchmark.
+ *
+ * \param[in] zf  The ZipFile to read from.
+ * \param[in] names  The names of all the entries.
+ * \param[in] start  The index of the first entry to read.
+ * \param[in] step  The number of entries to skip between reads.
+ * \param[in] whole  Read the entries with ZipFile::readEntry() instead
+ *                   of a stream.
+ *
+ * \return The number of bytes read.
+ */
+size_t read_entries(zipios::ZipFile & zf, std::vector<std::string> const & names, size_t start, size_t step, bool whole)
+{
+    size_t total(0);
+    for(size_t idx(start); idx < names.size(); idx += step)
+    {
+        if(whole)
+        {
+            total += zf.readEntry(names[idx]).size();
+            continue;
+        }
+        zipios::FileCollection::stream_pointer_t is(zf.getInputStream(names[idx]));
+        char buf[BUFSIZ];
+        while(is->read(buf, sizeof(buf)) || is->gcount() > 0)
+        {
+            total += is->gcount();
+        }
+    }
+    return total;
+}
+
+
+} // no name namespace
+
+
+int main(int argc, char *argv[])
+{
+    // define program name
+    {
+        g_progname = argv[0];
+        char *e(strrchr(g_progname, '/'));
+        if(e)
+        {
+            g_progname = e + 1;
+        }
+        e = strrchr(g_progname, '\\');
+        if(e)
+        {
+            g_progname = e + 1;
+        }
+    }
+
+    try
+    {
+        // check the various command line options
+        std::vector<std::string> files;
+        func_t function(func_t::UNDEFINED);
+        int repeat(10);
+        int thread_count(1);
+        bool use_index(false);
+        bool recompress(false);
+        bool whole(false);
+        std::vector<std::string> inflaters;
+        zipios::ZipFile::AccessMode access_mode(zipios::ZipFile::AccessMode::STREAM);
+        zipios::ZipFile::ValidationLevel validation_level(zipios::ZipFile::ValidationLevel::FULL);
+        for(int i(1); i < argc; ++i)
+        {
+            if(argv[i][0] == '-')
+            {
+                if(strcmp(argv[i], "--help") == 0)
+                {
+                    usage();
+                }
+                if(strcmp(argv[i], "--open") == 0)
+                {
+                    function = func_t::OPEN;
+                }
+                else if(strcmp(argv[i], "--read") == 0)
+                {
+                    function = func_t::READ;
+                }
+                else if(strcmp(argv[i], "--recompress") == 0)
+                {
+                    recompress = true;
+                }
+                else if(strcmp(argv[i], "--index") == 0)
+                {
+                    use_index = true;
+                }
+                else if(strcmp(argv[i], "--inflater") == 0)
+                {
+                    ++i;
+                    if(i >= argc)
+                    {
+                        std::cerr << g_progname << ":error: --inflater expects a name." << std::endl;
+                        usage();
+                    }
+                    if(strcmp(argv[i], "all") == 0)
+                    {
+                        inflaters = zipios::Inflater::getNames();
+                    }
+                    else
+                    {
+                        inflaters.push_back(argv[i]);
+                    }
+                }
+                else if(strcmp(argv[i], "--mmap") == 0)
+                {
+                    access_mode = zipios::ZipFile::AccessMode::MEMORY_MAP;
+                }
+                else if(strcmp(argv[i], "--repeat") == 0)
+                {
+                    ++i;
+                    if(i >= argc)
+                    {
+                        std::cerr << g_progname << ":error: --repeat expects a count." << std::endl;
+                        usage();
+                    }
+                    repeat = atoi(argv[i]);
+                    if(repeat <= 0)
+                    {
+                        std::cerr << g_progname << ":error: --repeat expects a positive count." << std::endl;
+                        usage();
+                    }
+                }
+                else if(strcmp(argv[i], "--threads") == 0)
+                {
+                    ++i;
+                    if(i >= argc)
+                    {
+                        std::cerr << g_progname << ":error: --threads expects a count." << std::endl;
+                        usage();
+                    }
+                    thread_count = atoi(argv[i]);
+                    if(thread_count <= 0)
+                    {
+                        std::cerr << g_progname << ":error: --threads expects a positive count." << std::endl;
+                        usage();
+                    }
+                }
+                else if(strcmp(argv[i], "--validation") == 0)
+                {
+                    ++i;
+                    if(i >= argc)
+                    {
+                        std::cerr << g_progname << ":error: --validation expects a level." << std::endl;
+                        usage();
+                    }
+                    if(strcmp(argv[i], "none") == 0)
+                    {
+                        validation_level = zipios::ZipFile::ValidationLevel::NONE;
+                    }
+                    else if(strcmp(argv[i], "central-directory") == 0)
+                    {
+                        validation_level = zipios::ZipFile::ValidationLevel::CENTRAL_DIRECTORY;
+                    }
+                    else if(strcmp(argv[i], "lazy") == 0)
+                    {
+                        validation_level = zipios::ZipFile::ValidationLevel::LAZY;
+                    }
+                    else if(strcmp(argv[i], "full") == 0)
+                    {
+                        validation_level = zipios::ZipFile::ValidationLevel::FULL;
+                    }
+                    else
+                    {
+                        std::cerr << g_progname << ":error: unknown validation level \"" << argv[i] << "\"." << std::endl;
+                        usage();
+                    }
+                }
+                else if(strcmp(argv[i], "--whole") == 0)
+                {
+                    whole = true;
+                }
+                else if(strcmp(argv[i], "--write") == 0)
+                {
+                    function = func_t::WRITE;
+                }
+                else
+                {
+                    std::cerr << g_progname << ":error: unknown option \"" << argv[i] << "\"." << std::endl;
+                    usage();
+                }
+            }
+            else
+            {
+                files.push_back(argv[i]);
+            }
+        }
+
+        if(inflaters.empty())
+        {
+            // the default inflater
+            inflaters.push_back(std::string());
+        }
+
+        switch(function)
+        {
+        case func_t::OPEN:
+            for(auto it(files.begin()); it != files.end(); ++it)
+            {
+                std::string const index_filename(use_index ? *it + ".index" : std::string());
+                benchmark_clock_t::duration min(benchmark_clock_t::duration::max());
+                benchmark_clock_t::duration total(benchmark_clock_t::duration::zero());
+                bool rejected(false);
+                for(int r(0); r < repeat; ++r)
+                {
+                    benchmark_clock_t::time_point const start(benchmark_clock_t::now());
+                    try
+                    {
+                        zipios::ZipFile zf(*it, 0, 0, access_mode, validation_level, index_filename);
+                    }
+                    catch(zipios::Exception const &)
+                    {
+                        rejected = true;
+                    }
+                    benchmark_clock_t::duration const d(benchmark_clock_t::now() - start);
+                    min = std::min(min, d);
+                    total += d;
+                }
+                print_result(*it, rejected ? "reject" : "open", min, total, repeat);
+            }
+            break;
+
+        case func_t::READ:
+            for(auto it(files.begin()); it != files.end(); ++it)
+            {
+                std::string const index_filename(use_index ? *it + ".index" : std::string());
+                zipios::ZipFile zf(*it, 0, 0, access_mode, validation_level, index_filename);
+                std::vector<std::string> names;
+                zipios::FileEntry::vector_t const entries(zf.entries());
+                for(auto const & e : entries)
+                {
+                    if(!e->isDirectory())
+                    {
+                        names.push_back(e->getName());
+                    }
+                }
+
+                for(auto const & inflater : inflaters)
+                {
+                    zf.setInflater(zipios::Inflater::create(inflater));
+                    std::string const mode(whole ? "whole read (" + zf.getInflater()->getName() + ")" : std::string("read"));
+                    for(int count(1);; count = std::min(count * 2, thread_count))
+                    {
+                        benchmark_clock_t::duration min(benchmark_clock_t::duration::max());
+                        benchmark_clock_t::duration total(benchmark_clock_t::duration::zero());
+                        for(int r(0); r < repeat; ++r)
+                        {
+                            benchmark_clock_t::time_point const start(benchmark_clock_t::now());
+                            std::vector<std::thread> threads;
+                            for(int t(0); t < count; ++t)
+                            {
+                                threads.push_back(std::thread(read_entries, std::ref(zf), std::cref(names), t, count, whole));
+                            }
+                            for(auto & th : threads)
+                            {
+                                th.join();
+                            }
+                            benchmark_clock_t::duration const d(benchmark_clock_t::now() - start);
+                            min = std::min(min, d);
+                            total += d;
+                        }
+                        std::string const what(mode + " with " + std::to_string(count) + (count == 1 ? " thread" : " threads"));
+                        print_result(*it, what.c_str(), min, total, repeat);
+                        if(count >= thread_count)
+                        {
+                            break;
+                        }
+                    }
+                }
+            }
+            break;
+
+        case func_t::WRITE:
+            for(auto it(files.begin()); it != files.end(); ++it)
+            {
+                std::string const index_filename(use_index ? *it + ".index" : std::string());
+                zipios::ZipFile zf(*it, 0, 0, access_mode, validation_level, index_filename);
+                if(recompress)
+                {
+                    zf.setLevel(0, zipios::FileEntry::COMPRESSION_LEVEL_FASTEST, zipios::FileEntry::COMPRESSION_LEVEL_FASTEST);
+                }
+                for(auto write_mode : { zipios::ZipFile::WriteMode::SEEK_BACK, zipios::ZipFile::WriteMode::DATA_DESCRIPTOR })
+                {
+                    std::string const mode(write_mode == zipios::ZipFile::WriteMode::SEEK_BACK ? "write (seek back)" : "write (data descriptor)");
+                    for(int count(1);; count = std::min(count * 2, thread_count))
+                    {
+                        benchmark_clock_t::duration min(benchmark_clock_t::duration::max());
+                        benchmark_clock_t::duration total(benchmark_clock_t::duration::zero());
+                        for(int r(0); r < repeat; ++r)
+                        {
+                            std::stringstream out;
+                            benchmark_clock_t::time_point const start(benchmark_clock_t::now());
+                            zipios::ZipFile::saveCollectionToArchive(out, zf, std::string(), write_mode, count);
+                            benchmark_clock_t::duration const d(benchmark_clock_t::now() - start);
+                            min = std::min(min, d);
+                            total += d;
+                        }
+                        std::string const what(mode + " with " + std::to_string(count) + (count == 1 ? " thread" : " threads"));
+                        print_result(*it, what.c_str(), min, total, repeat);
+                        if(count >= thread_count)
+                        {
+                            break;
+                        }
+                    }
+                }
+            }
+            break;
+
+        default:
+            std::cerr << g_progname << ":error: undefined function." << std::endl;
+            usage();
+            break;
+
+        }
+    }
+    catch(zipios::Exception const & e)
+    {
+        std::cerr << g_progname << ":error: an exception occurred: "
+                  << e.what() << std::endl;
+    }
+
+    return 0;
+}
+
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
@@ -30,6 +30,7 @@
  * a collection of collections with a simple interface.
  */
 
+#include "zipios/entrycache.hpp"
 #include "zipios/filecollection.hpp"
 
 
@@ -50,13 +51,18 @@ public:
     bool                            addCollection(FileCollection::pointer_t collection);
     virtual void                    close() override;
     virtual FileEntry::vector_t     entries() const override;
+    EntryCache::statistics_t        getCacheStatistics() const;
     virtual FileEntry::pointer_t    getEntry(std::string const & name, MatchPath matchpath = MatchPath::MATCH) const override;
     virtual stream_pointer_t        getInputStream(std::string const & entry_name, MatchPath matchpath = MatchPath::MATCH) override;
+    virtual FileEntry::vector_t     glob(std::string const & pattern) const override;
+    virtual FileEntry::vector_t     listDirectory(std::string const & prefix, bool recursive = false) const override;
+    void                            setCacheBudget(size_t budget);
     virtual size_t                  size() const override;
     virtual void                    mustBeValid() const;
 
 protected:
     vector_t                        m_collections;
+    EntryCache::pointer_t           m_cache;
 };
 
 
@@ -50,6 +50,8 @@ public:
     virtual FileEntry::vector_t     entries() const override;
     virtual FileEntry::pointer_t    getEntry(std::string const& name, MatchPath matchpath = MatchPath::MATCH) const override;
     virtual stream_pointer_t        getInputStream(std::string const& entry_name, MatchPath matchpath = MatchPath::MATCH) override;
+    virtual FileEntry::vector_t     glob(std::string const & pattern) const override;
+    virtual FileEntry::vector_t     listDirectory(std::string const & prefix, bool recursive = false) const override;
 
 protected:
     void                            loadEntries() const;
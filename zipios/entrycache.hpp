@@ -0,0 +1,109 @@
+#pragma once
+#ifndef ZIPIOS_ENTRYCACHE_HPP
+#define ZIPIOS_ENTRYCACHE_HPP
+
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2019  Made to Order Software Corporation
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Define the zipios::EntryCache class.
+ *
+ * The zipios::EntryCache class keeps the decompressed content of the
+ * entries most recently read from a collection so reading them again
+ * does not require decompressing them again.
+ */
+
+#include "zipios/zipios-config.hpp"
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+namespace zipios
+{
+
+
+class EntryCache
+{
+public:
+    typedef std::shared_ptr<EntryCache>                 pointer_t;
+    typedef std::shared_ptr<std::vector<char> const>    data_t;
+
+    struct statistics_t
+    {
+        size_t                  m_budget = 0;
+        size_t                  m_size = 0;
+        size_t                  m_count = 0;
+        size_t                  m_hits = 0;
+        size_t                  m_misses = 0;
+        size_t                  m_evictions = 0;
+    };
+
+                                EntryCache(size_t budget);
+                                EntryCache(EntryCache const & src) = delete;
+    EntryCache &                operator = (EntryCache const & rhs) = delete;
+
+    size_t                      getBudget() const;
+    void                        setBudget(size_t budget);
+    data_t                      find(std::string const & name);
+    void                        insert(std::string const & name, data_t data);
+    void                        clear();
+    statistics_t                getStatistics() const;
+
+private:
+    struct item_t
+    {
+        std::string             m_name;
+        data_t                  m_data;
+        bool                    m_protected = false;
+    };
+
+    typedef std::list<item_t>   list_t;
+
+    void                        evict();
+
+    mutable std::mutex          m_mutex;
+    size_t                      m_budget = 0;
+    list_t                      m_probation;
+    list_t                      m_protected;
+    size_t                      m_probation_size = 0;
+    size_t                      m_protected_size = 0;
+    std::unordered_map<std::string, list_t::iterator>   m_items;
+    size_t                      m_hits = 0;
+    size_t                      m_misses = 0;
+    size_t                      m_evictions = 0;
+};
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
+#endif
@@ -32,17 +32,26 @@
 
 #include "zipios/fileentry.hpp"
 
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+
 
 namespace zipios
 {
 
 
+class SortedNames;
+
+
 class FileCollection
 {
 public:
     typedef std::shared_ptr<FileCollection> pointer_t;
     typedef std::vector<pointer_t>          vector_t;
     typedef std::shared_ptr<std::istream>   stream_pointer_t;
+    typedef std::function<StorageMethod (FileEntry const & entry)>  method_selector_t;
 
     enum class MatchPath : uint32_t
     {
@@ -62,16 +71,35 @@ public:
     virtual FileEntry::pointer_t    getEntry(std::string const & name, MatchPath matchpath = MatchPath::MATCH) const;
     virtual stream_pointer_t        getInputStream(std::string const & entry_name, MatchPath matchpath = MatchPath::MATCH) = 0;
     virtual std::string             getName() const;
+    virtual FileEntry::vector_t     glob(std::string const & pattern) const;
+    virtual FileEntry::vector_t     listDirectory(std::string const & prefix, bool recursive = false) const;
     virtual size_t                  size() const;
     bool                            isValid() const;
     virtual void                    mustBeValid() const;
     void                            setMethod(size_t limit, StorageMethod small_storage_method, StorageMethod large_storage_method);
+    void                            setMethod(method_selector_t selector);
     void                            setLevel(size_t limit, FileEntry::CompressionLevel small_compression_level, FileEntry::CompressionLevel large_compression_level);
 
 protected:
+    typedef std::unordered_map<std::string, size_t> entry_index_t;
+
+    void                            buildIndex() const;
+    void                            buildSortedIndex() const;
+    bool                            findEntryIndex(std::string const & name, MatchPath matchpath, size_t & index) const;
+    void                            resetIndex();
+
     std::string                     m_filename;
     FileEntry::vector_t             m_entries;
     bool                            m_valid = true;
+
+private:
+    mutable std::mutex              m_index_mutex;
+    mutable entry_index_t           m_name_index;
+    mutable entry_index_t           m_filename_index;
+    mutable std::atomic<size_t>     m_indexed_entries{0};
+    mutable std::vector<std::string> m_sorted_entry_names;
+    mutable std::shared_ptr<SortedNames> m_sorted_names;
+    mutable std::atomic<size_t>     m_sorted_entries{0};
 };
 
 
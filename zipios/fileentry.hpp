@@ -67,6 +67,7 @@ enum class StorageMethod : uint8_t
     RESERVED17  = 17,
     NEW_TERSE   = 18,
     LZ77        = 19,
+    ZSTD        = 93,
     WAVPACK     = 97,
     PPMD_I_1    = 98
 };
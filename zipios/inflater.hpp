@@ -0,0 +1,69 @@
+#pragma once
+#ifndef ZIPIOS_INFLATER_HPP
+#define ZIPIOS_INFLATER_HPP
+
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2019  Made to Order Software Corporation
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Define the zipios::Inflater interface.
+ *
+ * The zipios::Inflater interface is used to decompress the whole data
+ * of a DEFLATED entry at once. Zipios offers a zlib implementation and,
+ * when available at build time, a libdeflate implementation.
+ */
+
+#include "zipios/zipios-config.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+
+namespace zipios
+{
+
+
+class Inflater
+{
+public:
+    typedef std::shared_ptr<Inflater>   pointer_t;
+
+    virtual                     ~Inflater();
+
+    virtual std::string         getName() const = 0;
+    virtual void                inflate(char const * input, size_t input_size, char * output, size_t output_size) = 0;
+
+    static pointer_t            create(std::string const & name = std::string());
+    static std::vector<std::string> getNames();
+};
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
+#endif
@@ -36,29 +36,118 @@
  * zipios::FileEntry objects from a zipios::DirectoryCollection.
  */
 
+#include "zipios/entrycache.hpp"
 #include "zipios/filecollection.hpp"
+#include "zipios/inflater.hpp"
 #include "zipios/virtualseeker.hpp"
 
+#include <map>
+
 
 namespace zipios
 {
 
 
+class InflateCheckpoints;
+class InflatePool;
+class MemoryMappedFile;
+class PositionalFile;
+class ZipEntryTable;
+
+
 class ZipFile : public FileCollection
 {
 public:
+    enum class AccessMode : uint32_t
+    {
+        STREAM,
+        MEMORY_MAP
+    };
+
+    enum class ValidationLevel : uint32_t
+    {
+        NONE,
+        CENTRAL_DIRECTORY,
+        LAZY,
+        FULL
+    };
+
+    enum class WriteMode : uint32_t
+    {
+        AUTO,
+        SEEK_BACK,
+        DATA_DESCRIPTOR
+    };
+
     static pointer_t            openEmbeddedZipFile(std::string const & name);
 
                                 ZipFile();
-                                ZipFile(std::string const & filename, offset_t s_off = 0, offset_t e_off = 0);
+                                ZipFile(std::string const & filename, offset_t s_off = 0, offset_t e_off = 0, AccessMode access_mode = AccessMode::STREAM, ValidationLevel validation_level = ValidationLevel::FULL, std::string const & index_filename = std::string());
+                                ZipFile(ZipFile const & src);
+    ZipFile &                   operator = (ZipFile const & rhs);
     virtual pointer_t           clone() const override;
     virtual                     ~ZipFile() override;
 
+    virtual void                addEntry(FileEntry const & entry) override;
+    virtual void                close() override;
+    virtual FileEntry::vector_t entries() const override;
+    AccessMode                  getAccessMode() const;
+    EntryCache::statistics_t    getCacheStatistics() const;
+    size_t                      getCheckpointInterval() const;
+    bool                        getCrcVerification() const;
+    virtual FileEntry::pointer_t getEntry(std::string const & name, MatchPath matchpath = MatchPath::MATCH) const override;
+    Inflater::pointer_t         getInflater() const;
+    ValidationLevel             getValidationLevel() const;
     virtual stream_pointer_t    getInputStream(std::string const & entry_name, MatchPath matchpath = MatchPath::MATCH) override;
-    static void                 saveCollectionToArchive(std::ostream & os, FileCollection & collection, std::string const & zip_comment = "");
+    stream_pointer_t            getRawInputStream(std::string const & entry_name, MatchPath matchpath = MatchPath::MATCH);
+    virtual FileEntry::vector_t glob(std::string const & pattern) const override;
+    virtual FileEntry::vector_t listDirectory(std::string const & prefix, bool recursive = false) const override;
+    size_t                      readEntry(std::string const & entry_name, char * buffer, size_t size, MatchPath matchpath = MatchPath::MATCH) const;
+    std::vector<char>           readEntry(std::string const & entry_name, MatchPath matchpath = MatchPath::MATCH) const;
+    bool                        loadCheckpoints(std::string const & entry_name, std::istream & is);
+    void                        saveCheckpoints(std::string const & entry_name, std::ostream & os);
+    void                        setCacheBudget(size_t budget);
+    void                        setCheckpointInterval(size_t interval);
+    void                        setCrcVerification(bool verify);
+    void                        setInflater(Inflater::pointer_t inflater);
+    virtual size_t              size() const override;
+    static size_t const         SAVE_MEMORY_BUDGET_DEFAULT = 64 * 1024 * 1024;
+
+    static void                 saveCollectionToArchive(std::ostream & os, FileCollection & collection, std::string const & zip_comment = "", WriteMode write_mode = WriteMode::AUTO, size_t thread_count = 1, size_t memory_budget = SAVE_MEMORY_BUDGET_DEFAULT, size_t deflate_thread_count = 1);
 
 private:
+    typedef std::vector<std::atomic<bool>>  verified_entries_t;
+    typedef std::map<size_t, std::shared_ptr<InflateCheckpoints>>   checkpoints_t;
+
+    void                        loadEntries() const;
+    FileEntry::pointer_t        getTableEntry(size_t index) const;
+    FileEntry::vector_t         cloneTableEntries() const;
+    bool                        isRawCopyPossible(FileEntry const & entry) const;
+    size_t                      findEntryIndex(std::string const & entry_name, MatchPath matchpath) const;
+    size_t                      readArchive(offset_t position, char * buffer, size_t size) const;
+    offset_t                    getEntryDataOffset(size_t index) const;
+    void                        readEntryData(size_t index, char * buffer) const;
+    void                        decompressEntryData(size_t index, offset_t data_offset, char * buffer) const;
+    std::shared_ptr<InflateCheckpoints> getCheckpoints(size_t index);
+
     VirtualSeeker               m_vs;
+    AccessMode                  m_access_mode = AccessMode::STREAM;
+    ValidationLevel             m_validation_level = ValidationLevel::FULL;
+    std::shared_ptr<verified_entries_t> m_verified_entries;
+    std::shared_ptr<MemoryMappedFile>   m_mapped_file;
+    std::shared_ptr<PositionalFile>     m_positional_file;
+    std::shared_ptr<InflatePool>        m_inflate_pool;
+    EntryCache::pointer_t               m_cache;
+    Inflater::pointer_t                 m_inflater;
+    std::shared_ptr<ZipEntryTable const> m_entry_table;
+    mutable std::mutex          m_entries_mutex;
+    mutable FileEntry::vector_t m_table_entries;
+    mutable std::atomic<bool>   m_entries_loaded{false};
+    mutable std::mutex          m_checkpoints_mutex;
+    size_t                      m_checkpoint_interval = 0;
+    checkpoints_t               m_checkpoints;
+    std::atomic<bool>           m_use_checkpoints{false};
+    std::atomic<bool>           m_verify_crc{false};
 };
 
 
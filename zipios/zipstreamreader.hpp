@@ -0,0 +1,74 @@
+#pragma once
+#ifndef ZIPIOS_ZIPSTREAMREADER_HPP
+#define ZIPIOS_ZIPSTREAMREADER_HPP
+
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2019  Made to Order Software Corporation
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Define the zipios::ZipStreamReader class.
+ *
+ * The zipios::ZipStreamReader class reads a Zip archive sequentially
+ * from a stream which cannot seek, such as a pipe or stdin.
+ */
+
+#include "zipios/fileentry.hpp"
+
+#include <memory>
+
+
+namespace zipios
+{
+
+
+class ZipStreamReaderStreambuf;
+
+
+class ZipStreamReader
+{
+public:
+    typedef std::shared_ptr<std::istream>   stream_pointer_t;
+
+                                ZipStreamReader(std::istream & is);
+                                ZipStreamReader(std::streambuf * inbuf);
+                                ZipStreamReader(ZipStreamReader const & src) = delete;
+    ZipStreamReader &           operator = (ZipStreamReader const & rhs) = delete;
+                                ~ZipStreamReader();
+
+    FileEntry::pointer_t        getNextEntry();
+    stream_pointer_t            getInputStream();
+
+private:
+    std::shared_ptr<ZipStreamReaderStreambuf>   m_streambuf;
+    FileEntry::pointer_t        m_entry;
+};
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
+#endif